@@ -0,0 +1,377 @@
+/*
+ * 概要：ステルスセンサーの線の位置(line_error)の推定精度を、従来の重心の計算と比べる
+ * 合成：線の位置を少しずつ動かしてセンサーの生値を作り、line_sensor_stealthのupdate()の結果と真の位置の誤差を求める
+ *       センサーの応答は、見る範囲と白線の重なりの割合(host/simと同じ)と、感度がガウス分布のものの2通りで、ノイズの大きさを変えて試す
+ * 記録：インプットレコーダーの_input.csv(scripts/mcr_log_to_csv.pyの出力)の生値で推定し、従来の重心との差、1msごとの変化量、信頼度を集計する
+ *       真の位置は無いため、ばらつき(1msごとの変化量)で比べる
+ * 使い方：line_position_bench [-r _input.csv ...]
+ * 戻り値：0:成功 1:合成で誤差が許容値を超えた、または中央付近のRMSが従来より大きい 2:ファイルを読めない
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "hal.h"
+#include "calibration.h"
+#include "line_sensor.h"
+#include "stealth.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define BENCH_PITCH_MM ( 15.0 )      // センサーの間隔 LSB:1[mm]
+#define BENCH_SPOT_MM ( 20.0 )       // センサーの見る範囲の幅 LSB:1[mm]
+#define BENCH_LINE_MM ( 20.0 )       // 白線の幅 LSB:1[mm]
+#define BENCH_SIGMA_MM ( 7.0 )       // ガウス分布の応答の標準偏差 LSB:1[mm]
+#define BENCH_STEP_MM ( 0.1 )        // 線を動かす間隔 LSB:1[mm]
+#define BENCH_CENTER_MM ( 7.5 )      // 中央付近として集計する範囲(±) LSB:1[mm]
+#define BENCH_MAX_ERROR_MM ( 2.5 )   // 推定の誤差の許容値 LSB:1[mm]
+#define BENCH_REPEAT ( 4 )           // 線の位置ごとにノイズを変えて試す回数
+#define BENCH_LINE_SIZE ( 1024 )     // _input.csvの1行の最大長
+
+// センサーの応答
+enum e_bench_model {
+    BENCH_MODEL_BOX = 0, // 見る範囲と白線の重なりの割合
+    BENCH_MODEL_GAUSS,   // 感度がガウス分布
+    BENCH_MODEL_NUM,
+};
+
+// 誤差の集計
+typedef struct {
+    double sum2;        // 二乗和
+    double max;         // 絶対値の最大
+    long count;         // 数
+    double center_sum2; // 中央付近の二乗和
+    long center_count;  // 中央付近の数
+} bench_error_t;
+
+// 従来の重心の計算(line_position.hにする前のstealth.hのupdate())
+class legacy_estimator {
+  public:
+    legacy_estimator() : line_error_old( 0 ) {
+    }
+    s4 estimate( const s4 ( &values )[STEALTH_SENSOR_NUM] ) {
+        s4 v[STEALTH_SENSOR_NUM];
+        memcpy( v, values, sizeof( v ) );
+        u1 mount_count = 0;
+        s4 trend = 0; // stealth.hはs1(符号なしのchar)で-1との比較が常に偽になるため、意図どおり符号付きにする
+        s4 trend_old = 0;
+        if ( v[0] > 0 ) {
+            mount_count++;
+            trend_old = 1;
+        }
+        for ( u1 i = 1; i < STEALTH_SENSOR_NUM; i++ ) {
+            trend = ( v[i - 1] < v[i] ) ? 1 : ( v[i - 1] > v[i] ) ? -1 : 0;
+            if ( ( trend_old == 0 || trend_old == -1 ) && trend == 1 ) {
+                mount_count++;
+            }
+            trend_old = trend;
+        }
+        s4 result = 0;
+        if ( mount_count == 2 ) {
+            u1 pivot = 0;
+            u4 diff_pivot_min = UINT32_MAX;
+            for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+                u4 diff_pivot = abs( line_position_of<STEALTH_SENSOR_NUM>( i ) - line_error_old );
+                if ( diff_pivot < diff_pivot_min ) {
+                    pivot = i;
+                    diff_pivot_min = diff_pivot;
+                }
+            }
+            static const s4 weights[] = { 100, 90, 75, 20 };
+            for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+                u1 diff = abs( pivot - i );
+                v[i] = ( diff < 4 ) ? ( v[i] * weights[diff] ) / 100 : 0;
+            }
+        }
+        if ( mount_count == 1 || mount_count == 2 ) {
+            s4 bunshi = 0;
+            s4 bunbo = 0;
+            for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+                bunshi += v[i] * line_position_of<STEALTH_SENSOR_NUM>( i );
+                bunbo += v[i];
+            }
+            result = ( bunbo != 0 ) ? bunshi / bunbo : 0;
+        }
+        line_error_old = result;
+        return result;
+    }
+
+  private:
+    s4 line_error_old;
+};
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static line_sensor_stealth* stealth = static_cast<line_sensor_stealth*>( &ls );
+static const char* const model_names[BENCH_MODEL_NUM] = { "重なり", "ガウス" };
+static const s4 noise_levels[] = { 0, 7, 14 }; // 生値に加える一様ノイズの大きさ(±) LSB:10bitADCの値
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：センサーが白線を見る割合を求める
+ * 引数：model 応答 line 白線の中心 sensor センサーの中心(いずれも横方向の位置 LSB:1[mm])
+ * 戻り値：0.0(全て黒)～1.0(全て白)
+ */
+static double white_ratio( e_bench_model model, double line, double sensor ) {
+    if ( model == BENCH_MODEL_BOX ) {
+        double low = fmax( line - BENCH_LINE_MM / 2, sensor - BENCH_SPOT_MM / 2 );
+        double high = fmin( line + BENCH_LINE_MM / 2, sensor + BENCH_SPOT_MM / 2 );
+        return fmax( 0.0, high - low ) / BENCH_SPOT_MM;
+    }
+    double k = 1.0 / ( BENCH_SIGMA_MM * sqrt( 2.0 ) );
+    return 0.5 * ( erf( ( line + BENCH_LINE_MM / 2 - sensor ) * k ) - erf( ( line - BENCH_LINE_MM / 2 - sensor ) * k ) );
+}
+
+/*
+ * 概要：誤差を集計に加える
+ * 引数：error 集計先 value 誤差 center 中央付近か
+ * 戻り値：なし
+ */
+static void add_error( bench_error_t* error, double value, bool center ) {
+    error->sum2 += value * value;
+    error->max = fmax( error->max, fabs( value ) );
+    error->count++;
+    if ( center ) {
+        error->center_sum2 += value * value;
+        error->center_count++;
+    }
+}
+
+/*
+ * 概要：生値を与えてline_sensor_stealthを更新する
+ * 引数：raw AR3～AL3の生値 10bitADCの値
+ * 戻り値：なし
+ */
+static void update_sensor( const s4 ( &raw )[STEALTH_SENSOR_NUM] ) {
+    for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+        hal_set_analog( stealth_pins[i], constrain( raw[i], 0, ( 1 << ADC_SCAN_BITS ) - 1 ) );
+    }
+    ls.update();
+}
+
+/*
+ * 概要：補正後のセンサー値を取得する
+ * 引数：values 格納先
+ * 戻り値：なし
+ */
+static void corrected_values( s4 ( &values )[STEALTH_SENSOR_NUM] ) {
+    for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+        values[i] = stealth->sensors.corrected[i];
+    }
+}
+
+/*
+ * 概要：合成した生値で推定の誤差を求めて表示する
+ * 引数：なし
+ * 戻り値：true:誤差が許容値以内で、中央付近のRMSが従来以下 false:いずれかの応答とノイズで満たさない
+ * 詳細：線はAR3からAL3の範囲で動かす。真の位置はline_errorの単位に直して比べる
+ */
+static bool run_synthetic() {
+    std::mt19937 rng( 1 );
+    double edge = ( STEALTH_SENSOR_NUM - 1 ) / 2 * BENCH_PITCH_MM;
+    double mm_per_lsb = BENCH_PITCH_MM / LINE_POSITION_PITCH;
+    bool ok = true;
+
+    printf( "合成 線の位置±%.0fmm %.1fmmごと 誤差 LSB:1[mm]\n", edge, BENCH_STEP_MM );
+    printf( "応答      ノイズ  従来:RMS  最大  中央RMS  新:RMS  最大  中央RMS\n" );
+    for ( u1 m = 0; m < BENCH_MODEL_NUM; m++ ) {
+        for ( s4 noise : noise_levels ) {
+            std::uniform_int_distribution<int> dist( -noise, noise );
+            bench_error_t legacy_error = {};
+            bench_error_t new_error = {};
+            legacy_estimator legacy;
+            for ( double line = -edge; line <= edge + 1e-9; line += BENCH_STEP_MM ) {
+                for ( u1 r = 0; r < BENCH_REPEAT; r++ ) {
+                    s4 raw[STEALTH_SENSOR_NUM];
+                    for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+                        double sensor = -edge + i * BENCH_PITCH_MM; // AR3(右)が先頭
+                        s4 black = stealth_black[i]->get();
+                        s4 white = stealth_white[i]->get();
+                        raw[i] = (s4)lround( black + ( white - black ) * white_ratio( (e_bench_model)m, line, sensor ) ) + dist( rng );
+                    }
+                    update_sensor( raw );
+                    s4 values[STEALTH_SENSOR_NUM];
+                    corrected_values( values );
+                    double truth = -line;                  // line_errorは右(AR3の側)が正
+                    bool center = fabs( line ) <= BENCH_CENTER_MM;
+                    add_error( &legacy_error, legacy.estimate( values ) * mm_per_lsb - truth, center );
+                    add_error( &new_error, ls.line_error * mm_per_lsb - truth, center );
+                }
+            }
+            double legacy_center = sqrt( legacy_error.center_sum2 / legacy_error.center_count );
+            double new_center = sqrt( new_error.center_sum2 / new_error.center_count );
+            printf( "%-8s  ±%-4ld  %7.2f %5.2f %8.2f  %6.2f %5.2f %8.2f\n", model_names[m], (long)noise,
+                    sqrt( legacy_error.sum2 / legacy_error.count ), legacy_error.max, legacy_center, sqrt( new_error.sum2 / new_error.count ),
+                    new_error.max, new_center );
+            if ( new_error.max > BENCH_MAX_ERROR_MM || new_center > legacy_center ) {
+                printf( "  失敗: 最大%.2fmm(許容%.2fmm) 中央RMS %.2fmm(従来%.2fmm)\n", new_error.max, BENCH_MAX_ERROR_MM, new_center, legacy_center );
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+/*
+ * 概要：csvの1行をカンマで分割する
+ * 引数：line 行 cells 分割した値の格納先
+ * 戻り値：なし
+ */
+static void split_csv( const std::string& line, std::vector<std::string>* cells ) {
+    size_t pos = 0;
+
+    cells->clear();
+    while ( true ) {
+        size_t comma = line.find( ',', pos );
+        if ( comma == std::string::npos ) {
+            cells->push_back( line.substr( pos ) );
+            return;
+        }
+        cells->push_back( line.substr( pos, comma - pos ) );
+        pos = comma + 1;
+    }
+}
+
+/*
+ * 概要：_input.csvの生値で推定し、集計を表示する
+ * 引数：path ファイル名
+ * 戻り値：成功:true ファイルを読めない、またはステルスセンサーの記録でない:false
+ * 詳細：PARAMETERSの行のうちセンサーの補正値を走行用パラメータへ設定してから推定する
+ */
+static bool run_recorded( const char* path ) {
+    static const char* const raw_names[STEALTH_SENSOR_NUM] = { "AR3", "AR2", "AR1", "AC", "AL1", "AL2", "AL3" };
+    FILE* fp = fopen( path, "r" );
+    char buf[BENCH_LINE_SIZE];
+    std::vector<std::string> cells;
+    int columns[STEALTH_SENSOR_NUM];
+    bool in_parameters = false;
+    bool in_values = false;
+    legacy_estimator legacy;
+    long frames = 0;
+    long found = 0;
+    double diff_sum = 0;
+    double legacy_jitter = 0;
+    double new_jitter = 0;
+    double width_sum = 0;
+    s4 contrast_min = INT32_MAX;
+    double contrast_sum = 0;
+    s4 legacy_prev = 0;
+    s4 new_prev = 0;
+
+    if ( fp == nullptr ) {
+        fprintf( stderr, "%s: ファイルを開けません\n", path );
+        return false;
+    }
+    while ( fgets( buf, sizeof( buf ), fp ) != nullptr ) {
+        std::string line( buf );
+        while ( !line.empty() && ( line.back() == '\n' || line.back() == '\r' ) ) {
+            line.pop_back();
+        }
+        split_csv( line, &cells );
+
+        if ( in_values ) {
+            if ( line.empty() ) {
+                continue;
+            }
+            s4 raw[STEALTH_SENSOR_NUM];
+            for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+                raw[i] = ( columns[i] < (int)cells.size() ) ? (s4)strtol( cells[columns[i]].c_str(), nullptr, 10 ) : 0;
+            }
+            update_sensor( raw );
+            s4 values[STEALTH_SENSOR_NUM];
+            corrected_values( values );
+            s4 legacy_value = legacy.estimate( values );
+            s4 new_value = ls.line_error;
+            if ( frames > 0 ) {
+                legacy_jitter += abs( legacy_value - legacy_prev );
+                new_jitter += abs( new_value - new_prev );
+            }
+            diff_sum += abs( new_value - legacy_value );
+            if ( stealth->line_contrast > 0 ) {
+                found++;
+                width_sum += stealth->line_width;
+                contrast_sum += stealth->line_contrast;
+                contrast_min = ( stealth->line_contrast < contrast_min ) ? stealth->line_contrast : contrast_min;
+            }
+            legacy_prev = legacy_value;
+            new_prev = new_value;
+            frames++;
+        } else if ( line.compare( 0, 8, "time_ms," ) == 0 ) {
+            for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+                columns[i] = -1;
+                for ( size_t c = 0; c < cells.size(); c++ ) {
+                    if ( cells[c] == raw_names[i] ) {
+                        columns[i] = (int)c;
+                    }
+                }
+                if ( columns[i] < 0 ) {
+                    fprintf( stderr, "%s: %sの列がありません(ステルスセンサーの記録ではない)\n", path, raw_names[i] );
+                    fclose( fp );
+                    return false;
+                }
+            }
+            in_values = true;
+        } else if ( line == "PARAMETERS" ) {
+            in_parameters = true;
+        } else if ( in_parameters ) {
+            if ( line.empty() ) {
+                in_parameters = false;
+            } else if ( cells.size() >= 2 ) {
+                for ( parameter* prm : parameters ) {
+                    if ( prm->get_category() == CATEGORY_SENSOR_CALIBRATION && cells[0] == prm->get_short_name() ) {
+                        *prm = (s4)strtol( cells[1].c_str(), nullptr, 10 );
+                    }
+                }
+                ls.reload_calibration();
+            }
+        }
+    }
+    fclose( fp );
+
+    printf( "記録 %s %ldフレーム(線あり%ld)\n", path, frames, found );
+    if ( frames > 1 ) {
+        printf( "  従来との差の平均 %.1f  1msごとの変化量の平均 従来:%.1f 新:%.1f  LSB:1/%d[センサーの間隔]\n", diff_sum / frames,
+                legacy_jitter / ( frames - 1 ), new_jitter / ( frames - 1 ), LINE_POSITION_PITCH );
+    }
+    if ( found > 0 ) {
+        printf( "  線の幅の平均 %.0f  コントラストの平均 %.0f 最小 %ld\n", width_sum / found, contrast_sum / found, (long)contrast_min );
+    }
+    return true;
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main( int argc, char** argv ) {
+    std::vector<const char*> records;
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strcmp( argv[i], "-r" ) == 0 && i + 1 < argc ) {
+            records.push_back( argv[++i] );
+        } else {
+            fprintf( stderr, "使い方: %s [-r _input.csv ...]\n", argv[0] );
+            return 2;
+        }
+    }
+
+    ls.init();
+    bool ok = run_synthetic();
+    for ( const char* path : records ) {
+        if ( !run_recorded( path ) ) {
+            return 2;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+/*
+ * 概要：ステルスセンサーのアナログセンサー補正の処理時間を、従来の実装(センサーごとのオブジェクトとmap())と比べる
+ * 同じ生値の列を両方の実装で補正し、1周期(全センサー)あたりの時間と、補正後の値の差の最大を表示する
+ * sensor_arrayの時間は毎周期の補正(correct())だけで、補正値が変わったときのrefresh()は含まない
+ * ホストのCPUでの比であり、実機のサイクル数はテストモードのprofileコマンド(センサー更新の区間)で確認すること
+ * 使い方：sensor_bench [周期の数]
+ * 戻り値：0:成功 1:補正後の値の差が許容値を超えた
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include "sensor_array.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define BENCH_SENSOR_NUM ( 7 )           // ステルスアームのセンサーの数
+#define BENCH_DEFAULT_CYCLES ( 2000000 ) // 周期の数の既定値
+#define BENCH_PATTERN_NUM ( 4096 )       // 生値の列の長さ(周期ごとに順に使う)
+#define BENCH_TOLERANCE ( 1 )            // 補正後の値の差の許容値(Q16の丸め分)
+
+// 従来の実装(sensor_arrayにする前のstealth.hのAnalogSensor)
+class legacy_sensor {
+  private:
+    constexpr static u1 fine_shift = ADC_SCAN_FINE_BITS - ADC_SCAN_BITS;
+
+  public:
+    u4 raw;
+
+    legacy_sensor( parameter* black, parameter* white ) : black( black ), white( white ) {
+        raw = 0;
+        fine = 0;
+    }
+    void push( u4 fine ) {
+        this->fine = fine;
+        raw = fine >> fine_shift;
+    }
+    u4 get() {
+        return fine;
+    }
+    u4 corrected() {
+        s4 temp = map( get(), black->get() << fine_shift, white->get() << fine_shift, 0, 1023 );
+        temp = constrain( temp, 0, 1023 );
+        return (u4)temp;
+    }
+
+  private:
+    u4 fine;
+    parameter* black;
+    parameter* white;
+};
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static parameter* const bench_black[BENCH_SENSOR_NUM] = { &prm_line_AR3_B, &prm_line_AR2_B, &prm_line_AR1_B, &prm_line_AC_B,
+                                                          &prm_line_AL1_B, &prm_line_AL2_B, &prm_line_AL3_B };
+static parameter* const bench_white[BENCH_SENSOR_NUM] = { &prm_line_AR3_W, &prm_line_AR2_W, &prm_line_AR1_W, &prm_line_AC_W,
+                                                          &prm_line_AL1_W, &prm_line_AL2_W, &prm_line_AL3_W };
+static const pin_size_t bench_pins[BENCH_SENSOR_NUM] = { 0, 1, 2, 3, 4, 5, 6 };
+static u2 patterns[BENCH_PATTERN_NUM][BENCH_SENSOR_NUM];
+static volatile u4 sink; // 最適化で補正が消えないように結果を書き込む
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：経過時間を取得する
+ * 引数：start 開始時刻
+ * 戻り値：経過時間 LSB:1[ns]
+ */
+static double elapsed_ns( std::chrono::steady_clock::time_point start ) {
+    return std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count();
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main( int argc, char** argv ) {
+    long cycles = ( argc > 1 ) ? atol( argv[1] ) : BENCH_DEFAULT_CYCLES;
+    if ( cycles <= 0 ) {
+        fprintf( stderr, "使い方: %s [周期の数]\n", argv[0] );
+        return 1;
+    }
+
+    // センサーごとに補正値を少しずつ変え、黒より下と白より上の値も含めた生値の列を作る
+    std::mt19937 rng( 1 );
+    for ( u1 i = 0; i < BENCH_SENSOR_NUM; i++ ) {
+        *bench_black[i] = 90 + i * 7;
+        *bench_white[i] = 780 + i * 13;
+    }
+    std::uniform_int_distribution<int> dist( 0, ( 1 << ADC_SCAN_FINE_BITS ) - 1 );
+    for ( u4 n = 0; n < BENCH_PATTERN_NUM; n++ ) {
+        for ( u1 i = 0; i < BENCH_SENSOR_NUM; i++ ) {
+            patterns[n][i] = (u2)dist( rng );
+        }
+    }
+
+    legacy_sensor* legacy[BENCH_SENSOR_NUM];
+    for ( u1 i = 0; i < BENCH_SENSOR_NUM; i++ ) {
+        legacy[i] = new legacy_sensor( bench_black[i], bench_white[i] );
+    }
+    static sensor_array<BENCH_SENSOR_NUM> array( bench_pins, bench_black, bench_white );
+    array.refresh(); // 補正値を設定したため(実機ではinit()とパラメータの変更で呼ぶ)
+
+    // 補正後の値を比べる
+    s4 max_diff = 0;
+    for ( u4 n = 0; n < BENCH_PATTERN_NUM; n++ ) {
+        for ( u1 i = 0; i < BENCH_SENSOR_NUM; i++ ) {
+            legacy[i]->push( patterns[n][i] );
+            array.fine[i] = patterns[n][i];
+        }
+        array.correct();
+        for ( u1 i = 0; i < BENCH_SENSOR_NUM; i++ ) {
+            s4 diff = abs( (s4)legacy[i]->corrected() - (s4)array.corrected[i] );
+            max_diff = ( diff > max_diff ) ? diff : max_diff;
+        }
+    }
+
+    // 従来の実装
+    auto start = std::chrono::steady_clock::now();
+    for ( long c = 0; c < cycles; c++ ) {
+        const u2* pattern = patterns[c % BENCH_PATTERN_NUM];
+        u4 sum = 0;
+        for ( u1 i = 0; i < BENCH_SENSOR_NUM; i++ ) {
+            legacy[i]->push( pattern[i] );
+            sum += legacy[i]->corrected();
+        }
+        sink = sum;
+    }
+    double legacy_ns = elapsed_ns( start ) / cycles;
+
+    // sensor_array
+    start = std::chrono::steady_clock::now();
+    for ( long c = 0; c < cycles; c++ ) {
+        const u2* pattern = patterns[c % BENCH_PATTERN_NUM];
+        for ( u1 i = 0; i < BENCH_SENSOR_NUM; i++ ) {
+            array.fine[i] = pattern[i];
+        }
+        array.correct();
+        u4 sum = 0;
+        for ( u1 i = 0; i < BENCH_SENSOR_NUM; i++ ) {
+            sum += array.corrected[i];
+        }
+        sink = sum;
+    }
+    double array_ns = elapsed_ns( start ) / cycles;
+
+    for ( u1 i = 0; i < BENCH_SENSOR_NUM; i++ ) {
+        delete legacy[i];
+    }
+
+    printf( "センサー数 %d 周期 %ld\n", BENCH_SENSOR_NUM, cycles );
+    printf( "従来(map)      %8.1f ns/周期\n", legacy_ns );
+    printf( "sensor_array   %8.1f ns/周期 (%.2f倍)\n", array_ns, legacy_ns / array_ns );
+    printf( "補正後の値の差 最大%ld\n", (long)max_diff );
+    return ( max_diff > BENCH_TOLERANCE ) ? 1 : 0;
+}
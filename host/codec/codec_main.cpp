@@ -0,0 +1,87 @@
+/*
+ * 概要：ログのレコードをsrc/util/delta_codec.hのdelta_encoderで圧縮する(ホストで実行する)
+ * マイコンと同じエンコーダの出力を、scripts/log_codec_bench.pyがmcr_log_to_csv.pyのデコーダで復元して往復を確認するために使う
+ * 使い方：codec [-k キーフレームの間隔] < レコードのテキスト > 圧縮したバイト列
+ *        レコードのテキストは1行1レコードで"mask 値 値 ..."(10進数、空白区切り)
+ *        値はmaskの立っているチャンネルの分だけ、チャンネル番号の小さい順に並べる
+ * 出力：標準出力に圧縮したバイト列(MCRLOG3のレコード部と同じ形式)
+ * 戻り値：0:成功 2:引数、入力の誤り
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "delta_codec.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define CODEC_LINE_SIZE ( 1024 ) // 入力の1行の最大長
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：1行のレコードを読む
+ * 引数：line 行 mask 読んだmask values チャンネル番号で引く値の配列
+ * 戻り値：true:成功 false:形式の誤り
+ */
+static bool parse_record( char* line, uint32_t* mask, int32_t* values ) {
+    char* end;
+    *mask = (uint32_t)strtoul( line, &end, 0 );
+    if ( end == line ) {
+        return false;
+    }
+    for ( uint8_t i = 0; i < DELTA_CODEC_CHANNELS; i++ ) {
+        if ( *mask & ( 1UL << i ) ) {
+            char* p = end;
+            values[i] = (int32_t)strtoll( p, &end, 10 );
+            if ( end == p ) {
+                return false;
+            }
+        }
+    }
+    while ( *end == ' ' || *end == '\t' || *end == '\r' || *end == '\n' ) {
+        end++;
+    }
+    return *end == '\0';
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main( int argc, char** argv ) {
+    long keyframe_interval = DELTA_CODEC_KEYFRAME_INTERVAL;
+    int opt;
+    while ( ( opt = getopt( argc, argv, "k:" ) ) != -1 ) {
+        if ( opt == 'k' && atol( optarg ) > 0 ) {
+            keyframe_interval = atol( optarg );
+        } else {
+            fprintf( stderr, "使い方: %s [-k キーフレームの間隔] < レコードのテキスト > 圧縮したバイト列\n", argv[0] );
+            return 2;
+        }
+    }
+
+    delta_encoder encoder( (uint32_t)keyframe_interval );
+    char line[CODEC_LINE_SIZE];
+    uint8_t out[DELTA_CODEC_RECORD_MAX];
+    int32_t values[DELTA_CODEC_CHANNELS] = { 0 };
+    long line_no = 0;
+    while ( fgets( line, sizeof( line ), stdin ) != nullptr ) {
+        line_no++;
+        uint32_t mask;
+        if ( !parse_record( line, &mask, values ) ) {
+            fprintf( stderr, "%ld行目: レコードの形式が正しくありません\n", line_no );
+            return 2;
+        }
+        fwrite( out, 1, encoder.encode( mask, values, out ), stdout );
+    }
+    return 0;
+}
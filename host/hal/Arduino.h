@@ -0,0 +1,170 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のArduino API
+ * 制御コードが使う分だけを実装する。ピンの入力値と時刻はhal.hの関数で外から与える
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <array>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define HIGH ( 1 )
+#define LOW ( 0 )
+
+#define INPUT ( 0 )
+#define OUTPUT ( 1 )
+#define INPUT_PULLUP ( 2 )
+
+#define PI ( 3.1415926535897932384626433832795 )
+#define DEG_TO_RAD ( 0.017453292519943295769236907684886 )
+#define RAD_TO_DEG ( 57.295779513082320876798154814105 )
+
+#define constrain( amt, low, high ) ( ( amt ) < ( low ) ? ( low ) : ( ( amt ) > ( high ) ? ( high ) : ( amt ) ) )
+#define radians( deg ) ( ( deg ) * DEG_TO_RAD )
+#define degrees( rad ) ( ( rad ) * RAD_TO_DEG )
+#define sq( x ) ( ( x ) * ( x ) )
+
+#define F( s ) ( s )
+
+#define NUM_DIGITAL_PINS ( 82 )
+
+typedef uint8_t byte;
+typedef int pin_size_t;
+
+// Arduino UNO R4(RA4M1)と同じピン番号
+enum {
+    D0, D1, D2, D3, D4, D5, D6, D7, D8, D9, D10, D11, D12, D13, D14, D15, D16, D17, D18, D19, D20,
+    D21, D22, D23, D24, D25, D26, D27, D28, D29, D30, D31, D32, D33, D34, D35, D36, D37, D38, D39, D40, D41,
+    D42, D43, D44, D45, D46, D47, D48, D49, D50, D51, D52, D53, D54, D55, D56, D57, D58, D59, D60, D61, D62,
+    D63, D64, D65, D66, D67, D68, D69, D70, D71, D72, D73, D74, D75, D76, D77, D78, D79, D80, D81,
+};
+#define A0 ( D14 )
+#define A1 ( D15 )
+#define A2 ( D16 )
+#define A3 ( D17 )
+#define A4 ( D18 )
+#define A5 ( D19 )
+
+// ピンの設定(my_digital_read()が使う)
+typedef struct {
+    uint16_t pin;
+} pin_cfg_t;
+extern const pin_cfg_t* const g_pin_cfg;
+
+// GPT(汎用PWMタイマ)のレジスタ(mcr_gpt_lib.hが使うものだけ)
+typedef struct {
+    volatile uint32_t GTCNT;
+    volatile uint32_t GTCCR[6];
+    struct {
+        volatile uint32_t CST;
+    } GTCR_b;
+} gpt_regs_t;
+extern gpt_regs_t hal_gpt[8];
+#define R_GPT0 ( &hal_gpt[0] )
+#define R_GPT1 ( &hal_gpt[1] )
+#define R_GPT2 ( &hal_gpt[2] )
+#define R_GPT3 ( &hal_gpt[3] )
+#define R_GPT4 ( &hal_gpt[4] )
+#define R_GPT5 ( &hal_gpt[5] )
+#define R_GPT6 ( &hal_gpt[6] )
+#define R_GPT7 ( &hal_gpt[7] )
+
+// getPinCfgs()の戻り値 bit0-2:GPTのチャンネル bit3:A端子ならセット
+#define PIN_CFG_REQ_PWM ( 1 )
+#define GET_CHANNEL( cfg ) ( ( cfg ) & 0x07 )
+#define IS_PWM_ON_A( cfg ) ( ( ( cfg ) & 0x08 ) != 0 )
+
+typedef struct {
+    void* p_context;
+} timer_callback_args_t;
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：シリアル通信
+ * 送信した文字列は標準出力へ出し、受信は常に空とする
+ */
+class HardwareSerial {
+  public:
+    void begin( unsigned long baud ) {
+        (void)baud;
+    }
+    size_t write( uint8_t c ) {
+        return fwrite( &c, 1, 1, stdout );
+    }
+    size_t write( const void* buf, size_t len ) {
+        return fwrite( buf, 1, len, stdout );
+    }
+    size_t print( const char* s ) {
+        return fputs( s, stdout ) < 0 ? 0 : strlen( s );
+    }
+    size_t println( const char* s = "" ) {
+        return print( s ) + print( "\n" );
+    }
+    int availableForWrite() {
+        return 4096;
+    }
+    int available() {
+        return 0;
+    }
+    int read() {
+        return -1;
+    }
+    void flush() {
+        fflush( stdout );
+    }
+    operator bool() {
+        return true;
+    }
+};
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+void pinMode( pin_size_t pin, int mode );
+void digitalWrite( pin_size_t pin, int value );
+int digitalRead( pin_size_t pin );
+int analogRead( pin_size_t pin );
+void analogReadResolution( int bits );
+uint32_t millis();
+uint32_t micros();
+void delay( uint32_t ms );
+void delayMicroseconds( uint32_t us );
+void noInterrupts();
+void interrupts();
+uint32_t R_BSP_PinRead( uint16_t pin );
+std::array<uint16_t, 3> getPinCfgs( pin_size_t pin, int req );
+
+/*
+ * 概要：値の範囲を変換する
+ * 詳細：マイコン(longが32bit)と同じ結果になるよう、32bitで計算する(積のオーバーフローも同じように折り返す)
+ *      0での割り算はマイコン(Cortex-M4)と同じく商を0とする
+ */
+static inline int32_t map( int32_t x, int32_t in_min, int32_t in_max, int32_t out_min, int32_t out_max ) {
+    int32_t num = (int32_t)( (uint32_t)( x - in_min ) * (uint32_t)( out_max - out_min ) );
+    int32_t den = in_max - in_min;
+    return ( den != 0 ? num / den : 0 ) + out_min;
+}
+
+// 戻り値は値で返す(decltype(a < b ? a : b)は同じ型の場合に引数への参照になるため使わない)
+template <typename T, typename U> static inline auto min( T a, U b ) {
+    return a < b ? a : b;
+}
+template <typename T, typename U> static inline auto max( T a, U b ) {
+    return a > b ? a : b;
+}
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern HardwareSerial Serial;
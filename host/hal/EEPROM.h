@@ -0,0 +1,55 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のEEPROM(メモリ上に持つ)
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define HAL_EEPROM_SIZE ( 8192 ) // RA4M1のデータフラッシュの容量
+
+/***********************************/
+/* Class                           */
+/***********************************/
+class EEPROMClass {
+  public:
+    EEPROMClass() {
+        memset( data, 0xFF, sizeof( data ) );
+    }
+    uint8_t read( int idx ) {
+        return data[idx];
+    }
+    void write( int idx, uint8_t val ) {
+        data[idx] = val;
+    }
+    void update( int idx, uint8_t val ) {
+        data[idx] = val;
+    }
+    template <typename T> T& get( int idx, T& t ) {
+        memcpy( &t, &data[idx], sizeof( T ) );
+        return t;
+    }
+    template <typename T> const T& put( int idx, const T& t ) {
+        memcpy( &data[idx], &t, sizeof( T ) );
+        return t;
+    }
+    uint16_t length() {
+        return HAL_EEPROM_SIZE;
+    }
+    uint8_t* raw() {
+        return data;
+    }
+
+  private:
+    uint8_t data[HAL_EEPROM_SIZE];
+};
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern EEPROMClass EEPROM;
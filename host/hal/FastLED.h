@@ -0,0 +1,6 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のFastLED(pin_defines.hのピン定義のみ)
+ */
+#pragma once
+
+#define _FL_DEFPIN( pin, bit, base )
@@ -0,0 +1,74 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のFspTimer
+ * start()でコールバックをhal.cppの仮想時計へ登録し、時刻が周期をまたぐごとに呼ぶ
+ */
+#pragma once
+#include "Arduino.h"
+#include "hal.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+typedef enum { TIMER_MODE_PERIODIC, TIMER_MODE_ONE_SHOT, TIMER_MODE_PWM } timer_mode_t;
+typedef enum { GPT_TIMER, AGT_TIMER } timer_type_t;
+typedef enum { TIMER_SOURCE_DIV_1 = 0 } timer_source_div_t;
+typedef enum { IRQ_AGT, IRQ_GPT } irq_peripheral_t;
+
+#define HAL_TIMER_CLOCK_MHZ ( 24 ) // 周期のカウントクロック(PCLKB) LSB:1[MHz]
+
+typedef void ( *timer_callback_t )( timer_callback_args_t* p_args );
+
+/***********************************/
+/* Class                           */
+/***********************************/
+class FspTimer {
+  public:
+    bool begin( timer_mode_t mode, timer_type_t type, uint8_t channel, uint32_t period, uint32_t pulse, timer_source_div_t sd,
+                timer_callback_t cbk ) {
+        (void)mode;
+        (void)type;
+        (void)channel;
+        (void)pulse;
+        (void)sd;
+        period_us = ( period + 1 ) / HAL_TIMER_CLOCK_MHZ;
+        callback = cbk;
+        return true;
+    }
+    bool open() {
+        return true;
+    }
+    bool start() {
+        hal_attach_timer( callback, period_us );
+        return true;
+    }
+    bool stop() {
+        hal_attach_timer( nullptr, 0 );
+        return true;
+    }
+    void* get_cfg() {
+        return this;
+    }
+    timer_callback_t get_callback() {
+        return callback;
+    }
+
+  private:
+    timer_callback_t callback = nullptr;
+    uint32_t period_us = 0; // 周期 LSB:1[us]
+};
+
+class IRQManager {
+  public:
+    static IRQManager& getInstance() {
+        static IRQManager instance;
+        return instance;
+    }
+    bool addPeripheral( irq_peripheral_t p, void* cfg ) {
+        (void)p;
+        (void)cfg;
+        return true;
+    }
+};
@@ -0,0 +1,5 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のLibPrintf(標準のprintfを使う)
+ */
+#pragma once
+#include <stdio.h>
@@ -0,0 +1,4 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のWire.h(I2Cは使わないため空)
+ */
+#pragma once
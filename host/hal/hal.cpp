@@ -0,0 +1,394 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のArduino APIとハードウェアの状態
+ * デジタル入力は設定しない限りHIGH(プルアップされたボタンとスイッチは開放)、アナログ入力は0とする
+ * 時刻は仮想時計で、hal_advance_us()、delay()、またはmillis()とmicros()の呼び出し(hal_set_poll_cost_us())で進む
+ * 時刻が周期タイマーの周期をまたいだときに登録されたコールバックを呼ぶ(割り込み禁止中は許可されるまで遅らせる)
+ */
+#include <EEPROM.h>
+#include "Arduino.h"
+#include "hal.h"
+#include "mcr_gpt_lib.h"
+#include "cycle_counter.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+// GPTの端子に割り当てたピン(pin_defines.hのモーターのpwmピン)
+typedef struct {
+    pin_size_t pin;
+    uint8_t channel;
+    bool is_a;
+} pwm_pin_t;
+
+static const pwm_pin_t pwm_pins[] = {
+    { D47, 0, false }, { D46, 0, true },  // FL
+    { D2, 1, true },   { D3, 1, false },  // FR
+    { D76, 4, true },  { D75, 4, false }, // RL
+    { D67, 2, false }, { D68, 2, true },  // RR
+    { D53, 5, false }, { D52, 5, true },  // SV
+};
+
+// ピン番号をそのままポートとビットの値にする(my_digital_read()でR_BSP_PinRead()に渡る)
+struct pin_cfg_table {
+    pin_cfg_t cfg[NUM_DIGITAL_PINS];
+    constexpr pin_cfg_table() : cfg() {
+        for ( uint16_t i = 0; i < NUM_DIGITAL_PINS; i++ ) {
+            cfg[i].pin = i;
+        }
+    }
+};
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static uint64_t now_us = 0;                   // 現在時刻 LSB:1[us]
+static uint32_t poll_cost_us = 0;             // millis()とmicros()を1回呼ぶごとに進める時間 LSB:1[us]
+static bool digital_low[NUM_DIGITAL_PINS];    // 入力がLOWのピン(初期値はHIGHとするため反転して持つ)
+static uint8_t digital_out[NUM_DIGITAL_PINS]; // digitalWrite()した値
+static int analog_in[NUM_DIGITAL_PINS];       // アナログ入力の値
+static int interrupt_depth = 0;               // noInterrupts()の入れ子の数
+static constexpr pin_cfg_table pin_cfg;
+
+// 周期タイマー(FspTimer)
+static hal_timer_callback_t timer_callback = nullptr; // 周期ごとに呼ぶコールバック
+static uint32_t timer_period_us = 0;                  // 周期 LSB:1[us]
+static uint64_t timer_next_us = 0;                    // 次にコールバックを呼ぶ時刻 LSB:1[us]
+static bool timer_pending = false;                    // 割り込み禁止中、またはコールバック中に周期をまたいだ
+static bool in_timer = false;                         // コールバックの実行中
+static uint32_t timer_count = 0;                      // コールバックを呼んだ回数
+static hal_tick_hook_t tick_hook = nullptr;           // 周期をまたぐごとにコールバックより先に呼ぶ関数
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+gpt_regs_t hal_gpt[8];
+const pin_cfg_t* const g_pin_cfg = pin_cfg.cfg;
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+static bool valid_pin( pin_size_t pin ) {
+    return 0 <= pin && pin < NUM_DIGITAL_PINS;
+}
+
+/*
+ * 概要：時刻を進める(戻さない)
+ * 引数：us 時刻 LSB:1[us]
+ * 戻り値：なし
+ * 詳細：サイクルカウンタ(cycle_counter_stub)も同じだけ進める
+ */
+static void move_to( uint64_t us ) {
+    if ( us > now_us ) {
+        cycle_counter_stub += (uint32_t)( ( us - now_us ) * CYCLES_PER_US );
+        now_us = us;
+    }
+}
+
+/*
+ * 概要：周期タイマーのコールバックを呼ぶ
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：割り込み禁止中とコールバック中は保留し、割り込み許可またはコールバックの終了時に呼ぶ(マイコンの割り込み要求フラグと同じ)
+ */
+static void fire_timer() {
+    if ( in_timer || interrupt_depth > 0 ) {
+        timer_pending = true;
+        return;
+    }
+    timer_callback_args_t args = { nullptr };
+    in_timer = true;
+    do {
+        timer_pending = false;
+        timer_count++;
+        timer_callback( &args );
+    } while ( timer_pending && timer_callback != nullptr );
+    in_timer = false;
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：Arduino API
+ * 詳細：ピンの設定とアナログの分解能は何もしない。入力値はhal_set_xxx()で設定した値を返す
+ */
+void pinMode( pin_size_t pin, int mode ) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite( pin_size_t pin, int value ) {
+    if ( valid_pin( pin ) ) {
+        digital_out[pin] = value ? HIGH : LOW;
+    }
+}
+
+int digitalRead( pin_size_t pin ) {
+    return ( valid_pin( pin ) && digital_low[pin] ) ? LOW : HIGH;
+}
+
+int analogRead( pin_size_t pin ) {
+    return valid_pin( pin ) ? analog_in[pin] : 0;
+}
+
+void analogReadResolution( int bits ) {
+    (void)bits;
+}
+
+uint32_t millis() {
+    if ( poll_cost_us != 0 ) {
+        hal_advance_us( poll_cost_us );
+    }
+    return (uint32_t)( now_us / 1000 );
+}
+
+uint32_t micros() {
+    if ( poll_cost_us != 0 ) {
+        hal_advance_us( poll_cost_us );
+    }
+    return (uint32_t)now_us;
+}
+
+void delay( uint32_t ms ) {
+    hal_advance_us( (uint64_t)ms * 1000 );
+}
+
+void delayMicroseconds( uint32_t us ) {
+    hal_advance_us( us );
+}
+
+void noInterrupts() {
+    interrupt_depth++;
+}
+
+void interrupts() {
+    if ( interrupt_depth > 0 ) {
+        interrupt_depth--;
+    }
+    if ( interrupt_depth == 0 && timer_pending && !in_timer && timer_callback != nullptr ) {
+        fire_timer();
+    }
+}
+
+uint32_t R_BSP_PinRead( uint16_t pin ) {
+    return digitalRead( pin );
+}
+
+/*
+ * 概要：ピンに割り当てたGPTの端子を取得する
+ * 引数：pin ピン番号 req PIN_CFG_REQ_PWM
+ * 戻り値：[0]のみ有効 GET_CHANNEL()でチャンネル、IS_PWM_ON_A()でA端子かを取り出す
+ */
+std::array<uint16_t, 3> getPinCfgs( pin_size_t pin, int req ) {
+    std::array<uint16_t, 3> cfg {};
+    (void)req;
+    for ( const pwm_pin_t& p : pwm_pins ) {
+        if ( p.pin == pin ) {
+            cfg[0] = p.channel | ( p.is_a ? 0x08 : 0x00 );
+        }
+    }
+    return cfg;
+}
+
+/*
+ * 概要：時刻を設定する
+ * 引数：ms millis()の値 LSB:1[ms] / us micros()の値 LSB:1[us]
+ * 戻り値：なし
+ * 詳細：周期タイマーのコールバックは呼ばない(再生のように時刻を外から与える場合に使う)
+ */
+void hal_set_millis( uint32_t ms ) {
+    now_us = (uint64_t)ms * 1000;
+}
+
+void hal_set_micros( uint32_t us ) {
+    now_us = us;
+}
+
+/*
+ * 概要：時刻を進める
+ * 引数：us 進める時間 LSB:1[us]
+ * 戻り値：なし
+ * 詳細：周期タイマーの周期をまたぐごとにその時刻でコールバックを呼ぶ
+ *      hal_set_tick_hook()の関数は、割り込み禁止中でもコールバックより先にその時刻で呼ぶ
+ *      コールバックの中で時刻が進んだ場合(millis()の呼び出しなど)、その分だけ遅れて戻る
+ */
+void hal_advance_us( uint64_t us ) {
+    uint64_t target = now_us + us;
+
+    while ( timer_callback != nullptr && timer_next_us <= target ) {
+        move_to( timer_next_us );
+        timer_next_us += timer_period_us;
+        if ( tick_hook != nullptr ) {
+            tick_hook();
+        }
+        fire_timer();
+        target = max( target, now_us );
+    }
+    move_to( target );
+}
+
+/*
+ * 概要：millis()とmicros()を1回呼ぶごとに進める時間を設定する
+ * 引数：us 時間 LSB:1[us] 0なら進めない(初期値)
+ * 戻り値：なし
+ * 詳細：wait_ms()のように時刻が進むのを待つコードを、仮想時計で動かすために使う
+ */
+void hal_set_poll_cost_us( uint32_t us ) {
+    poll_cost_us = us;
+}
+
+/*
+ * 概要：周期タイマーのコールバックを登録する
+ * 引数：callback コールバック(nullptrで停止) period_us 周期 LSB:1[us]
+ * 戻り値：なし
+ * 詳細：FspTimer::start()とstop()から呼ばれる。最初のコールバックは現在時刻から1周期後
+ */
+void hal_attach_timer( hal_timer_callback_t callback, uint32_t period_us ) {
+    timer_callback = ( period_us != 0 ) ? callback : nullptr;
+    timer_period_us = period_us;
+    timer_next_us = now_us + period_us;
+    timer_pending = false;
+}
+
+/*
+ * 概要：周期タイマーの周期をまたぐごとに呼ぶ関数を登録する
+ * 引数：hook 関数(nullptrで解除)
+ * 戻り値：なし
+ * 詳細：シミュレーションで、1msタスクがセンサーを読む前に車体とセンサーの状態を進めるために使う
+ */
+void hal_set_tick_hook( hal_tick_hook_t hook ) {
+    tick_hook = hook;
+}
+
+/*
+ * 概要：周期タイマーのコールバックを呼んだ回数を取得する
+ * 引数：なし
+ * 戻り値：回数
+ */
+uint32_t hal_get_timer_count() {
+    return timer_count;
+}
+
+/*
+ * 概要：デジタル入力の値を設定する
+ * 引数：pin ピン番号 level HIGH or LOW
+ * 戻り値：なし
+ * 詳細：digitalRead()とmy_digital_read()の両方に反映する
+ */
+void hal_set_digital( pin_size_t pin, int level ) {
+    if ( valid_pin( pin ) ) {
+        digital_low[pin] = ( level == LOW );
+    }
+}
+
+/*
+ * 概要：digitalWrite()した値を取得する
+ * 引数：pin ピン番号
+ * 戻り値：HIGH or LOW
+ */
+int hal_get_digital_out( pin_size_t pin ) {
+    return valid_pin( pin ) ? digital_out[pin] : LOW;
+}
+
+/*
+ * 概要：アナログ入力の値を設定する
+ * 引数：pin ピン番号 value analogRead()が返す値
+ * 戻り値：なし
+ */
+void hal_set_analog( pin_size_t pin, int value ) {
+    if ( valid_pin( pin ) ) {
+        analog_in[pin] = value;
+    }
+}
+
+/*
+ * 概要：noInterrupts()の入れ子の数を取得する
+ * 引数：なし
+ * 戻り値：0なら割り込み許可
+ */
+int hal_get_interrupt_depth() {
+    return interrupt_depth;
+}
+
+/*
+ * 概要：EEPROMの内容をファイルから読む
+ * 引数：path ファイル名
+ * 戻り値：成功:true ファイルが無い、または大きさが違う:false(内容は変えない)
+ */
+bool hal_eeprom_load( const char* path ) {
+    FILE* fp = fopen( path, "rb" );
+    uint8_t buf[HAL_EEPROM_SIZE];
+    bool ok;
+
+    if ( fp == nullptr ) {
+        return false;
+    }
+    ok = ( fread( buf, 1, sizeof( buf ), fp ) == sizeof( buf ) );
+    fclose( fp );
+    if ( ok ) {
+        memcpy( EEPROM.raw(), buf, sizeof( buf ) );
+    }
+    return ok;
+}
+
+/*
+ * 概要：EEPROMの内容をファイルへ書き込む
+ * 引数：path ファイル名
+ * 戻り値：成功:true 失敗:false
+ */
+bool hal_eeprom_save( const char* path ) {
+    FILE* fp = fopen( path, "wb" );
+    bool ok;
+
+    if ( fp == nullptr ) {
+        return false;
+    }
+    ok = ( fwrite( EEPROM.raw(), 1, HAL_EEPROM_SIZE, fp ) == HAL_EEPROM_SIZE );
+    return ( fclose( fp ) == 0 ) && ok;
+}
+
+/*
+ * 概要：mcr_gpt_libのGPTの設定(ホストではレジスタの値のみ持つため、何もしない)
+ */
+void setGPTterminal( uint8_t port1, uint8_t port2 ) {
+    (void)port1;
+    (void)port2;
+}
+
+#define HAL_START_PWM_GPT( n )                                                                                                                       \
+    void startPWM_GPT##n( uint8_t ch_ab, uint8_t div, uint16_t syuuki ) {                                                                            \
+        (void)ch_ab;                                                                                                                                 \
+        (void)div;                                                                                                                                   \
+        (void)syuuki;                                                                                                                                \
+        hal_gpt[n].GTCR_b.CST = 1;                                                                                                                   \
+    }                                                                                                                                                \
+    void startGPT##n##_1SouEncoder( uint8_t ch_ab, uint8_t port1, uint8_t port2 ) {                                                                  \
+        (void)ch_ab;                                                                                                                                 \
+        (void)port1;                                                                                                                                 \
+        (void)port2;                                                                                                                                 \
+        hal_gpt[n].GTCR_b.CST = 1;                                                                                                                   \
+    }                                                                                                                                                \
+    void startGPT##n##_2SouEncoder( uint8_t port1_1, uint8_t port2_1, uint8_t port1_2, uint8_t port2_2 ) {                                           \
+        (void)port1_1;                                                                                                                               \
+        (void)port2_1;                                                                                                                               \
+        (void)port1_2;                                                                                                                               \
+        (void)port2_2;                                                                                                                               \
+        hal_gpt[n].GTCR_b.CST = 1;                                                                                                                   \
+    }
+
+HAL_START_PWM_GPT( 0 )
+HAL_START_PWM_GPT( 1 )
+HAL_START_PWM_GPT( 2 )
+HAL_START_PWM_GPT( 3 )
+HAL_START_PWM_GPT( 4 )
+HAL_START_PWM_GPT( 5 )
+HAL_START_PWM_GPT( 6 )
+HAL_START_PWM_GPT( 7 )
@@ -0,0 +1,41 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のハードウェアの状態を外から設定、参照する
+ * 再生やシミュレーションのコードから、ピンの入力値と時刻を与える
+ */
+#pragma once
+#include <stdint.h>
+#include "Arduino.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+typedef void ( *hal_timer_callback_t )( timer_callback_args_t* p_args );
+typedef void ( *hal_tick_hook_t )( void );
+
+/***********************************/
+/* Class                           */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+void hal_set_millis( uint32_t ms );
+void hal_set_micros( uint32_t us );
+void hal_advance_us( uint64_t us );
+void hal_set_poll_cost_us( uint32_t us );
+void hal_attach_timer( hal_timer_callback_t callback, uint32_t period_us );
+void hal_set_tick_hook( hal_tick_hook_t hook );
+uint32_t hal_get_timer_count();
+void hal_set_digital( pin_size_t pin, int level );
+int hal_get_digital_out( pin_size_t pin );
+void hal_set_analog( pin_size_t pin, int value );
+int hal_get_interrupt_depth();
+bool hal_eeprom_load( const char* path );
+bool hal_eeprom_save( const char* path );
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
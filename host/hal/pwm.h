@@ -0,0 +1,4 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のpwm.h(モーターのpwmはmcr_gpt_libのレジスタで扱うため空)
+ */
+#pragma once
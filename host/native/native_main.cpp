@@ -0,0 +1,153 @@
+/*
+ * 概要：ファームウェアのsetup()とloop()をホスト(Linux)の仮想時計で実行する
+ * 1msタスクはsetup()でFspTimerに登録したtimer_1ms_task()を、仮想時計が1msをまたぐごとに呼ぶ
+ * センサーの入力はhal.hの関数で与える(何も与えなければボタンとスイッチは開放、アナログ入力は0)
+ * 使い方：native [-t 実行時間ms] [-l loop()1回の時間us] [-p millis()1回の時間us] [-e EEPROMファイル]
+ *                [-b バッテリー電圧0.01V] [-d DIPスイッチ] [-s スタートボタンを押す時刻ms]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "defines.h"
+#include "pin_defines.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define BUTTON_PRESS_MS ( 100 ) // スタートボタンを押している時間 LSB:1[ms]
+
+// 実行条件
+typedef struct {
+    u4 run_ms;            // 実行時間(setup()の後から) LSB:1[ms]
+    u4 loop_us;           // loop()1回の処理時間 LSB:1[us]
+    u4 poll_us;           // millis()とmicros()1回の処理時間 LSB:1[us]
+    const char* eeprom;   // EEPROMの内容を保存するファイル(nullptrなら保存しない)
+    u4 battery;           // バッテリー電圧 LSB:0.01[V]
+    u1 dip_switch;        // DIPスイッチ bit0:SW1 bit1:SW2 bit2:SW3 bit3:SW4 bit4:board_sw1 bit5:board_sw2
+    s4 start_ms;          // スタートボタンを押す時刻(setup()の後から) LSB:1[ms] 負なら押さない
+} native_options_t;
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern u1 run_mode;
+extern void setup();
+extern void loop();
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：コマンドライン引数を読む
+ * 引数：argc、argv main()の引数 opt 実行条件の格納先
+ * 戻り値：成功:true 不明な引数:false
+ */
+static bool parse_options( int argc, char** argv, native_options_t* opt ) {
+    opt->run_ms = 10000;
+    opt->loop_us = 100;
+    opt->poll_us = 1;
+    opt->eeprom = nullptr;
+    opt->battery = 800;
+    opt->dip_switch = 0x02; // 3秒待ちスタート
+    opt->start_ms = -1;
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( i + 1 >= argc || argv[i][0] != '-' || strlen( argv[i] ) != 2 ) {
+            return false;
+        }
+        const char* value = argv[++i];
+        switch ( argv[i - 1][1] ) {
+        case 't':
+            opt->run_ms = strtoul( value, nullptr, 0 );
+            break;
+        case 'l':
+            opt->loop_us = strtoul( value, nullptr, 0 );
+            break;
+        case 'p':
+            opt->poll_us = strtoul( value, nullptr, 0 );
+            break;
+        case 'e':
+            opt->eeprom = value;
+            break;
+        case 'b':
+            opt->battery = strtoul( value, nullptr, 0 );
+            break;
+        case 'd':
+            opt->dip_switch = (u1)strtoul( value, nullptr, 0 );
+            break;
+        case 's':
+            opt->start_ms = strtol( value, nullptr, 0 );
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * 概要：DIPスイッチとバッテリー電圧の入力を設定する
+ * 引数：opt 実行条件
+ * 戻り値：なし
+ * 詳細：スイッチはプルアップのため、オンでLOWにする。バッテリー電圧はsensors.cppのbattery_update()の逆算
+ */
+static void set_static_inputs( const native_options_t* opt ) {
+    hal_set_digital( PIN_DIPSW_1, ( opt->dip_switch & 0x01 ) ? LOW : HIGH );
+    hal_set_digital( PIN_DIPSW_2, ( opt->dip_switch & 0x02 ) ? LOW : HIGH );
+    hal_set_digital( PIN_DIPSW_3, ( opt->dip_switch & 0x04 ) ? LOW : HIGH );
+    hal_set_digital( PIN_DIPSW_4, ( opt->dip_switch & 0x08 ) ? LOW : HIGH );
+    hal_set_digital( PIN_BOARD_DIPSW_1, ( opt->dip_switch & 0x10 ) ? LOW : HIGH );
+    hal_set_digital( PIN_BOARD_DIPSW_2, ( opt->dip_switch & 0x20 ) ? LOW : HIGH );
+    hal_set_analog( PIN_BATT_VOLTAGE, opt->battery * 4096 / 1400 );
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main( int argc, char** argv ) {
+    native_options_t opt;
+    u4 loop_num = 0;
+
+    if ( !parse_options( argc, argv, &opt ) ) {
+        fprintf( stderr, "使い方: %s [-t 実行時間ms] [-l loop()1回の時間us] [-p millis()1回の時間us] [-e EEPROMファイル]\n"
+                         "          [-b バッテリー電圧0.01V] [-d DIPスイッチ] [-s スタートボタンを押す時刻ms]\n",
+                 argv[0] );
+        return 2;
+    }
+    if ( opt.eeprom != nullptr && !hal_eeprom_load( opt.eeprom ) ) {
+        fprintf( stderr, "%s: 読めないため、EEPROMを消去した状態で開始します\n", opt.eeprom );
+    }
+    set_static_inputs( &opt );
+    hal_set_poll_cost_us( opt.poll_us );
+
+    setup();
+    u4 start = millis();
+    u4 elapsed = 0;
+    while ( elapsed < opt.run_ms ) {
+        bool press = ( opt.start_ms >= 0 ) && ( elapsed >= (u4)opt.start_ms ) && ( elapsed < (u4)opt.start_ms + BUTTON_PRESS_MS );
+        hal_set_digital( PIN_BUTTON_START, press ? LOW : HIGH );
+        loop();
+        loop_num++;
+        hal_advance_us( opt.loop_us );
+        elapsed = millis() - start;
+    }
+
+    if ( opt.eeprom != nullptr && !hal_eeprom_save( opt.eeprom ) ) {
+        fprintf( stderr, "%s: EEPROMを保存できません\n", opt.eeprom );
+    }
+    fprintf( stderr, "%u ms: loop() %u回, 1msタスク %u回, run_mode=%u\n", (unsigned)elapsed, (unsigned)loop_num, (unsigned)hal_get_timer_count(),
+             run_mode );
+    return 0;
+}
@@ -0,0 +1,342 @@
+/*
+ * 概要：インプットレコーダーの記録を再生し、制御コードの出力が記録と一致するか確認する
+ * scripts/mcr_log_to_csv.pyが出力した_input.csvを読み、1msタスクと走行制御の入力をフレームごとに与えて実行する
+ * 使い方：replay <出力ファイル名_input.csv> [-v]
+ *        -v 一致しなかった値を全て表示する(省略時は先頭の20個)
+ * 戻り値：0:全て一致 1:不一致あり 2:ファイルを読めない、または記録のチャンネルがこのビルドと異なる
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "hal.h"
+#include "calibration.h"
+#include "input_log.h"
+#include "line_sensor.h"
+#include "motor_control.h"
+#include "sensors.h"
+#include "target_speed.h"
+#include "time_measure.h"
+#include "mcr_gpt_lib.h"
+#include "pin_defines.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define MISMATCH_PRINT_MAX ( 20 ) // -v無しで表示する不一致の数
+
+// 比較する値
+typedef struct {
+    const char* name;
+    s4 expected; // 記録の値(s1はcharが符号なしでも負の値で表示するため、int8_tにして渡す)
+    s4 actual;   // 再生の値
+} compare_t;
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static u4 mismatch_num = 0; // 一致しなかった値の数
+static bool verbose = false;
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern u1 run_mode;
+extern u1 run_status;
+extern time_measure timer_start_mode_timer;
+extern void ruuning();
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：csvの1行をカンマで分割する
+ * 引数：line 行 cells 分割した値の格納先
+ * 戻り値：なし
+ */
+static void split_csv( const std::string& line, std::vector<std::string>* cells ) {
+    size_t pos = 0;
+
+    cells->clear();
+    while ( true ) {
+        size_t comma = line.find( ',', pos );
+        if ( comma == std::string::npos ) {
+            cells->push_back( line.substr( pos ) );
+            return;
+        }
+        cells->push_back( line.substr( pos, comma - pos ) );
+        pos = comma + 1;
+    }
+}
+
+/*
+ * 概要：プログラム情報のパラメータを走行用パラメータへ設定する
+ * 引数：cells "短縮名,値,説明"を分割したもの
+ * 戻り値：設定した:true 短縮名が見つからない:false
+ */
+static bool apply_parameter( const std::vector<std::string>& cells ) {
+    if ( cells.size() < 2 ) {
+        return false;
+    }
+    for ( parameter* prm : parameters ) {
+        if ( cells[0] == prm->get_short_name() ) {
+            *prm = (s4)strtol( cells[1].c_str(), nullptr, 10 );
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * 概要：_input.csvを読む
+ * 引数：path ファイル名 frames フレームの格納先
+ * 戻り値：成功:true 失敗:false
+ * 詳細：PARAMETERSの行は走行用パラメータへ設定する
+ *      値の列はinput_channelsと名前と順番が一致していること(ラインセンサーの種類が同じビルドであること)
+ *      値の格納位置は、input_channelsの格納場所のアドレスの先頭(time_ms)からの差で求める
+ */
+static bool read_input_csv( const char* path, std::vector<input_frame_t>* frames ) {
+    FILE* fp = fopen( path, "r" );
+    char buf[1024];
+    std::vector<std::string> cells;
+    bool in_parameters = false;
+    bool in_values = false;
+
+    if ( fp == nullptr ) {
+        fprintf( stderr, "%s: ファイルを開けません\n", path );
+        return false;
+    }
+    while ( fgets( buf, sizeof( buf ), fp ) != nullptr ) {
+        std::string line( buf );
+        while ( !line.empty() && ( line.back() == '\n' || line.back() == '\r' ) ) {
+            line.pop_back();
+        }
+        split_csv( line, &cells );
+
+        if ( in_values ) {
+            if ( line.empty() ) {
+                continue;
+            }
+            if ( cells.size() != input_channel_num ) {
+                fprintf( stderr, "%s: 値の数が違う行があります(%zu行目のフレーム)\n", path, frames->size() + 1 );
+                fclose( fp );
+                return false;
+            }
+            input_frame_t frame;
+            const u1* base = (const u1*)input_channels[0].ptr;
+            memset( &frame, 0, sizeof( frame ) );
+            for ( u1 i = 0; i < input_channel_num; i++ ) {
+                s4 value = (s4)strtoll( cells[i].c_str(), nullptr, 10 );
+                size_t offset = (const u1*)input_channels[i].ptr - base;
+                memcpy( (u1*)&frame + offset, &value, mcr_logger::log_type_size( input_channels[i].type ) ); // リトルエンディアン
+            }
+            frames->push_back( frame );
+        } else if ( line.compare( 0, 8, "time_ms," ) == 0 ) {
+            if ( cells.size() != input_channel_num ) {
+                fprintf( stderr, "%s: 値の列の数(%zu)がこのビルド(%u)と異なります\n", path, cells.size(), input_channel_num );
+                fclose( fp );
+                return false;
+            }
+            for ( u1 i = 0; i < input_channel_num; i++ ) {
+                if ( cells[i] != input_channels[i].name ) {
+                    fprintf( stderr, "%s: %u列目(%s)がこのビルド(%s)と異なります\n", path, i + 1, cells[i].c_str(), input_channels[i].name );
+                    fclose( fp );
+                    return false;
+                }
+            }
+            in_values = true;
+        } else if ( line == "PARAMETERS" ) {
+            in_parameters = true;
+        } else if ( in_parameters ) {
+            if ( line.empty() ) {
+                in_parameters = false;
+            } else if ( !apply_parameter( cells ) ) {
+                fprintf( stderr, "%s: 不明なパラメータ %s を無視します\n", path, cells[0].c_str() );
+            }
+        }
+    }
+    fclose( fp );
+    return true;
+}
+
+/*
+ * 概要：フレームの入力をピンとレジスタへ設定する
+ * 引数：frame フレーム
+ * 戻り値：なし
+ * 詳細：ボタンとスイッチはプルアップのため、押下(オン)でLOWにする
+ */
+static void inject_inputs( const input_frame_t* frame ) {
+#if defined( CONFIG_LINE_SENSOR_STEALTH )
+    static const pin_size_t raw_pins[LINE_SENSOR_RAW_NUM] = { PIN_LINE_AR3, PIN_LINE_AR2, PIN_LINE_AR1, PIN_LINE_AC,
+                                                              PIN_LINE_AL1, PIN_LINE_AL2, PIN_LINE_AL3 };
+#else
+    static const pin_size_t raw_pins[LINE_SENSOR_RAW_NUM] = { PIN_LINE_ANALOG_LEFT, PIN_LINE_ANALOG_RIGHT };
+
+    hal_set_digital( PIN_LINE_DIGITAL_CENTER, ( frame->digital & 0x10 ) ? LOW : HIGH );
+    hal_set_digital( PIN_LINE_DIGITAL_8, ( frame->digital & 0x08 ) ? LOW : HIGH );
+    hal_set_digital( PIN_LINE_DIGITAL_4, ( frame->digital & 0x04 ) ? LOW : HIGH );
+    hal_set_digital( PIN_LINE_DIGITAL_2, ( frame->digital & 0x02 ) ? LOW : HIGH );
+    hal_set_digital( PIN_LINE_DIGITAL_1, ( frame->digital & 0x01 ) ? LOW : HIGH );
+    hal_set_digital( PIN_LINE_DIGITAL_GATE, frame->gate ? LOW : HIGH );
+#endif
+    for ( u1 i = 0; i < LINE_SENSOR_RAW_NUM; i++ ) {
+        hal_set_analog( raw_pins[i], frame->raw[i] );
+    }
+
+    GPT6_CNT = (u4)(s4)frame->encoder; // encoder_update()が読んだ後に0にする
+    GPT7_CNT = (u4)(s4)frame->angle;   // 積算値
+
+    hal_set_analog( PIN_BATT_VOLTAGE, frame->battery_raw );
+    hal_set_digital( PIN_DIPSW_1, ( frame->dip_switch & 0x01 ) ? LOW : HIGH );
+    hal_set_digital( PIN_DIPSW_2, ( frame->dip_switch & 0x02 ) ? LOW : HIGH );
+    hal_set_digital( PIN_DIPSW_3, ( frame->dip_switch & 0x04 ) ? LOW : HIGH );
+    hal_set_digital( PIN_DIPSW_4, ( frame->dip_switch & 0x08 ) ? LOW : HIGH );
+    hal_set_digital( PIN_BOARD_DIPSW_1, ( frame->dip_switch & 0x10 ) ? LOW : HIGH );
+    hal_set_digital( PIN_BOARD_DIPSW_2, ( frame->dip_switch & 0x20 ) ? LOW : HIGH );
+    hal_set_digital( PIN_BUTTON_START, frame->button ? HIGH : LOW );
+}
+
+/*
+ * 概要：記録と再生の値を比較し、一致しなかったものを表示する
+ * 引数：frame フレーム values 比較する値 num 値の数
+ * 戻り値：なし
+ */
+static void compare( const input_frame_t* frame, const compare_t* values, u1 num ) {
+    for ( u1 i = 0; i < num; i++ ) {
+        if ( values[i].expected == values[i].actual ) {
+            continue;
+        }
+        mismatch_num++;
+        if ( verbose || mismatch_num <= MISMATCH_PRINT_MAX ) {
+            printf( "seq=%u time_ms=%u %s: 記録=%d 再生=%d%s%s\n", frame->seq, (unsigned)frame->time_ms, values[i].name, (int)values[i].expected,
+                    (int)values[i].actual, ( frame->flags & INPUT_FLAG_PREEMPTED ) ? " (走行制御中に1msタスクが割り込み)" : "",
+                    ( frame->flags & INPUT_FLAG_CLOCK ) ? " (走行制御中に時刻が進んだ)" : "" );
+        }
+    }
+}
+
+/*
+ * 概要：s4の値をs2の範囲に丸める(input_log.cppと同じ)
+ * 引数：value 値
+ * 戻り値：丸めた値
+ */
+static s2 clamp_s2( s4 value ) {
+    return (s2)constrain( value, -32768L, 32767L );
+}
+
+/*
+ * 概要：フレームを1つ再生する
+ * 引数：frame フレーム
+ * 戻り値：なし
+ * 詳細：timer_1ms_task()とloop()の走行制御と同じ順に呼ぶ
+ *      1msタスクの出力は全てのフレームで、走行制御の出力は走行制御を実行したフレームで比較する(ロギング開始前のフレームは比較しない)
+ */
+static void replay_frame( const input_frame_t* frame ) {
+    bool check = !( frame->flags & INPUT_FLAG_PRELUDE );
+
+    inject_inputs( frame );
+
+    hal_set_millis( frame->time_ms );
+    sensors_update_interrupt();
+    servo_control();
+    motor_control();
+    if ( check ) {
+        const compare_t values[] = {
+            { "line_error", frame->line_error, clamp_s2( ls.line_error ) },
+            { "steer_angle", frame->steer_angle, steer_angle },
+            { "speed", frame->speed, clamp_s2( speed ) },
+            { "SV", (int8_t)frame->SV, (int8_t)SV },
+        };
+        compare( frame, values, array_size( values ) );
+    }
+
+    if ( !( frame->flags & INPUT_FLAG_LOOP ) ) {
+        return;
+    }
+    hal_set_millis( frame->time_ms + frame->loop_dt_ms );
+    target_speed_update();
+    sensors_update_period();
+    ruuning();
+    if ( check ) {
+        const compare_t values[] = {
+            { "FL", (int8_t)frame->FL, (int8_t)FL },
+            { "FR", (int8_t)frame->FR, (int8_t)FR },
+            { "RL", (int8_t)frame->RL, (int8_t)RL },
+            { "RR", (int8_t)frame->RR, (int8_t)RR },
+            { "run_mode", frame->run_mode, run_mode },
+            { "run_status", frame->run_status, run_status },
+        };
+        compare( frame, values, array_size( values ) );
+    }
+}
+
+/*
+ * 概要：再生を開始する前の状態を作る
+ * 引数：frames フレーム
+ * 戻り値：なし
+ * 詳細：走行開始(RUN_PRE_STARTからの遷移)の直前から記録されているため、RUN_PRE_STARTから始める
+ *      タイマスタートモード(3秒待ち)は、最初のロギング中のフレームの走行制御で3秒経過するようにタイマーを開始する
+ */
+static void replay_init( const std::vector<input_frame_t>& frames ) {
+    motor_init();
+    sensors_init();
+
+    run_mode = frames[0].run_mode;
+    run_status = frames[0].run_status;
+    ls.line_digital = frames[0].digital; // ステルスセンサーはデジタル値を前回値との論理和で作るため
+
+    for ( const input_frame_t& frame : frames ) {
+        if ( !( frame.flags & INPUT_FLAG_PRELUDE ) ) {
+            hal_set_millis( frame.time_ms + frame.loop_dt_ms - 3000 );
+            timer_start_mode_timer.restart();
+            break;
+        }
+    }
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main( int argc, char** argv ) {
+    std::vector<input_frame_t> frames;
+    const char* path = nullptr;
+    u4 gap_num = 0;
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strcmp( argv[i], "-v" ) == 0 ) {
+            verbose = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if ( path == nullptr ) {
+        fprintf( stderr, "使い方: %s <出力ファイル名_input.csv> [-v]\n", argv[0] );
+        return 2;
+    }
+    if ( !read_input_csv( path, &frames ) ) {
+        return 2;
+    }
+    if ( frames.empty() ) {
+        fprintf( stderr, "%s: フレームがありません\n", path );
+        return 2;
+    }
+
+    replay_init( frames );
+    for ( size_t i = 0; i < frames.size(); i++ ) {
+        if ( i > 0 && frames[i].seq != (u2)( frames[i - 1].seq + 1 ) ) {
+            printf( "seq=%u: 直前のフレーム(seq=%u)との間が抜けています\n", frames[i].seq, frames[i - 1].seq );
+            gap_num++;
+        }
+        replay_frame( &frames[i] );
+    }
+
+    printf( "%zu frames, %u mismatches, %u gaps\n", frames.size(), (unsigned)mismatch_num, (unsigned)gap_num );
+    return mismatch_num == 0 ? 0 : 1;
+}
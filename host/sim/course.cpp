@@ -0,0 +1,340 @@
+/*
+ * 概要：シミュレーション用のコース(白線の形と走行できる範囲)
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defines.h"
+#include "course.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define SEARCH_BACK ( 2 )    // 白線と位置を探す区間の範囲(ヒントの区間より前)
+#define SEARCH_AHEAD ( 4 )   // 白線と位置を探す区間の範囲(ヒントの区間より後)
+#define LINE_BUF_SIZE ( 256 ) // コースファイルの1行の最大長
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+static double deg_to_rad( double deg ) {
+    return deg * M_PI / 180.0;
+}
+
+/*
+ * 概要：位置を向きに沿った座標に変換する
+ * 引数：origin 基準 x、y 位置 along 進行方向の距離の格納先 across 横方向の距離(左が正)の格納先
+ * 戻り値：なし
+ */
+static void to_local( const pose_t& origin, double x, double y, double* along, double* across ) {
+    double dx = x - origin.x;
+    double dy = y - origin.y;
+    double c = cos( origin.heading );
+    double s = sin( origin.heading );
+    *along = dx * c + dy * s;
+    *across = -dx * s + dy * c;
+}
+
+/*
+ * 概要：右(R)か左(L)かを読む
+ * 引数：token 文字列 left 左ならtrueの格納先
+ * 戻り値：R、Lのどちらか:true それ以外:false
+ */
+static bool parse_side( const char* token, bool* left ) {
+    if ( token == nullptr ) {
+        return false;
+    }
+    if ( strcmp( token, "R" ) == 0 ) {
+        *left = false;
+        return true;
+    }
+    if ( strcmp( token, "L" ) == 0 ) {
+        *left = true;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * 概要：数値を読む(省略可能)
+ * 引数：token 文字列(nullptrなら省略) value 値の格納先(省略時は変えない)
+ * 戻り値：省略または数値:true 数値でない:false
+ */
+static bool parse_number( const char* token, double* value ) {
+    char* end;
+
+    if ( token == nullptr ) {
+        return true;
+    }
+    *value = strtod( token, &end );
+    return *end == '\0';
+}
+
+/***********************************/
+/* Class implementions             */
+/***********************************/
+/*
+ * 概要：区間を追加する
+ * 引数：length 長さ LSB:1[mm] curvature 曲率(左が正) LSB:1[1/mm] grade 勾配 LSB:1[rad]
+ *      extend 白線を延ばす長さ LSB:1[mm] line 中心線があるか
+ * 戻り値：なし
+ * 詳細：次の区間の始点を、追加した区間の終点にする
+ */
+void sim_course::add_piece( double length, double curvature, double grade, double extend, bool line ) {
+    course_piece_t piece;
+    const pose_t& p = cursor;
+
+    piece.start = p;
+    piece.end = p;
+    piece.length = length;
+    piece.curvature = curvature;
+    piece.grade = grade;
+    piece.s = cursor_s;
+    piece.extend = extend;
+    piece.line = line;
+    if ( curvature == 0.0 ) {
+        piece.end.x = p.x + length * cos( p.heading );
+        piece.end.y = p.y + length * sin( p.heading );
+    } else {
+        double turn = length * curvature;
+        piece.end.x = p.x + ( sin( p.heading + turn ) - sin( p.heading ) ) / curvature;
+        piece.end.y = p.y - ( cos( p.heading + turn ) - cos( p.heading ) ) / curvature;
+        piece.end.heading = p.heading + turn;
+    }
+    pieces.push_back( piece );
+    cursor = piece.end;
+    cursor_s += length;
+}
+
+/*
+ * 概要：次の区間の始点にクロスラインかハーフラインを2本置く
+ * 引数：side0、side1 横方向の範囲 左が正 LSB:1[mm]
+ * 戻り値：なし
+ */
+void sim_course::add_markers( double side0, double side1 ) {
+    for ( int i = 0; i < 2; i++ ) {
+        course_marker_t marker;
+        marker.origin = cursor;
+        marker.along0 = i * ( COURSE_MARKER_WIDTH + COURSE_MARKER_GAP );
+        marker.along1 = marker.along0 + COURSE_MARKER_WIDTH;
+        marker.across0 = side0;
+        marker.across1 = side1;
+        markers.push_back( marker );
+    }
+}
+
+/*
+ * 概要：位置を区間に沿った座標に変換する
+ * 引数：piece 区間 x、y 位置 along 始点からの中心線に沿った距離の格納先 across 中心線からの横方向の距離(左が正)の格納先
+ * 戻り値：なし
+ * 備考：円弧は90度以下のため、中心から見た角度を-180～180度に丸めて求める
+ */
+void sim_course::piece_local( const course_piece_t& piece, double x, double y, double* along, double* across ) const {
+    if ( piece.curvature == 0.0 ) {
+        to_local( piece.start, x, y, along, across );
+        return;
+    }
+    double radius = 1.0 / fabs( piece.curvature );
+    double cx = piece.start.x - sin( piece.start.heading ) / piece.curvature;
+    double cy = piece.start.y + cos( piece.start.heading ) / piece.curvature;
+    double angle = atan2( y - cy, x - cx ) - atan2( piece.start.y - cy, piece.start.x - cx );
+    angle = remainder( angle, 2.0 * M_PI );
+    if ( piece.curvature < 0.0 ) {
+        angle = -angle;
+    }
+    *along = angle * radius;
+    *across = ( piece.curvature > 0.0 ? 1.0 : -1.0 ) * ( radius - hypot( x - cx, y - cy ) );
+}
+
+/*
+ * 概要：区間の中心線の上か判断する
+ * 引数：piece 区間 x、y 位置
+ * 戻り値：true:中心線の上
+ */
+bool sim_course::on_piece_line( const course_piece_t& piece, double x, double y ) const {
+    double along, across;
+
+    if ( !piece.line ) {
+        return false;
+    }
+    piece_local( piece, x, y, &along, &across );
+    return ( -piece.extend <= along ) && ( along <= piece.length + piece.extend ) && ( fabs( across ) <= COURSE_LINE_WIDTH / 2.0 );
+}
+
+/*
+ * 概要：コースファイルを読む
+ * 引数：path ファイル名
+ * 戻り値：成功:true 失敗:false(理由を表示する)
+ */
+bool sim_course::load( const char* path ) {
+    FILE* fp = fopen( path, "r" );
+    char buf[LINE_BUF_SIZE];
+    int line_no = 0;
+
+    if ( fp == nullptr ) {
+        fprintf( stderr, "%s: ファイルを開けません\n", path );
+        return false;
+    }
+    pieces.clear();
+    markers.clear();
+    cursor = start;
+    cursor_s = 0.0;
+
+    while ( fgets( buf, sizeof( buf ), fp ) != nullptr ) {
+        line_no++;
+        char* comment = strchr( buf, '#' );
+        if ( comment != nullptr ) {
+            *comment = '\0';
+        }
+        char* command = strtok( buf, " \t\r\n" );
+        char* arg[3];
+        for ( int i = 0; i < 3; i++ ) {
+            arg[i] = strtok( nullptr, " \t\r\n" );
+        }
+        if ( command == nullptr ) {
+            continue;
+        }
+
+        bool ok = false;
+        bool left = false;
+        double a = 0.0;
+        double b = 0.0;
+        if ( strcmp( command, "straight" ) == 0 ) {
+            ok = ( arg[0] != nullptr ) && parse_number( arg[0], &a ) && ( a > 0.0 );
+            if ( ok ) {
+                add_piece( a, 0.0, 0.0, 0.0, true );
+            }
+        } else if ( strcmp( command, "curve" ) == 0 ) {
+            ok = parse_side( arg[0], &left ) && ( arg[1] != nullptr ) && ( arg[2] != nullptr ) && parse_number( arg[1], &a ) &&
+                 parse_number( arg[2], &b ) && ( a > 0.0 ) && ( b > 0.0 );
+            if ( ok ) {
+                int split = (int)ceil( b / COURSE_CURVE_SPLIT );
+                for ( int i = 0; i < split; i++ ) {
+                    add_piece( a * deg_to_rad( b / split ), ( left ? 1.0 : -1.0 ) / a, 0.0, 0.0, true );
+                }
+            }
+        } else if ( strcmp( command, "crank" ) == 0 ) {
+            a = COURSE_CRANK_DISTANCE;
+            ok = parse_side( arg[0], &left ) && parse_number( arg[1], &a ) && ( a > 0.0 );
+            if ( ok ) {
+                add_markers( -COURSE_WIDTH / 2.0, COURSE_WIDTH / 2.0 );
+                difficults.push_back( { left ? CR_L : CR_R, a } );
+                add_piece( a, 0.0, 0.0, COURSE_LINE_WIDTH / 2.0, true );
+                cursor.heading += ( left ? 1.0 : -1.0 ) * M_PI / 2.0;
+            }
+        } else if ( strcmp( command, "lanechange" ) == 0 ) {
+            a = COURSE_LANECHANGE_DISTANCE;
+            b = COURSE_LANECHANGE_OFFSET;
+            ok = parse_side( arg[0], &left ) && parse_number( arg[1], &a ) && parse_number( arg[2], &b ) && ( a > 0.0 );
+            if ( ok ) {
+                add_markers( left ? 0.0 : -COURSE_WIDTH / 2.0, left ? COURSE_WIDTH / 2.0 : 0.0 );
+                difficults.push_back( { left ? LC_L : LC_R, a } );
+                add_piece( a, 0.0, 0.0, 0.0, true );
+                // 途切れた後の元のレーン(走行できるが中心線は無い)
+                pose_t lane_end = cursor;
+                double lane_end_s = cursor_s;
+                add_piece( COURSE_LANECHANGE_RUNOUT, 0.0, 0.0, 0.0, false );
+                cursor = lane_end;
+                cursor_s = lane_end_s;
+                double side = left ? b : -b;
+                cursor.x -= side * sin( cursor.heading );
+                cursor.y += side * cos( cursor.heading );
+            }
+        } else if ( strcmp( command, "slope" ) == 0 ) {
+            ok = ( arg[0] != nullptr ) && ( arg[1] != nullptr ) && parse_number( arg[0], &a ) && parse_number( arg[1], &b ) && ( a > 0.0 );
+            if ( ok ) {
+                add_piece( a, 0.0, deg_to_rad( b ), 0.0, true );
+            }
+        }
+        if ( !ok ) {
+            fprintf( stderr, "%s:%d: 区間を読めません\n", path, line_no );
+            fclose( fp );
+            return false;
+        }
+    }
+    fclose( fp );
+
+    if ( pieces.empty() || !pieces.back().line ) {
+        fprintf( stderr, "%s: コースの最後は中心線のある区間にしてください\n", path );
+        return false;
+    }
+    total_length = cursor_s;
+    return true;
+}
+
+/*
+ * 概要：白線の上か判断する
+ * 引数：x、y 位置 hint 近くにある区間(locate()で求めたもの)
+ * 戻り値：true:白 false:黒
+ * 詳細：中心線はヒントの前後の区間だけを調べる。クロスラインとハーフラインは全て調べる
+ */
+bool sim_course::is_white( double x, double y, int hint ) const {
+    for ( const course_marker_t& marker : markers ) {
+        double along, across;
+        to_local( marker.origin, x, y, &along, &across );
+        if ( ( marker.along0 <= along ) && ( along <= marker.along1 ) && ( marker.across0 <= across ) && ( across <= marker.across1 ) ) {
+            return true;
+        }
+    }
+    int first = ( hint - SEARCH_BACK > 0 ) ? hint - SEARCH_BACK : 0;
+    int last = ( hint + SEARCH_AHEAD < (int)pieces.size() ) ? hint + SEARCH_AHEAD : (int)pieces.size() - 1;
+    for ( int i = first; i <= last; i++ ) {
+        if ( on_piece_line( pieces[i], x, y ) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * 概要：コース上の位置を求める
+ * 引数：x、y 位置 hint 前回求めた区間
+ * 戻り値：コース上の位置
+ * 詳細：ヒントの前後の区間のうち、中心線に最も近い区間で求める
+ *      apartがCOURSE_WIDTHの半分を超えたらコースの外
+ */
+course_position_t sim_course::locate( double x, double y, int hint ) const {
+    course_position_t pos = { hint, 0.0, 0.0, INFINITY, false };
+    int first = ( hint - SEARCH_BACK > 0 ) ? hint - SEARCH_BACK : 0;
+    int last = ( hint + SEARCH_AHEAD < (int)pieces.size() ) ? hint + SEARCH_AHEAD : (int)pieces.size() - 1;
+
+    for ( int i = first; i <= last; i++ ) {
+        const course_piece_t& piece = pieces[i];
+        double along, across;
+        piece_local( piece, x, y, &along, &across );
+        double inside = fmin( fmax( along, 0.0 ), piece.length );
+        double apart = hypot( along - inside, across );
+        if ( apart < pos.apart ) {
+            pos.piece = i;
+            pos.s = piece.s + inside;
+            pos.offset = across;
+            pos.apart = apart;
+            pos.finished = ( i == (int)pieces.size() - 1 ) && ( along >= piece.length );
+        }
+    }
+    return pos;
+}
+
+/*
+ * 概要：区間の勾配を取得する
+ * 引数：piece 区間
+ * 戻り値：勾配 上りが正 LSB:1[rad]
+ */
+double sim_course::get_grade( int piece ) const {
+    return pieces[piece].grade;
+}
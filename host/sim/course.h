@@ -0,0 +1,108 @@
+/*
+ * 概要：シミュレーション用のコース(白線の形と走行できる範囲)
+ * コースファイルの1行が1つの区間で、前の区間の終わりから続けて置く
+ *   straight <長さmm>                          直線
+ *   curve <R|L> <半径mm> <角度deg>             カーブ
+ *   crank <R|L> [クロスラインからの距離mm]      クロスライン2本の後、直角に曲がる
+ *   lanechange <R|L> [ハーフラインからの距離mm] [移動量mm]
+ *                                             ハーフライン2本の後、中心線が途切れて隣のレーンから続く
+ *   slope <長さmm> <角度deg>                   坂(上りが正。白線は平面に投影した直線とする)
+ * #から行末まではコメント
+ * クランクとレーンチェンジは出てくる順に難所として記録し、難所種別と距離のパラメータの設定に使う
+ * 座標はスタート位置を原点、スタート時の進行方向をx、左をyとする LSB:1[mm]
+ */
+#pragma once
+#include <vector>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define COURSE_LINE_WIDTH ( 30 )           // 中心線の幅 LSB:1[mm]
+#define COURSE_WIDTH ( 600 )               // コースの幅 LSB:1[mm]
+#define COURSE_MARKER_WIDTH ( 20 )         // クロスライン、ハーフライン1本の幅 LSB:1[mm]
+#define COURSE_MARKER_GAP ( 30 )           // クロスライン、ハーフライン2本の間隔 LSB:1[mm]
+#define COURSE_CRANK_DISTANCE ( 500 )      // クロスラインからクランクまでの距離(省略時) LSB:1[mm]
+#define COURSE_LANECHANGE_DISTANCE ( 500 ) // ハーフラインから中心線が途切れるまでの距離(省略時) LSB:1[mm]
+#define COURSE_LANECHANGE_OFFSET ( 300 )   // レーンチェンジの横方向の移動量(省略時) LSB:1[mm]
+#define COURSE_LANECHANGE_RUNOUT ( 1500 )  // 途切れた後も元のレーンを走行できる範囲とする長さ LSB:1[mm]
+#define COURSE_CURVE_SPLIT ( 90 )          // カーブをこの角度以下の区間に分ける LSB:1[deg]
+
+// 位置と向き
+typedef struct {
+    double x;       // LSB:1[mm]
+    double y;       // LSB:1[mm]
+    double heading; // x軸からの角度 左回りが正 LSB:1[rad]
+} pose_t;
+
+// 区間(直線か円弧)
+typedef struct {
+    pose_t start;     // 始点
+    pose_t end;       // 終点
+    double length;    // 長さ LSB:1[mm]
+    double curvature; // 曲率 左カーブが正、直線は0 LSB:1[1/mm]
+    double grade;     // 勾配 上りが正 LSB:1[rad]
+    double s;         // 始点のスタートからの距離 LSB:1[mm]
+    double extend;    // 白線を始点と終点から延ばす長さ(クランクの角を埋める) LSB:1[mm]
+    bool line;        // 中心線があるか(レーンチェンジで途切れた後の元のレーンは無し)
+} course_piece_t;
+
+// クロスライン、ハーフライン1本(区間の始点の向きに沿った長方形)
+typedef struct {
+    pose_t origin;  // 基準位置
+    double along0;  // 進行方向の範囲 LSB:1[mm]
+    double along1;  //
+    double across0; // 横方向の範囲 左が正 LSB:1[mm]
+    double across1; //
+} course_marker_t;
+
+// 難所(クランク、レーンチェンジ)
+typedef struct {
+    int kind;        // 難所種別(CR_L、CR_R、LC_L、LC_R)
+    double distance; // クロスライン、ハーフラインから難所までの距離 LSB:1[mm]
+} course_difficult_t;
+
+// コース上の位置
+typedef struct {
+    int piece;     // 最も近い区間
+    double s;      // スタートからの距離 LSB:1[mm]
+    double offset; // 中心線からの横方向の距離 左が正 LSB:1[mm]
+    double apart;  // 最も近い区間の中心線からの距離(区間の外では端点からの距離) LSB:1[mm]
+    bool finished; // 最後の区間の終点を過ぎた
+} course_position_t;
+
+/***********************************/
+/* Class                           */
+/***********************************/
+class sim_course {
+  public:
+    bool load( const char* path );
+    bool is_white( double x, double y, int hint ) const;
+    course_position_t locate( double x, double y, int hint ) const;
+    double get_grade( int piece ) const;
+    double get_length() const {
+        return total_length;
+    }
+    const pose_t& get_start() const {
+        return start;
+    }
+    const std::vector<course_difficult_t>& get_difficults() const {
+        return difficults;
+    }
+
+  private:
+    void add_piece( double length, double curvature, double grade, double extend, bool line );
+    void add_markers( double side0, double side1 );
+    bool on_piece_line( const course_piece_t& piece, double x, double y ) const;
+    void piece_local( const course_piece_t& piece, double x, double y, double* along, double* across ) const;
+
+    std::vector<course_piece_t> pieces;
+    std::vector<course_marker_t> markers;
+    std::vector<course_difficult_t> difficults; // 出てくる順
+    pose_t start = { 0.0, 0.0, 0.0 };
+    pose_t cursor = { 0.0, 0.0, 0.0 }; // 次の区間の始点
+    double cursor_s = 0.0;             // 次の区間の始点のスタートからの距離
+    double total_length = 0.0;
+};
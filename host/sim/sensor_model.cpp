@@ -0,0 +1,130 @@
+/*
+ * 概要：シミュレーション用のラインセンサー(コースの白線から、センサーのピンの入力値を作る)
+ * センサーごとに見る範囲(センサーの列に沿った幅)のうち白線にかかる割合を求め、
+ * アナログセンサーはSENSOR_MODEL_RAW_BLACKとSENSOR_MODEL_RAW_WHITEの間の値、デジタルセンサーは半分以上が白ならLOWにする
+ * 黒と白の補正値(calibration.cpp)は、実機でキャリブレーション画面を使ったのと同じくsensor_model_calibrate()でこの値にする
+ */
+#include <math.h>
+#include "hal.h"
+#include "calibration.h"
+#include "features.h"
+#include "pin_defines.h"
+#include "sensor_model.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+// センサー1個
+typedef struct {
+    pin_size_t pin;
+    double lateral;   // 車体の中心からの横方向の位置 左が正 LSB:1[mm]
+    double spot;      // 見る範囲の幅 LSB:1[mm]
+    parameter* black; // アナログセンサーの黒の補正値(デジタルセンサーはnullptr)
+    parameter* white; // アナログセンサーの白の補正値
+} sensor_model_t;
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+#if defined( CONFIG_LINE_SENSOR_D5A2 )
+// デジタルセンサーは中心とD4、D2を白線の幅+見る範囲(26mm)の間隔にし、中心線1本で隙間(全て黒)や、
+// ハーフラインのパターン(0x0C、0x03)にならないようにする。D8、D1はそれより外側
+// アナログセンサーは見る範囲を中心で重ね、中心線が±20mmの間で左右の差が連続して変わるようにする
+static const sensor_model_t sensor_models[] = {
+    { PIN_LINE_DIGITAL_8, 90.0, 6.0, nullptr, nullptr },
+    { PIN_LINE_DIGITAL_4, 26.0, 6.0, nullptr, nullptr },
+    { PIN_LINE_DIGITAL_CENTER, 0.0, 6.0, nullptr, nullptr },
+    { PIN_LINE_DIGITAL_2, -26.0, 6.0, nullptr, nullptr },
+    { PIN_LINE_DIGITAL_1, -90.0, 6.0, nullptr, nullptr },
+    { PIN_LINE_ANALOG_LEFT, 20.0, 60.0, &prm_line_trace_left_B, &prm_line_trace_left_W },
+    { PIN_LINE_ANALOG_RIGHT, -20.0, 60.0, &prm_line_trace_right_B, &prm_line_trace_right_W },
+};
+#elif defined( CONFIG_LINE_SENSOR_STEALTH )
+static const sensor_model_t sensor_models[] = {
+    { PIN_LINE_AR3, -45.0, 20.0, &prm_line_AR3_B, &prm_line_AR3_W }, { PIN_LINE_AR2, -30.0, 20.0, &prm_line_AR2_B, &prm_line_AR2_W },
+    { PIN_LINE_AR1, -15.0, 20.0, &prm_line_AR1_B, &prm_line_AR1_W }, { PIN_LINE_AC, 0.0, 20.0, &prm_line_AC_B, &prm_line_AC_W },
+    { PIN_LINE_AL1, 15.0, 20.0, &prm_line_AL1_B, &prm_line_AL1_W },  { PIN_LINE_AL2, 30.0, 20.0, &prm_line_AL2_B, &prm_line_AL2_W },
+    { PIN_LINE_AL3, 45.0, 20.0, &prm_line_AL3_B, &prm_line_AL3_W },
+};
+#endif
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：センサーの見る範囲のうち白線にかかる割合を求める
+ * 引数：course コース x、y センサーの中心 heading 車体の向き spot 見る範囲の幅 hint 近くにある区間
+ * 戻り値：0.0(全て黒)～1.0(全て白)
+ * 詳細：センサーの列に沿ってSENSOR_MODEL_PITCHごとに調べる
+ */
+static double white_ratio( const sim_course& course, double x, double y, double heading, double spot, int hint ) {
+    double dx = -sin( heading );
+    double dy = cos( heading );
+    int samples = (int)ceil( spot / SENSOR_MODEL_PITCH );
+    int white = 0;
+
+    for ( int i = 0; i < samples; i++ ) {
+        double across = spot * ( ( i + 0.5 ) / samples - 0.5 );
+        if ( course.is_white( x + across * dx, y + across * dy, hint ) ) {
+            white++;
+        }
+    }
+    return (double)white / samples;
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：アナログセンサーの黒と白の補正値を、モデルのセンサーの値にする
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：既定値は実機のセンサーに合わせたものではない(D5A2の白は10bitADCの範囲を超える)ため、
+ *      実機で走る前にキャリブレーションするのと同じく、パラメータファイルを読む前に呼ぶこと
+ */
+void sensor_model_calibrate() {
+    for ( const sensor_model_t& sensor : sensor_models ) {
+        if ( sensor.black != nullptr ) {
+            *sensor.black = SENSOR_MODEL_RAW_BLACK;
+            *sensor.white = SENSOR_MODEL_RAW_WHITE;
+        }
+    }
+}
+
+/*
+ * 概要：車体の位置から見えるコースをラインセンサーのピンに設定する
+ * 引数：course コース car 車体(後輪の車軸の中心) hint 車体の近くにある区間(sim_course::locate()で求めたもの)
+ * 戻り値：なし
+ * 詳細：D5A2のゲートセンサーはゲートが無い(OPEN)とする
+ */
+void sensor_model_render( const sim_course& course, const pose_t& car, int hint ) {
+    double c = cos( car.heading );
+    double s = sin( car.heading );
+    double ahead = CAR_LENGTH + SENSOR_MODEL_AHEAD;
+
+    for ( const sensor_model_t& sensor : sensor_models ) {
+        double x = car.x + ahead * c - sensor.lateral * s;
+        double y = car.y + ahead * s + sensor.lateral * c;
+        double ratio = white_ratio( course, x, y, car.heading, sensor.spot, hint );
+        if ( sensor.black == nullptr ) {
+            hal_set_digital( sensor.pin, ( ratio >= 0.5 ) ? LOW : HIGH );
+        } else {
+            double full = fmin( sensor.spot, COURSE_LINE_WIDTH ) / sensor.spot; // 白線が見る範囲に全て入ったときの割合
+            s4 raw = (s4)lround( SENSOR_MODEL_RAW_BLACK + ( SENSOR_MODEL_RAW_WHITE - SENSOR_MODEL_RAW_BLACK ) * fmin( ratio / full, 1.0 ) );
+            hal_set_analog( sensor.pin, constrain( raw, 0, SENSOR_MODEL_ADC_MAX ) );
+        }
+    }
+#if defined( CONFIG_LINE_SENSOR_D5A2 )
+    hal_set_digital( PIN_LINE_DIGITAL_GATE, HIGH );
+#endif
+}
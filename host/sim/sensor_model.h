@@ -0,0 +1,25 @@
+/*
+ * 概要：シミュレーション用のラインセンサー(コースの白線から、センサーのピンの入力値を作る)
+ * センサーは前輪の車軸より前に横一列に並べ、features.hで選んだセンサー(D5A2かステルス)のピンに入力値を設定する
+ */
+#pragma once
+#include "adc_scan.h"
+#include "course.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define SENSOR_MODEL_AHEAD ( 120 ) // 前輪の車軸からセンサーの列までの距離 LSB:1[mm]
+#define SENSOR_MODEL_PITCH ( 2 )   // センサーの見る範囲を調べる間隔 LSB:1[mm]
+#define SENSOR_MODEL_ADC_MAX ( ( 1 << ADC_SCAN_BITS ) - 1 ) // アナログセンサーの最大値(adc_scan_read()の値の範囲)
+#define SENSOR_MODEL_RAW_BLACK ( 80 )  // アナログセンサーが黒を見たときの値(adc_scan_read()の値)
+#define SENSOR_MODEL_RAW_WHITE ( 800 ) // アナログセンサーが白を見たときの値(adc_scan_read()の値)
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+void sensor_model_calibrate();
+void sensor_model_render( const sim_course& course, const pose_t& car, int hint );
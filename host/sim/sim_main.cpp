@@ -0,0 +1,402 @@
+/*
+ * 概要：車体とコースのシミュレーションで、ファームウェアの走行制御(run_modeごとのrunning_xxx())をそのまま走らせる
+ * 仮想時計の1msごとに、モーターの指令値(FL、FR、RL、RR、SV)で車体を動かし、エンコーダとラインセンサーの入力を作ってから1msタスクを呼ぶ
+ * スタートボタンを押して走行を始め、コースの終点に着くか、失敗するまで実行する
+ * 使い方：sim <コースファイル> [-P パラメータファイル] [-o 軌跡csv] [-t 制限時間ms] [-g 摩擦係数0.01] [-b バッテリー電圧0.01V]
+ *             [-d DIPスイッチ] [-l loop()1回の時間us] [-p millis()1回の時間us] [-e EEPROMファイル] [-w paramコマンドファイル]
+ *        パラメータファイルは1行に"短縮名,値"(プログラム情報のPARAMETERSと同じ形式)
+ *        -wはパラメータファイルで変わったパラメータを、テストモードのシリアルシェルに貼り付けるparam set/saveコマンドにして書き出す
+ *        setup()の後(EEPROMの内容より後)、パラメータファイルより前に、センサーの黒と白の補正値をモデルの値にし、
+ *        難所種別と難所までの距離をコースの難所の順に設定する(実機で走る前にキャリブレーションと難所の設定をするのと同じ)
+ * 出力：標準出力に結果を1行で表示する
+ *       result=FINISH|COURSE_OUT|STOPPED|TIMEOUT time_ms=走行開始からの時間 distance=進んだ距離mm course=コースの長さmm
+ *       max_speed=最高速度0.01m/s slip_ms=滑った時間 max_offset=中心線からの最大距離mm max_lateral=最大横加速度0.01G
+ *       run_mode=終了時のrun_mode run_status=終了時のrun_status
+ * 戻り値：0:完走 1:完走できない 2:引数、コースファイル、パラメータファイルの誤り
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "hal.h"
+#include "calibration.h"
+#include "line_sensor.h"
+#include "motor_control.h"
+#include "mcr_gpt_lib.h"
+#include "pin_defines.h"
+#include "course.h"
+#include "sensor_model.h"
+#include "vehicle.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define BUTTON_PRESS_START_MS ( 100 ) // スタートボタンを押す時刻(setup()の後から) LSB:1[ms]
+#define BUTTON_PRESS_MS ( 100 )       // スタートボタンを押している時間 LSB:1[ms]
+#define PARAMETER_LINE_SIZE ( 256 )   // パラメータファイルの1行の最大長
+
+// 実行条件
+typedef struct {
+    const char* course;  // コースファイル
+    const char* params;  // パラメータファイル(nullptrなら既定値)
+    const char* trace;   // 軌跡csv(nullptrなら出力しない)
+    const char* eeprom;  // EEPROMの内容を読むファイル(nullptrなら消去した状態)
+    const char* command; // paramコマンドファイル(nullptrなら出力しない)
+    u4 timeout_ms;       // 制限時間(setup()の後から) LSB:1[ms]
+    u4 grip;             // タイヤの摩擦係数 LSB:0.01[-]
+    u4 battery;          // バッテリー電圧 LSB:0.01[V]
+    u1 dip_switch;       // DIPスイッチ bit0:SW1 bit1:SW2 bit2:SW3 bit3:SW4
+    u4 loop_us;          // loop()1回の処理時間 LSB:1[us]
+    u4 poll_us;          // millis()とmicros()1回の処理時間 LSB:1[us]
+} sim_options_t;
+
+// 走行の結果
+enum e_sim_result {
+    SIM_RUNNING,    // 走行中
+    SIM_FINISH,     // コースの終点に着いた
+    SIM_COURSE_OUT, // 車体の中心がコースの外に出た
+    SIM_STOPPED,    // 終点に着く前に走行制御が走行を終えた(停止判断)
+    SIM_TIMEOUT,    // 制限時間内に終点に着かない
+};
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static const char* const result_names[] = { "RUNNING", "FINISH", "COURSE_OUT", "STOPPED", "TIMEOUT" };
+
+static sim_options_t opt;
+static sim_course course;
+static sim_vehicle car;
+static course_position_t position;          // 車体の中心のコース上の位置
+static FILE* trace_fp = nullptr;            // 軌跡csv
+static u4 tick_ms = 0;                      // setup()の後の1msタスクの回数 LSB:1[ms]
+static s4 go_ms = -1;                       // 走行を始めた時刻(tick_ms) 走行前は負
+static enum e_sim_result result = SIM_RUNNING;
+static u4 result_ms = 0;                    // 結果が決まった時刻(tick_ms)
+static double max_speed = 0.0;              // 最高速度 LSB:1[mm/s]
+static u4 slip_ms = 0;                      // グリップの限界を超えていた時間 LSB:1[ms]
+static double max_offset = 0.0;             // 中心線からの最大距離 LSB:1[mm]
+static double max_lateral = 0.0;            // 最大横加速度 LSB:1[mm/s^2]
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern u1 run_mode;
+extern u1 run_status;
+extern void setup();
+extern void loop();
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：コマンドライン引数を読む
+ * 引数：argc、argv main()の引数
+ * 戻り値：成功:true コースファイルが無い、または不明な引数:false
+ */
+static bool parse_options( int argc, char** argv ) {
+    opt.course = nullptr;
+    opt.params = nullptr;
+    opt.trace = nullptr;
+    opt.eeprom = nullptr;
+    opt.command = nullptr;
+    opt.timeout_ms = 60000;
+    opt.grip = 400; // 既定のカーブ速度(sp_curve 4.0m/s)でR450を滑らずに曲がれる値
+    opt.battery = 800;
+    opt.dip_switch = 0x02; // 3秒待ちスタート
+    opt.loop_us = 100;
+    opt.poll_us = 1;
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( argv[i][0] != '-' ) {
+            if ( opt.course != nullptr ) {
+                return false;
+            }
+            opt.course = argv[i];
+            continue;
+        }
+        if ( i + 1 >= argc || strlen( argv[i] ) != 2 ) {
+            return false;
+        }
+        const char* value = argv[++i];
+        switch ( argv[i - 1][1] ) {
+        case 'P':
+            opt.params = value;
+            break;
+        case 'o':
+            opt.trace = value;
+            break;
+        case 'e':
+            opt.eeprom = value;
+            break;
+        case 'w':
+            opt.command = value;
+            break;
+        case 't':
+            opt.timeout_ms = strtoul( value, nullptr, 0 );
+            break;
+        case 'g':
+            opt.grip = strtoul( value, nullptr, 0 );
+            break;
+        case 'b':
+            opt.battery = strtoul( value, nullptr, 0 );
+            break;
+        case 'd':
+            opt.dip_switch = (u1)strtoul( value, nullptr, 0 );
+            break;
+        case 'l':
+            opt.loop_us = strtoul( value, nullptr, 0 );
+            break;
+        case 'p':
+            opt.poll_us = strtoul( value, nullptr, 0 );
+            break;
+        default:
+            return false;
+        }
+    }
+    return opt.course != nullptr;
+}
+
+/*
+ * 概要：パラメータファイルを読み、走行用パラメータへ設定する
+ * 引数：path ファイル名
+ * 戻り値：成功:true 失敗:false(理由を表示する)
+ * 詳細：1行に"短縮名,値"。空行と#で始まる行は読み飛ばす
+ */
+static bool load_parameters( const char* path ) {
+    FILE* fp = fopen( path, "r" );
+    char buf[PARAMETER_LINE_SIZE];
+    int line_no = 0;
+
+    if ( fp == nullptr ) {
+        fprintf( stderr, "%s: ファイルを開けません\n", path );
+        return false;
+    }
+    while ( fgets( buf, sizeof( buf ), fp ) != nullptr ) {
+        line_no++;
+        buf[strcspn( buf, "\r\n" )] = '\0';
+        if ( buf[0] == '\0' || buf[0] == '#' ) {
+            continue;
+        }
+        char* comma = strchr( buf, ',' );
+        parameter* found = nullptr;
+        if ( comma != nullptr ) {
+            *comma = '\0';
+            for ( parameter* prm : parameters ) {
+                if ( strcmp( buf, prm->get_short_name() ) == 0 ) {
+                    found = prm;
+                }
+            }
+        }
+        if ( found == nullptr ) {
+            fprintf( stderr, "%s:%d: パラメータの短縮名が見つかりません\n", path, line_no );
+            fclose( fp );
+            return false;
+        }
+        *found = (s4)strtol( comma + 1, nullptr, 10 );
+    }
+    fclose( fp );
+    return true;
+}
+
+/*
+ * 概要：パラメータファイルで変わったパラメータをparamコマンドにして書き出す
+ * 引数：path ファイル名 before パラメータファイルを読む前の値(parametersと同じ順)
+ * 戻り値：成功:true 失敗:false(理由を表示する)
+ * 詳細：command_parameter.hのparam set <番号> <値>を変わったパラメータの数だけ並べ、最後にparam saveを置く
+ */
+static bool write_parameter_commands( const char* path, const std::vector<s4>& before ) {
+    FILE* fp = fopen( path, "w" );
+
+    if ( fp == nullptr ) {
+        fprintf( stderr, "%s: ファイルを作れません\n", path );
+        return false;
+    }
+    for ( size_t i = 0; i < parameters.size(); i++ ) {
+        if ( parameters[i]->get() != before[i] ) {
+            fprintf( fp, "param set %u %d\n", (unsigned)i, (int)parameters[i]->get() );
+        }
+    }
+    fprintf( fp, "param save\n" );
+    fclose( fp );
+    return true;
+}
+
+/*
+ * 概要：コースの難所の並びを難所種別と難所までの距離のパラメータに設定する
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：難所を終えるたびにセクションが進むため、n番目の難所をdif_kind<n>とdifficlt<n>にする
+ *      パラメータの数より多い難所は設定しない(既定値のまま)
+ */
+static void set_course_difficults() {
+    static parameter* const kinds[] = { &prm_difficult_kind_0, &prm_difficult_kind_1, &prm_difficult_kind_2,
+                                        &prm_difficult_kind_3, &prm_difficult_kind_4, &prm_difficult_kind_5,
+                                        &prm_difficult_kind_6, &prm_difficult_kind_7, &prm_difficult_kind_8 };
+    static parameter* const distances[] = { &prm_difficult_distance_sec0, &prm_difficult_distance_sec1, &prm_difficult_distance_sec2,
+                                            &prm_difficult_distance_sec3, &prm_difficult_distance_sec4, &prm_difficult_distance_sec5,
+                                            &prm_difficult_distance_sec6, &prm_difficult_distance_sec7, &prm_difficult_distance_sec8 };
+    const std::vector<course_difficult_t>& difficults = course.get_difficults();
+
+    for ( size_t i = 0; i < difficults.size() && i < sizeof( kinds ) / sizeof( kinds[0] ); i++ ) {
+        *kinds[i] = (s4)difficults[i].kind;
+        *distances[i] = (s4)lround( difficults[i].distance );
+    }
+}
+
+/*
+ * 概要：DIPスイッチとバッテリー電圧の入力を設定する
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：スイッチはプルアップのため、オンでLOWにする。バッテリー電圧はsensors.cppのbattery_update()の逆算
+ */
+static void set_static_inputs() {
+    hal_set_digital( PIN_DIPSW_1, ( opt.dip_switch & 0x01 ) ? LOW : HIGH );
+    hal_set_digital( PIN_DIPSW_2, ( opt.dip_switch & 0x02 ) ? LOW : HIGH );
+    hal_set_digital( PIN_DIPSW_3, ( opt.dip_switch & 0x04 ) ? LOW : HIGH );
+    hal_set_digital( PIN_DIPSW_4, ( opt.dip_switch & 0x08 ) ? LOW : HIGH );
+    hal_set_analog( PIN_BATT_VOLTAGE, opt.battery * 4096 / 1400 );
+}
+
+/*
+ * 概要：車体の中心の位置を取得する
+ * 引数：なし
+ * 戻り値：x、y 車体の中心(後輪の車軸からホイールベースの半分前) LSB:1[mm]
+ */
+static void car_center( double* x, double* y ) {
+    *x = car.pose.x + CAR_LENGTH / 2.0 * cos( car.pose.heading );
+    *y = car.pose.y + CAR_LENGTH / 2.0 * sin( car.pose.heading );
+}
+
+/*
+ * 概要：軌跡csvに1行出力する
+ * 引数：なし
+ * 戻り値：なし
+ */
+static void write_trace() {
+    fprintf( trace_fp, "%u,%.1f,%.1f,%.2f,%.0f,%.2f,%.0f,%.1f,%u,%u,%d,0x%02x,%d,%d,%d,%d,%d,%d\n", (unsigned)tick_ms, car.pose.x, car.pose.y,
+             car.pose.heading * 180.0 / M_PI, car.speed, car.steer, position.s, position.offset, run_mode, run_status, (int)ls.line_error,
+             ls.line_digital, FL, FR, RL, RR, SV, car.slipping ? 1 : 0 );
+}
+
+/*
+ * 概要：車体とセンサーの状態を1ms進める
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：hal_set_tick_hook()で登録し、1msタスクの直前に呼ばれる
+ *      直前までのモーターの指令値で車体を動かし、エンコーダ(GPT6、GPT7)とラインセンサーの入力を設定する
+ *      走行中は終点とコースアウトを判断する
+ */
+static void sim_tick() {
+    vehicle_command_t cmd = { FL, FR, RL, RR, SV, opt.battery / 100.0 };
+    double x, y;
+
+    tick_ms++;
+    car.step( 0.001, cmd, course.get_grade( position.piece ), opt.grip / 100.0 );
+    GPT6_CNT = (u4)( (s4)GPT6_CNT + car.take_encoder_pulses() ); // encoder_update()が読んだ後に0にする
+    GPT7_CNT = (u4)car.get_steer_count();                        // 積算値
+    car_center( &x, &y );
+    position = course.locate( x, y, position.piece );
+    sensor_model_render( course, car.pose, position.piece );
+
+    if ( go_ms < 0 && RUN_STABLE <= run_mode && run_mode <= RUN_SLOPE ) {
+        go_ms = tick_ms;
+    }
+    if ( go_ms >= 0 && result == SIM_RUNNING ) {
+        max_speed = fmax( max_speed, car.speed );
+        max_offset = fmax( max_offset, fabs( position.offset ) );
+        max_lateral = fmax( max_lateral, fabs( car.lateral_acc ) );
+        slip_ms += car.slipping ? 1 : 0;
+        if ( position.finished ) {
+            result = SIM_FINISH;
+        } else if ( position.apart > COURSE_WIDTH / 2.0 ) {
+            result = SIM_COURSE_OUT;
+        }
+        result_ms = tick_ms;
+    }
+    if ( trace_fp != nullptr ) {
+        write_trace();
+    }
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main( int argc, char** argv ) {
+    if ( !parse_options( argc, argv ) ) {
+        fprintf( stderr,
+                 "使い方: %s <コースファイル> [-P パラメータファイル] [-o 軌跡csv] [-t 制限時間ms] [-g 摩擦係数0.01] [-b バッテリー電圧0.01V]\n"
+                 "          [-d DIPスイッチ] [-l loop()1回の時間us] [-p millis()1回の時間us] [-e EEPROMファイル] [-w paramコマンドファイル]\n",
+                 argv[0] );
+        return 2;
+    }
+    if ( !course.load( opt.course ) ) {
+        return 2;
+    }
+    if ( opt.eeprom != nullptr && !hal_eeprom_load( opt.eeprom ) ) {
+        fprintf( stderr, "%s: 読めないため、EEPROMを消去した状態で開始します\n", opt.eeprom );
+    }
+    if ( opt.trace != nullptr ) {
+        trace_fp = fopen( opt.trace, "w" );
+        if ( trace_fp == nullptr ) {
+            fprintf( stderr, "%s: ファイルを作れません\n", opt.trace );
+            return 2;
+        }
+        fprintf( trace_fp, "time_ms,x,y,heading,speed,steer,s,offset,run_mode,run_status,line_error,line_digital,FL,FR,RL,RR,SV,slip\n" );
+    }
+
+    car.reset( course.get_start() );
+    position = course.locate( CAR_LENGTH / 2.0, 0.0, 0 );
+    sensor_model_render( course, car.pose, position.piece );
+    set_static_inputs();
+    hal_set_poll_cost_us( opt.poll_us );
+    hal_set_tick_hook( sim_tick );
+
+    setup();
+    sensor_model_calibrate();
+    set_course_difficults();
+    std::vector<s4> before;
+    for ( parameter* prm : parameters ) {
+        before.push_back( prm->get() );
+    }
+    if ( opt.params != nullptr && !load_parameters( opt.params ) ) {
+        return 2;
+    }
+    if ( opt.command != nullptr && !write_parameter_commands( opt.command, before ) ) {
+        return 2;
+    }
+    ls.reload_calibration(); // 実機でパラメータを設定したときと同じく、補正値を反映する
+    tick_ms = 0;
+    while ( result == SIM_RUNNING ) {
+        bool press = ( BUTTON_PRESS_START_MS <= tick_ms ) && ( tick_ms < BUTTON_PRESS_START_MS + BUTTON_PRESS_MS );
+        hal_set_digital( PIN_BUTTON_START, press ? LOW : HIGH );
+        loop();
+        hal_advance_us( opt.loop_us );
+
+        if ( result != SIM_RUNNING ) {
+            break;
+        }
+        if ( go_ms >= 0 && !( RUN_STABLE <= run_mode && run_mode <= RUN_SLOPE ) ) {
+            result = SIM_STOPPED;
+        } else if ( tick_ms >= opt.timeout_ms ) {
+            result = SIM_TIMEOUT;
+        }
+        result_ms = tick_ms;
+    }
+    if ( trace_fp != nullptr ) {
+        fclose( trace_fp );
+    }
+
+    printf( "result=%s time_ms=%d distance=%.0f course=%.0f max_speed=%.0f slip_ms=%u max_offset=%.0f max_lateral=%.0f run_mode=%u run_status=%u\n",
+            result_names[result], ( go_ms >= 0 ) ? (int)( result_ms - go_ms ) : -1, position.s, course.get_length(), max_speed / 10.0,
+            (unsigned)slip_ms, max_offset, max_lateral * 100.0 / VEHICLE_GRAVITY, run_mode, run_status );
+    return ( result == SIM_FINISH ) ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+/*
+ * 概要：シミュレーション用の車体(モーター、ステアリング、タイヤのグリップ)
+ * モーターは電圧と逆起電力で駆動力が決まる直流モーター、ステアリングは慣性で角速度が遅れ、走行中はセルフアライニングトルクで直進に戻るモーター
+ * 4輪とも車体の速度で回るとし(内輪差は考えない)、後輪の車軸を基準にした二輪モデルで走らせる
+ * タイヤは1輪あたり 摩擦係数×重量/4 まで駆動力を伝え、駆動と旋回を合わせた加速度が 摩擦係数×重力 を超えると滑る
+ */
+#include <math.h>
+#include "vehicle.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：pwm指令値からモーターにかかる電圧を求める
+ * 引数：pwm pwm指令値 -100～100 battery バッテリー電圧 LSB:1[V]
+ * 戻り値：電圧 LSB:1[V]
+ * 詳細：motor_driver::out_pwm()はバッテリー電圧で補正するため、pwm100%が10V(バッテリー電圧が上限)になる
+ */
+static double motor_voltage( s4 pwm, double battery ) {
+    double volt = fmin( fmax( pwm, -100 ), 100 ) * VEHICLE_PWM_FULL_VOLTAGE / 100.0;
+    return fmin( fmax( volt, -battery ), battery );
+}
+
+/*
+ * 概要：モーター1個の駆動力を求める
+ * 引数：volt 電圧 LSB:1[V] speed 速度 LSB:1[mm/s]
+ * 戻り値：駆動力 LSB:1[N]
+ * 詳細：pwm0のブレーキは電圧0として、逆起電力による制動力になる
+ */
+static double motor_force( double volt, double speed ) {
+    double back_emf = speed * VEHICLE_PWM_FULL_VOLTAGE / VEHICLE_MOTOR_NO_LOAD_SPEED;
+    return VEHICLE_MOTOR_STALL_FORCE * ( volt - back_emf ) / VEHICLE_PWM_FULL_VOLTAGE;
+}
+
+/***********************************/
+/* Class implementions             */
+/***********************************/
+/*
+ * 概要：車体を止めてスタート位置に置く
+ * 引数：start 後輪の車軸の中心の位置と向き
+ * 戻り値：なし
+ */
+void sim_vehicle::reset( const pose_t& start ) {
+    pose = start;
+    speed = 0.0;
+    steer = 0.0;
+    steer_rate = 0.0;
+    lateral_acc = 0.0;
+    slipping = false;
+    encoder_distance = 0.0;
+}
+
+/*
+ * 概要：車体の状態を進める
+ * 引数：dt 時間 LSB:1[s] cmd モーターへの指令 grade 勾配(上りが正) LSB:1[rad] grip タイヤの摩擦係数
+ * 戻り値：なし
+ */
+void sim_vehicle::step( double dt, const vehicle_command_t& cmd, double grade, double grip ) {
+    const double mass = CAR_WEIGHT / 1000.0;                           // LSB:1[kg]
+    const double wheel_limit = grip * mass * VEHICLE_GRAVITY / 4000.0; // 1輪の駆動力の上限 LSB:1[N]
+    const double acc_limit = grip * VEHICLE_GRAVITY;                   // LSB:1[mm/s^2]
+    const s4 pwm[4] = { cmd.fl, cmd.fr, cmd.rl, cmd.rr };
+    double steer_rad = steer * M_PI / 180.0;
+
+    slipping = false;
+
+    // 駆動力(前輪はステアリング角度の分だけ進行方向の成分が減る)
+    double force = 0.0;
+    for ( int i = 0; i < 4; i++ ) {
+        double f = motor_force( motor_voltage( pwm[i], cmd.battery ), speed );
+        if ( fabs( f ) > wheel_limit ) {
+            f = copysign( wheel_limit, f );
+            slipping = true;
+        }
+        force += ( i < 2 ) ? f * cos( steer_rad ) : f;
+    }
+    force -= mass * VEHICLE_GRAVITY / 1000.0 * sin( grade );
+    double resistance = ( speed > 0.0 ) ? -VEHICLE_ROLLING_RESISTANCE : ( speed < 0.0 ) ? VEHICLE_ROLLING_RESISTANCE : 0.0;
+    double acc = ( force + resistance ) * 1000.0 / mass;
+    double new_speed = speed + acc * dt;
+    if ( ( speed != 0.0 ) && ( ( speed > 0.0 ) != ( new_speed > 0.0 ) ) && ( fabs( force ) < VEHICLE_ROLLING_RESISTANCE ) ) {
+        new_speed = 0.0; // 転がり抵抗だけでは逆に動かない
+    }
+
+    // 旋回(駆動と合わせた加速度がグリップの限界を超えたら、限界の曲率までしか曲がらない)
+    double curvature = tan( steer_rad ) / CAR_LENGTH;
+    double lateral = speed * speed * curvature;
+    double lateral_limit = sqrt( fmax( 0.0, acc_limit * acc_limit - acc * acc ) );
+    if ( fabs( lateral ) > lateral_limit ) {
+        lateral = copysign( lateral_limit, lateral );
+        curvature = lateral / ( speed * speed );
+        slipping = true;
+    }
+    lateral_acc = lateral;
+
+    double mid_heading = pose.heading - speed * curvature * dt / 2.0;
+    pose.x += speed * cos( mid_heading ) * dt;
+    pose.y += speed * sin( mid_heading ) * dt;
+    pose.heading -= speed * curvature * dt; // 右(steerが正)に曲がると向きの角度は減る
+    encoder_distance += speed * dt;
+    speed = new_speed;
+
+    // ステアリング(SVが正でsteer_angleが減る向きに回る。角度制御のerror = steer_angle - targetと合わせる)
+    // 走っている間はセルフアライニングトルクで直進に戻ろうとする
+    double target_rate = -VEHICLE_SERVO_RATE * motor_voltage( cmd.sv, cmd.battery ) / VEHICLE_PWM_FULL_VOLTAGE;
+    target_rate -= steer * fabs( speed ) / VEHICLE_SELF_ALIGN_LENGTH;
+    steer_rate += ( target_rate - steer_rate ) * ( 1.0 - exp( -dt / VEHICLE_SERVO_TIME_CONSTANT ) );
+    steer += steer_rate * dt;
+    if ( fabs( steer ) > VEHICLE_STEER_LIMIT ) {
+        steer = copysign( VEHICLE_STEER_LIMIT, steer );
+        steer_rate = 0.0;
+    }
+}
+
+/*
+ * 概要：前回からの走行距離をエンコーダのパルス数で取得する
+ * 引数：なし
+ * 戻り値：パルス数(GPT6のカウント)
+ * 詳細：1パルスに満たない端数は次回に持ち越す
+ */
+s4 sim_vehicle::take_encoder_pulses() {
+    s4 pulses = (s4)( encoder_distance * ENCODER_PULSE_PER_REV / ENCODER_WHEEL_LENGTH );
+    encoder_distance -= (double)pulses * ENCODER_WHEEL_LENGTH / ENCODER_PULSE_PER_REV;
+    return pulses;
+}
+
+/*
+ * 概要：ステアリング角度をサーボのエンコーダのカウントで取得する
+ * 引数：なし
+ * 戻り値：カウント(GPT7の積算値)
+ * 詳細：sensors.cppのangle_update()の逆算
+ */
+s4 sim_vehicle::get_steer_count() const {
+    return (s4)lround( -steer * ANGLE_PULSE * CAR_STEER_GEAR_RATIO / 10 / 360.0 );
+}
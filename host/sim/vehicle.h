@@ -0,0 +1,57 @@
+/*
+ * 概要：シミュレーション用の車体(モーター、ステアリング、タイヤのグリップ)
+ * 寸法と重量はdefines.hのCAR_xxx、エンコーダはENCODER_xxxとANGLE_PULSEを使う
+ * 位置は後輪の車軸の中心、ステアリング角度はsteer_angleと同じく右が正
+ * ステアリングの定数は実機の測定値ではなく、既定のパラメータ(lineP、lineIと各難所の角度、時間)でcourses/sample.txtを完走するように合わせた値
+ *   R450を既定のカーブ速度で曲がる舵角まで切れ、直線で振動しない速さと戻り
+ */
+#pragma once
+#include "defines.h"
+#include "course.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define VEHICLE_PWM_FULL_VOLTAGE ( 10.0 )      // pwm100%の電圧(motor_driver::out_pwm()の補正) LSB:1[V]
+#define VEHICLE_MOTOR_STALL_FORCE ( 3.0 )      // 10Vでのモーター1個の停動時の駆動力 LSB:1[N]
+#define VEHICLE_MOTOR_NO_LOAD_SPEED ( 7000.0 ) // 10Vでの無負荷速度 LSB:1[mm/s]
+#define VEHICLE_ROLLING_RESISTANCE ( 0.3 )     // 転がり抵抗 LSB:1[N]
+#define VEHICLE_SERVO_RATE ( 4000.0 )          // 10Vでのステアリングの無負荷角速度 LSB:1[deg/s]
+#define VEHICLE_SERVO_TIME_CONSTANT ( 0.002 )  // ステアリングの慣性による角速度の遅れ(時定数) LSB:1[s]
+#define VEHICLE_STEER_LIMIT ( 60.0 )           // ステアリングの機械的な限界 LSB:1[deg]
+#define VEHICLE_SELF_ALIGN_LENGTH ( 100.0 )    // タイヤのセルフアライニングトルクでステアリングが戻る速さ(この距離を走ると1/eに戻る) LSB:1[mm]
+#define VEHICLE_GRAVITY ( 9806.65 )            // 重力加速度 LSB:1[mm/s^2]
+
+// モーターへの指令(motor_control.cppのFL、FR、RL、RR、SV)
+typedef struct {
+    s4 fl;
+    s4 fr;
+    s4 rl;
+    s4 rr;
+    s4 sv;
+    double battery; // バッテリー電圧 LSB:1[V]
+} vehicle_command_t;
+
+/***********************************/
+/* Class                           */
+/***********************************/
+class sim_vehicle {
+  public:
+    void reset( const pose_t& start );
+    void step( double dt, const vehicle_command_t& cmd, double grade, double grip );
+    s4 take_encoder_pulses();
+    s4 get_steer_count() const;
+
+    pose_t pose;        // 後輪の車軸の中心
+    double speed;       // 速度 LSB:1[mm/s]
+    double steer;       // ステアリング角度 右が正 LSB:1[deg]
+    double steer_rate;  // ステアリング角速度 LSB:1[deg/s]
+    double lateral_acc; // 横加速度(実際に曲がった分) LSB:1[mm/s^2]
+    bool slipping;      // 直前のstep()でグリップの限界を超えた(空転、ロック、横滑り)
+
+  private:
+    double encoder_distance; // エンコーダのパルスにしていない走行距離 LSB:1[mm]
+};
@@ -0,0 +1,35 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のA/D変換(hal.cppのanalogRead()の値をそのまま返す)
+ */
+#include "adc_scan.h"
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Global functions                */
+/***********************************/
+bool adc_scan_add( pin_size_t pin, bool oversample ) {
+    (void)pin;
+    (void)oversample;
+    return true;
+}
+
+bool adc_scan_start() {
+    return true;
+}
+
+void adc_scan_wait() {
+}
+
+u2 adc_scan_read( pin_size_t pin ) {
+    return (u2)analogRead( pin );
+}
+
+u2 adc_scan_read_fine( pin_size_t pin ) {
+    return (u2)( analogRead( pin ) << ( ADC_SCAN_FINE_BITS - ADC_SCAN_BITS ) );
+}
+
+u4 adc_scan_timeouts() {
+    return 0;
+}
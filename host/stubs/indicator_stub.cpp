@@ -0,0 +1,28 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のLED表示(何もしない)
+ */
+#include "indicator.h"
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Global functions                */
+/***********************************/
+void indicator_init() {
+}
+
+void indicator_exec() {
+}
+
+void indicator_set_board_led( enum e_board_led_pattern pattern ) {
+    (void)pattern;
+}
+
+void indicator_set_neopixel_led( enum e_neopixel_led_pattern pattern ) {
+    (void)pattern;
+}
+
+void indicator_set_progress( u1 percent ) {
+    (void)percent;
+}
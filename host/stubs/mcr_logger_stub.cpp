@@ -0,0 +1,67 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のロガー
+ * SDカードが無いため、ロギング中かどうかのみ持ち、書き込む値は捨てる
+ */
+
+#include "mcr_logger.h"
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Class implementions             */
+/***********************************/
+bool mcr_logger::init() {
+    return true;
+}
+
+bool mcr_logger::make_log_file( bool binary ) {
+    this->binary = binary;
+    return true;
+}
+
+void mcr_logger::write_header( const log_channel_t* channels, u1 num, const log_channel_t* flight_channels, u1 flight_num,
+                               const log_channel_t* input_channels, u1 input_num ) {
+    (void)channels;
+    (void)num;
+    (void)flight_channels;
+    (void)flight_num;
+    (void)input_channels;
+    (void)input_num;
+}
+
+void mcr_logger::logging_begin() {
+    this->logging = true;
+}
+
+void mcr_logger::logging_end() {
+    this->logging = false;
+}
+
+void mcr_logger::exec() {
+}
+
+void mcr_logger::put_record( const log_channel_t* channels, u1 num, const log_record_t* record ) {
+    (void)channels;
+    (void)num;
+    (void)record;
+}
+
+void mcr_logger::put_flight_frame( u1 event, s2 offset, const void* frame, u1 len ) {
+    (void)event;
+    (void)offset;
+    (void)frame;
+    (void)len;
+}
+
+void mcr_logger::put_input_frame( const void* frame, u1 len ) {
+    (void)frame;
+    (void)len;
+}
+
+void mcr_logger::put_event( e_log_event type, s4 value, u4 time_us, s4 distance_mm ) {
+    (void)type;
+    (void)value;
+    (void)time_us;
+    (void)distance_mm;
+}
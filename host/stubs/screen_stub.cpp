@@ -0,0 +1,34 @@
+/*
+ * 概要：ホスト(ネイティブ)ビルド用のスクリーン
+ * スクリーンは未接続とし、テストモードの値は初期値のままとする
+ */
+#include "screen.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global Variables                */
+/***********************************/
+bool screen_is_connected = false;
+u1 line_trace_test_mode = LINETRACE_TEST_NORMAL;
+s4 test_deg = 150;
+u4 test_time = 150;
+u4 test_k = 100;
+u1 angle_ctrl_test_state = 0;
+s1 motor_test_fl = 0;
+s1 motor_test_fr = 0;
+s1 motor_test_rl = 0;
+s1 motor_test_rr = 0;
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Global functions                */
+/***********************************/
+void screen_setup() {
+}
+
+void screen_exec() {
+}
@@ -0,0 +1,141 @@
+/*
+ * 概要：cycle_profilerの統計(最小、平均、最大、ヒストグラム)の単体テスト
+ * 区間のサイクル数はスタブのサイクルカウンタ(cycle_counter_stub)を進めて作る
+ * 使い方：cycle_profiler_test
+ * 戻り値：0:成功 1:失敗
+ */
+
+#include "cycle_profiler.h"
+#include "test_check.h"
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：スタブのカウンタを進めて区間を1回計測する(profile_lap()と同じ計算)
+ * 引数：p 追加先 cycles 区間のサイクル数
+ * 戻り値：なし
+ */
+static void measure( cycle_profiler& p, uint32_t cycles ) {
+    uint32_t start = cycle_counter_read();
+    cycle_counter_stub += cycles;
+    p.add( cycle_counter_read() - start );
+}
+
+/*
+ * 概要：何も追加していない状態
+ */
+static void test_empty() {
+    cycle_profiler p;
+    CHECK_EQ( p.get_count(), 0 );
+    CHECK_EQ( p.get_min(), 0 );
+    CHECK_EQ( p.get_mean(), 0 );
+    CHECK_EQ( p.get_max(), 0 );
+    CHECK_EQ( p.get_last(), 0 );
+    for ( uint8_t bin = 0; bin < CYCLE_PROFILER_HIST_BINS; bin++ ) {
+        CHECK_EQ( p.get_hist( bin ), 0 );
+    }
+    CHECK_EQ( p.get_hist( CYCLE_PROFILER_HIST_BINS ), 0 );
+}
+
+/*
+ * 概要：最小、平均、最大、最後の値と、リセット
+ */
+static void test_statistics() {
+    cycle_profiler p;
+    cycle_counter_init();
+    measure( p, 300 );
+    measure( p, 100 );
+    measure( p, 200 );
+    CHECK_EQ( p.get_count(), 3 );
+    CHECK_EQ( p.get_min(), 100 );
+    CHECK_EQ( p.get_mean(), 200 );
+    CHECK_EQ( p.get_max(), 300 );
+    CHECK_EQ( p.get_last(), 200 );
+
+    p.reset();
+    CHECK_EQ( p.get_count(), 0 );
+    CHECK_EQ( p.get_min(), 0 );
+    CHECK_EQ( p.get_max(), 0 );
+    measure( p, 7 );
+    CHECK_EQ( p.get_min(), 7 );
+    CHECK_EQ( p.get_max(), 7 );
+}
+
+/*
+ * 概要：カウンタが一周しても区間のサイクル数が正しいこと
+ */
+static void test_counter_wrap() {
+    cycle_profiler p;
+    cycle_counter_stub = UINT32_MAX - 10;
+    measure( p, 48 );
+    CHECK_EQ( cycle_counter_stub, 37 );
+    CHECK_EQ( p.get_last(), 48 );
+}
+
+/*
+ * 概要：平均の合計が32bitを超えても正しいこと(1ms周期で約90秒分の最大値)
+ */
+static void test_mean_overflow() {
+    cycle_profiler p;
+    const uint32_t cycles = 10 * CYCLES_PER_US * 1000; // 10[ms]
+    for ( int i = 0; i < 1000; i++ ) {
+        p.add( cycles );
+    }
+    CHECK_EQ( p.get_mean(), cycles );
+}
+
+/*
+ * 概要：ヒストグラムのビンが2倍刻みであること
+ */
+static void test_histogram() {
+    CHECK_EQ( cycle_profiler::bin_of( 0 ), 0 );
+    CHECK_EQ( cycle_profiler::bin_of( CYCLES_PER_US - 1 ), 0 );
+    CHECK_EQ( cycle_profiler::bin_of( CYCLES_PER_US ), 1 );
+    CHECK_EQ( cycle_profiler::bin_of( 2 * CYCLES_PER_US - 1 ), 1 );
+    CHECK_EQ( cycle_profiler::bin_of( 2 * CYCLES_PER_US ), 2 );
+    CHECK_EQ( cycle_profiler::bin_of( 50 * CYCLES_PER_US ), 6 );    // 32～64us
+    CHECK_EQ( cycle_profiler::bin_of( 500 * CYCLES_PER_US ), 9 );   // 256～512us
+    CHECK_EQ( cycle_profiler::bin_of( 1023 * CYCLES_PER_US ), 10 ); // 512～1024us
+    CHECK_EQ( cycle_profiler::bin_of( 1024 * CYCLES_PER_US ), CYCLE_PROFILER_HIST_BINS - 1 );
+    CHECK_EQ( cycle_profiler::bin_of( UINT32_MAX ), CYCLE_PROFILER_HIST_BINS - 1 );
+
+    // 各ビンの下限はそのビンに入り、下限-1は前のビンに入る
+    CHECK_EQ( cycle_profiler::bin_floor( 0 ), 0 );
+    for ( uint8_t bin = 1; bin < CYCLE_PROFILER_HIST_BINS; bin++ ) {
+        CHECK_EQ( cycle_profiler::bin_of( cycle_profiler::bin_floor( bin ) ), bin );
+        CHECK_EQ( cycle_profiler::bin_of( cycle_profiler::bin_floor( bin ) - 1 ), bin - 1 );
+    }
+
+    // 1msタスクの各区間くらいの値が別々のビンに入ること
+    cycle_profiler p;
+    p.add( 5 * CYCLES_PER_US );
+    p.add( 20 * CYCLES_PER_US );
+    p.add( 20 * CYCLES_PER_US );
+    p.add( 120 * CYCLES_PER_US );
+    p.add( 3000 * CYCLES_PER_US );
+    CHECK_EQ( p.get_hist( 3 ), 1 );
+    CHECK_EQ( p.get_hist( 5 ), 2 );
+    CHECK_EQ( p.get_hist( 7 ), 1 );
+    CHECK_EQ( p.get_hist( CYCLE_PROFILER_HIST_BINS - 1 ), 1 );
+    uint32_t total = 0;
+    for ( uint8_t bin = 0; bin < CYCLE_PROFILER_HIST_BINS; bin++ ) {
+        total += p.get_hist( bin );
+    }
+    CHECK_EQ( total, p.get_count() );
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main() {
+    test_empty();
+    test_statistics();
+    test_counter_wrap();
+    test_mean_overflow();
+    test_histogram();
+    return test_result( "cycle_profiler" );
+}
@@ -0,0 +1,216 @@
+/*
+ * 概要：log_extentの単体テスト
+ * ファイルをディスクイメージ(image_block_device)にし、エクステントにsector_streamでデータを書いてMCRFOOT1のフッタで閉じ、
+ * 読み戻してフッタの内容、データ、ファイル長が正しいことを確認する
+ * 使い方：log_extent_test
+ * 戻り値：0:成功 1:失敗
+ */
+
+#include <vector>
+#include "log_extent.h"
+#include "test_check.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define TEST_FIRST_SECTOR ( 40 ) // エクステントの先頭セクタ(イメージの途中にする)
+#define TEST_LAST_SECTOR ( 49 )  // エクステントの最後のセクタ(フッタ用)
+#define TEST_IMAGE_SECTORS ( 64 )
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：sector_streamのセクタをエクステントの次のセクタへ同期で書き込むデバイス(ロガーの完了通知と同じ順に記録する)
+ */
+class extent_device : public sector_device {
+  public:
+    extent_device( block_device* blk, log_extent* extent ) : blk( blk ), extent( extent ) {
+    }
+    bool is_ready() override {
+        return true;
+    }
+    bool start_write( const uint8_t* sector ) override {
+        bool ok = blk->write_sector( extent->next_sector(), sector );
+        extent->mark_written( ok );
+        notify_complete( ok );
+        return true;
+    }
+
+  private:
+    block_device* blk;
+    log_extent* extent;
+};
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：0xFFで埋めた空のディスクイメージを作る
+ */
+static FILE* make_image() {
+    FILE* fp = tmpfile();
+    uint8_t blank[SECTOR_SIZE];
+    memset( blank, 0xFF, sizeof( blank ) );
+    for ( int i = 0; i < TEST_IMAGE_SECTORS; i++ ) {
+        fwrite( blank, sizeof( blank ), 1, fp );
+    }
+    return fp;
+}
+
+/*
+ * 概要：データを書いてフッタで閉じ、読み戻す
+ */
+static void test_round_trip() {
+    FILE* fp = make_image();
+    image_block_device blk( fp );
+    log_extent extent;
+    extent_device dev( &blk, &extent );
+    sector_stream<3> stream( &dev );
+
+    extent.begin( TEST_FIRST_SECTOR, TEST_LAST_SECTOR );
+    CHECK_EQ( extent.data_capacity(), TEST_LAST_SECTOR - TEST_FIRST_SECTOR );
+    stream.begin( extent.data_capacity() );
+
+    std::vector<uint8_t> data( 3 * SECTOR_SIZE + 77 );
+    for ( size_t i = 0; i < data.size(); i++ ) {
+        data[i] = (uint8_t)( i * 7 + 3 );
+    }
+    size_t accepted = 0;
+    for ( size_t pos = 0; pos < data.size(); pos += 300 ) {
+        size_t n = ( data.size() - pos < 300 ) ? data.size() - pos : 300;
+        accepted += stream.write( &data[pos], n );
+        stream.poll();
+    }
+    CHECK_EQ( accepted, data.size() );
+    stream.flush();
+    while ( !stream.is_idle() ) {
+        stream.poll();
+    }
+    CHECK_EQ( extent.get_written(), 4 );
+    CHECK_EQ( extent.next_sector(), TEST_FIRST_SECTOR + 4 );
+    CHECK_EQ( extent.file_bytes(), 5 * SECTOR_SIZE );
+    CHECK( extent.finalize( &blk, stream.get_bytes_accepted() ) );
+
+    // フッタ
+    log_footer_t footer;
+    CHECK( log_extent::read_footer( &blk, TEST_FIRST_SECTOR + 4, &footer ) );
+    CHECK( memcmp( footer.magic, LOG_FOOTER_MAGIC, 8 ) == 0 );
+    CHECK_EQ( footer.first_sector, TEST_FIRST_SECTOR );
+    CHECK_EQ( footer.sector_count, TEST_LAST_SECTOR - TEST_FIRST_SECTOR + 1 );
+    CHECK_EQ( footer.data_bytes, data.size() );
+    CHECK_EQ( footer.data_sectors, 4 );
+    CHECK_EQ( footer.errors, 0 );
+    CHECK( !log_extent::read_footer( &blk, TEST_FIRST_SECTOR + 3, &footer ) ); // データのセクタはフッタではない
+
+    // データ(最後のセクタの余りは0)
+    std::vector<uint8_t> back( 4 * SECTOR_SIZE );
+    for ( uint32_t i = 0; i < 4; i++ ) {
+        CHECK( blk.read_sector( TEST_FIRST_SECTOR + i, &back[i * SECTOR_SIZE] ) );
+    }
+    CHECK( memcmp( back.data(), data.data(), data.size() ) == 0 );
+    bool padded = true;
+    for ( size_t i = data.size(); i < back.size(); i++ ) {
+        padded = padded && back[i] == 0;
+    }
+    CHECK( padded );
+
+    // エクステントの外は書き換えない
+    uint8_t outside[SECTOR_SIZE];
+    CHECK( blk.read_sector( TEST_FIRST_SECTOR - 1, outside ) );
+    CHECK_EQ( outside[0], 0xFF );
+    CHECK( blk.read_sector( TEST_FIRST_SECTOR + 5, outside ) );
+    CHECK_EQ( outside[SECTOR_SIZE - 1], 0xFF );
+    fclose( fp );
+}
+
+/*
+ * 概要：壊れたフッタ、位置の合わないフッタは読めない
+ */
+static void test_corrupt_footer() {
+    FILE* fp = make_image();
+    image_block_device blk( fp );
+    log_extent extent;
+
+    extent.begin( TEST_FIRST_SECTOR, TEST_LAST_SECTOR );
+    extent.mark_written( true );
+    extent.mark_written( false );
+    CHECK( extent.finalize( &blk, 600 ) );
+
+    log_footer_t footer;
+    CHECK( log_extent::read_footer( &blk, TEST_FIRST_SECTOR + 2, &footer ) );
+    CHECK_EQ( footer.errors, 1 );
+
+    // 1バイト壊すとCRCで検出する
+    uint8_t sector[SECTOR_SIZE];
+    CHECK( blk.read_sector( TEST_FIRST_SECTOR + 2, sector ) );
+    sector[offsetof( log_footer_t, data_bytes )] ^= 0x01;
+    CHECK( blk.write_sector( TEST_FIRST_SECTOR + 2, sector ) );
+    CHECK( !log_extent::read_footer( &blk, TEST_FIRST_SECTOR + 2, &footer ) );
+
+    // 別のエクステントの位置にコピーしたフッタは、データの直後ではないため読めない
+    extent.begin( TEST_FIRST_SECTOR, TEST_LAST_SECTOR );
+    CHECK( extent.finalize( &blk, 0 ) );
+    CHECK( blk.read_sector( TEST_FIRST_SECTOR, sector ) );
+    CHECK( blk.write_sector( TEST_FIRST_SECTOR + 8, sector ) );
+    CHECK( log_extent::read_footer( &blk, TEST_FIRST_SECTOR, &footer ) );
+    CHECK( !log_extent::read_footer( &blk, TEST_FIRST_SECTOR + 8, &footer ) );
+
+    // イメージの外は読めない
+    CHECK( !log_extent::read_footer( &blk, TEST_IMAGE_SECTORS + 10, &footer ) );
+    fclose( fp );
+}
+
+/*
+ * 概要：最後のセクタはフッタ用に空け、データはその手前までに制限する
+ */
+static void test_full() {
+    FILE* fp = make_image();
+    image_block_device blk( fp );
+    log_extent extent;
+    extent_device dev( &blk, &extent );
+    sector_stream<3> stream( &dev );
+
+    extent.begin( TEST_FIRST_SECTOR, TEST_LAST_SECTOR );
+    stream.begin( extent.data_capacity() );
+    std::vector<uint8_t> data( ( extent.data_capacity() + 2 ) * SECTOR_SIZE, 0x42 );
+    size_t accepted = 0;
+    for ( size_t pos = 0; pos < data.size(); pos += SECTOR_SIZE ) {
+        accepted += stream.write( &data[pos], SECTOR_SIZE );
+        stream.poll();
+    }
+    while ( !stream.is_idle() ) {
+        stream.poll();
+    }
+    CHECK_EQ( accepted, extent.data_capacity() * SECTOR_SIZE );
+    CHECK( extent.is_full() );
+    CHECK( !extent.mark_written( true ) );
+    CHECK_EQ( extent.next_sector(), TEST_LAST_SECTOR );
+    CHECK( extent.finalize( &blk, accepted ) );
+
+    log_footer_t footer;
+    CHECK( log_extent::read_footer( &blk, TEST_LAST_SECTOR, &footer ) );
+    CHECK_EQ( footer.data_sectors, extent.data_capacity() );
+
+    // 領域が無い場合はフッタを書かない
+    extent.begin( 10, 9 );
+    CHECK_EQ( extent.data_capacity(), 0 );
+    CHECK( !extent.finalize( &blk, 0 ) );
+    fclose( fp );
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main() {
+    test_round_trip();
+    test_corrupt_footer();
+    test_full();
+    return test_result( "log_extent" );
+}
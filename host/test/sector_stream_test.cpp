@@ -0,0 +1,285 @@
+/*
+ * 概要：sector_streamの単体テスト
+ * 偽のブロックデバイス(書き込み中、完了、失敗をテストから操作できる)と組み合わせ、
+ * 3面のバッファの回り方、デバイスが書き込み中の場合、途中のセクタのフラッシュ、あふれたバイト数の計上を確認する
+ * 使い方：sector_stream_test
+ * 戻り値：0:成功 1:失敗
+ */
+
+#include <vector>
+#include "sector_stream.h"
+#include "test_check.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define TEST_BUFFERS ( 3 ) // ロガーと同じ3面
+
+typedef sector_stream<TEST_BUFFERS> test_stream;
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：偽のブロックデバイス
+ * start_write()したセクタを記録し、finish()で完了を通知する(実機のDMA完了割り込みの代わり)
+ * busyの間はis_ready()がfalseになる(カードが書き込み中)
+ */
+class fake_device : public sector_device {
+  public:
+    bool is_ready() override {
+        return !busy && !transferring;
+    }
+    bool start_write( const uint8_t* sector ) override {
+        if ( refuse ) {
+            return false;
+        }
+        transferring = true;
+        pending = sector;
+        return true;
+    }
+    // 転送中のセクタの書き込みを終える
+    void finish( bool ok = true ) {
+        sectors.push_back( std::vector<uint8_t>( pending, pending + SECTOR_SIZE ) );
+        transferring = false;
+        notify_complete( ok );
+    }
+    bool busy = false;         // カードが書き込み中
+    bool refuse = false;       // start_write()を失敗させる
+    bool transferring = false; // 転送中
+    const uint8_t* pending = nullptr;
+    std::vector<std::vector<uint8_t>> sectors; // 書き込んだセクタ
+};
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static std::vector<uint32_t> completed_index; // 完了通知のセクタ番号
+static std::vector<bool> completed_ok;        // 完了通知の結果
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+static void on_sector( void* context, uint32_t sector_index, bool ok ) {
+    (void)context;
+    completed_index.push_back( sector_index );
+    completed_ok.push_back( ok );
+}
+
+/*
+ * 概要：値が番号になっているバイト列を作る
+ */
+static std::vector<uint8_t> pattern( size_t len, uint8_t seed ) {
+    std::vector<uint8_t> data( len );
+    for ( size_t i = 0; i < len; i++ ) {
+        data[i] = (uint8_t)( seed + i );
+    }
+    return data;
+}
+
+/*
+ * 概要：3面のバッファがFREE -> FILLING -> READY -> WRITING -> FREEと順に回り、セクタが順番通りに書かれること
+ */
+static void test_rotation() {
+    fake_device dev;
+    test_stream s( &dev );
+    completed_index.clear();
+    completed_ok.clear();
+    s.set_callback( on_sector, nullptr );
+    s.begin( UINT32_MAX );
+
+    // 7セクタ分を1セクタより小さい単位で書き、1セクタごとに書き込みを進める
+    std::vector<uint8_t> data = pattern( 7 * SECTOR_SIZE, 1 );
+    size_t pos = 0;
+    uint8_t expected_buffer = 0;
+    while ( pos < data.size() ) {
+        size_t n = ( data.size() - pos < 200 ) ? data.size() - pos : 200;
+        CHECK_EQ( s.write( &data[pos], n ), n );
+        pos += n;
+        if ( s.get_state( expected_buffer ) == test_stream::BUFFER_READY ) {
+            s.poll();
+            CHECK_EQ( s.get_state( expected_buffer ), test_stream::BUFFER_WRITING );
+            CHECK( dev.transferring );
+            dev.finish();
+            CHECK_EQ( s.get_state( expected_buffer ), test_stream::BUFFER_FREE );
+            expected_buffer = ( expected_buffer + 1 ) % TEST_BUFFERS;
+        }
+    }
+    CHECK( s.is_idle() );
+    CHECK_EQ( s.get_sectors_written(), 7 );
+    CHECK_EQ( s.get_errors(), 0 );
+    CHECK_EQ( s.get_bytes_accepted(), data.size() );
+    CHECK_EQ( s.get_overflow_bytes(), 0 );
+    CHECK_EQ( dev.sectors.size(), 7 );
+    for ( size_t i = 0; i < dev.sectors.size(); i++ ) {
+        CHECK( memcmp( dev.sectors[i].data(), &data[i * SECTOR_SIZE], SECTOR_SIZE ) == 0 );
+    }
+    CHECK_EQ( completed_index.size(), 7 );
+    for ( uint32_t i = 0; i < completed_index.size(); i++ ) {
+        CHECK_EQ( completed_index[i], i );
+        CHECK( completed_ok[i] );
+    }
+}
+
+/*
+ * 概要：デバイスが書き込み中の間は開始せず、バッファが全て埋まったら受け付けない。空いたら順番通りに書く
+ */
+static void test_device_busy() {
+    fake_device dev;
+    test_stream s( &dev );
+    s.begin( UINT32_MAX );
+    dev.busy = true;
+
+    std::vector<uint8_t> data = pattern( TEST_BUFFERS * SECTOR_SIZE, 7 );
+    CHECK_EQ( s.write( data.data(), data.size() ), data.size() );
+    s.poll();
+    CHECK( !dev.transferring );
+    for ( uint8_t i = 0; i < TEST_BUFFERS; i++ ) {
+        CHECK_EQ( s.get_state( i ), test_stream::BUFFER_READY );
+    }
+    CHECK_EQ( s.bytes_free(), 0 );
+    uint8_t extra = 0xEE;
+    CHECK_EQ( s.write( &extra, 1 ), 0 );
+    CHECK( !s.is_idle() );
+
+    // 1セクタ分書けると、そのバッファだけ空く
+    dev.busy = false;
+    s.poll();
+    CHECK_EQ( s.get_state( 0 ), test_stream::BUFFER_WRITING );
+    s.poll(); // 転送中は次を開始しない
+    CHECK_EQ( s.get_state( 1 ), test_stream::BUFFER_READY );
+    dev.finish();
+    CHECK_EQ( s.bytes_free(), SECTOR_SIZE );
+    while ( !s.is_idle() ) {
+        s.poll();
+        if ( dev.transferring ) {
+            dev.finish();
+        }
+    }
+    CHECK_EQ( dev.sectors.size(), TEST_BUFFERS );
+    for ( size_t i = 0; i < dev.sectors.size(); i++ ) {
+        CHECK( memcmp( dev.sectors[i].data(), &data[i * SECTOR_SIZE], SECTOR_SIZE ) == 0 );
+    }
+    CHECK_EQ( s.get_overflow_bytes(), 1 );
+}
+
+/*
+ * 概要：書き込み途中のセクタのフラッシュは残りを0で埋め、埋めた分は受け付けたバイト数に含めない
+ */
+static void test_flush_partial() {
+    fake_device dev;
+    test_stream s( &dev );
+    s.begin( UINT32_MAX );
+
+    CHECK_EQ( s.flush(), 0 ); // 何も書いていなければ何もしない
+    std::vector<uint8_t> data = pattern( SECTOR_SIZE + 100, 3 );
+    CHECK_EQ( s.write( data.data(), data.size() ), data.size() );
+    CHECK_EQ( s.flush(), SECTOR_SIZE - 100 );
+    CHECK_EQ( s.flush(), 0 ); // 2回目は何もしない
+    CHECK_EQ( s.get_state( 1 ), test_stream::BUFFER_READY );
+    CHECK_EQ( s.get_bytes_accepted(), data.size() );
+
+    while ( !s.is_idle() ) {
+        s.poll();
+        if ( dev.transferring ) {
+            dev.finish();
+        }
+    }
+    CHECK_EQ( dev.sectors.size(), 2 );
+    CHECK( memcmp( dev.sectors[1].data(), &data[SECTOR_SIZE], 100 ) == 0 );
+    bool padded = true;
+    for ( size_t i = 100; i < SECTOR_SIZE; i++ ) {
+        padded = padded && dev.sectors[1][i] == 0;
+    }
+    CHECK( padded );
+
+    // フラッシュした後の書き込みは次のセクタから始まる
+    uint8_t next = 0x5A;
+    CHECK_EQ( s.write( &next, 1 ), 1 );
+    CHECK_EQ( s.flush(), SECTOR_SIZE - 1 );
+    s.poll();
+    dev.finish();
+    CHECK_EQ( dev.sectors.size(), 3 );
+    CHECK_EQ( dev.sectors[2][0], 0x5A );
+}
+
+/*
+ * 概要：受け付けられなかったバイト数の計上と、空き容量(bytes_free)がwrite()の結果と一致すること
+ */
+static void test_overflow_accounting() {
+    fake_device dev;
+    test_stream s( &dev );
+    s.begin( UINT32_MAX );
+    dev.busy = true;
+
+    CHECK_EQ( s.capacity(), TEST_BUFFERS * SECTOR_SIZE );
+    CHECK_EQ( s.bytes_free(), s.capacity() );
+    std::vector<uint8_t> data = pattern( 1000, 0 );
+    CHECK_EQ( s.write( data.data(), 1000 ), 1000 );
+    CHECK_EQ( s.bytes_free(), s.capacity() - 1000 );
+    size_t free_bytes = s.bytes_free();
+    CHECK_EQ( s.write( data.data(), 1000 ), free_bytes ); // 途中まで受け付ける
+    CHECK_EQ( s.get_bytes_accepted(), 1000 + free_bytes );
+    CHECK_EQ( s.get_overflow_bytes(), 1000 - free_bytes );
+    CHECK_EQ( s.write( data.data(), 300 ), 0 );
+    CHECK_EQ( s.get_overflow_bytes(), 1300 - free_bytes );
+
+    // 書き込めるセクタ数の上限: 上限を超える分は空き容量にも含めず、受け付けない
+    s.begin( 2 );
+    dev.busy = false;
+    CHECK_EQ( s.get_overflow_bytes(), 0 );
+    CHECK_EQ( s.get_bytes_accepted(), 0 );
+    CHECK_EQ( s.bytes_free(), 2 * SECTOR_SIZE );
+    CHECK_EQ( s.write( data.data(), 700 ), 700 );
+    CHECK_EQ( s.bytes_free(), 2 * SECTOR_SIZE - 700 );
+    CHECK_EQ( s.write( data.data(), 700 ), 2 * SECTOR_SIZE - 700 );
+    CHECK_EQ( s.get_overflow_bytes(), 1400 - 2 * SECTOR_SIZE );
+    CHECK_EQ( s.bytes_free(), 0 );
+}
+
+/*
+ * 概要：書き込みの開始や完了に失敗したセクタはエラーとして数え、バッファは空きに戻す
+ */
+static void test_errors() {
+    fake_device dev;
+    test_stream s( &dev );
+    completed_index.clear();
+    completed_ok.clear();
+    s.set_callback( on_sector, nullptr );
+    s.begin( UINT32_MAX );
+
+    std::vector<uint8_t> data = pattern( 2 * SECTOR_SIZE, 9 );
+    CHECK_EQ( s.write( data.data(), data.size() ), data.size() );
+    dev.refuse = true;
+    s.poll();
+    CHECK_EQ( s.get_state( 0 ), test_stream::BUFFER_FREE );
+    CHECK_EQ( s.get_errors(), 1 );
+    dev.refuse = false;
+    s.poll();
+    dev.finish( false );
+    CHECK_EQ( s.get_state( 1 ), test_stream::BUFFER_FREE );
+    CHECK_EQ( s.get_errors(), 2 );
+    CHECK_EQ( s.get_sectors_written(), 2 );
+    CHECK_EQ( completed_ok.size(), 2 );
+    CHECK( !completed_ok[0] );
+    CHECK( !completed_ok[1] );
+    CHECK( s.is_idle() );
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main() {
+    test_rotation();
+    test_device_busy();
+    test_flush_partial();
+    test_overflow_accounting();
+    test_errors();
+    return test_result( "sector_stream" );
+}
@@ -0,0 +1,135 @@
+/*
+ * 概要：spsc_queueの単体テストと、書き込み側と読み出し側を別スレッドにしたストレステスト
+ * ストレステストは小さなキューで何度もリングバッファを一周させ、順序が保たれ、捨てた要素以外が失われないことを確認する
+ * 使い方：spsc_queue_test [ストレステストの要素数]
+ * 戻り値：0:成功 1:失敗
+ */
+
+#include <stdlib.h>
+#include <thread>
+#include "spsc_queue.h"
+#include "test_check.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define TEST_STRESS_ITEMS ( 2000000 ) // ストレステストの要素数の既定値
+#define TEST_STRESS_DEPTH ( 8 )       // ストレステストのキューの深さ(小さくして頻繁に一周させる)
+
+// ストレステストの要素 seqから他のメンバーを計算できるため、途中まで書かれた要素を読むと検出できる
+typedef struct {
+    uint32_t seq;
+    uint32_t inverted; // ~seq
+    uint64_t square;   // seq * seq
+} test_item_t;
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：ストレステストの要素を作る
+ * 引数：seq 番号
+ * 戻り値：要素
+ */
+static test_item_t make_item( uint32_t seq ) {
+    test_item_t item;
+    item.seq = seq;
+    item.inverted = ~seq;
+    item.square = (uint64_t)seq * seq;
+    return item;
+}
+
+/*
+ * 概要：1スレッドでの追加、取り出し、満杯、一周
+ */
+static void test_single_thread() {
+    spsc_queue<uint32_t, 4> q;
+    uint32_t v = 0;
+    CHECK_EQ( q.capacity(), 4 );
+    CHECK_EQ( q.size(), 0 );
+    CHECK( !q.pop( &v ) );
+
+    for ( uint32_t i = 0; i < 4; i++ ) {
+        CHECK( q.push( i ) );
+    }
+    CHECK_EQ( q.size(), 4 );
+    CHECK( !q.push( 99 ) ); // 満杯は捨てて数える
+    CHECK( !q.push( 99 ) );
+    CHECK_EQ( q.get_dropped(), 2 );
+
+    // 取り出しと追加を交互に行い、何度も一周させる
+    uint32_t expected = 0;
+    for ( uint32_t i = 4; i < 100; i++ ) {
+        CHECK( q.pop( &v ) );
+        CHECK_EQ( v, expected++ );
+        CHECK( q.push( i ) );
+        CHECK_EQ( q.size(), 4 );
+    }
+    while ( q.pop( &v ) ) {
+        CHECK_EQ( v, expected++ );
+    }
+    CHECK_EQ( expected, 100 );
+    CHECK_EQ( q.size(), 0 );
+    CHECK_EQ( q.get_dropped(), 2 );
+}
+
+/*
+ * 概要：書き込み側と読み出し側を別スレッドにしたストレステスト
+ * 引数：items 要素数
+ * 詳細：書き込み側は満杯なら同じ要素を追加し直す(捨てた数はget_dropped()と一致すること)
+ *      読み出し側は全ての要素が番号順に1回ずつ、途中まで書かれていない状態で届くことを確認する
+ */
+static void test_stress( uint32_t items ) {
+    static spsc_queue<test_item_t, TEST_STRESS_DEPTH> q;
+    uint32_t refused = 0;
+
+    std::thread producer( [&]() {
+        for ( uint32_t seq = 0; seq < items; ) {
+            if ( q.push( make_item( seq ) ) ) {
+                seq++;
+            } else {
+                refused++;
+                std::this_thread::yield();
+            }
+        }
+    } );
+
+    uint32_t expected = 0;
+    uint32_t out_of_order = 0;
+    uint32_t torn = 0;
+    while ( expected < items ) {
+        test_item_t item;
+        if ( !q.pop( &item ) ) {
+            std::this_thread::yield(); // CPUが1個でも書き込み側が進むようにする
+            continue;
+        }
+        out_of_order += ( item.seq != expected ) ? 1 : 0;
+        torn += ( item.inverted != ~item.seq || item.square != (uint64_t)item.seq * item.seq ) ? 1 : 0;
+        expected = item.seq + 1;
+    }
+    producer.join();
+
+    test_item_t rest;
+    CHECK( !q.pop( &rest ) ); // 余分な要素が無いこと
+    CHECK_EQ( out_of_order, 0 );
+    CHECK_EQ( torn, 0 );
+    CHECK_EQ( expected, items );
+    CHECK_EQ( q.get_dropped(), refused );
+    printf( "ストレステスト 要素%u 一周%u回 満杯%u回\n", items, items / TEST_STRESS_DEPTH, refused );
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main( int argc, char** argv ) {
+    uint32_t items = ( argc > 1 ) ? (uint32_t)atol( argv[1] ) : TEST_STRESS_ITEMS;
+    test_single_thread();
+    test_stress( items );
+    return test_result( "spsc_queue" );
+}
@@ -0,0 +1,66 @@
+/*
+ * 概要：ホストで実行する単体テストの共通処理
+ * CHECK()で条件を確認し、失敗した条件はファイル名と行番号を表示して数える
+ * main()はtest_result()を戻り値にする(0:全て成功 1:失敗あり)
+ */
+
+#pragma once
+#include <stdio.h>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+// 条件を確認する。失敗しても続けて実行する
+#define CHECK( cond ) test_check( ( cond ), #cond, __FILE__, __LINE__ )
+// 2つの整数が等しいことを確認する。失敗したら両方の値を表示する
+#define CHECK_EQ( actual, expected ) test_check_eq( (long long)( actual ), (long long)( expected ), #actual, __FILE__, __LINE__ )
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+inline unsigned test_checks = 0;   // 確認した条件の数
+inline unsigned test_failures = 0; // 失敗した条件の数
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：条件を確認する
+ * 引数：cond 条件 text 条件の文字列 file ファイル名 line 行番号
+ * 戻り値：条件
+ */
+static inline bool test_check( bool cond, const char* text, const char* file, int line ) {
+    test_checks++;
+    if ( !cond ) {
+        test_failures++;
+        printf( "%s:%d: 失敗 %s\n", file, line, text );
+    }
+    return cond;
+}
+
+/*
+ * 概要：2つの整数が等しいことを確認する
+ * 引数：actual 値 expected 期待値 text 値の式の文字列 file ファイル名 line 行番号
+ * 戻り値：true:等しい
+ */
+static inline bool test_check_eq( long long actual, long long expected, const char* text, const char* file, int line ) {
+    test_checks++;
+    if ( actual != expected ) {
+        test_failures++;
+        printf( "%s:%d: 失敗 %s = %lld (期待値 %lld)\n", file, line, text, actual, expected );
+    }
+    return actual == expected;
+}
+
+/*
+ * 概要：テストの結果を表示する
+ * 引数：name テストの名前
+ * 戻り値：0:全て成功 1:失敗あり
+ */
+static inline int test_result( const char* name ) {
+    printf( "%s: %u件中 %u件失敗\n", name, test_checks, test_failures );
+    return ( test_failures == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+/*
+ * 概要：tick_monitorの遅れ、抜け、処理時間超過、ジッタの単体テスト
+ * 時刻は1msタスクと同じ48MHzのサイクル数を模擬した時計で与える
+ * 使い方：tick_monitor_test
+ * 戻り値：0:成功 1:失敗
+ */
+
+#include "tick_monitor.h"
+#include "test_check.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define TEST_PERIOD ( 48000 )   // 周期 1[ms]
+#define TEST_TOLERANCE ( 2400 ) // 許容値 50[us]
+#define TEST_WORK ( 10000 )     // タスクの処理時間
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：模擬した時計でタスクを実行する
+ */
+class simulated_task {
+  public:
+    simulated_task( uint32_t start ) : mon( TEST_PERIOD, TEST_TOLERANCE ), now( start ) {
+    }
+    // interval後にタスクを開始し、work後に終える
+    void tick( uint32_t interval, uint32_t work = TEST_WORK ) {
+        now += interval;
+        mon.entry( now );
+        mon.exit( now + work );
+    }
+    tick_monitor mon;
+    uint32_t now;
+};
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：周期通りなら異常なし、最初のentry()は間隔を測らない
+ */
+static void test_on_time() {
+    simulated_task t( 12345 );
+    for ( int i = 0; i < 100; i++ ) {
+        t.tick( TEST_PERIOD );
+    }
+    CHECK_EQ( t.mon.get_ticks(), 100 );
+    CHECK_EQ( t.mon.get_faults(), 0 );
+    CHECK( !t.mon.is_fault() );
+    CHECK_EQ( t.mon.get_worst_jitter(), 0 );
+}
+
+/*
+ * 概要：許容値までのずれは遅れにせず、超えたら遅れにする
+ */
+static void test_late() {
+    simulated_task t( 0 );
+    t.tick( TEST_PERIOD );
+    t.tick( TEST_PERIOD + TEST_TOLERANCE );
+    CHECK_EQ( t.mon.get_late(), 0 );
+    CHECK_EQ( t.mon.get_worst_jitter(), TEST_TOLERANCE );
+
+    t.tick( TEST_PERIOD - TEST_TOLERANCE ); // 早い方は遅れにしないが、ジッタにはなる
+    CHECK_EQ( t.mon.get_late(), 0 );
+    CHECK_EQ( t.mon.get_last_jitter(), TEST_TOLERANCE );
+
+    t.tick( TEST_PERIOD + TEST_TOLERANCE + 1 );
+    CHECK_EQ( t.mon.get_late(), 1 );
+    CHECK_EQ( t.mon.get_missed(), 0 );
+    CHECK_EQ( t.mon.get_worst_jitter(), TEST_TOLERANCE + 1 );
+    CHECK_EQ( t.mon.get_faults(), 1 );
+    CHECK( t.mon.is_fault() );
+
+    t.tick( TEST_PERIOD );
+    CHECK_EQ( t.mon.get_last_jitter(), 0 );
+    CHECK_EQ( t.mon.get_worst_jitter(), TEST_TOLERANCE + 1 );
+}
+
+/*
+ * 概要：周期の1.5倍以上の間隔は、実行されなかった周期の数を抜けとして数える
+ */
+static void test_missed() {
+    simulated_task t( 0 );
+    t.tick( TEST_PERIOD );
+    t.tick( TEST_PERIOD + TEST_PERIOD / 2 - 1 );
+    CHECK_EQ( t.mon.get_late(), 1 );
+    CHECK_EQ( t.mon.get_missed(), 0 );
+
+    t.tick( 2 * TEST_PERIOD );
+    CHECK_EQ( t.mon.get_late(), 2 );
+    CHECK_EQ( t.mon.get_missed(), 1 );
+
+    t.tick( 3 * TEST_PERIOD + TEST_PERIOD / 3 ); // 約3.3周期 → 2周期抜け
+    CHECK_EQ( t.mon.get_late(), 3 );
+    CHECK_EQ( t.mon.get_missed(), 3 );
+    CHECK_EQ( t.mon.get_faults(), 6 );
+}
+
+/*
+ * 概要：処理時間が周期を超えたら処理時間超過にする
+ */
+static void test_overrun() {
+    simulated_task t( 0 );
+    t.tick( TEST_PERIOD, TEST_PERIOD );
+    CHECK_EQ( t.mon.get_overrun(), 0 );
+    t.tick( TEST_PERIOD, TEST_PERIOD + 1 );
+    CHECK_EQ( t.mon.get_overrun(), 1 );
+    CHECK_EQ( t.mon.get_late(), 0 );
+    CHECK( t.mon.is_fault() );
+}
+
+/*
+ * 概要：時刻が32bitで一周しても、間隔、遅れ、処理時間超過が正しいこと
+ */
+static void test_wrap() {
+    simulated_task t( UINT32_MAX - 3 * TEST_PERIOD );
+    for ( int i = 0; i < 6; i++ ) {
+        t.tick( TEST_PERIOD );
+    }
+    CHECK( t.now < 3 * TEST_PERIOD ); // 一周している
+    CHECK_EQ( t.mon.get_faults(), 0 );
+    CHECK_EQ( t.mon.get_worst_jitter(), 0 );
+
+    // 一周をまたぐ遅れと抜け
+    simulated_task late( UINT32_MAX - 100 );
+    late.tick( 0 );
+    late.tick( 2 * TEST_PERIOD );
+    CHECK_EQ( late.mon.get_late(), 1 );
+    CHECK_EQ( late.mon.get_missed(), 1 );
+
+    // 一周をまたぐ処理時間超過
+    simulated_task overrun( UINT32_MAX - 100 );
+    overrun.tick( 0, TEST_PERIOD + 1 );
+    CHECK_EQ( overrun.mon.get_overrun(), 1 );
+    CHECK_EQ( overrun.mon.get_late(), 0 );
+}
+
+/*
+ * 概要：リセットで全てクリアし、次のentry()は間隔を測らない
+ */
+static void test_reset() {
+    simulated_task t( 0 );
+    t.tick( TEST_PERIOD );
+    t.tick( 5 * TEST_PERIOD, 2 * TEST_PERIOD );
+    CHECK( t.mon.is_fault() );
+    t.mon.reset();
+    CHECK_EQ( t.mon.get_ticks(), 0 );
+    CHECK_EQ( t.mon.get_faults(), 0 );
+    CHECK_EQ( t.mon.get_worst_jitter(), 0 );
+    t.tick( 10 * TEST_PERIOD );
+    CHECK_EQ( t.mon.get_faults(), 0 );
+    t.tick( TEST_PERIOD );
+    CHECK_EQ( t.mon.get_faults(), 0 );
+    CHECK_EQ( t.mon.get_ticks(), 2 );
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main() {
+    test_on_time();
+    test_late();
+    test_missed();
+    test_overrun();
+    test_wrap();
+    test_reset();
+    return test_result( "tick_monitor" );
+}
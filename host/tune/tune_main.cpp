@@ -0,0 +1,858 @@
+/*
+ * 概要：シミュレーター(host/sim)で走行用パラメータを探索し、完走率とタイムのよい組み合わせを求める
+ * 探索範囲のファイルに書いたパラメータの候補を作り、候補ごとにコース×摩擦係数の全ての条件でsimを実行する
+ * simは1回の実行ごとに別プロセスで起動し、CPUのコア数だけ並列に実行する(制御コードはグローバル変数を持つため)
+ * 使い方：tune <探索範囲ファイル> -c <コースファイル> [-c コースファイル ...] [-s simの実行ファイル] [-P 固定パラメータファイル]
+ *             [-m grid|random|cmaes] [-n 候補の数] [-j 並列数] [-g 摩擦係数0.01[,摩擦係数0.01...]] [-t 制限時間ms] [-r 乱数の種]
+ *             [-o 結果csv] [-w 最良パラメータファイル] [-S paramコマンドファイル]
+ *        探索範囲ファイルは1行に"短縮名,最小値,最大値[,刻み]"(刻みの省略時は1)。空行と#で始まる行は読み飛ばす
+ *        固定パラメータファイルはsimの-Pと同じ形式で、候補のパラメータより先に設定する
+ *        grid:全ての組み合わせ random:一様乱数 cmaes:対角共分散のCMA-ES(sep-CMA-ES)でコストを最小にする
+ * 出力：標準出力に完走失敗率とタイム(完走した条件の平均)のパレート最適な候補を表示する
+ *       -oは全ての候補の結果、-wは最良の候補(失敗率が最小のうちタイムが最短)をsimの-Pで読める形式で書き出す
+ *       -Sは最良の候補をsimの-wでテストモードのparam set/saveコマンドにして書き出す
+ *       1条件でも完走した候補が無いときは、-w、-Sを書き出さずに理由を表示する(-oは書き出す)
+ * 戻り値：0:成功 1:完走した候補が無い 2:引数、ファイルの誤り、またはsimを実行できない
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define TUNE_LINE_SIZE ( 256 )             // 探索範囲ファイルの1行の最大長
+#define TUNE_FAIL_COST_MS ( 100000.0 )     // 完走できない条件のコスト(これに走れなかった距離の割合分を足す) LSB:1[ms]
+#define TUNE_BATCH_SIZE ( 256 )            // grid、randomで一度に評価する候補の数
+#define TUNE_CMAES_SIGMA ( 0.3 )           // CMA-ESのステップサイズの初期値(探索範囲を0～1にした大きさ)
+#define TUNE_DEFAULT_SIM ".pio/build/sim/program"
+
+// 探索するパラメータ1個
+typedef struct {
+    std::string name; // 短縮名
+    long min;
+    long max;
+    long step; // 刻み(最小値からこの倍数の値だけ試す)
+} tune_range_t;
+
+// 1回のsimの実行条件
+typedef struct {
+    std::string course; // コースファイル
+    unsigned grip;      // 摩擦係数 LSB:0.01[-]
+} tune_scenario_t;
+
+// 候補1個の結果
+typedef struct {
+    std::vector<long> values; // パラメータの値(探索範囲ファイルの順)
+    int runs;                 // 実行した条件の数
+    int finished;             // 完走した条件の数
+    double lap_ms;            // 完走した条件の平均タイム(完走が無ければ0) LSB:1[ms]
+    double cost;              // 全ての条件の平均コスト LSB:1[ms]
+    bool pareto;              // パレート最適
+} tune_result_t;
+
+// 実行条件
+typedef struct {
+    const char* spec;                    // 探索範囲ファイル
+    std::vector<tune_scenario_t> scenes; // コース×摩擦係数
+    const char* sim;                     // simの実行ファイル
+    const char* base;                    // 固定パラメータファイル(nullptrなら無し)
+    const char* method;                  // 探索方法
+    unsigned budget;                     // 評価する候補の数の上限
+    unsigned jobs;                       // 並列数
+    unsigned timeout_ms;                 // simの制限時間 LSB:1[ms]
+    unsigned seed;                       // 乱数の種
+    const char* results;                 // 結果csv(nullptrなら出力しない)
+    const char* best;                    // 最良パラメータファイル(nullptrなら出力しない)
+    const char* command;                 // paramコマンドファイル(nullptrなら出力しない)
+} tune_options_t;
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static tune_options_t opt;
+static std::vector<tune_range_t> ranges;
+static std::string base_text;                              // 固定パラメータファイルの内容
+static char work_dir[] = "/tmp/mcr_tuneXXXXXX";             // 候補のパラメータファイルを置くディレクトリ
+static std::vector<tune_result_t> history;                 // 評価した全ての候補(重複なし)
+static std::map<std::vector<long>, size_t> history_index;  // 値からhistoryの位置を引く
+static std::mt19937 rng;
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：コマンドライン引数を読む
+ * 引数：argc、argv main()の引数
+ * 戻り値：成功:true 探索範囲ファイルかコースファイルが無い、または不明な引数:false
+ */
+static bool parse_options( int argc, char** argv ) {
+    std::vector<std::string> courses;
+    std::vector<unsigned> grips;
+
+    opt.spec = nullptr;
+    opt.sim = TUNE_DEFAULT_SIM;
+    opt.base = nullptr;
+    opt.method = "cmaes";
+    opt.budget = 1000;
+    opt.jobs = (unsigned)std::max( 1L, sysconf( _SC_NPROCESSORS_ONLN ) );
+    opt.timeout_ms = 60000;
+    opt.seed = 1;
+    opt.results = nullptr;
+    opt.best = nullptr;
+    opt.command = nullptr;
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( argv[i][0] != '-' ) {
+            if ( opt.spec != nullptr ) {
+                return false;
+            }
+            opt.spec = argv[i];
+            continue;
+        }
+        if ( i + 1 >= argc || strlen( argv[i] ) != 2 ) {
+            return false;
+        }
+        const char* value = argv[++i];
+        switch ( argv[i - 1][1] ) {
+        case 'c':
+            courses.push_back( value );
+            break;
+        case 's':
+            opt.sim = value;
+            break;
+        case 'P':
+            opt.base = value;
+            break;
+        case 'm':
+            opt.method = value;
+            break;
+        case 'n':
+            opt.budget = strtoul( value, nullptr, 0 );
+            break;
+        case 'j':
+            opt.jobs = std::max( 1UL, strtoul( value, nullptr, 0 ) );
+            break;
+        case 'g':
+            for ( const char* p = value; *p != '\0'; ) {
+                char* end;
+                grips.push_back( strtoul( p, &end, 0 ) );
+                p = ( *end == ',' ) ? end + 1 : end;
+                if ( end == p && *p != '\0' ) {
+                    return false;
+                }
+            }
+            break;
+        case 't':
+            opt.timeout_ms = strtoul( value, nullptr, 0 );
+            break;
+        case 'r':
+            opt.seed = strtoul( value, nullptr, 0 );
+            break;
+        case 'o':
+            opt.results = value;
+            break;
+        case 'w':
+            opt.best = value;
+            break;
+        case 'S':
+            opt.command = value;
+            break;
+        default:
+            return false;
+        }
+    }
+    if ( grips.empty() ) {
+        grips.push_back( 400 ); // simの既定値と同じ
+    }
+    for ( const std::string& course : courses ) {
+        for ( unsigned grip : grips ) {
+            opt.scenes.push_back( { course, grip } );
+        }
+    }
+    return opt.spec != nullptr && !opt.scenes.empty();
+}
+
+/*
+ * 概要：探索範囲ファイルを読む
+ * 引数：path ファイル名
+ * 戻り値：成功:true 失敗:false(理由を表示する)
+ * 詳細：短縮名が正しいかはsimがパラメータファイルを読むときに確認する
+ */
+static bool load_ranges( const char* path ) {
+    FILE* fp = fopen( path, "r" );
+    char buf[TUNE_LINE_SIZE];
+    int line_no = 0;
+
+    if ( fp == nullptr ) {
+        fprintf( stderr, "%s: ファイルを開けません\n", path );
+        return false;
+    }
+    while ( fgets( buf, sizeof( buf ), fp ) != nullptr ) {
+        line_no++;
+        buf[strcspn( buf, "\r\n" )] = '\0';
+        if ( buf[0] == '\0' || buf[0] == '#' ) {
+            continue;
+        }
+        char name[TUNE_LINE_SIZE];
+        long min, max, step = 1;
+        int n = sscanf( buf, "%[^,],%ld,%ld,%ld", name, &min, &max, &step );
+        if ( n < 3 || min > max || step <= 0 ) {
+            fprintf( stderr, "%s:%d: \"短縮名,最小値,最大値[,刻み]\"ではありません\n", path, line_no );
+            fclose( fp );
+            return false;
+        }
+        ranges.push_back( { name, min, max, step } );
+    }
+    fclose( fp );
+    if ( ranges.empty() ) {
+        fprintf( stderr, "%s: 探索するパラメータがありません\n", path );
+        return false;
+    }
+    return true;
+}
+
+/*
+ * 概要：ファイルの内容を全て読む
+ * 引数：path ファイル名 text 内容の格納先
+ * 戻り値：成功:true 失敗:false(理由を表示する)
+ */
+static bool read_text( const char* path, std::string* text ) {
+    FILE* fp = fopen( path, "r" );
+    char buf[TUNE_LINE_SIZE];
+
+    if ( fp == nullptr ) {
+        fprintf( stderr, "%s: ファイルを開けません\n", path );
+        return false;
+    }
+    while ( fgets( buf, sizeof( buf ), fp ) != nullptr ) {
+        *text += buf;
+    }
+    fclose( fp );
+    if ( !text->empty() && text->back() != '\n' ) {
+        *text += '\n';
+    }
+    return true;
+}
+
+/*
+ * 概要：パラメータの刻みの数を取得する
+ * 引数：range 探索するパラメータ
+ * 戻り値：試す値の数
+ */
+static long level_count( const tune_range_t& range ) {
+    return ( range.max - range.min ) / range.step + 1;
+}
+
+/*
+ * 概要：0～1の座標をパラメータの値にする
+ * 引数：x 座標(探索範囲ファイルの順)
+ * 戻り値：刻みに丸めた値
+ */
+static std::vector<long> to_values( const std::vector<double>& x ) {
+    std::vector<long> values;
+
+    for ( size_t i = 0; i < ranges.size(); i++ ) {
+        long level = lround( std::min( std::max( x[i], 0.0 ), 1.0 ) * ( level_count( ranges[i] ) - 1 ) );
+        values.push_back( ranges[i].min + level * ranges[i].step );
+    }
+    return values;
+}
+
+/*
+ * 概要：候補のパラメータファイルを書く
+ * 引数：path ファイル名 values パラメータの値
+ * 戻り値：成功:true 失敗:false
+ * 詳細：固定パラメータファイルの内容の後に候補の値を置く(simは後の行で上書きする)
+ */
+static bool write_parameters( const char* path, const std::vector<long>& values ) {
+    FILE* fp = fopen( path, "w" );
+
+    if ( fp == nullptr ) {
+        return false;
+    }
+    fputs( base_text.c_str(), fp );
+    for ( size_t i = 0; i < ranges.size(); i++ ) {
+        fprintf( fp, "%s,%ld\n", ranges[i].name.c_str(), values[i] );
+    }
+    fclose( fp );
+    return true;
+}
+
+/*
+ * 概要：simを起動する
+ * 引数：params パラメータファイル scene 実行条件 command paramコマンドファイル(nullptrなら出力しない) out 標準出力を読むファイル記述子の格納先
+ * 戻り値：プロセスID 失敗:-1
+ */
+static pid_t spawn_sim( const std::string& params, const tune_scenario_t& scene, const char* command, int* out ) {
+    int fds[2];
+    std::string grip = std::to_string( scene.grip );
+    std::string timeout = std::to_string( opt.timeout_ms );
+    std::vector<const char*> args = { opt.sim, scene.course.c_str(), "-P", params.c_str(), "-g", grip.c_str(), "-t", timeout.c_str() };
+
+    if ( command != nullptr ) {
+        args.push_back( "-w" );
+        args.push_back( command );
+    }
+    args.push_back( nullptr );
+    if ( pipe( fds ) != 0 ) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if ( pid == 0 ) {
+        dup2( fds[1], STDOUT_FILENO );
+        close( fds[0] );
+        close( fds[1] );
+        execv( opt.sim, (char* const*)args.data() );
+        _exit( 127 );
+    }
+    close( fds[1] );
+    if ( pid < 0 ) {
+        close( fds[0] );
+        return -1;
+    }
+    *out = fds[0];
+    return pid;
+}
+
+/*
+ * 概要：simの結果の1行から条件のコストを求める
+ * 引数：line 結果の行 finished 完走したかの格納先 time_ms タイムの格納先
+ * 戻り値：コスト LSB:1[ms] 結果の行でない:負
+ * 詳細：完走はタイム、完走できなければTUNE_FAIL_COST_MSに走れなかった距離の割合の分を足す
+ */
+static double scene_cost( const std::string& line, bool* finished, double* time_ms ) {
+    char result[32];
+    int time;
+    double distance, length;
+
+    if ( sscanf( line.c_str(), "result=%31s time_ms=%d distance=%lf course=%lf", result, &time, &distance, &length ) != 4 || length <= 0.0 ) {
+        return -1.0;
+    }
+    *finished = ( strcmp( result, "FINISH" ) == 0 );
+    *time_ms = time;
+    if ( *finished ) {
+        return time;
+    }
+    return TUNE_FAIL_COST_MS * ( 2.0 - std::min( std::max( distance / length, 0.0 ), 1.0 ) );
+}
+
+/*
+ * 概要：候補を全ての条件で実行し、結果をhistoryに加える
+ * 引数：candidates 候補の値 results 候補ごとのhistoryの位置の格納先(candidatesと同じ順)
+ * 戻り値：成功:true simを実行できない:false(理由を表示する)
+ * 詳細：評価済みの候補は実行せずに前の結果を使う。opt.jobsの数までsimを同時に実行する
+ */
+static bool evaluate( const std::vector<std::vector<long>>& candidates, std::vector<size_t>* results ) {
+    typedef struct {
+        size_t index; // historyの位置
+        size_t scene;
+        int fd;
+    } job_t;
+    std::vector<job_t> jobs;
+    std::vector<size_t> created; // 今回加えた候補のhistoryの位置
+    std::map<pid_t, job_t> running;
+    size_t next = 0;
+    bool ok = true;
+
+    results->clear();
+    for ( const std::vector<long>& values : candidates ) {
+        auto found = history_index.find( values );
+        if ( found != history_index.end() ) {
+            results->push_back( found->second );
+            continue;
+        }
+        size_t index = history.size();
+        history.push_back( { values, 0, 0, 0.0, 0.0, false } );
+        history_index[values] = index;
+        results->push_back( index );
+        created.push_back( index );
+        std::string path = std::string( work_dir ) + "/" + std::to_string( index ) + ".txt";
+        if ( !write_parameters( path.c_str(), values ) ) {
+            fprintf( stderr, "%s: ファイルを作れません\n", path.c_str() );
+            return false;
+        }
+        for ( size_t scene = 0; scene < opt.scenes.size(); scene++ ) {
+            jobs.push_back( { index, scene, -1 } );
+        }
+    }
+
+    while ( next < jobs.size() || !running.empty() ) {
+        while ( ok && next < jobs.size() && running.size() < opt.jobs ) {
+            job_t job = jobs[next++];
+            std::string path = std::string( work_dir ) + "/" + std::to_string( job.index ) + ".txt";
+            pid_t pid = spawn_sim( path, opt.scenes[job.scene], nullptr, &job.fd );
+            if ( pid < 0 ) {
+                fprintf( stderr, "%s: 起動できません(%s)\n", opt.sim, strerror( errno ) );
+                ok = false;
+                break;
+            }
+            running[pid] = job;
+        }
+        if ( running.empty() ) {
+            break;
+        }
+        int status;
+        pid_t pid = waitpid( -1, &status, 0 );
+        if ( pid < 0 || running.count( pid ) == 0 ) {
+            continue;
+        }
+        job_t job = running[pid];
+        running.erase( pid );
+
+        // simの出力は1行だけのため、終了後にまとめて読む
+        std::string out;
+        char buf[TUNE_LINE_SIZE];
+        ssize_t n;
+        while ( ( n = read( job.fd, buf, sizeof( buf ) ) ) > 0 ) {
+            out.append( buf, n );
+        }
+        close( job.fd );
+
+        bool finished = false;
+        double time_ms = 0.0;
+        double cost = scene_cost( out, &finished, &time_ms );
+        if ( !WIFEXITED( status ) || WEXITSTATUS( status ) == 2 || cost < 0.0 ) {
+            if ( ok ) {
+                fprintf( stderr, "%s %s: 結果がありません(コースファイル、探索範囲の短縮名、-sを確認してください)\n", opt.sim,
+                         opt.scenes[job.scene].course.c_str() );
+            }
+            ok = false;
+            continue;
+        }
+        tune_result_t& result = history[job.index];
+        result.runs++;
+        result.cost += cost;
+        if ( finished ) {
+            result.lap_ms += time_ms;
+            result.finished++;
+        }
+    }
+
+    for ( size_t index : created ) {
+        tune_result_t& result = history[index];
+        std::string path = std::string( work_dir ) + "/" + std::to_string( index ) + ".txt";
+        remove( path.c_str() );
+        result.cost /= std::max( result.runs, 1 );
+        result.lap_ms = ( result.finished > 0 ) ? result.lap_ms / result.finished : 0.0;
+    }
+    return ok;
+}
+
+/*
+ * 概要：失敗率を取得する
+ * 引数：result 候補の結果
+ * 戻り値：完走できなかった条件の割合 0.0～1.0
+ */
+static double failure_rate( const tune_result_t& result ) {
+    return 1.0 - (double)result.finished / std::max( result.runs, 1 );
+}
+
+/*
+ * 概要：探索の途中経過を表示する
+ * 引数：sampled 作った候補の数(評価済みの候補と重複したものを含む)
+ * 戻り値：なし
+ */
+static void print_progress( unsigned sampled ) {
+    const tune_result_t* best = nullptr;
+
+    for ( const tune_result_t& result : history ) {
+        if ( best == nullptr || result.cost < best->cost ) {
+            best = &result;
+        }
+    }
+    if ( best != nullptr ) {
+        fprintf( stderr, "候補 %u/%u(重複なし%u) 最小コスト %.0f 失敗率 %.2f タイム %.0fms\n", sampled, opt.budget, (unsigned)history.size(),
+                 best->cost, failure_rate( *best ), best->lap_ms );
+    }
+}
+
+/*
+ * 概要：全ての組み合わせを評価する
+ * 引数：なし
+ * 戻り値：成功:true 失敗:false(理由を表示する)
+ */
+static bool search_grid() {
+    double total = 1.0;
+    std::vector<long> levels( ranges.size(), 0 );
+
+    for ( const tune_range_t& range : ranges ) {
+        total *= level_count( range );
+    }
+    if ( total > opt.budget ) {
+        fprintf( stderr, "組み合わせが%.0f通りあり、-n %uを超えています(刻みを大きくするか、-nを増やしてください)\n", total, opt.budget );
+        return false;
+    }
+
+    std::vector<std::vector<long>> batch;
+    std::vector<size_t> results;
+    for ( long count = 0; count < (long)total; count++ ) {
+        std::vector<long> values;
+        for ( size_t i = 0; i < ranges.size(); i++ ) {
+            values.push_back( ranges[i].min + levels[i] * ranges[i].step );
+        }
+        batch.push_back( values );
+        for ( size_t i = 0; i < ranges.size() && ++levels[i] == level_count( ranges[i] ); i++ ) {
+            levels[i] = 0;
+        }
+        if ( batch.size() == TUNE_BATCH_SIZE || count + 1 == (long)total ) {
+            if ( !evaluate( batch, &results ) ) {
+                return false;
+            }
+            batch.clear();
+            print_progress( count + 1 );
+        }
+    }
+    return true;
+}
+
+/*
+ * 概要：一様乱数で候補を作って評価する
+ * 引数：なし
+ * 戻り値：成功:true 失敗:false(理由を表示する)
+ */
+static bool search_random() {
+    std::uniform_real_distribution<double> uniform( 0.0, 1.0 );
+    std::vector<std::vector<long>> batch;
+    std::vector<size_t> results;
+
+    for ( unsigned count = 0; count < opt.budget; count++ ) {
+        std::vector<double> x( ranges.size() );
+        for ( double& v : x ) {
+            v = uniform( rng );
+        }
+        batch.push_back( to_values( x ) );
+        if ( batch.size() == TUNE_BATCH_SIZE || count + 1 == opt.budget ) {
+            if ( !evaluate( batch, &results ) ) {
+                return false;
+            }
+            batch.clear();
+            print_progress( count + 1 );
+        }
+    }
+    return true;
+}
+
+/*
+ * 概要：sep-CMA-ES(共分散行列を対角に限ったCMA-ES)でコストが最小の候補を探す
+ * 引数：なし
+ * 戻り値：成功:true 失敗:false(理由を表示する)
+ * 詳細：探索範囲を0～1にした空間で、範囲の中央からTUNE_CMAES_SIGMAで始める。範囲外の候補は範囲の端にして評価と更新に使う
+ *      1世代の候補の数は標準の4+3ln(次元)と並列数の大きい方。候補の数がopt.budgetに達するまで世代を進める
+ */
+static bool search_cmaes() {
+    const size_t n = ranges.size();
+    const size_t lambda = std::max( (size_t)( 4 + 3 * log( (double)n ) ), (size_t)opt.jobs );
+    const size_t mu = lambda / 2;
+    std::vector<double> weights( mu );
+    double weight_sum = 0.0, weight_sq = 0.0;
+
+    for ( size_t i = 0; i < mu; i++ ) {
+        weights[i] = log( mu + 0.5 ) - log( i + 1.0 );
+        weight_sum += weights[i];
+    }
+    for ( double& w : weights ) {
+        w /= weight_sum;
+        weight_sq += w * w;
+    }
+    const double mu_eff = 1.0 / weight_sq;
+    const double c_sigma = ( mu_eff + 2.0 ) / ( n + mu_eff + 5.0 );
+    const double d_sigma = 1.0 + 2.0 * std::max( 0.0, sqrt( ( mu_eff - 1.0 ) / ( n + 1.0 ) ) - 1.0 ) + c_sigma;
+    const double c_c = ( 4.0 + mu_eff / n ) / ( n + 4.0 + 2.0 * mu_eff / n );
+    const double c_1 = std::min( 1.0, 2.0 / ( ( n + 1.3 ) * ( n + 1.3 ) + mu_eff ) * ( n + 2.0 ) / 3.0 );
+    const double c_mu =
+        std::min( 1.0 - c_1, 2.0 * ( mu_eff - 2.0 + 1.0 / mu_eff ) / ( ( n + 2.0 ) * ( n + 2.0 ) + mu_eff ) * ( n + 2.0 ) / 3.0 );
+    const double chi_n = sqrt( (double)n ) * ( 1.0 - 1.0 / ( 4.0 * n ) + 1.0 / ( 21.0 * n * n ) );
+    std::normal_distribution<double> normal( 0.0, 1.0 );
+    std::vector<double> mean( n, 0.5 ), diag( n, 1.0 ), p_sigma( n, 0.0 ), p_c( n, 0.0 );
+    double sigma = TUNE_CMAES_SIGMA;
+    unsigned sampled = 0;
+
+    for ( int generation = 1; sampled < opt.budget; generation++ ) {
+        std::vector<std::vector<double>> xs( lambda, std::vector<double>( n ) );
+        std::vector<std::vector<long>> batch;
+        std::vector<size_t> results;
+        for ( std::vector<double>& x : xs ) {
+            for ( size_t i = 0; i < n; i++ ) {
+                x[i] = std::min( std::max( mean[i] + sigma * sqrt( diag[i] ) * normal( rng ), 0.0 ), 1.0 );
+            }
+            batch.push_back( to_values( x ) );
+        }
+        sampled += lambda;
+        if ( !evaluate( batch, &results ) ) {
+            return false;
+        }
+
+        // コストの小さい順にmu個の候補で平均を更新する
+        std::vector<size_t> order( lambda );
+        for ( size_t k = 0; k < lambda; k++ ) {
+            order[k] = k;
+        }
+        std::stable_sort( order.begin(), order.end(),
+                          [&]( size_t a, size_t b ) { return history[results[a]].cost < history[results[b]].cost; } );
+        std::vector<double> old_mean = mean;
+        for ( size_t i = 0; i < n; i++ ) {
+            mean[i] = 0.0;
+            for ( size_t k = 0; k < mu; k++ ) {
+                mean[i] += weights[k] * xs[order[k]][i];
+            }
+        }
+
+        // 進化パスとステップサイズ
+        double p_sigma_norm = 0.0;
+        for ( size_t i = 0; i < n; i++ ) {
+            double step = ( mean[i] - old_mean[i] ) / sigma;
+            p_sigma[i] = ( 1.0 - c_sigma ) * p_sigma[i] + sqrt( c_sigma * ( 2.0 - c_sigma ) * mu_eff ) * step / sqrt( diag[i] );
+            p_sigma_norm += p_sigma[i] * p_sigma[i];
+        }
+        p_sigma_norm = sqrt( p_sigma_norm );
+        bool h_sigma = p_sigma_norm / sqrt( 1.0 - pow( 1.0 - c_sigma, 2.0 * generation ) ) < ( 1.4 + 2.0 / ( n + 1.0 ) ) * chi_n;
+        for ( size_t i = 0; i < n; i++ ) {
+            double step = ( mean[i] - old_mean[i] ) / sigma;
+            p_c[i] = ( 1.0 - c_c ) * p_c[i] + ( h_sigma ? sqrt( c_c * ( 2.0 - c_c ) * mu_eff ) * step : 0.0 );
+            double rank_mu = 0.0;
+            for ( size_t k = 0; k < mu; k++ ) {
+                double y = ( xs[order[k]][i] - old_mean[i] ) / sigma;
+                rank_mu += weights[k] * y * y;
+            }
+            double correction = h_sigma ? 0.0 : c_1 * c_c * ( 2.0 - c_c ) * diag[i];
+            diag[i] = ( 1.0 - c_1 - c_mu ) * diag[i] + c_1 * ( p_c[i] * p_c[i] + correction ) + c_mu * rank_mu;
+            diag[i] = std::max( diag[i], 1e-12 );
+        }
+        sigma *= exp( ( c_sigma / d_sigma ) * ( p_sigma_norm / chi_n - 1.0 ) );
+        sigma = std::min( sigma, 1.0 );
+        print_progress( sampled );
+    }
+    return true;
+}
+
+/*
+ * 概要：失敗率とタイムのパレート最適な候補に印を付ける
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：1条件も完走していない候補は対象にしない
+ */
+static void mark_pareto() {
+    for ( tune_result_t& a : history ) {
+        a.pareto = ( a.finished > 0 );
+        for ( const tune_result_t& b : history ) {
+            if ( !a.pareto ) {
+                break;
+            }
+            if ( b.finished == 0 || &a == &b ) {
+                continue;
+            }
+            bool no_worse = failure_rate( b ) <= failure_rate( a ) && b.lap_ms <= a.lap_ms;
+            bool better = failure_rate( b ) < failure_rate( a ) || b.lap_ms < a.lap_ms;
+            if ( no_worse && better ) {
+                a.pareto = false;
+            }
+        }
+    }
+}
+
+/*
+ * 概要：最良の候補を取得する
+ * 引数：なし
+ * 戻り値：1条件以上完走した候補のうち、失敗率が最小でタイムが最短の候補 完走した候補が無い:nullptr
+ * 詳細：完走していない候補はコストが小さくても走れるパラメータではないため、最良としない
+ */
+static const tune_result_t* find_best() {
+    const tune_result_t* best = nullptr;
+
+    for ( const tune_result_t& result : history ) {
+        if ( result.finished == 0 ) {
+            continue;
+        }
+        if ( best == nullptr || failure_rate( result ) < failure_rate( *best ) ||
+             ( failure_rate( result ) == failure_rate( *best ) && result.lap_ms < best->lap_ms ) ) {
+            best = &result;
+        }
+    }
+    return best;
+}
+
+/*
+ * 概要：パレート最適な候補を失敗率の小さい順に表示する
+ * 引数：なし
+ * 戻り値：なし
+ */
+static void print_pareto() {
+    std::vector<const tune_result_t*> front;
+
+    for ( const tune_result_t& result : history ) {
+        if ( result.pareto ) {
+            front.push_back( &result );
+        }
+    }
+    std::sort( front.begin(), front.end(), []( const tune_result_t* a, const tune_result_t* b ) {
+        return ( failure_rate( *a ) != failure_rate( *b ) ) ? failure_rate( *a ) < failure_rate( *b ) : a->lap_ms < b->lap_ms;
+    } );
+
+    printf( "failure_rate,lap_ms" );
+    for ( const tune_range_t& range : ranges ) {
+        printf( ",%s", range.name.c_str() );
+    }
+    printf( "\n" );
+    for ( const tune_result_t* result : front ) {
+        printf( "%.3f,%.0f", failure_rate( *result ), result->lap_ms );
+        for ( long value : result->values ) {
+            printf( ",%ld", value );
+        }
+        printf( "\n" );
+    }
+}
+
+/*
+ * 概要：全ての候補の結果をcsvに書き出す
+ * 引数：path ファイル名
+ * 戻り値：成功:true 失敗:false(理由を表示する)
+ */
+static bool write_results( const char* path ) {
+    FILE* fp = fopen( path, "w" );
+
+    if ( fp == nullptr ) {
+        fprintf( stderr, "%s: ファイルを作れません\n", path );
+        return false;
+    }
+    fprintf( fp, "id,failure_rate,lap_ms,cost,pareto" );
+    for ( const tune_range_t& range : ranges ) {
+        fprintf( fp, ",%s", range.name.c_str() );
+    }
+    fprintf( fp, "\n" );
+    for ( size_t id = 0; id < history.size(); id++ ) {
+        const tune_result_t& result = history[id];
+        fprintf( fp, "%u,%.3f,%.0f,%.0f,%d", (unsigned)id, failure_rate( result ), result.lap_ms, result.cost, result.pareto ? 1 : 0 );
+        for ( long value : result.values ) {
+            fprintf( fp, ",%ld", value );
+        }
+        fprintf( fp, "\n" );
+    }
+    fclose( fp );
+    return true;
+}
+
+/*
+ * 概要：最良の候補をパラメータファイルに書き出す
+ * 引数：path ファイル名 best 最良の候補
+ * 戻り値：成功:true 失敗:false(理由を表示する)
+ * 詳細：simの-Pで読める形式。固定パラメータファイルの内容も含める
+ */
+static bool write_best( const char* path, const tune_result_t& best ) {
+    FILE* fp = fopen( path, "w" );
+
+    if ( fp == nullptr ) {
+        fprintf( stderr, "%s: ファイルを作れません\n", path );
+        return false;
+    }
+    fprintf( fp, "# tune %s 失敗率 %.3f タイム %.0fms(%u条件)\n", opt.method, failure_rate( best ), best.lap_ms, (unsigned)opt.scenes.size() );
+    fputs( base_text.c_str(), fp );
+    for ( size_t i = 0; i < ranges.size(); i++ ) {
+        fprintf( fp, "%s,%ld\n", ranges[i].name.c_str(), best.values[i] );
+    }
+    fclose( fp );
+    return true;
+}
+
+/*
+ * 概要：最良の候補をparamコマンドファイルに書き出す
+ * 引数：path ファイル名 best 最良の候補
+ * 戻り値：成功:true 失敗:false(理由を表示する)
+ * 詳細：パラメータの番号はsimが知っているため、最初の条件でsimを-w付きで実行して作る
+ */
+static bool write_command( const char* path, const tune_result_t& best ) {
+    std::string params = std::string( work_dir ) + "/best.txt";
+    int fd, status;
+
+    if ( !write_parameters( params.c_str(), best.values ) ) {
+        fprintf( stderr, "%s: ファイルを作れません\n", params.c_str() );
+        return false;
+    }
+    pid_t pid = spawn_sim( params, opt.scenes[0], path, &fd );
+    if ( pid < 0 ) {
+        fprintf( stderr, "%s: 起動できません(%s)\n", opt.sim, strerror( errno ) );
+        return false;
+    }
+    char buf[TUNE_LINE_SIZE];
+    while ( read( fd, buf, sizeof( buf ) ) > 0 ) {
+    }
+    close( fd );
+    waitpid( pid, &status, 0 );
+    remove( params.c_str() );
+    return WIFEXITED( status ) && WEXITSTATUS( status ) != 2;
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+int main( int argc, char** argv ) {
+    if ( !parse_options( argc, argv ) ) {
+        fprintf( stderr,
+                 "使い方: %s <探索範囲ファイル> -c <コースファイル> [-c コースファイル ...] [-s simの実行ファイル] [-P 固定パラメータファイル]\n"
+                 "          [-m grid|random|cmaes] [-n 候補の数] [-j 並列数] [-g 摩擦係数0.01[,摩擦係数0.01...]] [-t 制限時間ms] [-r 乱数の種]\n"
+                 "          [-o 結果csv] [-w 最良パラメータファイル] [-S paramコマンドファイル]\n",
+                 argv[0] );
+        return 2;
+    }
+    if ( !load_ranges( opt.spec ) || ( opt.base != nullptr && !read_text( opt.base, &base_text ) ) ) {
+        return 2;
+    }
+    if ( mkdtemp( work_dir ) == nullptr ) {
+        fprintf( stderr, "%s: 作業ディレクトリを作れません\n", work_dir );
+        return 2;
+    }
+    rng.seed( opt.seed );
+
+    bool ok;
+    if ( strcmp( opt.method, "grid" ) == 0 ) {
+        ok = search_grid();
+    } else if ( strcmp( opt.method, "random" ) == 0 ) {
+        ok = search_random();
+    } else if ( strcmp( opt.method, "cmaes" ) == 0 ) {
+        ok = search_cmaes();
+    } else {
+        fprintf( stderr, "%s: 探索方法はgrid、random、cmaesのいずれかです\n", opt.method );
+        ok = false;
+    }
+
+    if ( !ok ) {
+        rmdir( work_dir );
+        return 2;
+    }
+    mark_pareto();
+    ok = ( opt.results == nullptr || write_results( opt.results ) );
+    const tune_result_t* best = find_best();
+    if ( ok && best == nullptr ) {
+        fprintf( stderr, "完走した候補がありません(%u候補×%u条件)。-w、-Sは書き出しません\n"
+                         "探索範囲を走れる値に近づけるか、-Pで固定パラメータ(速度など)を下げてください\n",
+                 (unsigned)history.size(), (unsigned)opt.scenes.size() );
+        rmdir( work_dir );
+        return 1;
+    }
+    if ( ok ) {
+        print_pareto();
+        ok = ( opt.best == nullptr || write_best( opt.best, *best ) ) && ( opt.command == nullptr || write_command( opt.command, *best ) );
+    }
+    rmdir( work_dir );
+    return ok ? 0 : 2;
+}
@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+# ホストで実行するテストを全てビルドして実行する
+#
+# 使い方:
+#   python scripts/host_test.py [env名 ...]
+#
+# env名を省略した場合、platformio.iniのtest_で始まる全てのenvを対象にする
+# 各envをpio runでビルドし、.pio/build/<env>/programを実行する
+# 1つでも失敗(ビルドの失敗、または0以外の終了コード)があれば1を返す
+
+import configparser
+import os
+import subprocess
+import sys
+
+PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def test_envs():
+    config = configparser.ConfigParser(interpolation=None)
+    config.read(os.path.join(PROJECT_DIR, 'platformio.ini'), encoding='utf-8')
+    return [s[len('env:'):] for s in config.sections() if s.startswith('env:test_')]
+
+
+def run(env):
+    if subprocess.run(['pio', 'run', '-e', env], cwd=PROJECT_DIR).returncode != 0:
+        return False
+    program = os.path.join(PROJECT_DIR, '.pio', 'build', env, 'program')
+    return subprocess.run([program], cwd=PROJECT_DIR).returncode == 0
+
+
+def main():
+    envs = sys.argv[1:] or test_envs()
+    failed = [env for env in envs if not run(env)]
+    for env in envs:
+        print(f"{env}: {'失敗' if env in failed else '成功'}")
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+# 記録済みのログを差分圧縮形式(MCRLOG3)に変換し、往復の正しさと圧縮率を確認する
+#
+# 使い方:
+#   python scripts/log_codec_bench.py log00000.bin log00001.csv ...
+#
+# 入力はマイコンが書いたcsvログ、またはバイナリログ(MCRLOG1/MCRLOG2/MCRLOG3)
+# 各ログについて以下を表示する
+#   csv     : csv形式で記録した場合のデータ部のバイト数
+#   binary  : MCRLOG2形式のデータ部のバイト数(csvの場合は型がわからないため全てs4として計算)
+#   delta   : MCRLOG3形式のデータ部のバイト数
+# エンコーダはsrc/util/delta_codec.hのdelta_encoderをホストでビルドしたもの(pio run -e codec、host/codec/codec_main.cpp)、
+# デコーダはmcr_log_to_csv.pyのものを使う
+
+import argparse
+import os
+import struct
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import mcr_log_to_csv as conv  # noqa: E402
+
+KEYFRAME_INTERVAL = 1000  # DELTA_CODEC_KEYFRAME_INTERVAL
+CSV_HEADER_LINES = 100    # プログラム情報の行数(mcr_logger::write_program_info)
+DEFAULT_CODEC = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), ".pio", "build", "codec", "program")
+
+
+def to_s32(v):
+    v &= 0xFFFFFFFF
+    return v - (1 << 32) if v >= 1 << 31 else v
+
+
+def encode(codec, rows):
+    """rowsをホストでビルドしたdelta_encoder(host/codec)で圧縮したバイト列を返す"""
+    if not rows:
+        return b""
+    lines = []
+    for row in rows:
+        mask = sum(1 << i for i, v in enumerate(row) if v is not None)
+        lines.append(" ".join([str(mask)] + [str(to_s32(v)) for v in row if v is not None]))
+    result = subprocess.run([codec, "-k", str(KEYFRAME_INTERVAL)], input=("\n".join(lines) + "\n").encode(),
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if result.returncode != 0:
+        raise ValueError("エンコーダの実行に失敗しました: " + result.stderr.decode("utf-8", errors="replace").strip())
+    return result.stdout
+
+
+def load_rows(path):
+    """ログを読み、(チャンネル一覧, 行のリスト)を返す。行は値のリスト(含まれないチャンネルはNone)"""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    if data.startswith(b"MCRLOG"):
+        data, _ = conv.strip_footer(data)
+        version, _, channels, start = conv.parse_header(data)
+        if version == 3:
+            rows, _ = conv.decode_delta_records(data, start, channels)
+        else:
+            rows, _ = conv.decode_records(version, data, start, channels)
+        return channels, rows
+
+    lines = data.decode("utf-8", errors="replace").split("\n")[CSV_HEADER_LINES:]
+    names = lines[0].split(",")
+    channels = [(name, "s4") for name in names]
+    rows = []
+    for line in lines[1:]:
+        fields = line.split(",")
+        if len(fields) != len(names):
+            continue
+        try:
+            rows.append([int(v) if v != "" else None for v in fields])
+        except ValueError:
+            continue
+    return channels, rows
+
+
+def bench(codec, path):
+    channels, rows = load_rows(path)
+    if len(channels) > 32:
+        raise ValueError("チャンネル数が32を超えています")
+    sizes = [struct.calcsize(conv.TYPE_FORMATS[t]) for _, t in channels]
+
+    csv_bytes = 0
+    binary_bytes = 0
+    for row in rows:
+        csv_bytes += len(",".join("" if v is None else str(v) for v in row)) + 1
+        binary_bytes += 5 + sum(sizes[i] for i, v in enumerate(row) if v is not None)
+    encoded = encode(codec, rows)
+
+    decoded, skipped = conv.decode_delta_records(encoded, 0, channels)
+    ok = skipped == 0 and decoded == rows
+    return len(rows), csv_bytes, binary_bytes, len(encoded), ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description="差分圧縮形式の往復の正しさと圧縮率を確認します")
+    parser.add_argument("logs", nargs="+", help="csvログ、またはバイナリログ")
+    parser.add_argument("--codec", default=DEFAULT_CODEC, help="エンコーダの実行ファイル(既定: {})".format(DEFAULT_CODEC))
+    args = parser.parse_args()
+    if not os.access(args.codec, os.X_OK):
+        print("Error: エンコーダ{}がありません。先にpio run -e codecでビルドしてください".format(args.codec), file=sys.stderr)
+        return 2
+
+    failed = False
+    print("{:<20} {:>8} {:>10} {:>10} {:>10} {:>7} {:>7} {}".format("log", "records", "csv", "binary", "delta", "csv/d", "bin/d",
+                                                                  "roundtrip"))
+    for path in args.logs:
+        try:
+            records, csv_bytes, binary_bytes, delta_bytes, ok = bench(args.codec, path)
+        except (OSError, ValueError) as e:
+            print("Error: {}: {}".format(path, e), file=sys.stderr)
+            failed = True
+            continue
+        print("{:<20} {:>8} {:>10} {:>10} {:>10} {:>7.1f} {:>7.1f} {}".format(
+            os.path.basename(path), records, csv_bytes, binary_bytes, delta_bytes, csv_bytes / max(delta_bytes, 1),
+            binary_bytes / max(delta_bytes, 1), "OK" if ok else "NG"))
+        failed |= not ok
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+# "sd get" に応答するマイコンの代わりを疑似端末(pty)で動かす(Linux/macOS)
+#
+# 使い方:
+#   python scripts/mcr_log_device_sim.py logs/                  -> 疑似端末のパスを表示し、logs/のファイルを転送する
+#   python scripts/mcr_log_device_sim.py logs/ --drop 0.05 --corrupt 0.05
+#   python scripts/mcr_log_device_sim.py --selftest              -> 転送、再送、再開を疑似端末の折り返しで確認する
+#
+# 表示されたパスをscripts/mcr_log_download.pyのポートに指定する
+# 応答はmcr_logger::download()と同じ。--drop、--corruptでデータフレームを捨てる、壊すことで再送を確認できる
+
+import argparse
+import os
+import pty
+import random
+import select
+import struct
+import sys
+import tempfile
+import threading
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import mcr_log_download as dl  # noqa: E402
+
+TIMEOUT = 5.0        # XFER_TIMEOUT_MS
+REQUEST_SECTORS = 64  # XFER_REQUEST_SECTORS
+
+
+class Device:
+    """疑似端末のマスター側でシェルと"sd get"の応答をまねる"""
+
+    def __init__(self, directory, drop=0.0, corrupt=0.0, stall_after=None, seed=0):
+        self.directory = directory
+        self.drop = drop
+        self.corrupt = corrupt
+        self.stall_after = stall_after  # このセクタ数を送ったら応答を止める(再開の確認用)
+        self.random = random.Random(seed)
+        self.sent = 0
+        self.master, slave = pty.openpty()
+        self.path = os.ttyname(slave)
+        self.slave = slave
+
+    def read(self, timeout):
+        ready, _, _ = select.select([self.master], [], [], timeout)
+        return os.read(self.master, 4096) if ready else b""
+
+    def send(self, frame_type, payload=b""):
+        frame = bytearray(dl.encode_frame(frame_type, payload))
+        if frame_type == dl.TYPE_DATA:
+            if self.random.random() < self.drop:
+                return
+            if self.random.random() < self.corrupt:
+                frame[self.random.randrange(len(frame))] ^= 0xFF
+        os.write(self.master, bytes(frame))
+
+    def serve_forever(self):
+        line = b""
+        while True:
+            data = self.read(1.0)
+            line += data
+            while b"\n" in line or b"\r" in line:
+                cmd, line = self._split(line)
+                words = cmd.decode(errors="replace").split()
+                if len(words) == 3 and words[:2] == ["sd", "get"]:
+                    self.transfer(words[2])
+                    line = b""
+
+    @staticmethod
+    def _split(line):
+        for i, c in enumerate(line):
+            if c in b"\r\n":
+                return line[:i], line[i + 1:]
+        return line, b""
+
+    def transfer(self, name):
+        path = os.path.join(self.directory, os.path.basename(name))
+        try:
+            with open(path, "rb") as f:
+                data = f.read()
+        except OSError:
+            self.send(dl.TYPE_ERROR, bytes([1]))
+            return
+        sectors = (len(data) + dl.SECTOR_SIZE - 1) // dl.SECTOR_SIZE
+        self.send(dl.TYPE_INFO, struct.pack("<II", len(data), sectors))
+
+        parser = dl.FrameParser()
+        last = time.monotonic()
+        while time.monotonic() - last < TIMEOUT:
+            for frame_type, payload in parser.feed(self.read(0.1)):
+                last = time.monotonic()
+                if frame_type == dl.TYPE_QUIT:
+                    return
+                if frame_type == dl.TYPE_INFO:
+                    self.send(dl.TYPE_INFO, struct.pack("<II", len(data), sectors))
+                elif frame_type == dl.TYPE_REQUEST and len(payload) == 6:
+                    sector, count = struct.unpack("<IH", payload)
+                    for index in range(sector, min(sector + min(count, REQUEST_SECTORS), sectors)):
+                        if self.stall_after is not None and self.sent >= self.stall_after:
+                            return
+                        chunk = data[index * dl.SECTOR_SIZE:(index + 1) * dl.SECTOR_SIZE]
+                        self.send(dl.TYPE_DATA, struct.pack("<I", index) + chunk)
+                        self.sent += 1
+
+
+def selftest():
+    """疑似端末の折り返しで、正常転送、再送、再開を確認する"""
+    rng = random.Random(1)
+    with tempfile.TemporaryDirectory() as tmp:
+        src = os.path.join(tmp, "sd")
+        os.mkdir(src)
+        data = bytes(rng.randrange(256) for _ in range(200 * dl.SECTOR_SIZE + 123))
+        with open(os.path.join(src, "log00001.bin"), "wb") as f:
+            f.write(data)
+
+        def run(name, device, output, expect_error=False, timeout=0.2):
+            threading.Thread(target=device.serve_forever, daemon=True).start()
+            port = dl.PosixPort(device.path, 460800)
+            try:
+                dl.download(port, name, output, timeout=timeout, log=lambda *a, **k: None)
+            except IOError as e:
+                if not expect_error:
+                    raise
+                return str(e)
+            finally:
+                port.close()
+            return None
+
+        results = []
+        out = os.path.join(tmp, "plain.bin")
+        run("log00001.bin", Device(src), out)
+        results.append(("転送", open(out, "rb").read() == data))
+
+        out = os.path.join(tmp, "lossy.bin")
+        run("log00001.bin", Device(src, drop=0.05, corrupt=0.05, seed=2), out)
+        results.append(("再送(5%欠落、5%破損)", open(out, "rb").read() == data))
+
+        out = os.path.join(tmp, "resume.bin")
+        run("log00001.bin", Device(src, stall_after=90), out, expect_error=True, timeout=0.05)
+        partial = os.path.getsize(out + ".part")
+        device = Device(src)
+        run("log00001.bin", device, out)
+        results.append(("再開({}バイトから)".format(partial),
+                        open(out, "rb").read() == data and 0 < partial < len(data)
+                        and device.sent == 201 - partial // dl.SECTOR_SIZE))
+
+        error = run("nofile.bin", Device(src), os.path.join(tmp, "x.bin"), expect_error=True)
+        results.append(("エラー応答", error is not None))
+
+    failed = False
+    for name, ok in results:
+        print("{:<28} {}".format(name, "OK" if ok else "NG"))
+        failed |= not ok
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="\"sd get\"に応答するマイコンの代わりを疑似端末で動かします")
+    parser.add_argument("directory", nargs="?", default=".", help="SDカードの代わりにするディレクトリ")
+    parser.add_argument("--drop", type=float, default=0.0, help="データフレームを捨てる確率")
+    parser.add_argument("--corrupt", type=float, default=0.0, help="データフレームを壊す確率")
+    parser.add_argument("--seed", type=int, default=0, help="乱数の種")
+    parser.add_argument("--selftest", action="store_true", help="転送、再送、再開を確認して終了する")
+    args = parser.parse_args()
+
+    if args.selftest:
+        return selftest()
+    device = Device(args.directory, args.drop, args.corrupt, seed=args.seed)
+    print("疑似端末: {}".format(device.path))
+    try:
+        device.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
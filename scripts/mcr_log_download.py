@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+# テストモードのシェルの "sd get" でマイコンからログファイルを高速に取り出す
+#
+# 使い方:
+#   python scripts/mcr_log_download.py COM3 log00012.bin              -> log00012.bin を保存
+#   python scripts/mcr_log_download.py /dev/ttyACM0 log00012.bin -o out.bin
+#
+# フレームの形式(src/util/xfer_frame.h参照。全てリトルエンディアン):
+#   0xAA 0x55 種類(u1) ペイロード長(u2) ペイロード CRC32(u4、種類からペイロードの最後まで)
+#   機器->ホスト I:ファイル情報 サイズ(u4) セクタ数(u4)  D:セクタ番号(u4) データ  E:エラーコード(u1)
+#   ホスト->機器 I:ファイル情報の再送要求  R:先頭セクタ(u4) セクタ数(u2)  Q:転送終了
+#
+# 受け取ったセクタは 出力ファイル名.part に先頭から順に書き、全て受け取ったら出力ファイル名に変える
+# CRC32が合わない、または届かなかったセクタは要求し直す(再送)
+# 途中で止まった場合は、もう一度実行すると.partの続きから要求する(再開)
+#
+# pyserialが無い環境(Linux/macOS)では、ポートを端末として直接開く
+# scripts/mcr_log_device_sim.pyの疑似端末を相手にすると、実機無しで動作を確認できる
+
+import argparse
+import os
+import struct
+import sys
+import time
+import zlib
+
+SOF = b"\xaa\x55"
+HEAD_FORMAT = "<2sBH"
+HEAD_SIZE = 5
+CRC_SIZE = 4
+SECTOR_SIZE = 512
+PAYLOAD_MAX = 4 + SECTOR_SIZE
+TYPE_INFO = ord("I")
+TYPE_REQUEST = ord("R")
+TYPE_DATA = ord("D")
+TYPE_ERROR = ord("E")
+TYPE_QUIT = ord("Q")
+ERRORS = {1: "ファイルを開けません", 2: "ロギング中です", 3: "SDカードが異常です"}
+
+REQUEST_SECTORS = 64  # 1回に要求するセクタ数(mcr_logger.hのXFER_REQUEST_SECTORS以下)
+RETRY_MAX = 10        # 1セクタも進まなかった要求を繰り返す回数
+
+
+def encode_frame(frame_type, payload=b""):
+    """フレームを作る"""
+    body = struct.pack("<BH", frame_type, len(payload)) + payload
+    return SOF + body + struct.pack("<I", zlib.crc32(body))
+
+
+class FrameParser:
+    """受信したバイト列からフレームを取り出す。SOFの前のバイトとCRC32が合わないフレームは捨てる"""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.errors = 0
+
+    def feed(self, data):
+        """受信したバイト列を加え、取り出せたフレームの(種類, ペイロード)のリストを返す"""
+        self.buf += data
+        frames = []
+        while True:
+            start = self.buf.find(SOF)
+            if start < 0:
+                del self.buf[:max(len(self.buf) - 1, 0)]
+                return frames
+            del self.buf[:start]
+            if len(self.buf) < HEAD_SIZE:
+                return frames
+            _, frame_type, length = struct.unpack_from(HEAD_FORMAT, self.buf)
+            if length > PAYLOAD_MAX:
+                self.errors += 1
+                del self.buf[:1]
+                continue
+            size = HEAD_SIZE + length + CRC_SIZE
+            if len(self.buf) < size:
+                return frames
+            body = bytes(self.buf[2:HEAD_SIZE + length])
+            crc = struct.unpack_from("<I", self.buf, HEAD_SIZE + length)[0]
+            if zlib.crc32(body) == crc:
+                frames.append((frame_type, body[3:]))
+                del self.buf[:size]
+            else:
+                self.errors += 1
+                del self.buf[:1]
+
+
+class PosixPort:
+    """pyserialが無い環境用。端末(疑似端末を含む)をrawモードで開く"""
+
+    def __init__(self, path, baudrate):
+        import termios
+        import tty
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        attrs = termios.tcgetattr(self.fd)
+        speed = getattr(termios, "B{}".format(baudrate), None)
+        if speed is not None:
+            attrs[4] = attrs[5] = speed
+            termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+
+    def read(self, timeout):
+        import select
+        ready, _, _ = select.select([self.fd], [], [], timeout)
+        return os.read(self.fd, 4096) if ready else b""
+
+    def write(self, data):
+        os.write(self.fd, data)
+
+    def close(self):
+        os.close(self.fd)
+
+
+class SerialPort:
+    """pyserialでポートを開く"""
+
+    def __init__(self, path, baudrate):
+        import serial
+        self.port = serial.serial_for_url(path, baudrate=baudrate, timeout=0)
+
+    def read(self, timeout):
+        end = time.monotonic() + timeout
+        while True:
+            data = self.port.read(4096)
+            if data or time.monotonic() >= end:
+                return data
+            time.sleep(0.001)
+
+    def write(self, data):
+        self.port.write(data)
+
+    def close(self):
+        self.port.close()
+
+
+def open_port(path, baudrate):
+    try:
+        return SerialPort(path, baudrate)
+    except ImportError:
+        return PosixPort(path, baudrate)
+
+
+def wait_frames(port, parser, timeout):
+    """フレームを1つ以上受け取るか、timeout[s]経つまで待ち、受け取ったフレームのリストを返す"""
+    end = time.monotonic() + timeout
+    while True:
+        frames = parser.feed(port.read(max(end - time.monotonic(), 0)))
+        if frames or time.monotonic() >= end:
+            return frames
+
+
+def download(port, name, output, timeout=1.0, restart=False, log=print):
+    """ファイルを転送して保存し、受け取ったバイト数を返す"""
+    parser = FrameParser()
+    port.write("sd get {}\r\n".format(name).encode())
+
+    info = None
+    for _ in range(RETRY_MAX):
+        for frame_type, payload in wait_frames(port, parser, timeout):
+            if frame_type == TYPE_ERROR:
+                raise IOError("マイコンでエラーが発生しました: {}".format(ERRORS.get(payload[0], payload[0])))
+            if frame_type == TYPE_INFO and len(payload) == 8:
+                info = struct.unpack("<II", payload)
+        if info:
+            break
+        port.write(encode_frame(TYPE_INFO))
+    if info is None:
+        raise IOError("ファイル情報を受け取れませんでした(テストモードのシェルが動いているか確認してください)")
+    size, sectors = info
+
+    part = output + ".part"
+    done = 0
+    if not restart and os.path.exists(part):
+        done = min(os.path.getsize(part) // SECTOR_SIZE, sectors)
+    with open(part, "ab" if done else "wb") as f:
+        f.truncate(done * SECTOR_SIZE)
+        if done:
+            log("{} セクタ目から再開します".format(done))
+
+        start = time.monotonic()
+        retries = 0
+        while done < sectors:
+            count = min(REQUEST_SECTORS, sectors - done)
+            port.write(encode_frame(TYPE_REQUEST, struct.pack("<IH", done, count)))
+
+            received = {}
+            while len(received) < count:
+                frames = wait_frames(port, parser, timeout)
+                if not frames:
+                    break  # 届かなかったセクタは要求し直す
+                for frame_type, payload in frames:
+                    if frame_type != TYPE_DATA or len(payload) < 4:
+                        continue
+                    index = struct.unpack_from("<I", payload)[0]
+                    expect = min(SECTOR_SIZE, size - index * SECTOR_SIZE)
+                    if done <= index < done + count and len(payload) - 4 == expect:
+                        received[index] = payload[4:]
+
+            progress = done
+            while done in received:
+                f.write(received.pop(done))
+                done += 1
+            if done == progress:
+                retries += 1
+                if retries > RETRY_MAX:
+                    raise IOError("{} セクタ目を受け取れません(もう一度実行すると続きから再開します)".format(done))
+            else:
+                retries = 0
+            elapsed = max(time.monotonic() - start, 1e-6)
+            log("\r{}/{} sectors {:.1f} kB/s".format(done, sectors, done * SECTOR_SIZE / 1024 / elapsed), end="")
+        log("")
+
+    port.write(encode_frame(TYPE_QUIT))
+    os.replace(part, output)
+    if parser.errors:
+        log("CRC32が合わないフレームを{}個捨てて要求し直しました".format(parser.errors))
+    return size
+
+
+def main():
+    parser = argparse.ArgumentParser(description="マイコンのSDカードからログファイルを転送します")
+    parser.add_argument("port", help="シリアルポート(COM3、/dev/ttyACM0など)")
+    parser.add_argument("name", help="SDカード上のファイル名(logNNNNN.binなど)")
+    parser.add_argument("-o", "--output", help="保存するファイル(省略時はファイル名と同じ)")
+    parser.add_argument("-b", "--baudrate", type=int, default=460800, help="ボーレート")
+    parser.add_argument("-t", "--timeout", type=float, default=1.0, help="応答を待つ時間[s]")
+    parser.add_argument("--restart", action="store_true", help=".partがあっても最初から転送する")
+    args = parser.parse_args()
+
+    port = open_port(args.port, args.baudrate)
+    try:
+        size = download(port, args.name, args.output or args.name, args.timeout, args.restart)
+    except IOError as e:
+        print("Error: {}".format(e), file=sys.stderr)
+        return 1
+    finally:
+        port.close()
+    print("{} -> {} ({} bytes)".format(args.name, args.output or args.name, size))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
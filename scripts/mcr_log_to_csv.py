@@ -0,0 +1,466 @@
+#!/usr/bin/env python3
+# バイナリログ(logNNNNN.bin)をcsvログと同じ形式に変換する
+#
+# 使い方:
+#   python scripts/mcr_log_to_csv.py log00000.bin            -> log00000.csv を出力
+#   python scripts/mcr_log_to_csv.py log00000.bin -o out.csv
+#
+# バイナリログの形式(mcr_logger::write_schema参照):
+#   MCRLOG2
+#   プログラム情報(BUILD_DATE、GIT_REVISION、PARAMETERS、100行目までの改行)
+#   CHANNELS
+#   名前,型,LSBと単位,記録周期[ms]   (チャンネル数分)
+#   (空行)
+#   DATA
+#   レコードの繰り返し
+#     同期バイト0xA5
+#     mask(u4) : bit iが立っているチャンネルiの値がレコードに含まれる
+#     maskが立っているチャンネルの値をチャンネル順にリトルエンディアンで詰めたもの
+#   含まれないチャンネルの列はcsvでは空欄になる(マイコンが書くcsvと同じ)
+#   レコードの間には一定間隔でチェックポイント(0xA6で始まる17バイト)が入る。変換時は読み飛ばす
+#
+# フライトレコーダー(CONFIG_FLIGHT_RECORDER)のフレームは、ヘッダのFLIGHTセクション(CHANNELSと同じ形式)に値の並びがあり、
+# レコードの間に 0xA7 イベント(u1) オフセット[ms](s2) バイト数(u1) フレーム の形で入る
+#   フレームは別のcsv(出力ファイル名_flight.csv)へ、event,offset_ms,値... の列で出力する
+#
+# イベント(run_mode/run_statusの変化、難所マーカー、セクションカウント、failerの変化)は、ヘッダのEVENTSセクション
+# (番号,イベント名)に種類があり、レコードの間に 0xA8 種類(u1) 時刻[us](u4) 走行距離[mm](s4) 値(s4) の形で入る
+#   イベントは別のcsv(出力ファイル名_events.csv)へ、time_us,distance_mm,event,value の列で出力する
+#
+# インプットレコーダー(CONFIG_INPUT_RECORDER)のフレームは、ヘッダのINPUTセクション(CHANNELSと同じ形式)に値の並びがあり、
+# レコードの間に 0xAA バイト数(u1) フレーム の形で入る(src/input_log.h参照)
+#   フレームは別のcsv(出力ファイル名_input.csv)へ、プログラム情報と値の列で出力する。host/replayで再生できる
+#
+# ログの最後には 0xA9 バッファの統計(u4 x 8、mcr_logger.hのlog_stats_t参照) が入る
+#   捨てたバイト数、捨てたレコード数、最大使用量、容量、busyで待たされた回数、最大書き出し時間[us]、最も強い間引きの段階、
+#   間引いていた時間[ms]。変換時に表示し、捨てたレコードがあれば警告する
+#
+# セクタストリーミング(CONFIG_LOG_SECTOR_STREAM)で記録したファイルは最後の512バイトがフッタ(log_extent.h参照)
+#   MCRFOOT1、先頭セクタ、セクタ数、有効バイト数、データのセクタ数、エラーセクタ数、CRC32 (全てu4リトルエンディアン)
+#   フッタがあれば有効バイト数までをログとして読む
+#
+# 差分圧縮形式(MCRLOG3 : CONFIG_LOG_COMPRESS)は、ヘッダはMCRLOG2と同じで、レコードはsrc/util/delta_codec.h参照
+#   キーフレーム : 0xA5 0x5A 長さ ペイロード(mask、値のzigzag varint) チェックサム
+#   デルタ       : ヘッダ [mask] changed 差分(zigzag varint)...
+#
+# 旧形式(MCRLOG1 : 全チャンネルを毎レコード記録し、RECORD_SIZE行を持つ)も変換できる
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+MAGICS = (b"MCRLOG1\n", b"MCRLOG2\n", b"MCRLOG3\n")
+RECORD_SYNC = 0xA5
+CHECKPOINT_SYNC = 0xA6
+CHECKPOINT_SIZE = 17
+FLIGHT_SYNC = 0xA7
+FLIGHT_HEAD_SIZE = 5
+EVENT_SYNC = 0xA8
+EVENT_FORMAT = "<BIii"
+EVENT_SIZE = 14
+STATS_SYNC = 0xA9
+STATS_FORMAT = "<8I"
+STATS_SIZE = 33
+STATS_NAMES = ["dropped_bytes", "dropped_records", "high_water", "capacity", "stalls", "max_write_us", "pressure_max",
+               "pressure_ms"]
+INPUT_SYNC = 0xAA
+INPUT_HEAD_SIZE = 2
+SECTOR_SIZE = 512
+FOOTER_MAGIC = b"MCRFOOT1"
+FOOTER_FORMAT = "<8s6I"
+KEYFRAME_MARKER = b"\xa5\x5a"
+FLAG_NEW_MASK = 0x01
+TYPE_FORMATS = {
+    "u1": "B",
+    "s1": "b",
+    "u2": "H",
+    "s2": "h",
+    "u4": "I",
+    "s4": "i",
+}
+
+
+def strip_footer(data):
+    """最後のセクタに正しいフッタがあれば、(有効バイト数までのデータ, フッタ)を返す。無ければ(data, None)"""
+    if len(data) < SECTOR_SIZE or len(data) % SECTOR_SIZE != 0:
+        return data, None
+    tail = data[-SECTOR_SIZE:]
+    if not tail.startswith(FOOTER_MAGIC):
+        return data, None
+    magic, first, count, data_bytes, data_sectors, errors, crc = struct.unpack_from(FOOTER_FORMAT, tail)
+    crc_len = struct.calcsize(FOOTER_FORMAT) - 4
+    if zlib.crc32(tail[:crc_len]) != crc or data_bytes > len(data) - SECTOR_SIZE:
+        return data, None
+    footer = {"data_bytes": data_bytes, "data_sectors": data_sectors, "errors": errors}
+    return data[:data_bytes], footer
+
+
+def parse_header(data):
+    """スキーマヘッダを読み、(バージョン, プログラム情報, チャンネル一覧, レコード開始位置)を返す"""
+    for version, magic in enumerate(MAGICS, 1):
+        if data.startswith(magic):
+            break
+    else:
+        raise ValueError("バイナリログではありません(先頭がMCRLOG1/MCRLOG2/MCRLOG3ではありません)")
+
+    data_pos = data.find(b"\nDATA\n", len(magic))
+    if data_pos < 0:
+        raise ValueError("DATA行が見つかりません")
+    header = data[len(magic):data_pos + 1].decode("utf-8", errors="replace")
+    record_start = data_pos + len(b"\nDATA\n")
+
+    channels_pos = header.find("CHANNELS\n")
+    if channels_pos < 0:
+        raise ValueError("CHANNELS行が見つかりません")
+    program_info = header[:channels_pos]
+
+    channels = parse_channels(header[channels_pos:])
+    return version, program_info, channels, record_start
+
+
+def parse_channels(section):
+    """セクション名の行に続く "名前,型,..." の行を空行まで読み、(名前, 型)のリストを返す"""
+    lines = section.split("\n")
+    channels = []
+    i = 1
+    while i < len(lines) and lines[i] != "":
+        fields = lines[i].split(",")
+        name, type_name = fields[0], fields[1]
+        if type_name not in TYPE_FORMATS:
+            raise ValueError("未知の型です: {}".format(type_name))
+        channels.append((name, type_name))
+        i += 1
+    return channels
+
+
+def parse_flight_header(data, section="FLIGHT"):
+    """スキーマヘッダのFLIGHTセクション(またはsectionで指定したセクション)を読み、フレームの(名前, 型)のリストを返す
+    無ければ空のリスト"""
+    data_pos = data.find(b"\nDATA\n")
+    header = data[:data_pos + 1].decode("utf-8", errors="replace")
+    flight_pos = header.find("\n{}\n".format(section))
+    if data_pos < 0 or flight_pos < 0:
+        return []
+    return parse_channels(header[flight_pos + 1:])
+
+
+def parse_event_header(data):
+    """スキーマヘッダのEVENTSセクションを読み、{番号: イベント名}を返す。無ければ空の辞書"""
+    data_pos = data.find(b"\nDATA\n")
+    header = data[:data_pos + 1].decode("utf-8", errors="replace")
+    events_pos = header.find("\nEVENTS\n")
+    if data_pos < 0 or events_pos < 0:
+        return {}
+    names = {}
+    for line in header[events_pos + len("\nEVENTS\n"):].split("\n"):
+        if line == "":
+            break
+        number, name = line.split(",", 1)
+        names[int(number)] = name
+    return names
+
+
+def read_aux(data, pos, flight, events, stats=None, inputs=None):
+    """チェックポイント、フライトレコーダーのフレーム、イベント、バッファの統計、インプットレコーダーのフレームを読み、
+    次の位置を返す。フレームはflightに、イベントはeventsに(種類, 時刻, 走行距離, 値)を追加し、統計はstatsに入れ、
+    インプットレコーダーのフレームはinputsにバイト列を追加する。どれでもなければNone"""
+    if data[pos] == CHECKPOINT_SYNC and pos + CHECKPOINT_SIZE <= len(data):
+        return pos + CHECKPOINT_SIZE
+    if data[pos] == FLIGHT_SYNC:
+        return read_flight(data, pos, flight)
+    if data[pos] == INPUT_SYNC and pos + INPUT_HEAD_SIZE <= len(data):
+        end = pos + INPUT_HEAD_SIZE + data[pos + 1]
+        if end > len(data):
+            return None
+        if inputs is not None:
+            inputs.append(data[pos + INPUT_HEAD_SIZE:end])
+        return end
+    if data[pos] == EVENT_SYNC and pos + EVENT_SIZE <= len(data):
+        if events is not None:
+            events.append(struct.unpack_from(EVENT_FORMAT, data, pos + 1))
+        return pos + EVENT_SIZE
+    if data[pos] == STATS_SYNC and pos + STATS_SIZE == len(data):
+        if stats is not None:
+            stats.update(zip(STATS_NAMES, struct.unpack_from(STATS_FORMAT, data, pos + 1)))
+        return pos + STATS_SIZE
+    return None
+
+
+def read_flight(data, pos, flight):
+    """フライトレコーダーのフレームを読んでflightに(イベント, オフセット, フレームのバイト列)を追加し、次の位置を返す
+    正しくなければNone"""
+    if pos + FLIGHT_HEAD_SIZE > len(data):
+        return None
+    event, offset, length = struct.unpack_from("<BhB", data, pos + 1)
+    end = pos + FLIGHT_HEAD_SIZE + length
+    if end > len(data):
+        return None
+    if flight is not None:
+        flight.append((event, offset, data[pos + FLIGHT_HEAD_SIZE:end]))
+    return end
+
+
+def decode_flight(flight, flight_channels):
+    """read_flightで集めたフレームを、event,offset_ms,値... の行のリストにする。長さの合わないフレームは捨てる"""
+    fmt = "<" + "".join(TYPE_FORMATS[t] for _, t in flight_channels)
+    size = struct.calcsize(fmt)
+    return [[event, offset] + list(struct.unpack(fmt, frame)) for event, offset, frame in flight if len(frame) == size]
+
+
+def decode_inputs(inputs, input_channels):
+    """read_auxで集めたインプットレコーダーのフレームを、値の行のリストにする。長さの合わないフレームは捨てる"""
+    fmt = "<" + "".join(TYPE_FORMATS[t] for _, t in input_channels)
+    size = struct.calcsize(fmt)
+    return [list(struct.unpack(fmt, frame)) for frame in inputs if len(frame) == size]
+
+
+def zigzag_decode(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+def read_varint(data, pos, end):
+    """varintを読み、(値, 次の位置)を返す。読めなければNone"""
+    value = 0
+    for i in range(5):
+        if pos + i >= end:
+            return None
+        b = data[pos + i]
+        value |= (b & 0x7F) << (7 * i)
+        if not b & 0x80:
+            return value & 0xFFFFFFFF, pos + i + 1
+    return None
+
+
+def to_type(value, type_name):
+    """32bitの値をチャンネルの型の値に戻す"""
+    size = struct.calcsize(TYPE_FORMATS[type_name])
+    value &= (1 << (8 * size)) - 1
+    if type_name.startswith("s") and value >= 1 << (8 * size - 1):
+        value -= 1 << (8 * size)
+    return value
+
+
+def decode_keyframe(data, pos, num):
+    """キーフレームを読み、(mask, 値のリスト, 次の位置)を返す。正しくなければNone"""
+    if pos + 3 > len(data) or data[pos:pos + 2] != KEYFRAME_MARKER:
+        return None
+    length = data[pos + 2]
+    start = pos + 3
+    end = start + length
+    if end + 1 > len(data) or sum(data[start:end]) & 0xFF != data[end]:
+        return None
+    r = read_varint(data, start, end)
+    if r is None or r[0] >> num:
+        return None
+    mask, p = r
+    values = [0] * num
+    for i in range(num):
+        if mask & (1 << i):
+            r = read_varint(data, p, end)
+            if r is None:
+                return None
+            values[i] = zigzag_decode(r[0])
+            p = r[1]
+    if p != end:
+        return None
+    return mask, values, end + 1
+
+
+def decode_delta(data, pos, num, prev_mask, prev):
+    """デルタを読み、(mask, 値のリスト, 次の位置)を返す。正しくなければNone"""
+    head = data[pos]
+    if head & ~FLAG_NEW_MASK:
+        return None
+    p = pos + 1
+    mask = prev_mask
+    if head & FLAG_NEW_MASK:
+        r = read_varint(data, p, len(data))
+        if r is None or r[0] >> num:
+            return None
+        mask, p = r
+    r = read_varint(data, p, len(data))
+    if r is None:
+        return None
+    changed, p = r
+    values = list(prev)
+    k = 0
+    for i in range(num):
+        if mask & (1 << i):
+            if changed & (1 << k):
+                r = read_varint(data, p, len(data))
+                if r is None:
+                    return None
+                values[i] = (prev[i] + zigzag_decode(r[0])) & 0xFFFFFFFF
+                if values[i] >= 1 << 31:
+                    values[i] -= 1 << 32
+                p = r[1]
+            k += 1
+    if changed >> k:
+        return None
+    return mask, values, p
+
+
+def decode_delta_records(data, start, channels, flight=None, events=None, stats=None, inputs=None):
+    """差分圧縮形式(MCRLOG3)のレコードを読み、各行の値のリストを返す(含まれないチャンネルはNone)
+    壊れたデータは次のキーフレームまで読み飛ばす。フライトレコーダーのフレームはflightに、イベントはeventsに追加し、
+    バッファの統計はstatsに入れ、インプットレコーダーのフレームはinputsに追加する"""
+    num = len(channels)
+    rows = []
+    skipped = 0
+    synced = False
+    prev_mask = 0
+    prev = [0] * num
+    pos = start
+    while pos < len(data):
+        end = read_aux(data, pos, flight, events, stats, inputs)
+        if end is not None:
+            pos = end
+            continue
+        if data[pos] == KEYFRAME_MARKER[0]:
+            result = decode_keyframe(data, pos, num)
+        elif synced:
+            result = decode_delta(data, pos, num, prev_mask, prev)
+        else:
+            result = None
+        if result is None:
+            synced = False
+            pos += 1
+            skipped += 1
+            continue
+
+        synced = True
+        prev_mask, prev, pos = result
+        rows.append([to_type(prev[i], t) if prev_mask & (1 << i) else None for i, (_, t) in enumerate(channels)])
+    return rows, skipped
+
+
+def decode_records(version, data, start, channels, flight=None, events=None, stats=None, inputs=None):
+    """レコードを読み、各行の値のリストを返す(含まれないチャンネルはNone)
+    同期バイトがずれていた場合は次の同期バイトまで読み飛ばす。フライトレコーダーのフレームはflightに、イベントはeventsに追加し、
+    バッファの統計はstatsに入れ、インプットレコーダーのフレームはinputsに追加する"""
+    formats = [TYPE_FORMATS[t] for _, t in channels]
+    sizes = [struct.calcsize(f) for f in formats]
+    full_mask = (1 << len(channels)) - 1
+
+    rows = []
+    skipped = 0
+    pos = start
+    while pos < len(data):
+        end = read_aux(data, pos, flight, events, stats, inputs)
+        if end is not None:
+            pos = end
+            continue
+        if data[pos] != RECORD_SYNC:
+            pos += 1
+            skipped += 1
+            continue
+
+        if version == 1:
+            mask = full_mask
+            head = 1
+        else:
+            if pos + 5 > len(data):
+                break
+            mask = struct.unpack_from("<I", data, pos + 1)[0]
+            head = 5
+        if mask & ~full_mask:
+            pos += 1
+            skipped += 1
+            continue
+
+        record_size = head + sum(sizes[i] for i in range(len(channels)) if mask & (1 << i))
+        if pos + record_size > len(data):
+            break
+
+        row = []
+        p = pos + head
+        for i in range(len(channels)):
+            if mask & (1 << i):
+                row.append(struct.unpack_from("<" + formats[i], data, p)[0])
+                p += sizes[i]
+            else:
+                row.append(None)
+        rows.append(row)
+        pos += record_size
+    return rows, skipped
+
+
+def main():
+    parser = argparse.ArgumentParser(description="バイナリログをcsvに変換します")
+    parser.add_argument("input", help="バイナリログファイル(logNNNNN.bin)")
+    parser.add_argument("-o", "--output", help="出力するcsvファイル(省略時は拡張子を.csvにしたもの)")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+
+    data, footer = strip_footer(data)
+
+    try:
+        version, program_info, channels, record_start = parse_header(data)
+        flight_channels = parse_flight_header(data)
+        input_channels = parse_flight_header(data, "INPUT")
+        event_names = parse_event_header(data)
+        flight = []
+        events = []
+        stats = {}
+        inputs = []
+        if version == 3:
+            rows, skipped = decode_delta_records(data, record_start, channels, flight, events, stats, inputs)
+        else:
+            rows, skipped = decode_records(version, data, record_start, channels, flight, events, stats, inputs)
+        flight_rows = decode_flight(flight, flight_channels)
+        input_rows = decode_inputs(inputs, input_channels)
+    except ValueError as e:
+        print("Error: {}".format(e), file=sys.stderr)
+        return 1
+
+    output = args.output or os.path.splitext(args.input)[0] + ".csv"
+    with open(output, "w", encoding="utf-8", newline="") as f:
+        f.write(program_info)
+        f.write(",".join(name for name, _ in channels) + "\n")
+        for row in rows:
+            f.write(",".join("" if v is None else str(v) for v in row) + "\n")
+
+    print("{} -> {} ({} records)".format(args.input, output, len(rows)))
+
+    if flight_rows:
+        flight_output = os.path.splitext(output)[0] + "_flight.csv"
+        with open(flight_output, "w", encoding="utf-8", newline="") as f:
+            f.write(",".join(["event", "offset_ms"] + [name for name, _ in flight_channels]) + "\n")
+            for row in flight_rows:
+                f.write(",".join(str(v) for v in row) + "\n")
+        windows = sum(1 for i, row in enumerate(flight_rows) if i == 0 or row[1] <= flight_rows[i - 1][1])
+        print("{} -> {} ({} frames, {} windows)".format(args.input, flight_output, len(flight_rows), windows))
+
+    if events:
+        events_output = os.path.splitext(output)[0] + "_events.csv"
+        with open(events_output, "w", encoding="utf-8", newline="") as f:
+            f.write("time_us,distance_mm,event,value\n")
+            for kind, time_us, distance_mm, value in events:
+                f.write("{},{},{},{}\n".format(time_us, distance_mm, event_names.get(kind, kind), value))
+        print("{} -> {} ({} events)".format(args.input, events_output, len(events)))
+    if input_rows:
+        input_output = os.path.splitext(output)[0] + "_input.csv"
+        with open(input_output, "w", encoding="utf-8", newline="") as f:
+            f.write(program_info)
+            f.write(",".join(name for name, _ in input_channels) + "\n")
+            for row in input_rows:
+                f.write(",".join(str(v) for v in row) + "\n")
+        print("{} -> {} ({} frames)".format(args.input, input_output, len(input_rows)))
+    if stats:
+        print("buffer: " + " ".join("{}={}".format(k, v) for k, v in stats.items()))
+        if stats["dropped_records"]:
+            print("Warning: バッファに空きが無く{}レコード({}バイト)を捨てました".format(stats["dropped_records"], stats["dropped_bytes"]),
+                  file=sys.stderr)
+    if footer and footer["errors"]:
+        print("Warning: 書き込みに失敗したセクタが{}個あります".format(footer["errors"]), file=sys.stderr)
+    if skipped:
+        print("Warning: 同期バイト(キーフレーム)が見つからず{}バイトを読み飛ばしました".format(skipped), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
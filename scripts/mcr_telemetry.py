@@ -0,0 +1,290 @@
+#!/usr/bin/env python3
+# マイコンが送るテレメトリ(src/telemetry.h参照)を受信して表示、記録する
+#
+# 使い方:
+#   python scripts/mcr_telemetry.py COM3                   -> 受信レートと抜けを1秒ごとに表示
+#   python scripts/mcr_telemetry.py /dev/ttyACM0 --start   -> テストモードのシェルに"telem on"を送ってから受信
+#   python scripts/mcr_telemetry.py COM3 --csv run.csv     -> 受信した値をcsvに記録
+#   python scripts/mcr_telemetry.py COM3 --plot speed,steer_angle  -> 指定した信号をグラフ表示(matplotlibが必要)
+#   python scripts/mcr_telemetry.py --selftest             -> 符号化、復号、抜けの検出を確認する
+#
+# パケットの形式(全てリトルエンディアン):
+#   COBS( 種類(u1) 通し番号(u2) ペイロード CRC32(u4、種類からペイロードの最後まで) ) 0x00
+#   種類0x01 : 値をスキーマのチャンネル順に詰めたもの
+#   種類0x02 : スキーマ 1行に1チャンネル "名前,型,LSBと単位"(1秒ごとに届く)
+# スキーマを受け取るまでの値は解釈できないため捨てる
+# 通し番号の抜けは、マイコンの送信バッファに空きが無かったか、受信側で壊れたパケット
+
+import argparse
+import collections
+import os
+import struct
+import sys
+import time
+import zlib
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from mcr_log_download import open_port  # noqa: E402
+
+TYPE_SAMPLE = 0x01
+TYPE_SCHEMA = 0x02
+HEAD_FORMAT = "<BH"
+HEAD_SIZE = 3
+CRC_SIZE = 4
+FRAME_MAX = 1024  # これより長い区切りの間は壊れているとみなす
+TYPE_FORMATS = {
+    "u1": "B",
+    "s1": "b",
+    "u2": "H",
+    "s2": "h",
+    "u4": "I",
+    "s4": "i",
+}
+PLOT_POINTS = 2000
+
+
+def cobs_encode(data):
+    """COBSで符号化する(区切りの0x00は含まない。src/util/cobs.hと同じ)"""
+    out = bytearray([0])
+    code_pos = 0
+    code = 1
+    for b in data:
+        if b:
+            out.append(b)
+            code += 1
+        if not b or code == 0xFF:
+            out[code_pos] = code
+            code_pos = len(out)
+            out.append(0)
+            code = 1
+    out[code_pos] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    """COBSを復号する。符号化が正しくない場合はNoneを返す"""
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        pos += 1
+        if code == 0 or pos + code - 1 > len(data):
+            return None
+        out += data[pos:pos + code - 1]
+        pos += code - 1
+        if code != 0xFF and pos < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def encode_packet(packet_type, seq, payload):
+    """パケットを作る(区切りの0x00を含む)"""
+    body = struct.pack(HEAD_FORMAT, packet_type, seq & 0xFFFF) + payload
+    return cobs_encode(body + struct.pack("<I", zlib.crc32(body))) + b"\x00"
+
+
+class Receiver:
+    """受信したバイト列からパケットを取り出し、スキーマに従って値を解釈する"""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.names = None
+        self.units = None
+        self.format = None
+        self.last_seq = None
+        self.received = 0
+        self.lost = 0
+        self.errors = 0
+
+    def feed(self, data):
+        """受信したバイト列を加え、解釈できたサンプルの(通し番号, 値のリスト)のリストを返す"""
+        self.buf += data
+        samples = []
+        while True:
+            end = self.buf.find(b"\x00")
+            if end < 0:
+                if len(self.buf) > FRAME_MAX:
+                    self.errors += 1
+                    self.buf.clear()
+                return samples
+            frame = bytes(self.buf[:end])
+            del self.buf[:end + 1]
+            if not frame:
+                continue
+            sample = self._packet(frame)
+            if sample is not None:
+                samples.append(sample)
+
+    def _packet(self, frame):
+        packet = cobs_decode(frame)
+        if packet is None or len(packet) < HEAD_SIZE + CRC_SIZE:
+            self.errors += 1  # シェルの文字列などもここで捨てる
+            return None
+        body, crc = packet[:-CRC_SIZE], struct.unpack("<I", packet[-CRC_SIZE:])[0]
+        if zlib.crc32(body) != crc:
+            self.errors += 1
+            return None
+        packet_type, seq = struct.unpack_from(HEAD_FORMAT, body)
+        payload = body[HEAD_SIZE:]
+        if packet_type == TYPE_SCHEMA:
+            self._schema(payload.decode(errors="replace"))
+            return None
+        if packet_type != TYPE_SAMPLE or self.format is None:
+            return None
+        if len(payload) != self.format.size:
+            self.errors += 1
+            return None
+
+        if self.last_seq is not None:
+            self.lost += (seq - self.last_seq - 1) & 0xFFFF
+        self.last_seq = seq
+        self.received += 1
+        return seq, list(self.format.unpack(payload))
+
+    def _schema(self, text):
+        names, units, formats = [], [], ""
+        for line in text.splitlines():
+            fields = line.split(",")
+            if len(fields) < 3 or fields[1] not in TYPE_FORMATS:
+                continue
+            names.append(fields[0])
+            formats += TYPE_FORMATS[fields[1]]
+            units.append(fields[2])
+        if names != self.names:
+            self.last_seq = None
+        self.names, self.units = names, units
+        self.format = struct.Struct("<" + formats)
+
+
+class Plot:
+    """指定した信号を直近PLOT_POINTS点だけグラフ表示する"""
+
+    def __init__(self, names):
+        import matplotlib.pyplot as plt
+        self.plt = plt
+        self.names = names
+        self.data = {name: collections.deque(maxlen=PLOT_POINTS) for name in names}
+        self.fig, self.axes = plt.subplots(len(names), 1, sharex=True, squeeze=False)
+        self.lines = {}
+        for ax, name in zip(self.axes[:, 0], names):
+            self.lines[name], = ax.plot([], [])
+            ax.set_ylabel(name)
+        plt.ion()
+        plt.show()
+
+    def add(self, receiver, seq, values):
+        for name in self.names:
+            if name in receiver.names:
+                self.data[name].append(values[receiver.names.index(name)])
+
+    def draw(self):
+        for ax, name in zip(self.axes[:, 0], self.names):
+            values = self.data[name]
+            self.lines[name].set_data(range(len(values)), values)
+            ax.relim()
+            ax.autoscale_view()
+        self.plt.pause(0.001)
+
+
+def selftest():
+    """符号化と復号の一致、区切りの再同期、抜けの検出を確認する"""
+    results = []
+    for n in (0, 1, 253, 254, 255, 508, 600):
+        data = bytes((i * 7) % 256 for i in range(n))
+        encoded = cobs_encode(data)
+        results.append(("COBS {}バイト".format(n), 0 not in encoded and cobs_decode(encoded) == data))
+
+    schema = "run_mode,u1,-\nline_error,s4,-\nsteer_angle,s2,0.1deg\n".encode()
+    stream = b"garbage\r\n\x00" + encode_packet(TYPE_SCHEMA, 0, schema)
+    for seq in (0, 1, 2, 5, 6):
+        stream += encode_packet(TYPE_SAMPLE, seq, struct.pack("<Bih", seq, -seq * 100, 0))
+    broken = bytearray(encode_packet(TYPE_SAMPLE, 7, struct.pack("<Bih", 7, 0, 0)))
+    broken[2] ^= 0x01
+    stream += bytes(broken) + encode_packet(TYPE_SAMPLE, 8, struct.pack("<Bih", 8, -800, 0))
+
+    receiver = Receiver()
+    samples = []
+    for i in range(0, len(stream), 5):  # 細切れで届いても解釈できること
+        samples += receiver.feed(stream[i:i + 5])
+    results.append(("スキーマ", receiver.names == ["run_mode", "line_error", "steer_angle"]))
+    results.append(("値", samples[-1] == (8, [8, -800, 0]) and len(samples) == 6))
+    results.append(("抜けの検出", receiver.lost == 3))
+    results.append(("壊れたパケット", receiver.errors == 2))
+
+    failed = False
+    for name, ok in results:
+        print("{:<20} {}".format(name, "OK" if ok else "NG"))
+        failed |= not ok
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="マイコンのテレメトリを受信して表示、記録します")
+    parser.add_argument("port", nargs="?", help="シリアルポート(COM3、/dev/ttyACM0など)")
+    parser.add_argument("-b", "--baudrate", type=int, default=460800, help="ボーレート")
+    parser.add_argument("--start", action="store_true", help="受信前にシェルへ\"telem on\"を送る")
+    parser.add_argument("--csv", help="受信した値を記録するcsvファイル")
+    parser.add_argument("--plot", help="グラフ表示する信号名(カンマ区切り)")
+    parser.add_argument("--duration", type=float, help="受信する時間[s](省略時はCtrl+Cまで)")
+    parser.add_argument("--selftest", action="store_true", help="符号化、復号、抜けの検出を確認して終了する")
+    args = parser.parse_args()
+
+    if args.selftest:
+        return selftest()
+    if not args.port:
+        parser.error("ポートを指定してください")
+
+    plot = None
+    if args.plot:
+        try:
+            plot = Plot(args.plot.split(","))
+        except ImportError:
+            print("matplotlibが無いため、グラフは表示しません", file=sys.stderr)
+
+    port = open_port(args.port, args.baudrate)
+    if args.start:
+        port.write(b"telem on\r\n")
+    receiver = Receiver()
+    csv = open(args.csv, "w") if args.csv else None
+    header = None
+    start = time.monotonic()
+    report = start
+    count = 0
+    try:
+        while args.duration is None or time.monotonic() - start < args.duration:
+            for seq, values in receiver.feed(port.read(0.05)):
+                if csv:
+                    if header != receiver.names:
+                        header = receiver.names
+                        csv.write("seq," + ",".join(header) + "\n")
+                    csv.write("{},{}\n".format(seq, ",".join(str(v) for v in values)))
+                if plot:
+                    plot.add(receiver, seq, values)
+                count += 1
+            now = time.monotonic()
+            if now - report >= 1.0:
+                if plot:
+                    plot.draw()
+                total = receiver.received + receiver.lost
+                print("\r{:.0f} packets/s  lost {} ({:.2f}%)  errors {}".format(
+                    count / (now - report), receiver.lost, 100.0 * receiver.lost / max(total, 1), receiver.errors), end="")
+                report = now
+                count = 0
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print("")
+        if args.start:
+            port.write(b"telem off\r\n")
+        port.close()
+        if csv:
+            csv.close()
+    if receiver.names is None:
+        print("スキーマを受け取れませんでした(\"telem on\"で送信を開始してください)", file=sys.stderr)
+        return 1
+    print("received {} lost {} errors {}".format(receiver.received, receiver.lost, receiver.errors))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
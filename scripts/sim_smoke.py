@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+# シミュレーターを既定のパラメータでコースの例に走らせ、完走(result=FINISH)することを確認する
+#
+# 使い方:
+#   python scripts/sim_smoke.py [コースファイル ...]
+#
+# コースファイルを省略した場合、host/sim/courses/の全ての.txtを対象にする
+# env:simをpio runでビルドし、.pio/build/sim/programを各コースで実行する
+# 1つでも完走しなければ(ビルドの失敗を含む)1を返す
+
+import glob
+import os
+import subprocess
+import sys
+
+PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def run(program, course):
+    result = subprocess.run([program, course], cwd=PROJECT_DIR, capture_output=True, text=True)
+    lines = result.stdout.strip().splitlines()
+    summary = lines[-1] if lines else ''
+    print(f"{os.path.relpath(course, PROJECT_DIR)}: {summary}")
+    return result.returncode == 0 and summary.startswith('result=FINISH ')
+
+
+def main():
+    courses = sys.argv[1:] or sorted(glob.glob(os.path.join(PROJECT_DIR, 'host', 'sim', 'courses', '*.txt')))
+    if subprocess.run(['pio', 'run', '-e', 'sim'], cwd=PROJECT_DIR).returncode != 0:
+        return 1
+    program = os.path.join(PROJECT_DIR, '.pio', 'build', 'sim', 'program')
+    failed = [course for course in courses if not run(program, os.path.abspath(course))]
+    print('成功' if not failed else f"失敗 {len(failed)}/{len(courses)}")
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
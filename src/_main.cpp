@@ -23,7 +23,15 @@
 #include "interval.h"
 #include "motor_control.h"
 #include "line_sensor.h"
+#include "adc_scan.h"
 #include "features.h"
+#include "profile.h"
+#include "tick_monitor.h"
+#include "spsc_queue.h"
+#include "log_channels.h"
+#include "flight_log.h"
+#include "telemetry.h"
+#include "input_log.h"
 
 /******************************************************************/
 /* Definitions                                                    */
@@ -44,6 +52,13 @@ static const u1 revolution_difference_rin[] = { // 後輪(内輪)の回転比
     100, 100, 100, 98, 97, 95, 93, 91, 90, 89, 87, 86, 84, 82, 80, 79, 78, 77, 76, 75, 74, 74, 74, 50,
     50,  50,  50,  50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50 };
 
+/* ログ */
+#define LOG_QUEUE_DEPTH ( 32 ) // 1msタスクからloop()へ渡すログレコードの数(2のべき乗)
+
+/* 1ms周期タスクの監視 */
+#define TICK_PERIOD_CYCLES ( CYCLES_PER_US * 1000 )  // 1msタスクの周期
+#define TICK_TOLERANCE_CYCLES ( CYCLES_PER_US * 50 ) // 遅れとみなさない許容値 50[us]
+
 /*********************************************************/
 /* Local Variables                                       */
 /*********************************************************/
@@ -65,8 +80,8 @@ time_measure running_timer;                 // 走行時間計測用タイマー
 
 // ロガー関連
 mcr_logger logger;
-s4 log_interval;
 s4 target_speed_now;
+spsc_queue<log_record_t, LOG_QUEUE_DEPTH> log_queue;
 
 // ブザー関連
 buzzer bz( PIN_BUZZER );
@@ -74,6 +89,13 @@ buzzer bz( PIN_BUZZER );
 // failer
 u4 failer = 0x00;
 
+// 1ms周期タスクの監視(周期の遅れ、抜け、処理時間超過の検出)
+tick_monitor tick_mon( TICK_PERIOD_CYCLES, TICK_TOLERANCE_CYCLES );
+static u4 tick_faults_at_start = 0; // 走行開始時の1ms周期タスクの異常の数(走行中に増えたらフェールにする)
+
+// 走行終了時のロギングの終了要求(log_task()が残りのレコードを書き込んでからロギングを終了する)
+static bool logging_end_pending = false;
+
 /*********************************************************/
 /* Global Variables                                      */
 /*********************************************************/
@@ -138,7 +160,7 @@ static s4 rear_out( s4 front_out, s4 angle ) {
  * 戻り値：なし
  * 詳細：ログ用のtarget_speedを設定する
  */
-static s4 set_target_speed_now( s4 target_speed ) {
+static void set_target_speed_now( s4 target_speed ) {
     target_speed_now = target_speed;
 }
 
@@ -307,9 +329,12 @@ bool run_judge_check_stop() {
             check_stop_fail_distance.restart();
         }
 
-        if ( ( check_stop_timer.measure() > 500 )                                           // 500ms以上継続
-             || ( check_stop_fail_distance.measure() > 100 )                                // 100mm以上走行
-             || ( check_stop_comp_distance.measure() > prm_stop_distance.get() * 1000 ) ) { // 停止距離以上走行完了
+        if ( ( check_stop_timer.measure() > 500 )              // 500ms以上継続
+             || ( check_stop_fail_distance.measure() > 100 ) ) { // 100mm以上走行
+            flight_log_trigger( FLIGHT_EVENT_STOP );
+            stop = true;
+        }
+        if ( check_stop_comp_distance.measure() > prm_stop_distance.get() * 1000 ) { // 停止距離以上走行完了
             stop = true;
         }
     }
@@ -346,6 +371,7 @@ bool run_judge_end_sharp_curve() {
  *     run_status_reset:run_statusをリセットするかどうか(デフォルト：リセットする)
  * 戻り値：なし
  * 詳細：run_modeを変更する
+ *      難所手前、クランクへの遷移ではフライトレコーダーの窓を切り出す
  */
 void run_mode_change_to( enum e_run_mode mode, bool dist_measure_reset = true, bool run_status_reset = true ) {
     run_mode = mode;
@@ -353,6 +379,12 @@ void run_mode_change_to( enum e_run_mode mode, bool dist_measure_reset = true, b
     if ( dist_measure_reset ) {
         dist_measure.restart();
     }
+
+    if ( mode == RUN_PRE_DIFFICULT ) {
+        flight_log_trigger( FLIGHT_EVENT_PRE_DIFFICULT );
+    } else if ( ( mode == RUN_R_CRANK ) || ( mode == RUN_L_CRANK ) ) {
+        flight_log_trigger( FLIGHT_EVENT_CRANK );
+    }
 }
 
 /***************************************************/
@@ -369,9 +401,11 @@ void running_stop() {
     motor_pwm( 0, 0, 0, 0 );
 
     if ( button_start.isPressed() ) {
-        logger.make_log_file();
-        logger.write_header( "run_mode,run_status,line_error,steer_angle,line_digital,FL,FR,RL,RR,SV,speed,battery_voltage,"
-                             "slope_status,target_speed" );
+        logger.make_log_file( CONFIG_LOG_BINARY );
+        logger.write_header( log_channels, log_channel_num, flight_channels,
+                             ( CONFIG_FLIGHT_RECORDER && !CONFIG_FLIGHT_RECORDER_SERIAL ) ? flight_channel_num : 0, input_channels,
+                             CONFIG_INPUT_RECORDER ? input_channel_num : 0 );
+        log_channels_restart();
 
         bz.set( 0x00000F0F );
         timer_start_mode_timer.restart();
@@ -419,6 +453,8 @@ void running_pre_start() {
         indicator_set_neopixel_led( NEOPIXEL_LED_PATTERN_OFF );
         bz.set( 0x000000FF );
         logger.logging_begin();
+        failer &= ~FAIL_CONTROL_TICK; // 前の走行や停止中の周期の遅れは、この走行のフェールにしない
+        tick_faults_at_start = tick_mon.get_faults();
         run_mode_change_to( RUN_STABLE );
         encoder_reset();
         running_timer.restart();
@@ -526,7 +562,9 @@ void running_pre_difficult() {
 void running_x_line_trace() {
     set_servo_mode( LINE_TRACE );
     spdctrl_stable( speed_crossline );
-    if ( ls.right_half_line() ) {
+    if ( dist_measure.measure() < prm_distance_crossline_pass.get() ) {
+        ; // 2本目のクロスラインの端を斜めに横切るとハーフラインのパターンになるため、通過し終えるまで判定しない
+    } else if ( ls.right_half_line() ) {
         run_mode_change_to( RUN_R_CRANK );
     } else if ( ls.left_half_line() ) {
         run_mode_change_to( RUN_L_CRANK );
@@ -894,14 +932,25 @@ void running_slope() {
  * 概要：走行終了制御
  * 引数：なし
  * 戻り値：なし
- * 詳細：ロギングタスクに走行終了を通知し、書き込みが終わるまで待つ
+ * 詳細：ロギングタスクに走行終了を通知し、ログファイルの終了処理が終わったらRUN_STOPへ遷移する
+ *      フライトレコーダーの窓を処理中の場合は、窓を書き終えてから通知する
+ *      ロギングはここでは止めず、log_task()がキューに残ったレコードとこの周期のイベント、インプットレコーダーの
+ *      フレームを書き込んだ後に止める。終了処理はlog_task()が少しずつ進めるため、ここでは待たない
  */
 void running_end() {
     set_servo_mode( STOP );
     motor_pwm( 0, 0, 0, 0 );
-    bz.set( 0x00000155 );
-    logger.logging_end();
-    run_mode = RUN_STOP;
+    if ( logger.is_logging() && !flight_log_is_busy() && !logging_end_pending ) {
+        bz.set( 0x00000155 );
+        logging_end_pending = true;
+        indicator_set_neopixel_led( NEOPIXEL_LED_PATTERN_LOG_FINALIZING );
+    }
+
+    indicator_set_progress( logger.get_finalize_progress() );
+    if ( !logger.is_logging() && !logger.is_finalizing() ) {
+        indicator_set_neopixel_led( NEOPIXEL_LED_PATTERN_OFF );
+        run_mode = RUN_STOP;
+    }
 }
 
 /*
@@ -1034,21 +1083,60 @@ void ruuning() {
  * 概要：フェールセーフ制御
  * 引数：なし
  * 戻り値：なし
- * 詳細：フェールを検出し、フェール表示を行う
+ * 詳細：フェールを検出し、フェールが変わったときにフェール表示を行う
+ *      1ms周期タスクの遅れは走行中だけ検出する(停止中のSDカードの処理やテストモードのコマンドでは遅れてもよい)
+ *      フェール表示はNeoPixelLEDのエラー状態のLEDに出すため、状態(ゲート待ち、ログの終了処理中など)の表示は消さない
  */
 void failsafe() {
+    static u4 failer_old = 0x00;
+    bool running = ( RUN_STABLE <= run_mode ) && ( run_mode <= RUN_SLOPE );
+
     // フェール検出
-    failer |= logger.is_fault() ? 1 : 0;
+    failer |= logger.is_fault() ? FAIL_SD_CARD : 0;
+    failer |= ( running && tick_mon.get_faults() != tick_faults_at_start ) ? FAIL_CONTROL_TICK : 0;
+    if ( failer == failer_old ) {
+        return;
+    }
+    failer_old = failer;
+    log_event( LOG_EVENT_FAILER, failer );
 
     // フェール表示
-    if ( failer & 0x01 ) {
+    if ( failer & FAIL_SD_CARD ) {
         indicator_set_neopixel_led( NEOPIXEL_LED_PATTERN_NO_SDCARD ); // SDカードエラー
+    } else if ( failer & FAIL_CONTROL_TICK ) {
+        indicator_set_neopixel_led( NEOPIXEL_LED_PATTERN_TICK_OVERRUN ); // 1ms周期タスクの遅れ
+    } else {
+        indicator_set_neopixel_led( NEOPIXEL_LED_PATTERN_ERROR_OFF );
     }
 }
 
 /*******************************/
 /* Task functions              */
 /*******************************/
+/*
+ * 概要：ログ出力タスク
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：1msタスクがキューに積んだログレコードを全て取り出し、ロガーへ渡す(csvの1行、またはバイナリレコードになる)
+ *      フライトレコーダーが切り出した窓のフレームも出力する
+ *      走行終了でロギングの終了が要求されていれば、キューを空にした後にロギングを終了する
+ *      (走行制御、イベント、インプットレコーダーのフレームの後に呼ぶため、この周期までの記録は全てログに入る)
+ *      文字列の生成とSDカードへの書き込みを割り込みコンテキストの外で行うため、loop()から呼ぶこと
+ */
+void log_task() {
+    log_record_t record;
+
+    while ( log_queue.pop( &record ) ) {
+        logger.put_record( log_channels, log_channel_num, &record );
+    }
+    flight_log_task();
+    if ( logging_end_pending ) {
+        logging_end_pending = false;
+        logger.logging_end();
+    }
+    logger.exec();
+}
+
 /*
  * 概要：1ms周期で動くタイマタスク
  * 引数：なし
@@ -1058,20 +1146,32 @@ void failsafe() {
  * 備考：割り込みコンテキストで実行される
  */
 void timer_1ms_task( timer_callback_args_t* p_args ) {
+    u4 start = cycle_counter_read();
+    u4 lap = start;
+
+    tick_mon.entry( start );
+
     sensors_update_interrupt();
+    lap = profile_lap( PROFILE_STAGE_SENSORS, lap );
     servo_control();
+    lap = profile_lap( PROFILE_STAGE_SERVO, lap );
     motor_control();
+    lap = profile_lap( PROFILE_STAGE_MOTOR, lap );
 
-    if ( log_interval++ > 10 ) {
-        char buf[256];
-        mini_snprintf( buf, 256, "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", run_mode, run_status, ls.line_error, steer_angle, ls.line_digital, FL,
-                       FR, RL, RR, SV, speed, battery_voltage, slope_status, target_speed_now );
-
-        logger.put_log( buf );
-        log_interval = 0;
+    log_record_t record;
+    if ( log_channels_sample( &record ) ) {
+        log_queue.push( record ); // 満杯の場合は捨てる(捨てた数はlog_queueが数える)
     }
+    flight_log_sample();
+    input_log_sample();
+    telemetry_sample();
+    lap = profile_lap( PROFILE_STAGE_LOG, lap );
 
     bz.process_1ms();
+    lap = profile_lap( PROFILE_STAGE_BUZZER, lap );
+
+    profile_add( PROFILE_STAGE_TOTAL, lap - start );
+    tick_mon.exit( lap );
 }
 
 /***********************************/
@@ -1085,16 +1185,21 @@ void setup() {
     motor_init();
     screen_setup();
     sensors_init();
-    logger.init();
     // nvm_erase(); キャリブレーションパラメータを減らしたときに実行すること
     nvm_load();
+    ls.reload_calibration(); // sensors_init()はnvm_load()の前のため、読み込んだキャリブレーションを反映する
+    logger.init(); // SDカードのSPIクロック(prm_sd_clock_mhz)を使うため、nvm_load()の後に呼ぶ
 
     indicator_init();
+    profile_init();
 
     fsp_timer.begin( TIMER_MODE_PERIODIC, AGT_TIMER, 1, 24000 - 1, 1, (timer_source_div_t)TIMER_SOURCE_DIV_1, timer_1ms_task );
     IRQManager::getInstance().addPeripheral( IRQ_AGT, (void*)fsp_timer.get_cfg() );
     fsp_timer.open();
     fsp_timer.start(); // APIのバグでopen()でstartされているが、APIが修正されたときにも動くようにするためにstart()を一応呼ぶ
+    if ( !adc_scan_start() ) { // 1msタスクのタイマー(AGT1)を使うため、タイマーの開始後に呼ぶ
+        DBG_PRINT( "ADC scan start failed\n" );
+    }
 
     // テストモードのときはシェルを起動する
     if ( CONFIG_COMMAND_TEST_MODE ) {
@@ -1103,12 +1208,20 @@ void setup() {
 }
 
 void loop() {
-    target_speed_update();
-    sensors_update_period();
-    if ( run_mode == RUN_STOP || run_mode == RUN_TEST_MOTOR || run_mode == RUN_TEST_TRACE || run_mode == RUN_TEST_ANGLE ) {
-        screen_exec();
+    // インプットレコーダーが有効のときは、1msタスク1周期につき1回だけ走行制御を実行する
+    // 無効のとき(csv形式のログを含む。input_log.hで禁止している)は毎回trueになり、実行周期は変わらない
+    if ( input_log_control_begin() ) {
+        target_speed_update();
+        sensors_update_period();
+        if ( run_mode == RUN_STOP || run_mode == RUN_TEST_MOTOR || run_mode == RUN_TEST_TRACE || run_mode == RUN_TEST_ANGLE ) {
+            screen_exec();
+        }
+        ruuning();
+        input_log_control_end();
     }
-    ruuning();
+    log_events_poll();
+    log_task();
+    telemetry_task();
     indicator_exec();
     failsafe();
 
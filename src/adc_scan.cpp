@@ -0,0 +1,347 @@
+/*
+ * 概要：ラインセンサー、バッテリー電圧、汎用ADCピンのA/D変換を、1msタスクの直前にハードウェアで一括して行う
+ * 実機での確認：テストモードのprof showでsensorsの区間の時間、prof tickでadc timeoutが0のままであることを見る
+ */
+#include <Arduino.h>
+#include <IRQManager.h>
+#include <r_adc.h>
+#include <r_dtc.h>
+#include "adc_scan.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define ADC_SCAN_HW_BITS ( 12 )          // ADC14の変換結果のビット数(Arduinoのanalog.cppと同じ12bitで使う)
+#define ADC_SCAN_AGT_COUNT_PER_US ( 24 ) // AGT1のカウントソース(PCLKB 24MHz、分周なし)の1usあたりのカウント
+#define ADC_SCAN_WAIT_LOOP ( 1000 )      // adc_scan_wait()でスキャンの終了を待つ回数の上限
+#define ADC_SCAN_SUM_BITS ( 16 )         // 加算モードのチャンネルのデータレジスタのビット数(12bitをADC_SCAN_OVERSAMPLE回加算)
+#define ADC_SCAN_CHANNEL_NUM ( 28 )      // ADC0のデータレジスタ(ADDR)の数
+#define ADC_SCAN_IPL ( 12 )              // スキャン終了割り込みの優先度(DTCの起動だけに使い、CPUの割り込みは発生しない)
+#define ADC_SCAN_DTC_BLOCKS ( 0xFFFF )   // 転送Aのブロック数(毎回転送Cで戻すため0にならない)
+#define ADC_SCAN_CLOCK_HZ ( 48000000 )   // ADC14の変換クロック(PCLKC 48MHz)
+#define ADC_SCAN_RIPPLE_HZ ( 18000 )     // 平均するリップルの周波数(モーターのPWM。motor_driver.cppのDEFAULT_FREQUENCY_HZ)
+#define ADC_SCAN_CONVERT_STATES ( 20 )   // 1回の変換のサンプリング以外の時間(12bit、データシートからの目安) LSB:1[ADCLK]
+#define ADC_SCAN_SAMPLE_STATES ( ADC_SCAN_CLOCK_HZ / ADC_SCAN_RIPPLE_HZ / ADC_SCAN_OVERSAMPLE - ADC_SCAN_CONVERT_STATES ) // サンプリング時間
+#define ADC_SCAN_MARGIN_US ( 30 )        // スキャンの時間の見積もりに足す余裕(DTCの転送を含む) LSB:1[us]
+
+static_assert( ADC_SCAN_SAMPLE_STATES >= ADC_SAMPLE_STATE_COUNT_MIN && ADC_SCAN_SAMPLE_STATES <= ADC_SAMPLE_STATE_COUNT_MAX,
+               "ADC_SCAN_SAMPLE_STATES is out of range" );
+
+// DTCのチェーン転送の順番
+typedef enum {
+    ADC_SCAN_DTC_COPY = 0, // A:データレジスタからresultsへ1ブロック転送する
+    ADC_SCAN_DTC_DEST,     // B:Aの転送先をresultsの先頭に戻す
+    ADC_SCAN_DTC_COUNT,    // C:Aのブロック数を戻す
+    ADC_SCAN_DTC_NUM,
+} e_adc_scan_dtc;
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static adc_instance_ctrl_t adc_ctrl;
+static adc_extended_cfg_t adc_cfg_extend;
+static adc_cfg_t adc_cfg;
+static adc_channel_cfg_t adc_channel_cfg;
+static u1 pin_channels[NUM_DIGITAL_PINS]; // ピンごとのチャンネル番号+1(0は登録なし)
+static bool started = false;
+static GenericIrqCfg_t scan_end_irq = { FSP_INVALID_VECTOR, ADC_SCAN_IPL, ELC_EVENT_ADC0_SCAN_END };
+static dtc_instance_ctrl_t dtc_ctrl;
+static dtc_extended_cfg_t dtc_cfg_extend;
+static transfer_cfg_t dtc_cfg;
+static transfer_info_t dtc_info[ADC_SCAN_DTC_NUM];
+static u4 dtc_reload[ADC_SCAN_DTC_NUM];           // 転送B、Cで転送Aに書き戻す値(転送先、ブロック数と長さ)
+static volatile u2 results[ADC_SCAN_CHANNEL_NUM]; // DTCで転送したデータレジスタの値(チャンネル番号の順)
+static u4 timeouts = 0;                           // adc_scan_wait()で待ちきれなかった回数
+static u2 lead_us = 0;                            // 1msタスクより前にスキャンを始める時間 LSB:1[us]
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：チャンネルの変換結果をADC_SCAN_FINE_BITSの値で取得する
+ * 引数：channel チャンネル番号
+ * 戻り値：変換結果 ADC_SCAN_FINE_BITSの値
+ * 詳細：加算モードのチャンネルは合計値の下位ビットを捨て、それ以外は12bitの値を左に詰める
+ */
+static u2 read_channel_fine( u1 channel ) {
+    u2 value = results[channel];
+    if ( adc_channel_cfg.add_mask & ( 1UL << channel ) ) {
+        return value >> ( ADC_SCAN_SUM_BITS - ADC_SCAN_FINE_BITS );
+    }
+    return value << ( ADC_SCAN_FINE_BITS - ADC_SCAN_HW_BITS );
+}
+
+/*
+ * 概要：スキャンする全チャンネルのサンプリング時間を設定し、スキャンの時間を見積もる
+ * 引数：なし
+ * 戻り値：成功:true 失敗:false
+ * 詳細：加算モードの変換は1チャンネルずつADC_SCAN_OVERSAMPLE回続けて行われるため、サンプリング時間を延ばして
+ *      1チャンネル分の変換がモーターのPWMの1周期(ADC_SCAN_RIPPLE_HZ)になるようにし、PWMのリップルを平均する
+ *      (最短のサンプリング時間では0.7us程度の間隔で16回変換するため、55usの周期のリップルのうち約1/5の区間しか見ない)
+ *      加算しないチャンネルも同じサンプリング時間にし、スキャンの時間を変換の回数だけで見積もれるようにする
+ *      16番以降のチャンネルはサンプリング時間のレジスタを共有する
+ *      見積もった時間にADC_SCAN_MARGIN_USを足した時間を、1msタスクより前にスキャンを始める時間にする
+ */
+static bool set_sample_states() {
+    u4 conversions = 0;
+
+    for ( u1 channel = 0; channel < ADC_SCAN_CHANNEL_NUM; channel++ ) {
+        if ( !( adc_channel_cfg.scan_mask & ( 1UL << channel ) ) ) {
+            continue;
+        }
+        adc_sample_state_t sample;
+        sample.reg_id = ( channel < 16 ) ? (adc_sample_state_reg_t)channel : ADC_SAMPLE_STATE_CHANNEL_16_TO_31;
+        sample.num_states = ADC_SCAN_SAMPLE_STATES;
+        if ( R_ADC_SampleStateCountSet( &adc_ctrl, &sample ) != FSP_SUCCESS ) {
+            return false;
+        }
+        conversions += ( adc_channel_cfg.add_mask & ( 1UL << channel ) ) ? ADC_SCAN_OVERSAMPLE : 1;
+    }
+    u4 states = conversions * ( ADC_SCAN_SAMPLE_STATES + ADC_SCAN_CONVERT_STATES );
+    lead_us = (u2)( states / ( ADC_SCAN_CLOCK_HZ / 1000000 ) + ADC_SCAN_MARGIN_US );
+    return lead_us < 1000; // 1msタスクの周期に収まること
+}
+
+/*
+ * 概要：スキャン終了割り込み
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：スキャン終了はDTCを起動するだけで、転送はブロック数が0にならないためCPUの割り込みは発生しない
+ *      DTCを止めた場合などに割り込みが発生したときのために、割り込み要求をクリアする
+ */
+static void scan_end_isr() {
+    R_BSP_IrqStatusClear( scan_end_irq.irq );
+}
+
+/*
+ * 概要：スキャンしたチャンネルのデータレジスタを、スキャンの終了ごとにDTCでresultsへ転送する
+ * 引数：なし
+ * 戻り値：成功:true 失敗:false
+ * 詳細：スキャン終了の割り込み要因でDTCを起動し、3つのチェーン転送を行う
+ *      A:最初から最後のスキャンするチャンネルまでのデータレジスタを、resultsの同じ番号へ1ブロックで転送する(転送元はブロックごとに戻る)
+ *      B、C:Aの転送先とブロック数の転送情報(RAM)をdtc_reloadの値で書き戻し、次のスキャンでも同じ場所へ同じように転送できるようにする
+ *      CPUで転送し直す必要がないため、1msタスクはresultsを読むだけになる
+ *      転送情報をチェーンの中で書き換えるため、DTCの転送情報リードスキップを無効にする
+ */
+static bool dtc_start() {
+    u1 first = __builtin_ctz( adc_channel_cfg.scan_mask );
+    u1 last = 31 - __builtin_clz( adc_channel_cfg.scan_mask );
+
+    if ( !IRQManager::getInstance().addGenericInterrupt( scan_end_irq, scan_end_isr ) ) {
+        return false;
+    }
+
+    transfer_info_t* copy = &dtc_info[ADC_SCAN_DTC_COPY];
+    copy->transfer_settings_word_b.dest_addr_mode = TRANSFER_ADDR_MODE_INCREMENTED;
+    copy->transfer_settings_word_b.repeat_area = TRANSFER_REPEAT_AREA_SOURCE;
+    copy->transfer_settings_word_b.irq = TRANSFER_IRQ_END;
+    copy->transfer_settings_word_b.chain_mode = TRANSFER_CHAIN_MODE_EACH;
+    copy->transfer_settings_word_b.src_addr_mode = TRANSFER_ADDR_MODE_INCREMENTED;
+    copy->transfer_settings_word_b.size = TRANSFER_SIZE_2_BYTE;
+    copy->transfer_settings_word_b.mode = TRANSFER_MODE_BLOCK;
+    copy->p_src = (const void*)&R_ADC0->ADDR[first];
+    copy->p_dest = (void*)&results[first];
+    copy->num_blocks = ADC_SCAN_DTC_BLOCKS;
+    copy->length = last - first + 1;
+
+    for ( u1 i = ADC_SCAN_DTC_DEST; i < ADC_SCAN_DTC_NUM; i++ ) {
+        transfer_info_t* reload = &dtc_info[i];
+        reload->transfer_settings_word_b.dest_addr_mode = TRANSFER_ADDR_MODE_FIXED;
+        reload->transfer_settings_word_b.repeat_area = TRANSFER_REPEAT_AREA_SOURCE;
+        reload->transfer_settings_word_b.irq = TRANSFER_IRQ_END;
+        reload->transfer_settings_word_b.chain_mode = ( i == ADC_SCAN_DTC_NUM - 1 ) ? TRANSFER_CHAIN_MODE_DISABLED : TRANSFER_CHAIN_MODE_EACH;
+        reload->transfer_settings_word_b.src_addr_mode = TRANSFER_ADDR_MODE_FIXED;
+        reload->transfer_settings_word_b.size = TRANSFER_SIZE_4_BYTE;
+        reload->transfer_settings_word_b.mode = TRANSFER_MODE_REPEAT; // 1回ごとに回数が戻るため終わらない
+        reload->p_src = &dtc_reload[i];
+        reload->num_blocks = 0;
+        reload->length = 1;
+    }
+    dtc_info[ADC_SCAN_DTC_DEST].p_dest = (void*)&copy->p_dest;
+    dtc_info[ADC_SCAN_DTC_COUNT].p_dest = (void*)&copy->num_blocks; // num_blocksとlengthの32bit
+
+    dtc_cfg_extend.activation_source = scan_end_irq.irq;
+    dtc_cfg.p_info = dtc_info;
+    dtc_cfg.p_extend = &dtc_cfg_extend;
+    if ( R_DTC_Open( &dtc_ctrl, &dtc_cfg ) != FSP_SUCCESS ) {
+        return false;
+    }
+    // R_DTC_Open()がブロック転送の長さ(CRAHとCRAL)を設定した後の値を書き戻す値にする
+    dtc_reload[ADC_SCAN_DTC_DEST] = (u4)(uintptr_t)copy->p_dest;
+    memcpy( &dtc_reload[ADC_SCAN_DTC_COUNT], (const void*)&copy->num_blocks, sizeof( u4 ) );
+    R_DTC->DTCCR_b.RRS = 0;
+    if ( R_DTC_Enable( &dtc_ctrl ) != FSP_SUCCESS ) {
+        R_DTC_Close( &dtc_ctrl );
+        return false;
+    }
+    return true;
+}
+
+/***********************************/
+/* Class implementions             */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：スキャンするピンを登録する
+ * 引数：pin ピン番号 oversample true:1回のスキャンでADC_SCAN_OVERSAMPLE回変換して加算する
+ * 戻り値：成功:true スキャン開始後、またはADC0のアナログ入力でないピン:false
+ * 詳細：ピンをアナログ入力にし、ピンのチャンネルをスキャンに加える。adc_scan_start()より前に呼ぶこと
+ *      オーバーサンプリングはモーターのPWMの1周期(約55us)に広げた変換の平均のため、PWMのリップルも平均され、
+ *      遅れはそのチャンネルからスキャンの終わりまでの時間(スキャン全体の時間以下)しか増えない
+ */
+bool adc_scan_add( pin_size_t pin, bool oversample ) {
+    if ( started || pin >= NUM_DIGITAL_PINS ) {
+        return false;
+    }
+    int32_t index = digitalPinToAnalogPin( pin );
+    auto cfg = getPinCfgs( index, PIN_CFG_REQ_ADC );
+    if ( cfg[0] == 0 || IS_ADC1( cfg[0] ) ) {
+        return false;
+    }
+    u1 channel = GET_CHANNEL( cfg[0] );
+    pinPeripheral( digitalPinToBspPin( index ), (uint32_t)IOPORT_CFG_ANALOG_ENABLE );
+    pin_channels[pin] = channel + 1;
+    adc_channel_cfg.scan_mask |= ( 1UL << channel );
+    if ( oversample ) {
+        adc_channel_cfg.add_mask |= ( 1UL << channel );
+    }
+    return true;
+}
+
+/*
+ * 概要：スキャンを開始する
+ * 引数：なし
+ * 戻り値：成功:true 失敗:false
+ * 詳細：ADC0をELCトリガのシングルスキャンにして、AGT1のコンペアマッチA(アンダーフローのスキャンの時間+余裕の前)をELCでつなぐ
+ *      以降、1msタスクの周期ごとに登録した全チャンネルを変換し、スキャンの終了でDTCが変換結果をRAMへ転送する
+ *      1msタスクのタイマーを開始した後に呼ぶこと
+ */
+bool adc_scan_start() {
+    if ( started || adc_channel_cfg.scan_mask == 0 ) {
+        return false;
+    }
+    adc_cfg_extend.add_average_count = ( adc_channel_cfg.add_mask != 0 ) ? ADC_ADD_SIXTEEN : ADC_ADD_OFF; // ADC_SCAN_OVERSAMPLE回
+    adc_cfg_extend.clearing = ADC_CLEAR_AFTER_READ_OFF;
+    adc_cfg_extend.trigger_group_b = ADC_TRIGGER_SYNC_ELC;
+    adc_cfg_extend.double_trigger_mode = ADC_DOUBLE_TRIGGER_DISABLED;
+    adc_cfg_extend.adc_vref_control = ADC_VREF_CONTROL_AVCC0_AVSS0;
+    adc_cfg_extend.enable_adbuf = 0;
+    adc_cfg_extend.window_a_irq = FSP_INVALID_VECTOR;
+    adc_cfg_extend.window_a_ipl = 12;
+    adc_cfg_extend.window_b_irq = FSP_INVALID_VECTOR;
+    adc_cfg_extend.window_b_ipl = 12;
+
+    adc_cfg.unit = 0;
+    adc_cfg.mode = ADC_MODE_SINGLE_SCAN;
+    adc_cfg.resolution = ADC_RESOLUTION_12_BIT;
+    adc_cfg.alignment = ADC_ALIGNMENT_RIGHT;
+    adc_cfg.trigger = ADC_TRIGGER_SYNC_ELC;
+    adc_cfg.p_callback = nullptr; // 割り込みは使わない
+    adc_cfg.p_context = nullptr;
+    adc_cfg.p_extend = &adc_cfg_extend;
+    adc_cfg.scan_end_irq = FSP_INVALID_VECTOR;
+    adc_cfg.scan_end_ipl = 12;
+    adc_cfg.scan_end_b_irq = FSP_INVALID_VECTOR;
+    adc_cfg.scan_end_b_ipl = 12;
+
+    adc_channel_cfg.scan_mask_group_b = 0;
+    adc_channel_cfg.p_window_cfg = nullptr;
+    adc_channel_cfg.priority_group_a = ADC_GROUP_A_PRIORITY_OFF;
+    adc_channel_cfg.sample_hold_mask = 0;
+    adc_channel_cfg.sample_hold_states = 24;
+
+    if ( R_ADC_Open( &adc_ctrl, &adc_cfg ) != FSP_SUCCESS ) {
+        return false;
+    }
+    if ( R_ADC_ScanCfg( &adc_ctrl, &adc_channel_cfg ) != FSP_SUCCESS || !set_sample_states() || !dtc_start() ) {
+        R_ADC_Close( &adc_ctrl );
+        return false;
+    }
+
+    // AGT1はアンダーフローで1msタスクを起動するダウンカウンタのため、コンペアマッチAをアンダーフローの少し前にする
+    // コンペアマッチの設定はカウントを止めて書く(止めている間もカウンタの値は保持される)
+    R_BSP_MODULE_START( FSP_IP_ELC, 0 );
+    R_ELC->ELSR[ELC_PERIPHERAL_ADC0].HA = ELC_EVENT_AGT1_COMPARE_A;
+    R_ELC->ELCR_b.ELCON = 1;
+    R_AGT1->AGTCR_b.TSTART = 0;
+    while ( R_AGT1->AGTCR_b.TCSTF ) {
+    }
+    R_AGT1->AGTCMA = lead_us * ADC_SCAN_AGT_COUNT_PER_US;
+    R_AGT1->AGTCMSR_b.TCMEA = 1;
+    R_AGT1->AGTCR_b.TSTART = 1;
+
+    if ( R_ADC_ScanStart( &adc_ctrl ) != FSP_SUCCESS ) { // ELCのトリガ待ちになる
+        R_ADC_Close( &adc_ctrl );
+        return false;
+    }
+    started = true;
+    return true;
+}
+
+/*
+ * 概要：実行中のスキャンと、その結果のDTCの転送が終わるのを待つ
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：1msタスクが遅れずに動いていれば、スキャンと転送は終わっているためすぐに戻る
+ *      1msタスクの先頭で呼び、全チャンネルが同じスキャンの値になるようにする
+ *      スキャン終了からDTCが転送を始めるまでは割り込み要求(IR)が立っているため、それも待つ
+ *      ADC_SCAN_WAIT_LOOP回で終わらなかった場合は回数を数える(adc_scan_timeouts())
+ */
+void adc_scan_wait() {
+    if ( !started ) {
+        return;
+    }
+    for ( u4 i = 0; R_ADC0->ADCSR_b.ADST || R_ICU->IELSR_b[scan_end_irq.irq].IR || R_DTC->DTCSTS_b.ACT; i++ ) {
+        if ( i >= ADC_SCAN_WAIT_LOOP ) {
+            timeouts++;
+            break;
+        }
+    }
+}
+
+/*
+ * 概要：adc_scan_wait()でスキャンと転送の終了を待ちきれなかった回数を取得する
+ * 引数：なし
+ * 戻り値：回数
+ * 詳細：0でなければ、スキャンの時間の見積もり(ADC_SCAN_CONVERT_STATES)が短いか、DTCが動いていない
+ */
+u4 adc_scan_timeouts() {
+    return timeouts;
+}
+
+/*
+ * 概要：直前のスキャンの変換結果を取得する
+ * 引数：pin ピン番号(adc_scan_add()で登録したもの)
+ * 戻り値：変換結果 ADC_SCAN_BITSの値 登録していないピン:0
+ * 詳細：DTCで転送した値を読むだけで、変換は待たない
+ */
+u2 adc_scan_read( pin_size_t pin ) {
+    return adc_scan_read_fine( pin ) >> ( ADC_SCAN_FINE_BITS - ADC_SCAN_BITS );
+}
+
+/*
+ * 概要：直前のスキャンの変換結果を、ADC_SCAN_BITSより細かい分解能で取得する
+ * 引数：pin ピン番号(adc_scan_add()で登録したもの)
+ * 戻り値：変換結果 ADC_SCAN_FINE_BITSの値 登録していないピン:0
+ * 詳細：オーバーサンプリングしたピンは加算した分だけ分解能が上がる。それ以外のピンは12bitの値を左に詰めたもの
+ */
+u2 adc_scan_read_fine( pin_size_t pin ) {
+    u1 channel = pin_channels[pin];
+    if ( channel == 0 ) {
+        return 0;
+    }
+    return read_channel_fine( channel - 1 );
+}
@@ -0,0 +1,39 @@
+/*
+ * 概要：ラインセンサー、バッテリー電圧、汎用ADCピンのA/D変換を、1msタスクの直前にハードウェアで一括して行う
+ * 登録したチャンネルをADC14のシングルスキャンで変換する。スキャンは1msタスクの周期タイマー(AGT1)のコンペアマッチAでELCから起動し、
+ * スキャンの終了でDTCがデータレジスタの値をRAMへ転送するため、1msタスクはanalogRead()のように変換を待たずに結果だけを読める
+ * オーバーサンプリングを指定したチャンネルは、1回のスキャンの中でADC_SCAN_OVERSAMPLE回変換し、ADC14の加算モードで合計する
+ * 変換のサンプリング時間を延ばし、1チャンネル分の変換がモーターのPWMの1周期に広がるようにしてPWMのリップルを平均する
+ * 注意：adc_scan_start()の後はanalogRead()を使わないこと(Arduinoのanalog.cppがADCの設定を上書きする)
+ */
+#pragma once
+#include <Arduino.h>
+#include "defines.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define ADC_SCAN_BITS ( 10 )       // adc_scan_read()の値のビット数(analogReadResolution(10)と同じ)
+#define ADC_SCAN_FINE_BITS ( 14 )  // adc_scan_read_fine()の値のビット数(12bitの16回加算を2bit捨てたもの)
+#define ADC_SCAN_OVERSAMPLE ( 16 ) // オーバーサンプリングするチャンネルの1スキャンあたりの変換回数
+
+/***********************************/
+/* Class                           */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+extern bool adc_scan_add( pin_size_t pin, bool oversample = false );
+extern bool adc_scan_start();
+extern void adc_scan_wait();
+extern u2 adc_scan_read( pin_size_t pin );
+extern u2 adc_scan_read_fine( pin_size_t pin );
+extern u4 adc_scan_timeouts();
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
@@ -118,6 +118,9 @@ parameter prm_time_R_crank( 140, 0, 10000, LSB_1, CATEGORY_CRANK, "tm_Rcrank", "
 parameter prm_time_L_crank( 140, 0, 10000, LSB_1, CATEGORY_CRANK, "tm_Lcrank", "左クランク時曲げ時間 LSB:1ms" );
 parameter prm_k_R_crank( 100, 0, 1000, LSB_001, CATEGORY_CRANK, "k_Rcrank", "右クランク角度制御時係数 LSB:0.01" );
 parameter prm_k_L_crank( 100, 0, 1000, LSB_001, CATEGORY_CRANK, "k_Lcrank", "左クランク角度制御時係数 LSB:0.01" );
+parameter prm_distance_crossline_pass( 60, 0, 1000, LSB_1, CATEGORY_CRANK, "dt_xline", "クロスライン検出後ハーフラインを判定しない距離(0で従来どおり) LSB:1mm" );
+
+parameter prm_sd_clock_mhz( 10, 1, 24, LSB_1, CATEGORY_LOGGER, "sd_clock", "SDカードのSPIクロック(sd benchで設定) LSB:1MHz" );
 
 /******************************************************************/
 /* Implementation                                                 */
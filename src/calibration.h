@@ -137,6 +137,8 @@ class parameter {
             return "DiffKind";
         case CATEGORY_CRANK:
             return "Crank";
+        case CATEGORY_LOGGER:
+            return "Logger";
         default:
             return "Others";
         }
@@ -255,5 +257,8 @@ extern parameter prm_k_R_crank;
 extern parameter prm_k_L_crank;
 extern parameter prm_time_R_crank;
 extern parameter prm_time_L_crank;
+extern parameter prm_distance_crossline_pass;
+
+extern parameter prm_sd_clock_mhz;
 
 extern std::vector<parameter*> parameters;
@@ -141,8 +141,14 @@ typedef unsigned char u1;
 typedef char s1;
 typedef unsigned short u2;
 typedef short s2;
+#if defined( ARDUINO_ARCH_RENESAS )
 typedef unsigned long u4;
 typedef long s4;
+#else
+// ホスト(ネイティブ)ビルドではlongが64bitのため、マイコンと同じ32bitの型にする
+typedef uint32_t u4;
+typedef int32_t s4;
+#endif
 typedef unsigned long long u8;
 typedef long long s8;
 typedef float f4;
@@ -178,6 +184,7 @@ enum category {
     CATEGORY_DIFFICULT_KIND,
     CATEGORY_LANE_CHANGE,
     CATEGORY_CRANK,
+    CATEGORY_LOGGER,
 };
 
 /* ディップスイッチの値を入れる型 */
@@ -279,6 +286,7 @@ static int my_digital_read( int pin ) {
 #define DECELERATION ( -120 ) // 減速度[0.1m/s^2]
 
 /* fail code */
-#define FAIL_SD_CARD ( 0x1 )
+#define FAIL_SD_CARD ( 0x1 )      // SDカードエラー
+#define FAIL_CONTROL_TICK ( 0x2 ) // 走行中の1ms周期タスクの遅れ、抜け、処理時間超過(走行開始でクリア)
 
 extern u4 failer;
@@ -7,10 +7,13 @@
 /******************************************************************/
 /* ラインセンサーの種類選択                                         */
 /******************************************************************/
+// ビルドオプション(-D)で指定した場合はそちらを優先する(platformio.iniのnative_stealth)
+#if !defined( CONFIG_LINE_SENSOR_D5A2 ) && !defined( CONFIG_LINE_SENSOR_STEALTH )
 // デジタルセンサ5個、アナログセンサ2個のセンサ構成
 #define CONFIG_LINE_SENSOR_D5A2
 // オールアナログステルスセンサの構成
 // #define CONFIG_LINE_SENSOR_STEALTH
+#endif
 
 /******************************************************************/
 /* モーター極性                                                    */
@@ -22,6 +25,69 @@
 #define CONFIG_MOTOR_RR_INVERT ( 0 )
 #define CONFIG_MOTOR_SV_INVERT ( 1 )
 
+/******************************************************************/
+/* ログ形式                                                        */
+/******************************************************************/
+// 1: バイナリ形式(logNNNNN.bin)で記録する。scripts/mcr_log_to_csv.pyでcsvに変換できる
+// 0: csv形式(logNNNNN.csv)で記録する
+#define CONFIG_LOG_BINARY ( 0 )
+
+// 1: バイナリ形式のログを前回値との差分とvarintで圧縮する(CONFIG_LOG_BINARYが1のときのみ有効)
+// 0: 圧縮しない
+#define CONFIG_LOG_COMPRESS ( 0 )
+
+// 1: ログファイルの連続領域へ、SPI1+DMACでセクタを直接書き込む(書き込み中にCPUが待たない)
+// 0: SdFatのファイル書き込みを使う
+#define CONFIG_LOG_SECTOR_STREAM ( 0 )
+
+// 1: 走行終了時、ログファイルの先頭500行をシリアルへ出力する(送信バッファの空きの分ずつ。csv形式のみ)
+// 0: 出力しない
+#define CONFIG_LOG_END_ECHO ( 1 )
+
+/******************************************************************/
+/* フライトレコーダー                                               */
+/******************************************************************/
+// 1: イベントの前後の窓を、ラインセンサーの生値などを含めて1kHzで記録する
+// 0: 記録しない
+// RAM: 約5KB(ステルスセンサーは約7.5KB) 0のときはフレーム2個分 RAMが足りない場合は0にすること
+// 窓の出力先が要るため、CONFIG_LOG_BINARYかCONFIG_FLIGHT_RECORDER_SERIALを1にしたときだけ1にできる
+#define CONFIG_FLIGHT_RECORDER ( 0 )
+
+// 窓を切り出すイベント(論理和で指定する)
+// 0x01: RUN_PRE_DIFFICULTへの遷移 0x02: クランク(RUN_R_CRANK、RUN_L_CRANK)への遷移 0x04: 完走以外の停止判断
+#define CONFIG_FLIGHT_RECORDER_EVENTS ( 0x07 )
+
+// 切り出す窓の長さ イベント前[ms](FLIGHT_RECORDER_FRAMES未満) イベント後[ms]
+#define CONFIG_FLIGHT_RECORDER_PRE_MS ( 200 )
+#define CONFIG_FLIGHT_RECORDER_POST_MS ( 700 )
+
+// 1: 窓をシリアルへcsvで出力する(送信が間に合わない場合は窓を打ち切る)
+// 0: 窓をログファイルへ書き込む(バイナリ形式のみ。scripts/mcr_log_to_csv.pyで別のcsvに変換される)
+#define CONFIG_FLIGHT_RECORDER_SERIAL ( 0 )
+
+/******************************************************************/
+/* テレメトリ                                                      */
+/******************************************************************/
+// 1: 起動時からテレメトリ(選択した信号のCOBS+CRC32のバイナリパケット)をシリアルへ送信する
+// 0: 送信しない(テストモードのシェルのtelemコマンドで開始できる)
+//    キューを1サンプルにしてRAMを使わないため、telemコマンドで開始した場合はloop()が遅れた周期のサンプルが抜ける
+// scripts/mcr_telemetry.pyで表示、記録できる
+#define CONFIG_TELEMETRY ( 0 )
+
+// テレメトリの送信周期[ms]
+#define CONFIG_TELEMETRY_PERIOD_MS ( 1 )
+
+/******************************************************************/
+/* インプットレコーダー                                             */
+/******************************************************************/
+// 1: 制御が読んだ全ての入力(ラインセンサー、エンコーダ、DIPスイッチ、ボタンなどの生値)と出力を1msごとにログファイルへ記録する
+//    ホストのhost/replayで記録を再生し、制御コードの出力がビット単位で一致するか確認できる
+//    再生と順序を合わせるため、loop()の走行制御を1msタスク1周期につき1回だけ実行する
+// 0: 記録しない
+// CONFIG_LOG_BINARYが1のときのみ使用できる(0のときに1にするとコンパイルエラーになる)
+// RAM: 約0.7KB(ステルスセンサーは約1KB) 0のときはフレーム3個分
+#define CONFIG_INPUT_RECORDER ( 0 )
+
 /******************************************************************/
 /* デバッグモード                                                  */
 /******************************************************************/
@@ -31,6 +97,9 @@
 // screenのフレームレート表示
 #define CONFIG_SCREEN_FPS ( 1 )
 
+// 1msタスクの各処理の実行時間[us]をログの列に追加する
+#define CONFIG_PROFILE_LOG ( 0 )
+
 /******************************************************************/
 /* シリアル通信によるテストモード有効                                */
 /******************************************************************/
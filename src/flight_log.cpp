@@ -0,0 +1,205 @@
+/*
+ * 概要：フライトレコーダー イベントの前後の窓を1kHzで記録し、ログファイルまたはシリアルへ出力する
+ */
+#include <Arduino.h>
+#include "flight_log.h"
+#include "log_channels.h"
+#include "flight_recorder.h"
+#include "sensors.h"
+#include "motor_control.h"
+#include "mini-printf.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define FLIGHT_SERIAL_LINE_MAX ( 192 ) // シリアルへ出力する1行の最大バイト数
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static flight_frame_t flight_staging; // 1msタスクで値を集めるフレーム(flight_channelsの値の格納場所)
+static flight_recorder<flight_frame_t, FLIGHT_RECORDER_FRAMES> recorder( CONFIG_FLIGHT_RECORDER_PRE_MS, CONFIG_FLIGHT_RECORDER_POST_MS );
+static u4 header_window = 0xFFFFFFFF; // シリアルへ列名を出力した窓の番号
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern u1 run_mode;
+extern u1 run_status;
+extern mcr_logger logger;
+
+/*
+ * フライトレコーダーのフレームの定義(flight_frame_tのメンバ順)
+ * ログファイルのスキーマヘッダのFLIGHTセクションになる。記録周期は全て1ms
+ */
+const log_channel_t flight_channels[] = {
+#if defined( CONFIG_LINE_SENSOR_STEALTH )
+    LOG_CHANNEL( "AR3", flight_staging.raw[0], "-", 1 ),
+    LOG_CHANNEL( "AR2", flight_staging.raw[1], "-", 1 ),
+    LOG_CHANNEL( "AR1", flight_staging.raw[2], "-", 1 ),
+    LOG_CHANNEL( "AC", flight_staging.raw[3], "-", 1 ),
+    LOG_CHANNEL( "AL1", flight_staging.raw[4], "-", 1 ),
+    LOG_CHANNEL( "AL2", flight_staging.raw[5], "-", 1 ),
+    LOG_CHANNEL( "AL3", flight_staging.raw[6], "-", 1 ),
+#else
+    LOG_CHANNEL( "line_left_raw", flight_staging.raw[0], "-", 1 ),
+    LOG_CHANNEL( "line_right_raw", flight_staging.raw[1], "-", 1 ),
+#endif
+    LOG_CHANNEL( "line_error", flight_staging.line_error, "-", 1 ),
+    LOG_CHANNEL( "steer_angle", flight_staging.steer_angle, "0.1deg", 1 ),
+    LOG_CHANNEL( "speed", flight_staging.speed, "0.01m/s", 1 ),
+    LOG_CHANNEL( "centrifugal_force", flight_staging.centrifugal_force, "0.1N", 1 ),
+    LOG_CHANNEL( "FL", flight_staging.FL, "1%", 1 ),
+    LOG_CHANNEL( "FR", flight_staging.FR, "1%", 1 ),
+    LOG_CHANNEL( "RL", flight_staging.RL, "1%", 1 ),
+    LOG_CHANNEL( "RR", flight_staging.RR, "1%", 1 ),
+    LOG_CHANNEL( "SV", flight_staging.SV, "1%", 1 ),
+    LOG_CHANNEL( "line_digital", flight_staging.line_digital, "bit", 1 ),
+    LOG_CHANNEL( "run_mode", flight_staging.run_mode, "-", 1 ),
+    LOG_CHANNEL( "run_status", flight_staging.run_status, "-", 1 ),
+};
+const u1 flight_channel_num = array_size( flight_channels );
+
+static_assert( sizeof( flight_frame_t ) == LINE_SENSOR_RAW_NUM * 2 + 16, "flight_frame_tに詰め物が入っています" );
+static_assert( !CONFIG_FLIGHT_RECORDER || CONFIG_FLIGHT_RECORDER_PRE_MS < FLIGHT_RECORDER_FRAMES,
+               "CONFIG_FLIGHT_RECORDER_PRE_MSはFLIGHT_RECORDER_FRAMES未満にしてください" );
+static_assert( !CONFIG_FLIGHT_RECORDER || CONFIG_LOG_BINARY || CONFIG_FLIGHT_RECORDER_SERIAL,
+               "CONFIG_FLIGHT_RECORDERはCONFIG_LOG_BINARYかCONFIG_FLIGHT_RECORDER_SERIALを1にしたときだけ使えます(窓の出力先がありません)" );
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：s4の値をs2の範囲に丸める
+ * 引数：value 値
+ * 戻り値：丸めた値
+ */
+static s2 clamp_s2( s4 value ) {
+    return (s2)constrain( value, -32768L, 32767L );
+}
+
+/*
+ * 概要：フレームの1行をシリアルへ出力する
+ * 引数：event イベントの種類 offset イベント時刻からの経過時間 LSB:1[ms] frame フレーム(nullptrなら列名の行)
+ * 戻り値：なし
+ * 詳細："FR,イベント,オフセット,値..."の形式で出力する。列名の行はイベントとオフセットの位置も列名にする
+ */
+static void print_frame( u1 event, s4 offset, const flight_frame_t* frame ) {
+    char line[FLIGHT_SERIAL_LINE_MAX];
+    s4 len;
+
+    if ( frame == nullptr ) {
+        len = mini_snprintf( line, sizeof( line ), "FR,event,offset_ms" );
+    } else {
+        len = mini_snprintf( line, sizeof( line ), "FR,%d,%ld", event, offset );
+    }
+    for ( u1 i = 0; i < flight_channel_num && len < (s4)sizeof( line ) - 13; i++ ) {
+        const log_channel_t* ch = &flight_channels[i];
+        if ( frame == nullptr ) {
+            len += mini_snprintf( &line[len], sizeof( line ) - len, ",%s", ch->name );
+        } else {
+            const u1* p = (const u1*)frame + ( (const u1*)ch->ptr - (const u1*)&flight_staging );
+            len += mini_snprintf( &line[len], sizeof( line ) - len, ",%ld", mcr_logger::unpack_value( ch->type, p ) );
+        }
+    }
+    line[len++] = '\n';
+    Serial.write( line, len );
+}
+
+/***********************************/
+/* Class implementions             */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：フライトレコーダーに1ms分のフレームを記録する
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：1msタスクから毎周期呼ぶこと
+ */
+void flight_log_sample() {
+    if ( !CONFIG_FLIGHT_RECORDER ) {
+        return;
+    }
+    ls.get_raw( flight_staging.raw, LINE_SENSOR_RAW_NUM );
+    flight_staging.line_error = clamp_s2( ls.line_error );
+    flight_staging.steer_angle = steer_angle;
+    flight_staging.speed = clamp_s2( speed );
+    flight_staging.centrifugal_force = clamp_s2( centrifugal_force );
+    flight_staging.FL = FL;
+    flight_staging.FR = FR;
+    flight_staging.RL = RL;
+    flight_staging.RR = RR;
+    flight_staging.SV = SV;
+    flight_staging.line_digital = ls.line_digital;
+    flight_staging.run_mode = run_mode;
+    flight_staging.run_status = run_status;
+    recorder.record( flight_staging );
+}
+
+/*
+ * 概要：イベントの前後の窓の切り出しを要求する
+ * 引数：event イベントの種類
+ * 戻り値：受け付けた:true CONFIG_FLIGHT_RECORDER_EVENTSで無効、または前の窓を処理中:false
+ * 詳細：loop()から呼ぶこと
+ *      次の1msタスクで記録するフレームがイベント時刻になり、その前CONFIG_FLIGHT_RECORDER_PRE_MS[ms]から
+ *      後CONFIG_FLIGHT_RECORDER_POST_MS[ms]までを切り出す
+ */
+bool flight_log_trigger( enum e_flight_event event ) {
+    if ( !CONFIG_FLIGHT_RECORDER || event == FLIGHT_EVENT_NONE || !( CONFIG_FLIGHT_RECORDER_EVENTS & ( 1 << ( event - 1 ) ) ) ) {
+        return false;
+    }
+    return recorder.trigger( event );
+}
+
+/*
+ * 概要：切り出した窓のフレームを出力する
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：loop()から呼ぶこと 1回でFLIGHT_DRAIN_MAXフレームまで出力する
+ *      CONFIG_FLIGHT_RECORDER_SERIALが0のときはロガーへ渡す。ロギング中でなければ捨てる
+ *      1のときはシリアルの送信バッファに空きがある分だけ出力し、送信完了を待たない
+ */
+void flight_log_task() {
+    flight_frame_t frame;
+    int32_t offset;
+
+    if ( !CONFIG_FLIGHT_RECORDER ) {
+        return;
+    }
+    for ( u1 i = 0; i < FLIGHT_DRAIN_MAX; i++ ) {
+        if ( CONFIG_FLIGHT_RECORDER_SERIAL && Serial.availableForWrite() < FLIGHT_SERIAL_LINE_MAX ) {
+            break;
+        }
+        if ( !recorder.pop( &frame, &offset ) ) {
+            break;
+        }
+        if ( CONFIG_FLIGHT_RECORDER_SERIAL ) {
+            if ( header_window != recorder.get_windows() ) {
+                header_window = recorder.get_windows();
+                print_frame( 0, 0, nullptr );
+            }
+            print_frame( recorder.get_event(), offset, &frame );
+        } else {
+            logger.put_flight_frame( recorder.get_event(), (s2)offset, &frame, sizeof( frame ) );
+        }
+    }
+}
+
+/*
+ * 概要：窓を処理中か
+ * 引数：なし
+ * 戻り値：処理中:true イベント待ち:false
+ * 詳細：走行終了時、停止判断の窓をログファイルへ書き終えてからロギングを終了するために使う
+ */
+bool flight_log_is_busy() {
+    return CONFIG_FLIGHT_RECORDER && recorder.is_busy();
+}
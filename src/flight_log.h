@@ -0,0 +1,65 @@
+/*
+ * 概要：フライトレコーダー イベントの前後の窓を1kHzで記録し、ログファイルまたはシリアルへ出力する
+ */
+#pragma once
+#include <Arduino.h>
+#include "defines.h"
+#include "features.h"
+#include "line_sensor.h"
+#include "mcr_logger.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#if CONFIG_FLIGHT_RECORDER
+#define FLIGHT_RECORDER_FRAMES ( 256 ) // リングバッファのフレーム数(2のべき乗) イベント前の窓と読み出し遅れの分を確保する
+#else
+#define FLIGHT_RECORDER_FRAMES ( 1 ) // 無効のときはRAMを使わない
+#endif
+#define FLIGHT_DRAIN_MAX ( 8 ) // flight_log_task()1回で出力する最大フレーム数
+
+// 窓を切り出すイベント(CONFIG_FLIGHT_RECORDER_EVENTSのビットはイベント番号-1)
+enum e_flight_event {
+    FLIGHT_EVENT_NONE = 0,
+    FLIGHT_EVENT_PRE_DIFFICULT, // RUN_PRE_DIFFICULTへの遷移
+    FLIGHT_EVENT_CRANK,         // RUN_R_CRANK、RUN_L_CRANKへの遷移
+    FLIGHT_EVENT_STOP,          // 完走以外の停止判断
+};
+
+// 1ms分のフレーム(値の並びとログファイルへ書き込む形式はflight_channelsの定義と一致させること)
+typedef struct {
+    u2 raw[LINE_SENSOR_RAW_NUM]; // ラインセンサーの生値 10bitADCの値
+    s2 line_error;               // センタラインからのズレ量
+    s2 steer_angle;              // ステアリング角度 LSB:0.1[deg]
+    s2 speed;                    // 速度 LSB:0.01[m/s]
+    s2 centrifugal_force;        // 遠心力 LSB:0.1[N]
+    s1 FL;                       // FLモーターのpwm指令値 LSB:1[%]
+    s1 FR;                       // FRモーターのpwm指令値 LSB:1[%]
+    s1 RL;                       // RLモーターのpwm指令値 LSB:1[%]
+    s1 RR;                       // RRモーターのpwm指令値 LSB:1[%]
+    s1 SV;                       // SVモーターのpwm指令値 LSB:1[%]
+    u1 line_digital;             // ラインセンサーのデジタル値
+    u1 run_mode;                 // 走行モード
+    u1 run_status;               // 走行ステータス
+} flight_frame_t;
+
+/***********************************/
+/* Class                           */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+void flight_log_sample();
+bool flight_log_trigger( enum e_flight_event event );
+void flight_log_task();
+bool flight_log_is_busy();
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern const log_channel_t flight_channels[];
+extern const u1 flight_channel_num;
@@ -37,6 +37,8 @@ int func( int argc, char** argv ) {
         shell.println( F( " 4:NO_SDCARD" ) );
         shell.println( F( " 5:MOTOR_FAIL" ) );
         shell.println( F( " 6:ERROR_OFF" ) );
+        shell.println( F( " 7:TICK_OVERRUN" ) );
+        shell.println( F( " 8:LOG_FINALIZING" ) );
     } else if ( strcmp( (const char*)argv[1], "set" ) == 0 ) {
         if ( argc != 4 ) {
             shell.println( F( "引数が足りません\n使い方→led set [led_name] [value]" ) );
@@ -52,9 +54,9 @@ int func( int argc, char** argv ) {
             indicator_set_board_led( (e_board_led_pattern)value );
         } else if ( strcmp( (const char*)argv[2], "neopixel" ) == 0 ) {
             u1 value = atoi( (const char*)argv[3] );
-            if ( value > 6 ) {
+            if ( value >= NEOPIXEL_LED_PATTERN_NUM ) {
                 shell.println( F( "valueが不正です" ) );
-                shell.println( F( "valueの範囲は0から6までです" ) );
+                shell.println( F( "valueの範囲は0から8までです" ) );
                 return -1;
             }
             indicator_set_neopixel_led( (e_neopixel_led_pattern)value );
@@ -4,6 +4,7 @@
 #include "defines.h"
 #include "nvm.h"
 #include "calibration.h"
+#include "line_sensor.h"
 
 namespace command_parameter {
 int help() {
@@ -49,8 +50,10 @@ int func( int argc, char** argv ) {
             return -1;
         }
         *parameters[parameter_No] = value;
+        ls.reload_calibration();
     } else if ( strcmp( (const char*)argv[1], "load" ) == 0 ) {
         nvm_load();
+        ls.reload_calibration();
     } else if ( strcmp( (const char*)argv[1], "save" ) == 0 ) {
         shell.println( F( "start save" ) );
         nvm_save();
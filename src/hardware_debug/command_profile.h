@@ -0,0 +1,95 @@
+#pragma once
+#include <Arduino.h>
+#include <SimpleSerialShell.h>
+#include "defines.h"
+#include "adc_scan.h"
+#include "profile.h"
+#include "tick_monitor.h"
+
+extern tick_monitor tick_mon;
+
+namespace command_profile {
+int help() {
+    shell.println( F( "===profコマンドについてのヘルプ===\n"
+                      "下記のサブコマンドがあります。\n"
+                      "    show\n"
+                      "         1msタスクの各処理の実行時間(最小/平均/最大)[us]と0.5ms枠に対する割合を表示します\n"
+                      "         例 : prof show\n"
+                      "    hist\n"
+                      "         各処理の実行時間のヒストグラム(2倍刻み、1行目は各ビンの下限[us])を表示します\n"
+                      "         例 : prof hist\n"
+                      "    tick\n"
+                      "         1ms周期タスクの遅れ(late)、抜け(missed)、処理時間超過(overrun)の回数と最悪ジッタ[us]、\n"
+                      "         A/D変換のスキャンが1msタスクまでに終わらなかった回数(adc timeout)を表示します\n"
+                      "         例 : prof tick\n"
+                      "    reset\n"
+                      "         計測結果をクリアします(failerはクリアされません)\n"
+                      "         例 : prof reset\n" ) );
+}
+
+int func( int argc, char** argv ) {
+    cycle_profiler p;
+
+    if ( strcmp( (const char*)argv[1], "show" ) == 0 ) {
+        shell.println( F( "stage : count, min, mean, max [us] (max/500us[%])" ) );
+        for ( u1 i = 0; i < PROFILE_STAGE_NUM; i++ ) {
+            profile_get( (e_profile_stage)i, &p );
+            shell.print( profile_stage_name( (e_profile_stage)i ) );
+            shell.print( " : " );
+            shell.print( p.get_count() );
+            shell.print( ", " );
+            shell.print( CYCLES_TO_US( p.get_min() ) );
+            shell.print( ", " );
+            shell.print( CYCLES_TO_US( p.get_mean() ) );
+            shell.print( ", " );
+            shell.print( CYCLES_TO_US( p.get_max() ) );
+            shell.print( " (" );
+            shell.print( CYCLES_TO_US( p.get_max() ) * 100 / 500 );
+            shell.println( "%)" );
+        }
+    } else if ( strcmp( (const char*)argv[1], "hist" ) == 0 ) {
+        shell.print( "[us] :" );
+        for ( u1 bin = 0; bin < CYCLE_PROFILER_HIST_BINS; bin++ ) {
+            shell.print( " " );
+            shell.print( CYCLES_TO_US( cycle_profiler::bin_floor( bin ) ) );
+        }
+        shell.println();
+        for ( u1 i = 0; i < PROFILE_STAGE_NUM; i++ ) {
+            profile_get( (e_profile_stage)i, &p );
+            shell.print( profile_stage_name( (e_profile_stage)i ) );
+            shell.print( " :" );
+            for ( u1 bin = 0; bin < CYCLE_PROFILER_HIST_BINS; bin++ ) {
+                shell.print( " " );
+                shell.print( p.get_hist( bin ) );
+            }
+            shell.println();
+        }
+    } else if ( strcmp( (const char*)argv[1], "tick" ) == 0 ) {
+        noInterrupts();
+        tick_monitor t = tick_mon;
+        interrupts();
+        shell.print( "ticks : " );
+        shell.println( t.get_ticks() );
+        shell.print( "late : " );
+        shell.println( t.get_late() );
+        shell.print( "missed : " );
+        shell.println( t.get_missed() );
+        shell.print( "overrun : " );
+        shell.println( t.get_overrun() );
+        shell.print( "worst jitter [us] : " );
+        shell.println( CYCLES_TO_US( t.get_worst_jitter() ) );
+        shell.print( "adc timeout : " );
+        shell.println( adc_scan_timeouts() );
+    } else if ( strcmp( (const char*)argv[1], "reset" ) == 0 ) {
+        profile_reset();
+        noInterrupts();
+        tick_mon.reset();
+        interrupts();
+    } else {
+        shell.println( F( "コマンドがありません" ) );
+        help();
+    }
+
+    return 0;
+}
+} // namespace command_profile
@@ -2,11 +2,19 @@
 #include <Arduino.h>
 #include <SimpleSerialShell.h>
 #include "defines.h"
+#include "features.h"
 #include "mcr_logger.h"
+#include "log_channels.h"
+#include "calibration.h"
+#include "nvm.h"
 
 extern mcr_logger logger;
 
 namespace command_sd {
+// sd benchで試すSPIクロック[MHz](SPIの分周で実際のクロックは指定以下の値になる)
+const u1 bench_clocks[] = { 4, 6, 8, 10, 12, 16, 20, 24 };
+#define BENCH_CLOCK_ARGS_MAX ( 8 ) // sd benchで指定できるクロックの数
+
 int help() {
     shell.println( F( "===sdコマンドについてのヘルプ===\n"
                       "下記のサブコマンドがあります。\n"
@@ -17,15 +25,27 @@ int help() {
                       "    ls\n"
                       "         ログファイルの一覧を表示します\n"
                       "    cat [ファイル名]\n"
-                      "         ログファイルの内容を表示します\n" ) );
+                      "         ログファイルの内容を表示します\n"
+                      "    get [ファイル名]\n"
+                      "         ログファイルをCRC32付きのフレームで転送します\n"
+                      "         scripts/mcr_log_download.pyから使います\n"
+                      "    stat\n"
+                      "         今回(ロギング中でなければ前回)のロギングのバッファの統計を表示します\n"
+                      "         捨てたバイト数とレコード数、最大使用量、カードのbusyで待たされた回数、間引きの状況です\n"
+                      "         例 : sd stat\n"
+                      "    bench [クロック[MHz]...]\n"
+                      "         SPIクロックとバッファサイズを変えて、書き込み速度、1回の書き込み(バッファサイズ分)の時間\n"
+                      "         (p50/p99/最大)、isBusy()の待ち時間を計ります。クロックごとに3回繰り返します\n"
+                      "         3回とも安定していたクロックのうち最も速いものをsd_clockに設定して保存します(約90秒かかります)\n"
+                      "         例 : sd bench\n"
+                      "              sd bench 8 12\n" ) );
 }
 
 int func( int argc, char** argv ) {
     if ( strcmp( (const char*)argv[1], "logstart" ) == 0 ) {
-        logger.make_log_file();
-        logger.write_header( "micros,run_mode,run_status,line_error,steer_angle,line_digital,FL,FR,RL,RR,SV,speed,battery_voltage,"
-                             "slope_status,speed_stable,speed_slope,speed_curve,speed_crossline,speed_L_lanechange,speed_R_lanechange,"
-                             "speed_L_crank,speed_R_crank,failer,acc_x,acc_y,acc_z,gyro_x,gyro_y,gyro_z" );
+        logger.make_log_file( CONFIG_LOG_BINARY );
+        logger.write_header( log_channels, log_channel_num );
+        log_channels_restart();
         logger.logging_begin();
     } else if ( strcmp( (const char*)argv[1], "logstop" ) == 0 ) {
         logger.logging_end();
@@ -37,6 +57,48 @@ int func( int argc, char** argv ) {
             return 1;
         }
         logger.cat( argv[2] );
+    } else if ( strcmp( (const char*)argv[1], "get" ) == 0 ) {
+        if ( argc < 3 ) {
+            shell.println( F( "ファイル名を指定してください" ) );
+            return 1;
+        }
+        logger.download( argv[2] );
+    } else if ( strcmp( (const char*)argv[1], "stat" ) == 0 ) {
+        const log_stats_t* stats = logger.get_stats();
+        shell.print( F( "dropped_bytes : " ) );
+        shell.println( stats->dropped_bytes );
+        shell.print( F( "dropped_records : " ) );
+        shell.println( stats->dropped_records );
+        shell.print( F( "high_water : " ) );
+        shell.print( stats->high_water );
+        shell.print( F( " / " ) );
+        shell.println( stats->capacity );
+        shell.print( F( "stalls : " ) );
+        shell.println( stats->stalls );
+        shell.print( F( "max_write_us : " ) );
+        shell.println( stats->max_write_us );
+        shell.print( F( "pressure_max : " ) );
+        shell.println( stats->pressure_max );
+        shell.print( F( "pressure_ms : " ) );
+        shell.println( stats->pressure_ms );
+        shell.print( F( "buffer_used : " ) );
+        shell.println( logger.get_buffer_used() );
+        shell.print( F( "pressure : " ) );
+        shell.println( logger.get_pressure() );
+    } else if ( strcmp( (const char*)argv[1], "bench" ) == 0 ) {
+        u1 clocks[BENCH_CLOCK_ARGS_MAX];
+        u1 num = 0;
+        for ( int i = 2; i < argc && num < BENCH_CLOCK_ARGS_MAX; i++ ) {
+            clocks[num++] = (u1)constrain( atoi( argv[i] ), prm_sd_clock_mhz.get_min(), prm_sd_clock_mhz.get_max() );
+        }
+        u1 best = num ? logger.bench( clocks, num ) : logger.bench( bench_clocks, array_size( bench_clocks ) );
+        if ( best != 0 ) {
+            prm_sd_clock_mhz = best;
+            nvm_save();
+            shell.print( F( "sd_clockを保存しました : " ) );
+            shell.println( prm_sd_clock_mhz.get() );
+        }
+        logger.init();
     } else {
         shell.println( F( "サブコマンドが間違っています" ) );
         help();
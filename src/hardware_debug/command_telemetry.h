@@ -0,0 +1,44 @@
+#pragma once
+#include <Arduino.h>
+#include <SimpleSerialShell.h>
+#include "defines.h"
+#include "telemetry.h"
+
+namespace command_telemetry {
+int help() {
+    shell.println( F( "===telemコマンドについてのヘルプ===\n"
+                      "下記のサブコマンドがあります。\n"
+                      "    on\n"
+                      "         テレメトリ(COBS+CRC32のバイナリパケット)の送信を開始します\n"
+                      "         scripts/mcr_telemetry.pyで表示、記録できます\n"
+                      "         例 : telem on\n"
+                      "    off\n"
+                      "         テレメトリの送信を停止します\n"
+                      "         例 : telem off\n"
+                      "    stat\n"
+                      "         送信したパケット数と、送信バッファに空きが無く捨てたパケット数を表示します\n"
+                      "         例 : telem stat\n" ) );
+}
+
+int func( int argc, char** argv ) {
+    if ( strcmp( (const char*)argv[1], "on" ) == 0 ) {
+        telemetry_set_enabled( true );
+    } else if ( strcmp( (const char*)argv[1], "off" ) == 0 ) {
+        telemetry_set_enabled( false );
+    } else if ( strcmp( (const char*)argv[1], "stat" ) == 0 ) {
+        shell.print( F( "enabled : " ) );
+        shell.println( telemetry_is_enabled() ? 1 : 0 );
+        shell.print( F( "sent : " ) );
+        shell.println( telemetry_get_sent() );
+        shell.print( F( "dropped : " ) );
+        shell.println( telemetry_get_dropped() );
+    } else {
+        shell.println( F( "サブコマンドが間違っています" ) );
+        help();
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace command_telemetry
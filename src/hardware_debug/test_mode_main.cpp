@@ -7,6 +7,7 @@
 // 2. パラメータの操作
 // 3. LEDの動作確認
 // 4. バッテリーの確認
+// 5. 1msタスクの処理時間の確認
 
 #include <Arduino.h>
 #include <SimpleSerialShell.h>
@@ -20,6 +21,8 @@
 #include "command_parameter.h"
 #include "command_buzzer.h"
 #include "command_sd.h"
+#include "command_profile.h"
+#include "command_telemetry.h"
 
 #if defined( F )
 #undef F
@@ -61,6 +64,8 @@ void test_mode_setup() {
     shell.addCommand( F( "led" ), command_led::func );
     shell.addCommand( F( "buzzer" ), command_buzzer::func );
     shell.addCommand( F( "sd" ), command_sd::func );
+    shell.addCommand( F( "prof" ), command_profile::func );
+    shell.addCommand( F( "telem" ), command_telemetry::func );
 }
 
 void test_mode_main_task() {
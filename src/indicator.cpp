@@ -20,14 +20,16 @@
 /* Local Variables                 */
 /***********************************/
 // ボードLED
-static enum e_neopixel_led_pattern neopixel_led_pattern = NEOPIXEL_LED_PATTERN_OFF;
+static enum e_board_led_pattern board_led_pattern = BOARD_LED_PATTERN_OFF;
 static PinStatus board_led_status = LOW; // 点滅時の状態を保持
 
 // NeoPixelLED
-static enum e_board_led_pattern board_led_pattern = BOARD_LED_PATTERN_OFF;
+static enum e_neopixel_led_pattern neopixel_led_pattern = NEOPIXEL_LED_PATTERN_OFF;       // 状態(1個目のLED)
+static enum e_neopixel_led_pattern neopixel_error_pattern = NEOPIXEL_LED_PATTERN_ERROR_OFF; // エラー状態(2個目のLED)
 static CRGB neopixel[NEOPIXEL_LEDS];
 static u4 one_shot_tmr = 0;
 static bool neopixel_blink_flag = LOW; // 点滅時の状態を保持
+static u1 progress_percent = 0;        // 進捗表示のパターンで表示する進捗 LSB:1[%]
 
 /***********************************/
 /* Global Variables                */
@@ -72,6 +74,23 @@ static void board_led_exec() {
     END_EVERY_MS
 }
 
+/*
+ * 概要：NeoPixelLEDのパターンがエラー状態か判断する
+ * 引数：pattern パターン
+ * 戻り値：true:エラー状態(2個目のLEDに表示する)
+ */
+static bool neopixel_is_error_pattern( enum e_neopixel_led_pattern pattern ) {
+    switch ( pattern ) {
+    case NEOPIXEL_LED_PATTERN_NO_SDCARD:
+    case NEOPIXEL_LED_PATTERN_MOTOR_FAIL:
+    case NEOPIXEL_LED_PATTERN_ERROR_OFF:
+    case NEOPIXEL_LED_PATTERN_TICK_OVERRUN:
+        return true;
+    default:
+        return false;
+    }
+}
+
 static void neopixel_exec() {
     static u1 hue = 0;
     static uint32_t prev_time = 0;
@@ -92,6 +111,16 @@ static void neopixel_exec() {
                 neopixel_led_pattern = NEOPIXEL_LED_PATTERN_OFF;
             }
             break;
+        case NEOPIXEL_LED_PATTERN_LOG_FINALIZING:
+            neopixel[0] = CHSV( 128, 255, 15 + progress_percent * 2 );
+            break;
+        default:
+        case NEOPIXEL_LED_PATTERN_OFF:
+            neopixel[0] = CHSV( 0, 0, 0 );
+            break;
+        }
+
+        switch ( neopixel_error_pattern ) {
         case NEOPIXEL_LED_PATTERN_NO_SDCARD:
             if ( current_time - prev_time > 500 ) {
                 neopixel[1] = neopixel_blink_flag ? CHSV( 60, 255, 63 ) : CHSV( 0, 0, 0 );
@@ -102,12 +131,16 @@ static void neopixel_exec() {
         case NEOPIXEL_LED_PATTERN_MOTOR_FAIL:
             neopixel[1] = CHSV( 0, 255, 63 );
             break;
-        case NEOPIXEL_LED_PATTERN_ERROR_OFF:
-            neopixel[1] = CHSV( 0, 0, 0 );
+        case NEOPIXEL_LED_PATTERN_TICK_OVERRUN:
+            if ( current_time - prev_time > 100 ) {
+                neopixel[1] = neopixel_blink_flag ? CHSV( 200, 255, 63 ) : CHSV( 0, 0, 0 );
+                neopixel_blink_flag = !neopixel_blink_flag;
+                prev_time = current_time;
+            }
             break;
         default:
-        case NEOPIXEL_LED_PATTERN_OFF:
-            neopixel[0] = CHSV( 0, 0, 0 );
+        case NEOPIXEL_LED_PATTERN_ERROR_OFF:
+            neopixel[1] = CHSV( 0, 0, 0 );
             break;
         }
         FastLED.show();
@@ -145,8 +178,29 @@ void indicator_set_board_led( enum e_board_led_pattern pattern ) {
     }
 }
 
+/*
+ * 概要：進捗を表示するパターンの進捗を設定する
+ * 引数：percent 進捗 LSB:1[%] 0～100
+ * 戻り値：なし
+ * 詳細：NEOPIXEL_LED_PATTERN_LOG_FINALIZINGの明るさに反映される
+ */
+void indicator_set_progress( u1 percent ) {
+    progress_percent = percent > 100 ? 100 : percent;
+}
+
+/*
+ * 概要：NeoPixelLEDのパターンを設定する
+ * 引数：pattern パターン
+ * 戻り値：なし
+ * 詳細：状態のパターンは1個目、エラー状態のパターンは2個目のLEDに表示し、互いに上書きしない
+ */
 void indicator_set_neopixel_led( enum e_neopixel_led_pattern pattern ) {
-    if ( NEOPIXEL_LED_PATTERN_OFF <= pattern && pattern <= NEOPIXEL_LED_PATTERN_MOTOR_FAIL ) {
+    if ( pattern < NEOPIXEL_LED_PATTERN_OFF || NEOPIXEL_LED_PATTERN_NUM <= pattern ) {
+        return;
+    }
+    if ( neopixel_is_error_pattern( pattern ) ) {
+        neopixel_error_pattern = pattern;
+    } else {
         neopixel_led_pattern = pattern;
         one_shot_tmr = millis();
     }
@@ -2,6 +2,7 @@
  * 概要：マイコンボードの単色LED及び、ドライブ基板のNeoPixelLEDを制御する
  */
 #pragma once
+#include "defines.h"
 
 /******************************************************************/
 /* Definitions                                                    */
@@ -22,10 +23,17 @@ enum e_neopixel_led_pattern {
     NEOPIXEL_LED_PATTERN_SAVING,             // 青点灯
     NEOPIXEL_LED_PATTERN_DIFFICULT_ONE_SHOT, // 0.5秒間緑点灯
 
-    // エラー状態
-    NEOPIXEL_LED_PATTERN_NO_SDCARD,  // 黄点滅
-    NEOPIXEL_LED_PATTERN_MOTOR_FAIL, // 赤点灯
-    NEOPIXEL_LED_PATTERN_ERROR_OFF,  // エラーも消灯
+    // エラー状態(状態とは別のLEDに表示する)
+    NEOPIXEL_LED_PATTERN_NO_SDCARD,    // 黄点滅
+    NEOPIXEL_LED_PATTERN_MOTOR_FAIL,   // 赤点灯
+    NEOPIXEL_LED_PATTERN_ERROR_OFF,    // エラーも消灯
+    NEOPIXEL_LED_PATTERN_TICK_OVERRUN, // 紫点滅
+
+    // 状態
+    NEOPIXEL_LED_PATTERN_LOG_FINALIZING, // 水色点灯 進捗に合わせて明るくなる
+
+    // 番号はledコマンドで使うため、追加は末尾に行うこと
+    NEOPIXEL_LED_PATTERN_NUM,
 };
 
 /***********************************/
@@ -39,6 +47,7 @@ void indicator_init();
 void indicator_exec();
 void indicator_set_board_led( enum e_board_led_pattern pattern );
 void indicator_set_neopixel_led( enum e_neopixel_led_pattern pattern );
+void indicator_set_progress( u1 percent );
 
 /***********************************/
 /* Global Variables                */
@@ -0,0 +1,233 @@
+/*
+ * 概要：インプットレコーダー 制御が読んだ全ての入力と出力を1msごとにログファイルへ記録する
+ * 記録をホスト(host/replay)で再生し、制御コードの出力がビット単位で一致するか確認するために使う
+ */
+#include <Arduino.h>
+#include <stddef.h>
+#include "input_log.h"
+#include "log_channels.h"
+#include "sensors.h"
+#include "motor_control.h"
+#include "spsc_queue.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static input_frame_t input_staging; // 走行制御に渡したフレーム(input_channelsの値の格納場所)
+static spsc_queue<input_frame_t, INPUT_QUEUE_DEPTH> input_queue;
+static volatile u2 tick_seq = 0;                       // 次の1msタスクの通し番号(1msタスクのみ更新)
+static u4 control_ms = 0;                              // 走行制御を開始したmillis() LSB:1[ms]
+static input_frame_t prelude[INPUT_PRELUDE_FRAMES];    // ロギング開始前の直近のフレーム(リングバッファ)
+static u1 prelude_num = 0;                             // preludeに入っているフレームの数
+static u1 prelude_idx = 0;                             // preludeに次に書き込む位置
+static bool logging_old = false;                       // 前回のフレームを出力したときにロギング中だったか
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern u1 run_mode;
+extern u1 run_status;
+extern mcr_logger logger;
+
+/*
+ * インプットレコーダーのフレームの定義(input_frame_tのメンバ順)
+ * ログファイルのスキーマヘッダのINPUTセクションになる。記録周期は全て1ms
+ */
+const log_channel_t input_channels[] = {
+    LOG_CHANNEL( "time_ms", input_staging.time_ms, "1ms", 1 ),
+    LOG_CHANNEL( "seq", input_staging.seq, "-", 1 ),
+    LOG_CHANNEL( "encoder", input_staging.encoder, "-", 1 ),
+    LOG_CHANNEL( "angle", input_staging.angle, "-", 1 ),
+#if defined( CONFIG_LINE_SENSOR_STEALTH )
+    LOG_CHANNEL( "AR3", input_staging.raw[0], "-", 1 ),
+    LOG_CHANNEL( "AR2", input_staging.raw[1], "-", 1 ),
+    LOG_CHANNEL( "AR1", input_staging.raw[2], "-", 1 ),
+    LOG_CHANNEL( "AC", input_staging.raw[3], "-", 1 ),
+    LOG_CHANNEL( "AL1", input_staging.raw[4], "-", 1 ),
+    LOG_CHANNEL( "AL2", input_staging.raw[5], "-", 1 ),
+    LOG_CHANNEL( "AL3", input_staging.raw[6], "-", 1 ),
+#else
+    LOG_CHANNEL( "line_left_raw", input_staging.raw[0], "-", 1 ),
+    LOG_CHANNEL( "line_right_raw", input_staging.raw[1], "-", 1 ),
+#endif
+    LOG_CHANNEL( "line_error", input_staging.line_error, "-", 1 ),
+    LOG_CHANNEL( "steer_angle", input_staging.steer_angle, "0.1deg", 1 ),
+    LOG_CHANNEL( "speed", input_staging.speed, "0.01m/s", 1 ),
+    LOG_CHANNEL( "battery_raw", input_staging.battery_raw, "-", 1 ),
+    LOG_CHANNEL( "digital", input_staging.digital, "bit", 1 ),
+    LOG_CHANNEL( "gate", input_staging.gate, "-", 1 ),
+    LOG_CHANNEL( "dip_switch", input_staging.dip_switch, "bit", 1 ),
+    LOG_CHANNEL( "button", input_staging.button, "-", 1 ),
+    LOG_CHANNEL( "flags", input_staging.flags, "bit", 1 ),
+    LOG_CHANNEL( "loop_dt_ms", input_staging.loop_dt_ms, "1ms", 1 ),
+    LOG_CHANNEL( "SV", input_staging.SV, "1%", 1 ),
+    LOG_CHANNEL( "FL", input_staging.FL, "1%", 1 ),
+    LOG_CHANNEL( "FR", input_staging.FR, "1%", 1 ),
+    LOG_CHANNEL( "RL", input_staging.RL, "1%", 1 ),
+    LOG_CHANNEL( "RR", input_staging.RR, "1%", 1 ),
+    LOG_CHANNEL( "run_mode", input_staging.run_mode, "-", 1 ),
+    LOG_CHANNEL( "run_status", input_staging.run_status, "-", 1 ),
+};
+const u1 input_channel_num = array_size( input_channels );
+
+static_assert( offsetof( input_frame_t, run_status ) + 1 == INPUT_FRAME_SIZE, "input_frame_tに詰め物が入っています" );
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：s4の値をs2の範囲に丸める
+ * 引数：value 値
+ * 戻り値：丸めた値
+ */
+static s2 clamp_s2( s4 value ) {
+    return (s2)constrain( value, -32768L, 32767L );
+}
+
+/*
+ * 概要：フレームをロガーへ渡す
+ * 引数：frame フレーム
+ * 戻り値：なし
+ * 詳細：ロギング中でなければ直近INPUT_PRELUDE_FRAMES個を残しておき、ロギングを開始したら
+ *      INPUT_FLAG_PRELUDEを付けて先に書き込む(再生時に移動平均やボタンの前回値を作るため)
+ */
+static void emit( input_frame_t* frame ) {
+    bool logging = logger.is_logging();
+
+    if ( !logging ) {
+        prelude[prelude_idx] = *frame;
+        prelude_idx = ( prelude_idx + 1 ) % INPUT_PRELUDE_FRAMES;
+        if ( prelude_num < INPUT_PRELUDE_FRAMES ) {
+            prelude_num++;
+        }
+        logging_old = false;
+        return;
+    }
+    if ( !logging_old ) {
+        u1 idx = ( prelude_idx + INPUT_PRELUDE_FRAMES - prelude_num ) % INPUT_PRELUDE_FRAMES;
+        for ( u1 i = 0; i < prelude_num; i++ ) {
+            input_frame_t* p = &prelude[( idx + i ) % INPUT_PRELUDE_FRAMES];
+            p->flags |= INPUT_FLAG_PRELUDE;
+            logger.put_input_frame( p, INPUT_FRAME_SIZE );
+        }
+        prelude_num = 0;
+        logging_old = true;
+    }
+    logger.put_input_frame( frame, INPUT_FRAME_SIZE );
+}
+
+/***********************************/
+/* Class implementions             */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：1msタスクの入力と出力をフレームに詰めてloop()へ渡す
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：1msタスクからsensors_update_interrupt()、servo_control()、motor_control()の後に毎周期呼ぶこと
+ *      キューが満杯の場合は捨てる(通し番号は進めるため、再生時に抜けとしてわかる)
+ */
+void input_log_sample() {
+    if ( !CONFIG_INPUT_RECORDER ) {
+        return;
+    }
+    input_frame_t frame;
+
+    memset( &frame, 0, sizeof( frame ) );
+    frame.time_ms = millis();
+    frame.seq = tick_seq;
+    tick_seq = tick_seq + 1;
+    frame.encoder = (s2)encoder_pulse_1ms;
+    frame.angle = steer_angle_raw;
+    ls.get_raw( frame.raw, LINE_SENSOR_RAW_NUM );
+    frame.line_error = clamp_s2( ls.line_error );
+    frame.steer_angle = steer_angle;
+    frame.speed = clamp_s2( speed );
+    frame.digital = ls.line_digital;
+    frame.gate = ls.get_gate();
+    frame.SV = SV;
+    input_queue.push( frame );
+}
+
+/*
+ * 概要：走行制御の前に、1msタスクが渡したフレームを受け取る
+ * 引数：なし
+ * 戻り値：走行制御を実行する:true 前回の走行制御の後に1msタスクが実行されていない:false
+ * 詳細：loop()から走行制御の前に呼び、trueのときは走行制御の後にinput_log_control_end()を呼ぶこと
+ *      無効のときは常にtrueを返す(走行制御を毎回実行する)
+ *      走行制御が間に合わず複数のフレームがたまっていた場合、最後以外は走行制御を実行しなかったフレームとして出力する
+ */
+bool input_log_control_begin() {
+    if ( !CONFIG_INPUT_RECORDER ) {
+        return true;
+    }
+    input_frame_t frame;
+    bool received = false;
+
+    while ( input_queue.pop( &frame ) ) {
+        if ( received ) {
+            emit( &input_staging );
+        }
+        // 走行制御の値は前のフレームのまま引き継ぐ
+        frame.battery_raw = input_staging.battery_raw;
+        frame.dip_switch = input_staging.dip_switch;
+        frame.button = input_staging.button;
+        frame.FL = input_staging.FL;
+        frame.FR = input_staging.FR;
+        frame.RL = input_staging.RL;
+        frame.RR = input_staging.RR;
+        frame.run_mode = input_staging.run_mode;
+        frame.run_status = input_staging.run_status;
+        input_staging = frame;
+        received = true;
+    }
+    if ( !received ) {
+        return false;
+    }
+    control_ms = millis();
+    input_staging.loop_dt_ms = (u1)min( control_ms - input_staging.time_ms, (u4)UINT8_MAX );
+    return true;
+}
+
+/*
+ * 概要：走行制御の後に、走行制御の入力と出力をフレームに詰めて出力する
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：loop()から走行制御の後に呼ぶこと
+ *      走行制御の実行中に1msタスクが割り込んだ場合と、millis()が進んだ場合はフラグを付ける
+ */
+void input_log_control_end() {
+    if ( !CONFIG_INPUT_RECORDER ) {
+        return;
+    }
+    input_staging.flags |= INPUT_FLAG_LOOP;
+    if ( tick_seq != (u2)( input_staging.seq + 1 ) ) {
+        input_staging.flags |= INPUT_FLAG_PREEMPTED;
+    }
+    if ( millis() != control_ms ) {
+        input_staging.flags |= INPUT_FLAG_CLOCK;
+    }
+    input_staging.battery_raw = (u2)battery_voltage_raw;
+    input_staging.dip_switch = dip_switch.byte;
+    input_staging.button = button_start.getState();
+    input_staging.FL = FL;
+    input_staging.FR = FR;
+    input_staging.RL = RL;
+    input_staging.RR = RR;
+    input_staging.run_mode = run_mode;
+    input_staging.run_status = run_status;
+    emit( &input_staging );
+}
@@ -0,0 +1,84 @@
+/*
+ * 概要：インプットレコーダー 制御が読んだ全ての入力と出力を1msごとにログファイルへ記録する
+ * 記録をホスト(host/replay)で再生し、制御コードの出力がビット単位で一致するか確認するために使う
+ */
+#pragma once
+#include <Arduino.h>
+#include "defines.h"
+#include "features.h"
+#include "line_sensor.h"
+#include "mcr_logger.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+// 走行制御の実行周期を変えるため、csv形式のログでは使えないようにする(このヘッダはinput_log.cppと_main.cppの両方で読み込む)
+#if CONFIG_INPUT_RECORDER && !CONFIG_LOG_BINARY
+#error "インプットレコーダー(CONFIG_INPUT_RECORDER)はバイナリ形式のログ(CONFIG_LOG_BINARY)でのみ使用できます"
+#endif
+
+#if CONFIG_INPUT_RECORDER
+#define INPUT_QUEUE_DEPTH ( 16 )   // 1msタスクからloop()へ渡すフレームの数(2のべき乗)
+#define INPUT_PRELUDE_FRAMES ( 4 ) // ロギング開始前のフレームを残す数(再生時にフィルタとボタンの状態を作るため)
+#else
+#define INPUT_QUEUE_DEPTH ( 1 ) // 無効のときはRAMを使わない
+#define INPUT_PRELUDE_FRAMES ( 1 )
+#endif
+
+// フレームのフラグ
+#define INPUT_FLAG_LOOP ( 0x01 )      // このフレームの1msタスクの後にloop()の走行制御を実行した
+#define INPUT_FLAG_PREEMPTED ( 0x02 ) // 走行制御の実行中に次の1msタスクが割り込んだ(再生では順序を再現できない)
+#define INPUT_FLAG_CLOCK ( 0x04 )     // 走行制御の実行中にmillis()が進んだ(再生では開始時の時刻に固定する)
+#define INPUT_FLAG_PRELUDE ( 0x08 )   // ロギング開始前のフレーム(再生では入力にのみ使い、出力を比較しない)
+
+/*
+ * 1ms分のフレーム(値の並びとログファイルへ書き込む形式はinput_channelsの定義と一致させること)
+ * 1msタスクの入力と出力、その後に実行した走行制御の入力と出力を1つにまとめる
+ * 走行制御を実行しなかったフレーム(INPUT_FLAG_LOOPが無い)のloop()の値は前のフレームのまま
+ */
+typedef struct {
+    u4 time_ms;                  // 1msタスクのmillis() LSB:1[ms]
+    u2 seq;                      // 1msタスクの通し番号(抜けたフレームがわかる)
+    s2 encoder;                  // エンコーダのカウント(GPT6) LSB:1[-]
+    s2 angle;                    // ステアリング角度のエンコーダカウント(GPT7) LSB:1[-]
+    u2 raw[LINE_SENSOR_RAW_NUM]; // ラインセンサーの生値 10bitADCの値
+    s2 line_error;               // センタラインからのズレ量 (1msタスクの出力)
+    s2 steer_angle;              // ステアリング角度 LSB:0.1[deg] (1msタスクの出力)
+    s2 speed;                    // 速度 LSB:0.01[m/s] (1msタスクの出力)
+    u2 battery_raw;              // バッテリー電圧の生値 14bitADCの値 (loop()の入力)
+    u1 digital;                  // ラインセンサーのデジタル値
+    u1 gate;                     // ゲートセンサ
+    u1 dip_switch;               // DIPスイッチのデジタル値 (loop()の入力)
+    u1 button;                   // スタートボタンの状態 0:押下 1:開放 (loop()の入力)
+    u1 flags;                    // INPUT_FLAG_xxx
+    u1 loop_dt_ms;               // 走行制御を開始したmillis()と1msタスクのmillis()の差 LSB:1[ms]
+    s1 SV;                       // SVモーターのpwm指令値 LSB:1[%] (1msタスクの出力)
+    s1 FL;                       // FLモーターのpwm指令値 LSB:1[%] (loop()の出力)
+    s1 FR;                       // FRモーターのpwm指令値 LSB:1[%] (loop()の出力)
+    s1 RL;                       // RLモーターのpwm指令値 LSB:1[%] (loop()の出力)
+    s1 RR;                       // RRモーターのpwm指令値 LSB:1[%] (loop()の出力)
+    u1 run_mode;                 // 走行モード (loop()の出力)
+    u1 run_status;               // 走行ステータス (loop()の出力)
+} input_frame_t;
+
+#define INPUT_FRAME_SIZE ( LINE_SENSOR_RAW_NUM * 2 + 31 ) // ログファイルへ書き込むバイト数(末尾の詰め物を含まない)
+
+/***********************************/
+/* Class                           */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+void input_log_sample();
+bool input_log_control_begin();
+void input_log_control_end();
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern const log_channel_t input_channels[];
+extern const u1 input_channel_num;
@@ -6,6 +6,7 @@
 #include <Arduino.h>
 #include "defines.h"
 #include "line_sensor.h"
+#include "adc_scan.h"
 #include "calibration.h"
 #include "features.h"
 
@@ -56,7 +57,8 @@ class line_sensor_d5a2 : public line_sensor {
         pinMode( PIN_LINE_ANALOG_RIGHT, INPUT );
         pinMode( PIN_LINE_DIGITAL_2, INPUT );
         pinMode( PIN_LINE_DIGITAL_1, INPUT );
-        analogReadResolution( 10 );
+        adc_scan_add( PIN_LINE_ANALOG_LEFT, true );
+        adc_scan_add( PIN_LINE_ANALOG_RIGHT, true );
     }
 
     /***********************************/
@@ -78,8 +80,8 @@ class line_sensor_d5a2 : public line_sensor {
 
         u1 temp_gate = !my_digital_read( PIN_LINE_DIGITAL_GATE );
 
-        line_left_raw = analogRead( PIN_LINE_ANALOG_LEFT );
-        line_right_raw = analogRead( PIN_LINE_ANALOG_RIGHT );
+        line_left_raw = adc_scan_read( PIN_LINE_ANALOG_LEFT );
+        line_right_raw = adc_scan_read( PIN_LINE_ANALOG_RIGHT );
 
         noInterrupts();
         line_digital = temp_line_digital;
@@ -122,6 +124,24 @@ class line_sensor_d5a2 : public line_sensor {
         interrupts();
     }
 
+    /***********************************/
+    /* 生値の取得                       */
+    /***********************************/
+    /*
+     * 概要：アナログセンサーの生値を取得する
+     * 引数：raw 生値の格納先 max 格納先の要素数
+     * 戻り値：格納した生値の数
+     * 詳細：左、右の順に10bitADCの値を格納する
+     */
+    u1 get_raw( u2* raw, u1 max ) override {
+        const u4 values[] = { line_left_raw, line_right_raw };
+        u1 n = 0;
+        for ( ; n < max && n < 2; n++ ) {
+            raw[n] = values[n];
+        }
+        return n;
+    }
+
     /***********************************/
     /* ライン状態判断                   */
     /***********************************/
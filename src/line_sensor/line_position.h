@@ -0,0 +1,206 @@
+/*
+ * 概要：横一列に並んだアナログセンサーの値から、線の位置をセンサーの間隔より細かく求める
+ * ピークのセンサーと両隣の3点に、頂点の両側が同じ傾きの三角形と、ガウス関数(対数をとった値の放物線)を当てはめ、2つの頂点の平均を線の位置とする
+ * 位置の信頼度として、線の幅(ピークの半分以上の範囲)とコントラスト(ピークと最も暗いセンサーの差)も求める
+ * 計算は全て整数で行う
+ */
+
+#pragma once
+#include <stdlib.h>
+#include "defines.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define LINE_POSITION_PITCH ( 1024 )   // 隣のセンサーとの位置の差
+#define LINE_POSITION_PEAK_SHIFT ( 1 ) // 山とする値の下限(最大値を右にこのビット数シフトした値)
+#define LINE_POSITION_LOG2_Q ( 10 )    // line_position_log2()の小数部のビット数
+
+// 線の位置の推定結果
+typedef struct {
+    s4 position; // 線の位置 中央のセンサー:0 先頭(0番)のセンサーの側が正 LSB:1/LINE_POSITION_PITCH[センサーの間隔]
+    s4 width;    // 線の幅(ピークの半分以上の範囲) LSB:1/LINE_POSITION_PITCH[センサーの間隔]
+    s4 contrast; // ピークと最も暗いセンサーの差 LSB:センサーの値
+    u1 peak;     // ピークのセンサーの番号
+} line_position_t;
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+// log2( 1 + i / 16 )をLINE_POSITION_LOG2_Qの固定小数点にした値
+static const u2 line_position_log2_table[17] = { 0, 90, 174, 254, 330, 402, 470, 536, 599, 659, 717, 773, 827, 879, 929, 977, 1024 };
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：2を底とする対数を求める
+ * 引数：value 値(1以上)
+ * 戻り値：log2( value ) LSB:1/(1<<LINE_POSITION_LOG2_Q)
+ * 詳細：整数部は最上位のビットの位置、小数部は次の4ビットで表を引いて残りのビットで直線補間する(誤差は0.001程度)
+ */
+static inline s4 line_position_log2( s4 value ) {
+    s4 msb = 31 - __builtin_clz( (u4)value );
+    u4 mantissa = ( msb <= 15 ) ? ( (u4)value << ( 15 - msb ) ) : ( (u4)value >> ( msb - 15 ) ); // 1.15の固定小数点
+    u1 index = ( mantissa >> 11 ) & 0x0F;
+    s4 fraction = mantissa & 0x7FF;
+    s4 low = line_position_log2_table[index];
+    s4 high = line_position_log2_table[index + 1];
+    return ( msb << LINE_POSITION_LOG2_Q ) + low + ( ( ( high - low ) * fraction ) >> 11 );
+}
+
+/*
+ * 概要：センサーの番号の位置を求める
+ * 引数：index センサーの番号
+ * 戻り値：位置 LSB:1/LINE_POSITION_PITCH[センサーの間隔]
+ */
+template <u1 N>
+static inline s4 line_position_of( u1 index ) {
+    return ( ( N - 1 ) * LINE_POSITION_PITCH ) / 2 - (s4)index * LINE_POSITION_PITCH;
+}
+
+/*
+ * 概要：センサーが山(線の中心に近いセンサー)か判断する
+ * 引数：values センサーの値(0以上) index センサーの番号 lower 山とする値の下限
+ * 戻り値：true:山
+ * 詳細：先頭側の隣より大きく、後ろ側の隣以上で、lower以上かつ0より大きいものを山とする(平らな山は先頭側の1個)
+ */
+template <u1 N>
+static inline bool line_position_is_peak( const s4 ( &values )[N], u1 index, s4 lower ) {
+    bool front = ( index == 0 ) || ( values[index] > values[index - 1] );
+    bool back = ( index == N - 1 ) || ( values[index] >= values[index + 1] );
+    return front && back && values[index] >= lower && values[index] > 0;
+}
+
+/*
+ * 概要：山の下限を求める
+ * 引数：values センサーの値(0以上)
+ * 戻り値：山とする値の下限
+ * 詳細：最大値の半分(LINE_POSITION_PEAK_SHIFT)未満の小さな山はノイズとして数えない
+ */
+template <u1 N>
+static inline s4 line_position_floor( const s4 ( &values )[N] ) {
+    s4 brightest = 0;
+    for ( u1 i = 0; i < N; i++ ) {
+        brightest = ( values[i] > brightest ) ? values[i] : brightest;
+    }
+    return brightest >> LINE_POSITION_PEAK_SHIFT;
+}
+
+/*
+ * 概要：山の数を数える
+ * 引数：values センサーの値(0以上)
+ * 戻り値：山の数
+ */
+template <u1 N>
+u1 line_position_count( const s4 ( &values )[N] ) {
+    s4 lower = line_position_floor( values );
+    u1 count = 0;
+    for ( u1 i = 0; i < N; i++ ) {
+        count += line_position_is_peak( values, i, lower ) ? 1 : 0;
+    }
+    return count;
+}
+
+/*
+ * 概要：線の位置を求めるピークのセンサーを選ぶ
+ * 引数：values センサーの値(0以上) hint 前回の線の位置
+ * 戻り値：ピークのセンサーの番号 山が無い場合:0
+ * 詳細：山のうち、hintに最も近いものを選ぶ
+ *      山が1つならそのセンサーになる。線が2本見えるときに前回の線を追い続けるために使う
+ */
+template <u1 N>
+u1 line_position_peak( const s4 ( &values )[N], s4 hint ) {
+    s4 lower = line_position_floor( values );
+    u1 peak = 0;
+    u4 distance_min = UINT32_MAX;
+    for ( u1 i = 0; i < N; i++ ) {
+        if ( !line_position_is_peak( values, i, lower ) ) {
+            continue;
+        }
+        u4 distance = abs( line_position_of<N>( i ) - hint );
+        if ( distance < distance_min ) {
+            peak = i;
+            distance_min = distance;
+        }
+    }
+    return peak;
+}
+
+/*
+ * 概要：ピークの周りから線の位置、幅、コントラストを求める
+ * 引数：values センサーの値(0以上) peak ピークのセンサーの番号(line_position_peak()で求めたもの)
+ * 戻り値：推定結果
+ * 詳細：位置はピークと両隣の値に当てはめた三角形の頂点とガウス関数の頂点の平均
+ *      三角形は暗い方の隣が斜面の下側にあるとして傾きを求め、明るい方の隣へずらす。ガウス関数は3点の対数に放物線を当てはめる
+ *      センサーの見る範囲と線の幅が同じくらいなら応答は三角形に、センサーの感度の裾が広ければガウス関数に近くなる
+ *      どちらか一方だけでは他方の応答で中央付近に逆向きの偏りが出るため、平均して打ち消す
+ *      隣の値が0(端のセンサーの外側を含む)で対数をとれない場合は三角形の頂点だけを使う
+ *      端のセンサーの外側は値が0(黒)として扱い、頂点はピークから±0.5センサー間隔までに制限する
+ *      幅はピークの半分の値になる位置を両側で直線補間して求める。端のセンサーまで半分を下回らない場合は端までの幅になる
+ */
+template <u1 N>
+line_position_t line_position_estimate( const s4 ( &values )[N], u1 peak ) {
+    line_position_t result;
+    s4 center = values[peak];
+    s4 darkest = center;
+    for ( u1 i = 0; i < N; i++ ) {
+        darkest = ( values[i] < darkest ) ? values[i] : darkest;
+    }
+
+    // 三角形の補間
+    s4 front_value = ( peak > 0 ) ? values[peak - 1] : 0;
+    s4 back_value = ( peak < N - 1 ) ? values[peak + 1] : 0;
+    s4 slope = 2 * ( center - ( ( front_value < back_value ) ? front_value : back_value ) ); // ピークなので0以上
+    // ピークのセンサーからの頂点のずれ 後ろ(番号が大きい側)が正
+    s4 offset = 0;
+    if ( slope > 0 ) {
+        offset = ( ( back_value - front_value ) * LINE_POSITION_PITCH ) / slope;
+        offset = ( offset < -LINE_POSITION_PITCH / 2 ) ? -LINE_POSITION_PITCH / 2 : offset;
+        offset = ( offset > LINE_POSITION_PITCH / 2 ) ? LINE_POSITION_PITCH / 2 : offset;
+    }
+
+    // ガウス関数の補間
+    if ( front_value > 0 && back_value > 0 ) {
+        s4 log_center = line_position_log2( center );
+        s4 log_front = line_position_log2( front_value );
+        s4 log_back = line_position_log2( back_value );
+        s4 curvature = 2 * ( 2 * log_center - log_front - log_back );
+        s4 gauss_offset = 0;
+        if ( curvature > 0 ) {
+            gauss_offset = ( ( log_back - log_front ) * LINE_POSITION_PITCH ) / curvature;
+            gauss_offset = ( gauss_offset < -LINE_POSITION_PITCH / 2 ) ? -LINE_POSITION_PITCH / 2 : gauss_offset;
+            gauss_offset = ( gauss_offset > LINE_POSITION_PITCH / 2 ) ? LINE_POSITION_PITCH / 2 : gauss_offset;
+        }
+        offset = ( offset + gauss_offset ) / 2;
+    }
+    result.position = line_position_of<N>( peak ) - offset;
+
+    // 幅
+    s4 half = center / 2;
+    s4 front = 0; // ピークから先頭側の半分の位置までの距離
+    u1 i = peak;
+    while ( i > 0 && values[i - 1] >= half ) {
+        i--;
+        front += LINE_POSITION_PITCH;
+    }
+    if ( i > 0 && values[i] > values[i - 1] ) {
+        front += ( ( values[i] - half ) * LINE_POSITION_PITCH ) / ( values[i] - values[i - 1] );
+    }
+    s4 back = 0; // ピークから後ろ側の半分の位置までの距離
+    i = peak;
+    while ( i < N - 1 && values[i + 1] >= half ) {
+        i++;
+        back += LINE_POSITION_PITCH;
+    }
+    if ( i < N - 1 && values[i] > values[i + 1] ) {
+        back += ( ( values[i] - half ) * LINE_POSITION_PITCH ) / ( values[i] - values[i + 1] );
+    }
+    result.width = front + back;
+    result.contrast = center - darkest;
+    result.peak = peak;
+    return result;
+}
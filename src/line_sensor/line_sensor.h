@@ -12,6 +12,11 @@
 /***********************************/
 /* Global definitions              */
 /***********************************/
+#if defined( CONFIG_LINE_SENSOR_STEALTH )
+#define LINE_SENSOR_RAW_NUM ( 7 ) // get_raw()で取得できるアナログセンサー生値の数
+#else
+#define LINE_SENSOR_RAW_NUM ( 2 )
+#endif
 
 /***********************************/
 /* Class                           */
@@ -27,11 +32,25 @@ class line_sensor {
     /***********************************/
     virtual void init() = 0;
 
+    /***********************************/
+    /* 補正値の反映                     */
+    /***********************************/
+    /*
+     * 概要：キャリブレーションのパラメータを変えたときに呼び、補正に反映する
+     * 詳細：毎周期パラメータを読まないセンサーだけがオーバーライドする
+     */
+    virtual void reload_calibration() {};
+
     /***********************************/
     /* センサ値の更新                   */
     /***********************************/
     virtual void update() = 0;
 
+    /***********************************/
+    /* 生値の取得                       */
+    /***********************************/
+    virtual u1 get_raw( u2* raw, u1 max ) = 0;
+
     /***********************************/
     /* ライン状態判断                   */
     /***********************************/
@@ -0,0 +1,136 @@
+/*
+ * 概要：N個のアナログラインセンサーの値をまとめて補正する
+ * センサーごとのオブジェクトではなく、値の種類ごとにN要素の配列で持つ(structure of arrays)
+ * 黒と白の補正値(パラメータ)は、変わったとき(refresh()を呼んだとき)だけQ16の傾きとオフセットにしておき、
+ * 毎周期の補正はパラメータを読まず、除算と分岐のない1つのループで行う
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "defines.h"
+#include "adc_scan.h"
+#include "calibration.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define SENSOR_ARRAY_OUT_MAX ( 1023 ) // 補正後の値の最大値(黒:0 白:SENSOR_ARRAY_OUT_MAX)
+#define SENSOR_ARRAY_Q ( 16 )         // 傾きとオフセットの小数部のビット数
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：N個のアナログセンサーの生値の読み込みと、黒と白の補正値による0～SENSOR_ARRAY_OUT_MAXへの補正
+ * 補正はmap( fine, 黒, 白, 0, SENSOR_ARRAY_OUT_MAX )をSENSOR_ARRAY_OUT_MAXで制限したものと同じ(Q16の丸めで1程度違うことがある)
+ * 黒と白が同じ値の場合は0にする
+ * 注意：黒と白の補正値は10bit(ADC_SCAN_BITS)の値であること
+ *      補正値を変えたら(パラメータの設定、NVMの読み込み、キャリブレーション画面)refresh()を呼ぶこと
+ */
+template <u1 N>
+class sensor_array {
+    static_assert( N != 0, "N must not be 0" );
+
+  private:
+    constexpr static u1 fine_shift = ADC_SCAN_FINE_BITS - ADC_SCAN_BITS;
+
+  public:
+    sensor_array( const pin_size_t ( &pins )[N], parameter* const ( &black )[N], parameter* const ( &white )[N] ) {
+        for ( u1 i = 0; i < N; i++ ) {
+            this->pins[i] = pins[i];
+            this->black[i] = black[i];
+            this->white[i] = white[i];
+            gain[i] = 0; // パラメータは静的な初期化の順番が決まらないため、init()で計算する
+            offset[i] = 0;
+            fine[i] = 0;
+            raw[i] = 0;
+            corrected[i] = 0;
+        }
+    }
+
+    /*
+     * 概要：初期化
+     * 引数：なし
+     * 戻り値：なし
+     * 詳細：全てのピンを入力にし、オーバーサンプリングでA/D変換のスキャンに加え、補正値から傾きとオフセットを計算する
+     */
+    void init() {
+        for ( u1 i = 0; i < N; i++ ) {
+            pinMode( pins[i], INPUT );
+            adc_scan_add( pins[i], true );
+        }
+        refresh();
+    }
+
+    /*
+     * 概要：黒と白の補正値から傾きとオフセットを計算し直す
+     * 引数：なし
+     * 戻り値：なし
+     * 詳細：1msタスクのcorrect()と傾きとオフセットの組が食い違わないように、センサーごとに割り込みを禁止して書き込む
+     */
+    void refresh() {
+        for ( u1 i = 0; i < N; i++ ) {
+            s4 b = black[i]->get();
+            s4 range = ( white[i]->get() - b ) << fine_shift;
+            s4 new_gain = ( range != 0 ) ? ( ( SENSOR_ARRAY_OUT_MAX << SENSOR_ARRAY_Q ) / range ) : 0;
+            s8 new_offset = -(s8)( b << fine_shift ) * new_gain;
+            noInterrupts();
+            gain[i] = new_gain;
+            offset[i] = new_offset;
+            interrupts();
+        }
+    }
+
+    /*
+     * 概要：生値の読み込みと補正をする
+     * 引数：なし
+     * 戻り値：なし
+     * 詳細：load()とcorrect()を続けて行う
+     */
+    void update() {
+        load();
+        correct();
+    }
+
+    /*
+     * 概要：直前のA/D変換のスキャンから生値を読み込む
+     * 引数：なし
+     * 戻り値：なし
+     */
+    void load() {
+        for ( u1 i = 0; i < N; i++ ) {
+            fine[i] = adc_scan_read_fine( pins[i] );
+            raw[i] = fine[i] >> fine_shift;
+        }
+    }
+
+    /*
+     * 概要：fineの値を補正してcorrectedに格納する
+     * 引数：なし
+     * 戻り値：なし
+     * 詳細：傾きとオフセットは最後のrefresh()のもの
+     */
+    void correct() {
+        for ( u1 i = 0; i < N; i++ ) {
+            s4 value = (s4)( ( (s8)fine[i] * gain[i] + offset[i] ) >> SENSOR_ARRAY_Q );
+            value = ( value < 0 ) ? 0 : value;
+            value = ( value > SENSOR_ARRAY_OUT_MAX ) ? SENSOR_ARRAY_OUT_MAX : value;
+            corrected[i] = (u2)value;
+        }
+    }
+
+  public:
+    pin_size_t pins[N];
+    u2 fine[N];      // 生値 ADC_SCAN_FINE_BITSの値
+    u2 raw[N];       // 生値 ADC_SCAN_BITSの値(キャリブレーションの表示用)
+    u2 corrected[N]; // 補正後の値 黒:0 白:SENSOR_ARRAY_OUT_MAX
+    s4 gain[N];      // 傾き Q16(fineの1LSBあたり)
+    s8 offset[N];    // オフセット Q16
+
+  private:
+    parameter* black[N];
+    parameter* white[N];
+};
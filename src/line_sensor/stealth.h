@@ -6,6 +6,8 @@
 #include <Arduino.h>
 #include "defines.h"
 #include "line_sensor.h"
+#include "sensor_array.h"
+#include "line_position.h"
 #include "calibration.h"
 #include "features.h"
 
@@ -16,49 +18,18 @@
 /* Local definitions               */
 /***********************************/
 #define DIGITAL_THRESHOLD ( 800 )
-
-// アナログセンサの管理クラス
-// フィルター処理(移動平均)を行う
-class AnalogSensor {
-  public:
-    u4 raw;
-
-  private:
-    constexpr static u1 move_average_size = 3;
-
-  public:
-    AnalogSensor( parameter* black, parameter* white ) : black( black ), white( white ) {
-        memset( filter_buf, 0, sizeof( filter_buf ) );
-        idx = 0;
-    }
-    void push( u4 raw ) {
-        this->raw = raw;
-        filter_buf[idx] = raw;
-        idx = ( idx + 1 ) % move_average_size;
-    }
-    u4 get() {
-        u4 sum = 0;
-        for ( u1 i = 0; i < move_average_size; i++ ) {
-            sum += filter_buf[i];
-        }
-        return sum / move_average_size;
-    }
-    u4 corrected() {
-        s4 temp = map( get(), black->get(), white->get(), 0, 1023 );
-        temp = constrain( temp, 0, 1023 );
-        return (u4)temp;
-    }
-
-  private:
-    u4 filter_buf[move_average_size]; // フィルター用バッファ
-    u1 idx;
-    parameter* black;
-    parameter* white;
-};
+#define STEALTH_SENSOR_NUM ( 7 ) // アナログセンサーの数(AR3～AL3)
 
 /***********************************/
 /* Local Variables                 */
 /***********************************/
+// 右(AR3)から左(AL3)の順
+static const pin_size_t stealth_pins[STEALTH_SENSOR_NUM] = { PIN_LINE_AR3, PIN_LINE_AR2, PIN_LINE_AR1, PIN_LINE_AC, PIN_LINE_AL1, PIN_LINE_AL2,
+                                                             PIN_LINE_AL3 };
+static parameter* const stealth_black[STEALTH_SENSOR_NUM] = { &prm_line_AR3_B, &prm_line_AR2_B, &prm_line_AR1_B, &prm_line_AC_B, &prm_line_AL1_B,
+                                                              &prm_line_AL2_B, &prm_line_AL3_B };
+static parameter* const stealth_white[STEALTH_SENSOR_NUM] = { &prm_line_AR3_W, &prm_line_AR2_W, &prm_line_AR1_W, &prm_line_AC_W, &prm_line_AL1_W,
+                                                              &prm_line_AL2_W, &prm_line_AL3_W };
 
 /***********************************/
 /* Global Variables                */
@@ -81,23 +52,7 @@ static u1 bit_count( u1 value ) {
 /***********************************/
 class line_sensor_stealth : public line_sensor {
   public:
-    line_sensor_stealth() {
-        ar3 = new AnalogSensor( &prm_line_AR3_B, &prm_line_AR3_W );
-        ar2 = new AnalogSensor( &prm_line_AR2_B, &prm_line_AR2_W );
-        ar1 = new AnalogSensor( &prm_line_AR1_B, &prm_line_AR1_W );
-        ac = new AnalogSensor( &prm_line_AC_B, &prm_line_AC_W );
-        al1 = new AnalogSensor( &prm_line_AL1_B, &prm_line_AL1_W );
-        al2 = new AnalogSensor( &prm_line_AL2_B, &prm_line_AL2_W );
-        al3 = new AnalogSensor( &prm_line_AL3_B, &prm_line_AL3_W );
-    }
-    ~line_sensor_stealth() {
-        delete ar3;
-        delete ar2;
-        delete ar1;
-        delete ac;
-        delete al1;
-        delete al2;
-        delete al3;
+    line_sensor_stealth() : sensors( stealth_pins, stealth_black, stealth_white ) {
     }
 
     /*
@@ -107,14 +62,17 @@ class line_sensor_stealth : public line_sensor {
      * 詳細：初期化する
      */
     void init() override {
-        pinMode( PIN_LINE_AR3, INPUT );
-        pinMode( PIN_LINE_AR2, INPUT );
-        pinMode( PIN_LINE_AR1, INPUT );
-        pinMode( PIN_LINE_AC, INPUT );
-        pinMode( PIN_LINE_AL1, INPUT );
-        pinMode( PIN_LINE_AL2, INPUT );
-        pinMode( PIN_LINE_AL3, INPUT );
-        analogReadResolution( 10 );
+        sensors.init();
+    }
+
+    /*
+     * 概要：キャリブレーションの反映
+     * 引数：なし
+     * 戻り値：なし
+     * 詳細：黒と白の補正値から傾きとオフセットを計算し直す
+     */
+    void reload_calibration() override {
+        sensors.refresh();
     }
 
     /***********************************/
@@ -127,111 +85,56 @@ class line_sensor_stealth : public line_sensor {
      * 詳細：センサ値をアップデートする
      */
     void update() override {
-        ar3->push( analogRead( PIN_LINE_AR3 ) );
-        ar2->push( analogRead( PIN_LINE_AR2 ) );
-        ar1->push( analogRead( PIN_LINE_AR1 ) );
-        ac->push( analogRead( PIN_LINE_AC ) );
-        al1->push( analogRead( PIN_LINE_AL1 ) );
-        al2->push( analogRead( PIN_LINE_AL2 ) );
-        al3->push( analogRead( PIN_LINE_AL3 ) );
+        sensors.update();
 
-        s4 sensor_values[7] = { (s4)ar3->corrected(), (s4)ar2->corrected(), (s4)ar1->corrected(), (s4)ac->corrected(),
-                                (s4)al1->corrected(), (s4)al2->corrected(), (s4)al3->corrected() };
-
-        // 山の数を数える
-        // 下がったところで山としてカウントする
-        u1 mount_count = 0;
-        s1 trend = 0; // -1:下り 0:平坦 1:上り
-        s1 trend_old = 0;
-        if ( sensor_values[0] > 0 ) {
-            mount_count++;
-            trend_old = 1;
+        s4 sensor_values[STEALTH_SENSOR_NUM];
+        for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+            sensor_values[i] = sensors.corrected[i];
         }
-        for ( u1 i = 1; i < 7; i++ ) { // 1始まりであることに注意
-            trend = ( sensor_values[i - 1] < sensor_values[i] ) ? 1 : ( sensor_values[i - 1] > sensor_values[i] ) ? -1 : 0;
-            // 上りの後に下りになったら山とする
-            if ( ( trend_old == 0 || trend_old == -1 ) && trend == 1 ) {
-                mount_count++;
-            }
 
-            trend_old = trend;
-        }
+        // 山の数を数える
+        // 最大値の半分に満たない山はノイズとして数えない
+        u1 mount_count = line_position_count( sensor_values );
 
-        s4 gravity_center;
-        s4 bunshi; // 分子
-        s4 bunbo;  // 分母
-        s4 pivot_value;
         // 山の数によって処理を変える
+        line_position_t estimate = {};
         switch ( mount_count ) {
-        case 2: {
-            // 山が2つある場合は前回値を軸(pivot)とし、軸からの距離で重みを付けて重心を求めるようにする
-            // まずはpivotを求める
-            u1 pivot = 0;
-            u4 diff_pivot_min = UINT32_MAX;
-            pivot_value = 3072;
-            for ( u1 i = 0; i < 7; i++, pivot_value -= 1024 ) {
-                u4 diff_pivot = abs( pivot_value - line_error_old );
-                if ( diff_pivot < diff_pivot_min ) {
-                    pivot = i;
-                    diff_pivot_min = diff_pivot;
-                }
-            }
-
-            // pivotを100%として離れているところは以下のように重みを付ける
-            // 0(pivot) : 100%
-            // ±1 : 90%
-            // ±2 : 75%
-            // ±3 : 20%
-            // ±4 : 0%
-            // ±5 : 0%
-            // ±6 : 0%
-            for ( u1 i = 0; i < 7; i++ ) {
-                u1 diff = abs( pivot - i );
-                if ( diff == 0 ) {
-                    ; // 100%
-                } else if ( diff == 1 ) {
-                    sensor_values[i] = ( sensor_values[i] * 90 ) / 100;
-                } else if ( diff == 2 ) {
-                    sensor_values[i] = ( sensor_values[i] * 75 ) / 100;
-                } else if ( diff == 3 ) {
-                    sensor_values[i] = ( sensor_values[i] * 20 ) / 100;
-                } else {
-                    sensor_values[i] = 0;
-                }
-            }
-            /* fall-through */
-        }
-        case 1: {
-            // 重心を求める
-            bunshi = 0;
-            bunbo = 0;
-            pivot_value = 3072;
-            for ( u1 i = 0; i < 7; i++, pivot_value -= 1024 ) {
-                bunshi += ( sensor_values[i] * pivot_value );
-                bunbo += sensor_values[i];
-            }
-            if ( bunbo != 0 ) {
-                gravity_center = bunshi / bunbo;
-            } else {
-                gravity_center = 0;
-            }
-
+        case 1:
+        case 2:
+            // 山が2つある場合は前回の位置に近い方の山を追う
+            estimate = line_position_estimate( sensor_values, line_position_peak( sensor_values, line_error_old ) );
             break;
-        }
         default:
             // 山が0もしくは3以上の場合は難所の恐れがある。その場合はステアリングを変に操作したくないため0を返す。
-            gravity_center = 0;
             break;
         }
 
+        u1 temp_line_digital = digital_pattern( sensor_values );
+
         noInterrupts();
-        line_error = gravity_center;
+        line_error = estimate.position;
         line_error_old = line_error;
+        line_width = estimate.width;
+        line_contrast = estimate.contrast;
+        line_digital = temp_line_digital;
+        interrupts();
+    }
 
-        for ( u1 i = 0; i < 7; i++ ) {
-            line_digital |= ( sensor_values[i] > DIGITAL_THRESHOLD ) << ( 6 - i );
+    /***********************************/
+    /* 生値の取得                       */
+    /***********************************/
+    /*
+     * 概要：アナログセンサーの生値を取得する
+     * 引数：raw 生値の格納先 max 格納先の要素数
+     * 戻り値：格納した生値の数
+     * 詳細：AR3、AR2、AR1、AC、AL1、AL2、AL3の順に10bitADCの値を格納する
+     */
+    u1 get_raw( u2* raw, u1 max ) override {
+        u1 n = 0;
+        for ( ; n < max && n < STEALTH_SENSOR_NUM; n++ ) {
+            raw[n] = sensors.raw[n];
         }
-        interrupts();
+        return n;
     }
 
     /***********************************/
@@ -401,15 +304,85 @@ class line_sensor_stealth : public line_sensor {
     }
 
   public:
-    AnalogSensor* ar3;
-    AnalogSensor* ar2;
-    AnalogSensor* ar1;
-    AnalogSensor* ac;
-    AnalogSensor* al1;
-    AnalogSensor* al2;
-    AnalogSensor* al3;
+    sensor_array<STEALTH_SENSOR_NUM> sensors; // AR3、AR2、AR1、AC、AL1、AL2、AL3の順
+    s4 line_width;                            // 線の幅(信頼度) 山が無いときは0 LSB:1/1024[センサーの間隔]
+    s4 line_contrast;                         // 線のコントラスト(信頼度) 山が無いときは0 LSB:補正後のセンサー値
 
   private:
+    /*
+     * 概要：補正後のセンサー値からデジタル値を求める
+     * 引数：values 補正後のセンサー値(AR3～AL3の順)
+     * 戻り値：デジタル値 bit6:AR3～bit0:AL3
+     * 詳細：山が2つある場合は前回値を軸(pivot)とし、軸からの距離で重みを付けた値をしきい値と比べる
+     *      山の数え方と重みは線の位置を重心で求めていたときと同じ(線の位置の求め方を変えてもデジタル値は変えない)
+     *      line_error_oldを更新する前に呼ぶこと
+     */
+    u1 digital_pattern( const s4 ( &values )[STEALTH_SENSOR_NUM] ) {
+        s4 weighted[STEALTH_SENSOR_NUM];
+        for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+            weighted[i] = values[i];
+        }
+
+        // 山の数を数える
+        // 下がったところで山としてカウントする
+        u1 mount_count = 0;
+        s1 trend = 0; // -1:下り 0:平坦 1:上り
+        s1 trend_old = 0;
+        if ( weighted[0] > 0 ) {
+            mount_count++;
+            trend_old = 1;
+        }
+        for ( u1 i = 1; i < STEALTH_SENSOR_NUM; i++ ) { // 1始まりであることに注意
+            trend = ( weighted[i - 1] < weighted[i] ) ? 1 : ( weighted[i - 1] > weighted[i] ) ? -1 : 0;
+            // 上りの後に下りになったら山とする
+            if ( ( trend_old == 0 || trend_old == -1 ) && trend == 1 ) {
+                mount_count++;
+            }
+
+            trend_old = trend;
+        }
+
+        if ( mount_count == 2 ) {
+            // まずはpivotを求める
+            u1 pivot = 0;
+            u4 diff_pivot_min = UINT32_MAX;
+            for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+                u4 diff_pivot = abs( line_position_of<STEALTH_SENSOR_NUM>( i ) - line_error_old );
+                if ( diff_pivot < diff_pivot_min ) {
+                    pivot = i;
+                    diff_pivot_min = diff_pivot;
+                }
+            }
+
+            // pivotを100%として離れているところは以下のように重みを付ける
+            // 0(pivot) : 100%
+            // ±1 : 90%
+            // ±2 : 75%
+            // ±3 : 20%
+            // ±4～±6 : 0%
+            for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+                u1 diff = abs( pivot - i );
+                if ( diff == 0 ) {
+                    ; // 100%
+                } else if ( diff == 1 ) {
+                    weighted[i] = ( weighted[i] * 90 ) / 100;
+                } else if ( diff == 2 ) {
+                    weighted[i] = ( weighted[i] * 75 ) / 100;
+                } else if ( diff == 3 ) {
+                    weighted[i] = ( weighted[i] * 20 ) / 100;
+                } else {
+                    weighted[i] = 0;
+                }
+            }
+        }
+
+        u1 pattern = 0;
+        for ( u1 i = 0; i < STEALTH_SENSOR_NUM; i++ ) {
+            pattern |= ( weighted[i] > DIGITAL_THRESHOLD ) << ( STEALTH_SENSOR_NUM - 1 - i );
+        }
+        return pattern;
+    }
+
     s4 line_error_old;
 };
 
@@ -0,0 +1,167 @@
+/*
+ * 概要：ログに記録する信号(ログチャンネル)を一元管理する
+ */
+#include <Arduino.h>
+#include "log_channels.h"
+#include "features.h"
+#include "sensors.h"
+#include "line_sensor.h"
+#include "motor_control.h"
+#include "profile.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static u4 log_tick = 0; // 記録周期の判定に使う1msカウンタ
+
+// log_events_poll()で変化を検出する値の前回値
+static u1 event_run_mode = RUN_STOP;
+static u1 event_run_status = S00;
+static u1 event_pressure = LOG_PRESSURE_NONE;
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern u1 run_mode;
+extern u1 run_status;
+extern s4 target_speed_now;
+extern mcr_logger logger;
+
+/*
+ * ログチャンネルの定義(csvの列順)
+ * ログに記録する信号はここに追加すること。ヘッダ、レコードの形式、記録周期は全てこの定義から作られる
+ * 記録周期1msのチャンネルは優先チャンネルとして、ロガーのバッファが逼迫しても記録を続ける(e_log_pressure参照)
+ */
+const log_channel_t log_channels[] = {
+    LOG_CHANNEL( "run_mode", run_mode, "-", 10 ),
+    LOG_CHANNEL( "run_status", run_status, "-", 10 ),
+    LOG_CHANNEL( "line_error", ls.line_error, "-", 1 ),
+    LOG_CHANNEL( "steer_angle", steer_angle, "0.1deg", 1 ),
+    LOG_CHANNEL( "line_digital", ls.line_digital, "bit", 1 ),
+    LOG_CHANNEL( "FL", FL, "1%", 10 ),
+    LOG_CHANNEL( "FR", FR, "1%", 10 ),
+    LOG_CHANNEL( "RL", RL, "1%", 10 ),
+    LOG_CHANNEL( "RR", RR, "1%", 10 ),
+    LOG_CHANNEL( "SV", SV, "1%", 1 ),
+    LOG_CHANNEL( "speed", speed, "0.01m/s", 10 ),
+    LOG_CHANNEL( "battery_voltage", battery_voltage, "0.01V", 100 ),
+    LOG_CHANNEL( "slope_status", slope_status, "-", 10 ),
+    LOG_CHANNEL( "target_speed", target_speed_now, "0.01m/s", 10 ),
+    LOG_CHANNEL( "failer", failer, "bit", 100 ),
+#if CONFIG_PROFILE_LOG
+    LOG_CHANNEL( "prof_sensors", profile_us[PROFILE_STAGE_SENSORS], "1us", 10 ),
+    LOG_CHANNEL( "prof_servo", profile_us[PROFILE_STAGE_SERVO], "1us", 10 ),
+    LOG_CHANNEL( "prof_motor", profile_us[PROFILE_STAGE_MOTOR], "1us", 10 ),
+    LOG_CHANNEL( "prof_log", profile_us[PROFILE_STAGE_LOG], "1us", 10 ),
+    LOG_CHANNEL( "prof_buzzer", profile_us[PROFILE_STAGE_BUZZER], "1us", 10 ),
+    LOG_CHANNEL( "prof_total", profile_us[PROFILE_STAGE_TOTAL], "1us", 10 ),
+#endif
+};
+const u1 log_channel_num = array_size( log_channels );
+
+static_assert( array_size( log_channels ) <= LOG_CHANNEL_MAX, "ログチャンネルが多すぎます" );
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+
+/***********************************/
+/* Class implementions             */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：記録周期になったチャンネルの値をログレコードに詰める
+ * 引数：record 格納先のログレコード
+ * 戻り値：記録するチャンネルがある:true 無い:false
+ * 詳細：1msタスクから毎周期呼ぶこと
+ *      LOG_RECORD_DATA_MAXに収まらないチャンネルは記録しない
+ *      ロガーのバッファが逼迫している間は、記録周期をLOG_PRESSURE_DECIMATION倍に間引き、
+ *      さらに逼迫すると優先チャンネル(記録周期1ms)だけを記録する
+ */
+bool log_channels_sample( log_record_t* record ) {
+    u1 pressure = logger.get_pressure();
+
+    record->mask = 0;
+    record->len = 0;
+
+    for ( u1 i = 0; i < log_channel_num; i++ ) {
+        const log_channel_t* ch = &log_channels[i];
+        u4 period = ch->period_ms;
+        if ( pressure == LOG_PRESSURE_PRIORITY && period != 1 ) {
+            continue;
+        }
+        if ( pressure != LOG_PRESSURE_NONE ) {
+            period *= LOG_PRESSURE_DECIMATION;
+        }
+        if ( log_tick % period != 0 ) {
+            continue;
+        }
+        u1 size = mcr_logger::log_type_size( ch->type );
+        if ( record->len + size > LOG_RECORD_DATA_MAX ) {
+            break;
+        }
+        memcpy( &record->data[record->len], ch->ptr, size );
+        record->len += size;
+        record->mask |= 1UL << i;
+    }
+    log_tick++;
+
+    return record->mask != 0;
+}
+
+/*
+ * 概要：記録周期の判定をやり直す
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：ロギング開始時に呼ぶと、最初のレコードに全てのチャンネルが記録される
+ */
+void log_channels_restart() {
+    log_tick = 0;
+}
+
+/*
+ * 概要：イベントを記録する
+ * 引数：type イベントの種類 value イベントの値
+ * 戻り値：なし
+ * 詳細：呼んだ時点の時刻(micros())と走行距離をイベントに付けてロガーへ渡す
+ *      記録周期に丸められないため、周期的なレコードの列の変化から探すより正確に発生時刻と位置がわかる
+ *      loop()から呼ぶこと
+ */
+void log_event( e_log_event type, s4 value ) {
+    logger.put_event( type, value, micros(), distance );
+}
+
+/*
+ * 概要：run_mode、run_status、ロガーの間引きの段階の変化をイベントとして記録する
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：run_mode、run_statusは代入箇所が多いため、前回値との比較で変化を検出する
+ *      変化させた処理の直後に記録するため、loop()のruuning()の直後に呼ぶこと
+ */
+void log_events_poll() {
+    if ( run_mode != event_run_mode ) {
+        event_run_mode = run_mode;
+        log_event( LOG_EVENT_RUN_MODE, run_mode );
+    }
+    if ( run_status != event_run_status ) {
+        event_run_status = run_status;
+        log_event( LOG_EVENT_RUN_STATUS, run_status );
+    }
+    if ( logger.get_pressure() != event_pressure ) {
+        event_pressure = logger.get_pressure();
+        log_event( LOG_EVENT_PRESSURE, event_pressure );
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * 概要：ログに記録する信号(ログチャンネル)を一元管理する
+ */
+#pragma once
+#include <Arduino.h>
+#include "defines.h"
+#include "mcr_logger.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+/*
+ * ログチャンネルを定義する
+ * name:チャンネル名(csvの列名) var:記録する変数 unit:LSBと単位 period_ms:記録周期[ms]
+ * 型はvarの型から自動で決まる
+ */
+#define LOG_CHANNEL( name, var, unit, period_ms ) { name, log_type_of( var ), unit, &( var ), period_ms }
+
+/***********************************/
+/* Class                           */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+static constexpr e_log_type log_type_of( const unsigned char& ) {
+    return LOG_TYPE_U1;
+}
+static constexpr e_log_type log_type_of( const char& ) {
+    return LOG_TYPE_S1;
+}
+static constexpr e_log_type log_type_of( const signed char& ) {
+    return LOG_TYPE_S1;
+}
+static constexpr e_log_type log_type_of( const unsigned short& ) {
+    return LOG_TYPE_U2;
+}
+static constexpr e_log_type log_type_of( const short& ) {
+    return LOG_TYPE_S2;
+}
+static constexpr e_log_type log_type_of( const unsigned long& ) {
+    return LOG_TYPE_U4;
+}
+static constexpr e_log_type log_type_of( const long& ) {
+    return LOG_TYPE_S4;
+}
+static constexpr e_log_type log_type_of( const unsigned int& ) {
+    return LOG_TYPE_U4;
+}
+static constexpr e_log_type log_type_of( const int& ) {
+    return LOG_TYPE_S4;
+}
+
+bool log_channels_sample( log_record_t* record );
+void log_channels_restart();
+void log_event( e_log_event type, s4 value );
+void log_events_poll();
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern const log_channel_t log_channels[];
+extern const u1 log_channel_num;
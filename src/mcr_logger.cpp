@@ -16,12 +16,23 @@
 /* Local definitions               */
 /***********************************/
 const u1 chipSelect = CS1;
-const u4 CLOCK_MHZ = 10;
-const char* file_name_prefix = "log"; // ex:log0000.csv
+const char* file_name_prefix = "log";            // ex:log00000.csv log00000.bin
+const char* log_index_file_name = "logidx.txt"; // 次のログ番号を保存するファイル
 
-#define SD_CONFIG SdSpiConfig( chipSelect, DEDICATED_SPI, SD_SCK_MHZ( CLOCK_MHZ ), &SPI1 )
+#define SD_CONFIG( clock_mhz ) SdSpiConfig( chipSelect, DEDICATED_SPI, SD_SCK_MHZ( clock_mhz ), &SPI1 )
 
 #define LOG_FILE_SIZE ( 64 * 1000 * 60 ) // 最大60sec
+#define LOG_NUMBER_MAX ( 99999 )         // ログ番号の最大値(5桁)
+
+#define LOG_BENCH_FILE_NAME "bench.tmp" // ベンチマークで書き込むファイル(終了時に削除する)
+
+// ベンチマークの1回(1つのクロックとバッファサイズ)の結果
+typedef struct {
+    bool ok;                  // 全て書き込め、読み戻した内容が一致した
+    u4 total_us;              // 書き込みにかかった時間(同期を含む) LSB:1[us]
+    u4 busy_us;               // 書き込み前にisBusy()で待った時間の合計 LSB:1[us]
+    latency_histogram call;   // 1回の書き込み(write()1回、バッファサイズ分)の時間の分布 LSB:1[us]
+} log_bench_result_t;
 
 /***********************************/
 /* Local Variables                 */
@@ -37,6 +48,100 @@ const char* file_name_prefix = "log"; // ex:log0000.csv
 /***********************************/
 /* Local functions                 */
 /***********************************/
+/*
+ * 概要：ファイル名からログ番号を取り出す
+ * 引数：name ファイル名
+ * 戻り値：ログ番号 ログファイルでなければ-1
+ * 詳細：旧形式の4桁(log0000.csv)と5桁(log00000.csv)の両方を受け付ける
+ */
+static s4 parse_log_number( const char* name ) {
+    size_t prefix_len = strlen( file_name_prefix );
+    s4 number = 0;
+    u1 digits = 0;
+
+    if ( strncmp( name, file_name_prefix, prefix_len ) != 0 ) {
+        return -1;
+    }
+    for ( const char* p = &name[prefix_len]; *p != '.'; p++ ) {
+        if ( *p < '0' || *p > '9' || ++digits > 5 ) {
+            return -1;
+        }
+        number = number * 10 + ( *p - '0' );
+    }
+    if ( digits < 4 ) {
+        return -1;
+    }
+    return number;
+}
+
+/*
+ * 概要：ベンチマークの書き込みデータを作る
+ * 引数：buf 格納先 size バイト数 block 何回目の書き込みか
+ * 戻り値：なし
+ * 詳細：読み戻したときに、別の位置のデータと取り違えていないかもわかるように、書き込みごとに内容を変える
+ */
+static void bench_fill( u1* buf, u2 size, u4 block ) {
+    for ( u2 i = 0; i < size; i++ ) {
+        buf[i] = (u1)( i * 31 + block * 7 );
+    }
+    memcpy( buf, &block, sizeof( block ) );
+}
+
+/*
+ * 概要：1つのクロックとバッファサイズでベンチマークを行う
+ * 引数：sd 初期化済みのSDカード buf バッファ size 1回に書き込むバイト数(512の倍数) result 結果の格納先
+ * 戻り値：なし
+ * 詳細：LOG_BENCH_FILE_SIZEバイトを先に確保したファイルへ順に書き込み、時間を計る
+ *      ロギング中と同じく、書き込む前にisBusy()が解けるのを待ち、その時間を別に数える
+ *      書き込み後に読み戻して内容を確認し、一致しなければ不安定とみなす
+ */
+static void bench_run( SdFs* sd, u1* buf, u2 size, log_bench_result_t* result ) {
+    FsFile f;
+    u4 blocks = LOG_BENCH_FILE_SIZE / size;
+
+    result->ok = false;
+    result->total_us = 0;
+    result->busy_us = 0;
+    result->call.reset();
+    if ( !f.open( LOG_BENCH_FILE_NAME, O_RDWR | O_CREAT | O_TRUNC ) ) {
+        return;
+    }
+    if ( !f.preAllocate( LOG_BENCH_FILE_SIZE ) ) {
+        f.close();
+        sd->remove( LOG_BENCH_FILE_NAME );
+        return;
+    }
+
+    bool ok = true;
+    u4 start = micros();
+    for ( u4 block = 0; block < blocks && ok; block++ ) {
+        bench_fill( buf, size, block );
+        u4 t = micros();
+        while ( f.isBusy() ) {
+        }
+        u4 ready = micros();
+        result->busy_us += ready - t;
+        ok = f.write( buf, size ) == size;
+        result->call.add( micros() - ready ); // セクタ数で割ると1回の中の遅いセクタが隠れるため、1回の時間のまま数える
+    }
+    ok = ok && f.sync();
+    result->total_us = micros() - start;
+
+    f.rewind();
+    for ( u4 block = 0; block < blocks && ok; block++ ) {
+        ok = f.read( buf, size ) == size;
+        for ( u2 i = 0; i < size && ok; i++ ) {
+            u1 expect = (u1)( i * 31 + block * 7 );
+            if ( i < sizeof( block ) ) {
+                expect = (u1)( block >> ( i * 8 ) );
+            }
+            ok = buf[i] == expect;
+        }
+    }
+    f.close();
+    sd->remove( LOG_BENCH_FILE_NAME );
+    result->ok = ok;
+}
 
 /***********************************/
 /* Class implementions             */
@@ -50,35 +155,200 @@ const char* file_name_prefix = "log"; // ex:log0000.csv
 bool mcr_logger::init() {
     sd.end();
     DBG_PRINT( "SD card init\n" );
-    if ( !sd.begin( SD_CONFIG ) ) {
+    if ( !sd.begin( SD_CONFIG( prm_sd_clock_mhz.get() ) ) ) {
         DBG_PRINT( "sd.begin failed\n" );
         sd.initErrorPrint( &Serial );
         fault = true;
         return false;
     }
+    fault = false;
 
+    load_log_index();
     return true;
 }
 
 /*
- * 概要：ログファイルを作成する
+ * 概要：閉じられなかったログファイルを、最後の正しいチェックポイントまでに切り詰める
+ * 引数：name ファイル名 number ログ番号
+ * 戻り値：切り詰めた:true 復旧できない、または不要:false
+ * 詳細：ログファイルはLOG_FILE_SIZEで確保されるため、閉じられなかった場合は後ろに古いデータが残る
+ *      先頭から長さ0のチェックポイント(通し番号0)を探し、以降はチェックポイントごとにCRC32を確認して進む
+ *      チェックポイントはLOG_CHECKPOINT_SECTORSセクタ分書いた後の最初のレコードの後ろにあるため、
+ *      その先LOG_CHECKPOINT_SCANバイトの範囲だけを探す
+ *      最後に確認できたチェックポイントの後ろのデータ(最大でLOG_CHECKPOINT_SECTORSセクタ程度)は捨てる
+ *      csvログはチェックポイントが無いため復旧しない
+ */
+bool mcr_logger::recover_log( const char* name, u4 number ) {
+    FsFile f;
+    u1 buf[SECTOR_SIZE];
+    u4 fields[4];
+    u4 pos = 0;
+    u4 end = 0;
+    bool found = false;
+
+    if ( strstr( name, ".bin" ) == nullptr || !f.open( name, O_RDWR ) ) {
+        return false;
+    }
+    u4 size = f.fileSize();
+
+    // 通し番号0のチェックポイントを探す(スキーマヘッダの直後にある)
+    for ( pos = 0; pos < LOG_CHECKPOINT_HEADER_MAX && pos + LOG_CHECKPOINT_SIZE <= size; pos++ ) {
+        f.seekSet( pos );
+        if ( f.read( buf, LOG_CHECKPOINT_SIZE ) != LOG_CHECKPOINT_SIZE || buf[0] != LOG_CHECKPOINT_SYNC ) {
+            continue;
+        }
+        memcpy( fields, &buf[1], sizeof( fields ) );
+        if ( fields[0] == 0 && fields[1] == 0 && fields[2] == 0 && fields[3] == number ) {
+            found = true;
+            break;
+        }
+    }
+    if ( !found ) {
+        f.close();
+        return false;
+    }
+    end = pos + LOG_CHECKPOINT_SIZE;
+
+    // チェックポイントをたどる
+    for ( u4 seq = 1;; seq++ ) {
+        u4 start = end;
+        u4 len = LOG_CHECKPOINT_SECTORS * SECTOR_SIZE;
+        CRC32 crc;
+
+        if ( start + len + LOG_CHECKPOINT_SIZE > size ) {
+            break;
+        }
+        f.seekSet( start );
+        for ( u4 done = 0; done < len; ) {
+            u4 n = len - done < SECTOR_SIZE ? len - done : SECTOR_SIZE;
+            f.read( buf, n );
+            crc.update( buf, n );
+            done += n;
+        }
+
+        found = false;
+        for ( pos = start + len; pos < start + len + LOG_CHECKPOINT_SCAN && pos + LOG_CHECKPOINT_SIZE <= size; pos++ ) {
+            f.seekSet( pos );
+            if ( f.read( buf, LOG_CHECKPOINT_SIZE ) != LOG_CHECKPOINT_SIZE ) {
+                break;
+            }
+            memcpy( fields, &buf[1], sizeof( fields ) );
+            if ( buf[0] == LOG_CHECKPOINT_SYNC && fields[0] == seq && fields[1] == pos - start && fields[3] == number &&
+                 fields[2] == crc.finalize() ) {
+                found = true;
+                break;
+            }
+            crc.update( buf[0] ); // チェックポイントでなければ、このバイトはデータ
+        }
+        if ( !found ) {
+            break;
+        }
+        end = pos + LOG_CHECKPOINT_SIZE;
+    }
+
+    bool ret = f.truncate( end );
+    f.close();
+    DBG_PRINT( "recovered %s : %lu bytes\n", name, end );
+    return ret;
+}
+
+/*
+ * 概要：次のログ番号を決める
  * 引数：なし
+ * 戻り値：なし
+ * 詳細：インデックスファイルの番号と、ルートディレクトリを1回走査して見つけた最大のログ番号+1の大きい方を使う
+ *      インデックスファイルが無い、壊れている、またはPCでログを追加した場合でも番号が重複しない
+ *      インデックスファイルに閉じられなかったログファイルが記録されていれば、recover_log()で切り詰める
+ */
+void mcr_logger::load_log_index() {
+    FsFile f;
+    FsFile dir;
+    char buf[32] = { 0 };
+    char open_name[16] = { 0 };
+    u4 next = 0;
+
+    if ( f.open( log_index_file_name, O_RDONLY ) ) {
+        f.read( buf, sizeof( buf ) - 1 );
+        f.close();
+        char* p;
+        next = strtoul( buf, &p, 10 );
+        // 2行目は書き込み中のログファイル名(正常に閉じられていれば無い)
+        if ( *p == '\n' && p[1] != '\0' && p[1] != '\n' ) {
+            strncpy( open_name, &p[1], sizeof( open_name ) - 1 );
+            open_name[strcspn( open_name, "\n" )] = '\0';
+        }
+    }
+
+    if ( open_name[0] != '\0' ) {
+        recover_log( open_name, parse_log_number( open_name ) );
+    }
+
+    if ( dir.open( "/", O_RDONLY ) ) {
+        while ( f.openNext( &dir, O_RDONLY ) ) {
+            f.getName( buf, sizeof( buf ) );
+            s4 number = parse_log_number( buf );
+            if ( number >= 0 && (u4)number + 1 > next ) {
+                next = number + 1;
+            }
+            f.close();
+        }
+        dir.close();
+    }
+
+    // 番号が変わった場合と、2行目を消す場合に書き直す
+    if ( next_log_number != next || open_name[0] != '\0' ) {
+        next_log_number = next;
+        save_log_index( nullptr );
+    }
+}
+
+/*
+ * 概要：次のログ番号をインデックスファイルに保存する
+ * 引数：open_name 書き込み中のログファイル名 無ければnullptr
+ * 戻り値：保存成功:true 失敗:false
+ * 詳細：1行目に次のログ番号、2行目に書き込み中のログファイル名を書く
+ */
+bool mcr_logger::save_log_index( const char* open_name ) {
+    FsFile f;
+    char buf[32];
+
+    if ( !f.open( log_index_file_name, O_RDWR | O_CREAT | O_TRUNC ) ) {
+        return false;
+    }
+    size_t len = mini_snprintf( buf, sizeof( buf ), "%lu\n%s", next_log_number, open_name != nullptr ? open_name : "" );
+    bool ret = f.write( buf, len ) == len;
+    f.close();
+    return ret;
+}
+
+/*
+ * 概要：ログファイルを作成する
+ * 引数：binary バイナリログ(.bin)を作成する場合はtrue
  * 戻り値：作成成功:true 失敗:false
- * 詳細：csvファイルを作成する
+ * 詳細：csvファイル、またはバイナリログファイルを作成する
+ *      ファイル名はinit()で決めた次のログ番号を使い、インデックスファイルを更新する
  */
-bool mcr_logger::make_log_file() {
+bool mcr_logger::make_log_file( bool binary ) {
     bool ret = true;
-    u1 file_number = 0;
-    char file_name[12] = { 0 };
+    char file_name[13] = { 0 };
+    const char* ext = binary ? "bin" : "csv";
+
+    this->binary = binary;
 
     if ( fault ) {
         return false;
     }
-    sprintf( file_name, "%s%04d.csv", file_name_prefix, file_number );
-    while ( sd.exists( file_name ) ) {
-        file_number++;
-        sprintf( file_name, "%s%04d.csv", file_name_prefix, file_number );
-    }
+    // 番号はinit()で決めてあるため、通常はsd.exists()1回で決まる
+    do {
+        if ( next_log_number > LOG_NUMBER_MAX ) {
+            DBG_PRINT( "log number overflow\n" );
+            ret = false;
+            goto fail;
+        }
+        sprintf( file_name, "%s%05lu.%s", file_name_prefix, next_log_number, ext );
+        log_number = next_log_number++;
+    } while ( sd.exists( file_name ) );
+    save_log_index( file_name );
     DBG_PRINT( "make file_name is :" );
     DBG_PRINT( file_name );
     DBG_PRINT( "\n" );
@@ -99,7 +369,26 @@ bool mcr_logger::make_log_file() {
         goto fail;
     }
 
-    rb.begin( &file );
+    if ( CONFIG_LOG_SECTOR_STREAM ) {
+        uint32_t first_sector;
+        uint32_t last_sector;
+        if ( !file.contiguousRange( &first_sector, &last_sector ) || !sd_dev.begin( sd.card(), first_sector ) ) {
+            DBG_PRINT( "sector stream begin failed\n" );
+            file.close();
+            ret = false;
+            goto fail;
+        }
+        // クラスタ単位で確保されるため、LOG_FILE_SIZEを超える分は使わない
+        if ( last_sector - first_sector + 1 > LOG_FILE_SIZE / SECTOR_SIZE ) {
+            last_sector = first_sector + LOG_FILE_SIZE / SECTOR_SIZE - 1;
+        }
+        extent.begin( first_sector, last_sector );
+        stream.begin( extent.data_capacity() );
+        stream.set_callback( on_sector_written, this );
+        streaming = true;
+    } else {
+        rb.begin( &file );
+    }
 
 fail:
     if ( !ret ) {
@@ -116,14 +405,157 @@ bool mcr_logger::make_log_file() {
  */
 void mcr_logger::put( const char* str ) {
     if ( !fault ) {
-        size_t n = rb.bytesUsed();
+        write_out( str, strlen( str ) );
+    }
+}
+
+/*
+ * 概要：バイト列をリングバッファ、またはセクタストリームへ書き込む
+ * 引数：data データ len バイト数
+ * 戻り値：なし
+ * 詳細：リングバッファの場合、512バイト以上たまっていてカードがbusyでなければ先に512バイト書き出す
+ *      ロギング中はバッファが足りなければ捨てる(待たない)
+ *      ロギング前(ヘッダ書き込み)と終了時(統計)はバッファが空くまで待つ
+ *      レコードの途中で切れないよう、ロギング中のレコードはreserve()で空きを確認してから書き込むこと
+ */
+void mcr_logger::write_out( const void* data, size_t len ) {
+    size_t done = write_raw( data, len );
+
+    // チェックポイントのCRCは実際に書き込めたバイトで計算する
+    if ( checkpointing ) {
+        checkpoint_crc.update( (const u1*)data, done );
+        checkpoint_bytes += done;
+    }
+}
+
+/*
+ * 概要：バイト列をリングバッファ、またはセクタストリームへ書き込む(チェックポイントの計算をしない)
+ * 引数：data データ len バイト数
+ * 戻り値：書き込めたバイト数
+ * 詳細：write_out()参照
+ */
+size_t mcr_logger::write_raw( const void* data, size_t len ) {
+    if ( streaming ) {
+        const u1* p = (const u1*)data;
+        size_t done = stream.write( p, len );
+        while ( !logging && done < len && stream.get_errors() == 0 ) {
+            stream.poll();
+            done += stream.write( &p[done], len - done );
+        }
+        return done;
+    }
 
-        if ( n >= 512 && !file.isBusy() ) {
-            if ( 512 != rb.writeOut( 512 ) ) {
+    const u1* p = (const u1*)data;
+    drain();
+    size_t done = rb.write( p, len );
+    while ( !logging && done < len ) {
+        if ( !file.isBusy() ) {
+            size_t n = rb.bytesUsed();
+            if ( rb.writeOut( n < 512 ? n : 512 ) == 0 ) {
+                break;
             }
         }
-        rb.print( str );
+        done += rb.write( &p[done], len - done );
+    }
+    return done;
+}
+
+/*
+ * 概要：リングバッファに512バイト以上たまっていれば書き出す
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：カードがbusyの場合は待たずに戻り、待たされ始めた回数を数える
+ *      書き出しにかかった時間の最大値を記録する
+ */
+void mcr_logger::drain() {
+    if ( rb.bytesUsed() < 512 ) {
+        stalled = false;
+        return;
+    }
+    if ( file.isBusy() ) {
+        if ( !stalled ) {
+            stats.stalls++;
+            stalled = true;
+        }
+        return;
+    }
+    stalled = false;
+
+    u4 start = micros();
+    rb.writeOut( 512 );
+    u4 elapsed = micros() - start;
+    if ( elapsed > stats.max_write_us ) {
+        stats.max_write_us = elapsed;
+    }
+}
+
+/*
+ * 概要：バッファの使用量を取得する
+ * 引数：なし
+ * 戻り値：リングバッファ、またはセクタストリームのバッファにたまっているバイト数
+ */
+size_t mcr_logger::get_buffer_used() {
+    return streaming ? stream.capacity() - stream.bytes_free() : rb.bytesUsed();
+}
+
+/*
+ * 概要：レコードを書き込む空きがあるか確認する
+ * 引数：len レコードのバイト数
+ * 戻り値：書き込める:true 空きが無い:false
+ * 詳細：空きが無い場合はレコードを丸ごと捨てたものとして数える(途中で切れたレコードを書かないため)
+ *      バイナリの場合、次のチェックポイントの分の空きも残す
+ *      書き込んだ後の使用量で最大使用量を更新する
+ */
+bool mcr_logger::reserve( size_t len ) {
+    if ( !streaming ) {
+        drain();
+    }
+    size_t free_bytes = streaming ? stream.bytes_free() : rb.bytesFree();
+    if ( len + ( binary ? LOG_CHECKPOINT_SIZE : 0 ) > free_bytes ) {
+        stats.dropped_bytes += len;
+        stats.dropped_records++;
+        return false;
+    }
+    size_t used = ( streaming ? stream.capacity() : RING_BUF_CAPACITY ) - free_bytes + len;
+    if ( used > stats.high_water ) {
+        stats.high_water = used;
+    }
+    return true;
+}
+
+/*
+ * 概要：バッファの使用率から間引きの段階を更新する
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：使用率がLOG_PRESSURE_DECIMATE_PERCENT以上で間引き、LOG_PRESSURE_PRIORITY_PERCENT以上で優先チャンネルだけにする
+ *      LOG_PRESSURE_RELEASE_PERCENT未満になったら1段階ずつ戻す(しきい値の付近で段階が振動しないようにするため)
+ *      間引いていた時間と最も強く間引いた段階を統計に記録する
+ */
+void mcr_logger::update_pressure() {
+    size_t capacity = streaming ? stream.capacity() : RING_BUF_CAPACITY;
+    u4 percent = get_buffer_used() * 100 / capacity;
+    u1 level = pressure;
+
+    if ( percent >= LOG_PRESSURE_PRIORITY_PERCENT ) {
+        level = LOG_PRESSURE_PRIORITY;
+    } else if ( percent >= LOG_PRESSURE_DECIMATE_PERCENT && level < LOG_PRESSURE_DECIMATE ) {
+        level = LOG_PRESSURE_DECIMATE;
+    } else if ( percent < LOG_PRESSURE_RELEASE_PERCENT && level > LOG_PRESSURE_NONE ) {
+        level--;
+    }
+    if ( level == pressure ) {
+        return;
+    }
+
+    if ( pressure == LOG_PRESSURE_NONE ) {
+        pressure_since = millis();
+    } else if ( level == LOG_PRESSURE_NONE ) {
+        stats.pressure_ms += millis() - pressure_since;
+    }
+    if ( level > stats.pressure_max ) {
+        stats.pressure_max = level;
     }
+    pressure = level;
 }
 
 /*
@@ -181,17 +613,249 @@ void mcr_logger::write_program_info() {
 }
 
 /*
- * 概要：csvヘッダを作成して書き込む
- * 引数：なし
+ * 概要：csvヘッダ、またはバイナリログのスキーマヘッダを書き込む
+ * 引数：channels ログチャンネルの定義 num チャンネル数
+ *       flight_channels フライトレコーダーのフレームの定義 flight_num フレームの値の数(バイナリのみ 省略時は無し)
+ *       input_channels インプットレコーダーのフレームの定義 input_num フレームの値の数(バイナリのみ 省略時は無し)
  * 戻り値：なし
- * 詳細：csvヘッダを作成して書き込む
+ * 詳細：make_log_file()で作成したファイルの形式に合わせて書き込む
+ *      csvの場合はプログラム情報とチャンネル名を並べた列名の行を書き込む
  */
-void mcr_logger::write_header( const char* header ) {
+void mcr_logger::write_header( const log_channel_t* channels, u1 num, const log_channel_t* flight_channels, u1 flight_num,
+                               const log_channel_t* input_channels, u1 input_num ) {
     if ( fault ) {
         return;
     }
+    if ( binary ) {
+        write_schema( channels, num, flight_channels, flight_num, input_channels, input_num );
+        return;
+    }
+    write_program_info();
+    for ( u1 i = 0; i < num; i++ ) {
+        if ( i != 0 ) {
+            put( "," );
+        }
+        put( channels[i].name );
+    }
+    put( "\n" );
+}
+
+/*
+ * 概要：ロギングモードのときにログレコードを書き込む
+ * 引数：channels ログチャンネルの定義 num チャンネル数 record ログレコード
+ * 戻り値：なし
+ * 詳細：write_header()に渡したものと同じチャンネルの定義を渡すこと
+ *      csvの場合、recordに含まれないチャンネルの列は空欄にする
+ *      バイナリの場合、同期バイト、mask(u4)、dataの順にリトルエンディアンで書き込む
+ *      CONFIG_LOG_COMPRESSが有効な場合、delta_encoderで前回値との差分に圧縮して書き込む
+ *      バイナリの場合、前回のチェックポイントからLOG_CHECKPOINT_SECTORSセクタ分書いたらチェックポイントを書く
+ */
+void mcr_logger::put_record( const log_channel_t* channels, u1 num, const log_record_t* record ) {
+    if ( !logging || fault ) {
+        return;
+    }
+
+    if ( binary && CONFIG_LOG_COMPRESS ) {
+        s4 values[LOG_CHANNEL_MAX];
+        u1 out[DELTA_CODEC_RECORD_MAX];
+        u1 pos = 0;
+        for ( u1 i = 0; i < num; i++ ) {
+            if ( record->mask & ( 1UL << i ) ) {
+                values[i] = unpack_value( channels[i].type, &record->data[pos] );
+                pos += log_type_size( channels[i].type );
+            }
+        }
+        size_t n = delta_enc.encode( record->mask, (const int32_t*)values, out );
+        if ( !reserve( n ) ) {
+            delta_enc.reset(); // 捨てたレコードとの差分は復号できないため、次はキーフレームにする
+            return;
+        }
+        write_out( out, n );
+    } else if ( binary ) {
+        u1 head[5] = { LOG_RECORD_SYNC, (u1)record->mask, (u1)( record->mask >> 8 ), (u1)( record->mask >> 16 ), (u1)( record->mask >> 24 ) };
+
+        if ( !reserve( sizeof( head ) + record->len ) ) {
+            return;
+        }
+        write_out( head, sizeof( head ) );
+        write_out( record->data, record->len );
+    }
+    if ( binary ) {
+        if ( checkpoint_bytes >= LOG_CHECKPOINT_SECTORS * SECTOR_SIZE ) {
+            put_checkpoint();
+        }
+        return;
+    }
+
+    char line[LOG_CHANNEL_MAX * 12 + 2]; // 1列あたり最大で符号と10桁とカンマ、最後に改行と終端
+    s4 len = 0;
+    u1 pos = 0;
+    for ( u1 i = 0; i < num; i++ ) {
+        if ( i != 0 ) {
+            line[len++] = ',';
+        }
+        if ( record->mask & ( 1UL << i ) ) {
+            s4 value = unpack_value( channels[i].type, &record->data[pos] );
+            if ( channels[i].type == LOG_TYPE_U4 ) {
+                len += mini_snprintf( &line[len], sizeof( line ) - len, "%lu", (u4)value );
+            } else {
+                len += mini_snprintf( &line[len], sizeof( line ) - len, "%ld", value );
+            }
+            pos += log_type_size( channels[i].type );
+        }
+    }
+    line[len++] = '\n';
+    line[len] = '\0';
+    if ( reserve( len ) ) {
+        put( line );
+    }
+}
+
+/*
+ * 概要：ロギングモードのときにフライトレコーダーのフレームを書き込む
+ * 引数：event イベントの種類 offset イベント時刻からの経過時間 LSB:1[ms] frame フレーム len フレームのバイト数
+ * 戻り値：なし
+ * 詳細：バイナリの場合のみ書き込む(csvの場合は何もしない)
+ *      形式(リトルエンディアン) : LOG_FLIGHT_SYNC イベント(u1) オフセット(s2) バイト数(u1) フレーム
+ *      フレームの値の並びはwrite_header()に渡したflight_channelsの定義に従う
+ *      差分圧縮の対象外のため、圧縮する場合もそのまま書き込む
+ */
+void mcr_logger::put_flight_frame( u1 event, s2 offset, const void* frame, u1 len ) {
+    if ( !logging || fault || !binary ) {
+        return;
+    }
+    u1 head[5] = { LOG_FLIGHT_SYNC, event, (u1)offset, (u1)( (u2)offset >> 8 ), len };
+
+    if ( !reserve( sizeof( head ) + len ) ) {
+        return;
+    }
+    write_out( head, sizeof( head ) );
+    write_out( frame, len );
+    if ( checkpoint_bytes >= LOG_CHECKPOINT_SECTORS * SECTOR_SIZE ) {
+        put_checkpoint();
+    }
+}
+
+/*
+ * 概要：ロギングモードのときにインプットレコーダーのフレームを書き込む
+ * 引数：frame フレーム len フレームのバイト数
+ * 戻り値：なし
+ * 詳細：バイナリの場合のみ書き込む(csvの場合は何もしない)
+ *      形式(リトルエンディアン) : LOG_INPUT_SYNC バイト数(u1) フレーム
+ *      フレームの値の並びはwrite_header()に渡したinput_channelsの定義に従う
+ *      差分圧縮の対象外のため、圧縮する場合もそのまま書き込む
+ */
+void mcr_logger::put_input_frame( const void* frame, u1 len ) {
+    if ( !logging || fault || !binary ) {
+        return;
+    }
+    u1 head[2] = { LOG_INPUT_SYNC, len };
+
+    if ( !reserve( sizeof( head ) + len ) ) {
+        return;
+    }
+    write_out( head, sizeof( head ) );
+    write_out( frame, len );
+    if ( checkpoint_bytes >= LOG_CHECKPOINT_SECTORS * SECTOR_SIZE ) {
+        put_checkpoint();
+    }
+}
+
+/*
+ * 概要：ロギングモードのときにイベントを書き込む
+ * 引数：type イベントの種類 value イベントの値 time_us 発生時刻(micros()) LSB:1[us] distance_mm 発生位置の走行距離 LSB:1[mm]
+ * 戻り値：なし
+ * 詳細：周期的なレコードとは別に、発生した時刻と位置をそのまま記録する
+ *      バイナリの場合 形式(リトルエンディアン) : LOG_EVENT_SYNC 種類(u1) 時刻(u4) 走行距離(s4) 値(s4)
+ *      csvの場合 "#EV,時刻,走行距離,イベント名,値"のコメント行を書き込む
+ */
+void mcr_logger::put_event( e_log_event type, s4 value, u4 time_us, s4 distance_mm ) {
+    if ( !logging || fault ) {
+        return;
+    }
+
+    if ( binary ) {
+        u1 buf[LOG_EVENT_SIZE];
+        buf[0] = LOG_EVENT_SYNC;
+        buf[1] = type;
+        memcpy( &buf[2], &time_us, 4 ); // RA4M1はリトルエンディアン
+        memcpy( &buf[6], &distance_mm, 4 );
+        memcpy( &buf[10], &value, 4 );
+        if ( !reserve( sizeof( buf ) ) ) {
+            return;
+        }
+        write_out( buf, sizeof( buf ) );
+        if ( checkpoint_bytes >= LOG_CHECKPOINT_SECTORS * SECTOR_SIZE ) {
+            put_checkpoint();
+        }
+        return;
+    }
+
+    char line[64];
+    size_t len = mini_snprintf( line, sizeof( line ), "#EV,%lu,%ld,%s,%ld\n", time_us, distance_mm, log_event_name( type ), value );
+    if ( reserve( len ) ) {
+        put( line );
+    }
+}
+
+/*
+ * 概要：バイナリログのスキーマヘッダを書き込む
+ * 引数：channels ログチャンネルの定義 num チャンネル数
+ *       flight_channels フライトレコーダーのフレームの定義 flight_num フレームの値の数
+ *       input_channels インプットレコーダーのフレームの定義 input_num フレームの値の数
+ * 戻り値：なし
+ * 詳細：以下をテキストで書き込む。ホスト側はDATA行の次のバイトからレコードとして読む
+ *     LOG_BINARY_MAGIC(圧縮する場合はLOG_DELTA_MAGIC)
+ *     プログラム情報(write_program_infoと同じ内容)
+ *     CHANNELS : 1行に1チャンネル "名前,型,LSBと単位,記録周期[ms]"
+ *     FLIGHT   : フライトレコーダーのフレームの値をCHANNELSと同じ形式で並べたもの(flight_numが0なら書かない)
+ *     INPUT    : インプットレコーダーのフレームの値をCHANNELSと同じ形式で並べたもの(input_numが0なら書かない)
+ *     EVENTS   : 1行に1種類 "番号,イベント名"
+ *     DATA
+ */
+void mcr_logger::write_schema( const log_channel_t* channels, u1 num, const log_channel_t* flight_channels, u1 flight_num,
+                               const log_channel_t* input_channels, u1 input_num ) {
+    if ( CONFIG_LOG_COMPRESS ) {
+        put( LOG_DELTA_MAGIC "\n" );
+        delta_enc.reset(); // 最初のレコードをキーフレームにする
+    } else {
+        put( LOG_BINARY_MAGIC "\n" );
+    }
     write_program_info();
-    put( header );
+
+    write_channels( "CHANNELS\n", channels, num );
+    if ( flight_num != 0 ) {
+        write_channels( "FLIGHT\n", flight_channels, flight_num );
+    }
+    if ( input_num != 0 ) {
+        write_channels( "INPUT\n", input_channels, input_num );
+    }
+
+    put( "EVENTS\n" );
+    for ( u1 i = 0; i < LOG_EVENT_NUM; i++ ) {
+        char buf[32];
+        mini_snprintf( buf, sizeof( buf ), "%d,%s\n", i, log_event_name( (e_log_event)i ) );
+        put( buf );
+    }
+    put( "\n" );
+    put( "DATA\n" );
+}
+
+/*
+ * 概要：スキーマヘッダのチャンネル一覧を1セクション書き込む
+ * 引数：title セクション名の行 channels ログチャンネルの定義 num チャンネル数
+ * 戻り値：なし
+ * 詳細：セクション名の行、1行に1チャンネル "名前,型,LSBと単位,記録周期[ms]"、空行の順に書き込む
+ */
+void mcr_logger::write_channels( const char* title, const log_channel_t* channels, u1 num ) {
+    char buf[64];
+
+    put( title );
+    for ( u1 i = 0; i < num; i++ ) {
+        mini_snprintf( buf, sizeof( buf ), "%s,%s,%s,%d\n", channels[i].name, log_type_name( channels[i].type ), channels[i].unit,
+                       channels[i].period_ms );
+        put( buf );
+    }
     put( "\n" );
 }
 
@@ -234,54 +898,395 @@ void mcr_logger::cat( const char* filename ) {
         return;
     }
 
-    while ( file.available() ) {
-        int c = file.read();
-        if ( c < 0 ) {
+    u1 buf[64];
+    int n;
+    while ( ( n = file.read( buf, sizeof( buf ) ) ) > 0 ) {
+        Serial.write( buf, n );
+    }
+
+    file.close();
+}
+
+/*
+ * 概要：SPIクロックとバッファサイズを変えてSDカードの書き込み性能を計る
+ * 引数：clocks 試すSPIクロックの配列 LSB:1[MHz] clock_num 配列の要素数
+ * 戻り値：最も速く安定していたクロック LSB:1[MHz] 安定したクロックが無ければ0
+ * 詳細：クロックごとにSDカードを初期化し直し、LOG_BENCH_BUFFER_SIZESの各バッファサイズで
+ *      スループット、1回の書き込み(バッファサイズ分)の時間の分布(p50/p99/最大)、isBusy()で待った時間を表示する
+ *      これをLOG_BENCH_PASSES回(回ごとにSDカードを初期化し直す)繰り返し、1回でも初期化に失敗するか、
+ *      読み戻した内容が一致しなかったクロックは不安定とみなす(1回だけ通ったクロックを保存しないため)
+ *      ロギングはセクタ単位で書き込むため、安定したクロックのうち512バイトのスループット(全ての回の最小値)が
+ *      最も高いものを選ぶ(同じ場合は先に試した方)
+ *      SDカードの初期化状態を変えるため、戻った後にinit()を呼ぶこと
+ *      時間がかかるため、テストモードのシェルから呼ぶこと
+ */
+u1 mcr_logger::bench( const u1* clocks, u1 clock_num ) {
+    static const u2 sizes[] = LOG_BENCH_BUFFER_SIZES;
+    static log_bench_result_t result; // スタックを使わないようにstaticにする
+    char line[96];
+    u1 best_clock = 0;
+    u4 best_kbps = 0;
+
+    if ( logging || finalize_state != LOG_FINALIZE_IDLE ) {
+        Serial.println( "logging now" );
+        return 0;
+    }
+    u1* buf = (u1*)malloc( LOG_BENCH_BUFFER_MAX ); // ベンチマークの間だけ確保する
+    if ( buf == nullptr ) {
+        Serial.println( "out of memory" );
+        return 0;
+    }
+
+    Serial.println( "clock[MHz],pass,buffer[B],kB/s,p50[us],p99[us],max[us],busy[ms],result" );
+    for ( u1 c = 0; c < clock_num; c++ ) {
+        u4 kbps_sector = UINT32_MAX;
+        bool stable = true;
+
+        for ( u1 pass = 1; pass <= LOG_BENCH_PASSES && stable; pass++ ) {
+            sd.end();
+            if ( !sd.begin( SD_CONFIG( clocks[c] ) ) ) {
+                mini_snprintf( line, sizeof( line ), "%u,%u,-,-,-,-,-,-,init NG", clocks[c], pass );
+                Serial.println( line );
+                stable = false;
+                break;
+            }
+            for ( u1 s = 0; s < array_size( sizes ); s++ ) {
+                bench_run( &sd, buf, sizes[s], &result );
+                u4 kbps = result.total_us ? (u4)( (uint64_t)LOG_BENCH_FILE_SIZE * 1000 / result.total_us ) : 0;
+                mini_snprintf( line, sizeof( line ), "%u,%u,%u,%lu,%lu,%lu,%lu,%lu,%s", clocks[c], pass, sizes[s], kbps,
+                               result.call.get_percentile( 500 ), result.call.get_percentile( 990 ), result.call.get_max(), result.busy_us / 1000,
+                               result.ok ? "OK" : "NG" );
+                Serial.println( line );
+                stable = stable && result.ok;
+                if ( sizes[s] == SECTOR_SIZE && kbps < kbps_sector ) {
+                    kbps_sector = kbps;
+                }
+            }
+        }
+        if ( stable && kbps_sector > best_kbps ) {
+            best_kbps = kbps_sector;
+            best_clock = clocks[c];
+        }
+    }
+    free( buf );
+    sd.end();
+
+    mini_snprintf( line, sizeof( line ), "best clock : %u MHz (%lu kB/s)", best_clock, best_kbps );
+    Serial.println( line );
+    return best_clock;
+}
+
+/*
+ * 概要：ファイルをCRC32付きのフレームでホストへ転送する
+ * 引数：filename ファイル名
+ * 戻り値：なし
+ * 詳細：フレームの形式はxfer_frame.h参照。ホスト側はscripts/mcr_log_download.py
+ *      ファイル情報(サイズ、セクタ数)を送った後、ホストが要求したセクタをデータフレームで送る
+ *      ホストは受け取れなかったセクタを要求し直すことで再送、途中から要求することで再開する
+ *      終了要求を受けるか、XFER_TIMEOUT_MSの間要求が無ければ戻る
+ *      転送が終わるまで戻らないため、テストモードのシェルから呼ぶこと
+ */
+void mcr_logger::download( const char* filename ) {
+    static u1 frame[XFER_FRAME_MAX]; // 送信するフレーム(スタックを使わないようにstaticにする)
+    xfer_frame_parser<XFER_REQUEST_PAYLOAD_MAX> parser;
+    u1* payload = xfer_frame_payload( frame );
+
+    if ( fault || logging || finalize_state != LOG_FINALIZE_IDLE || !file.open( filename, O_RDONLY ) ) {
+        payload[0] = fault ? XFER_ERROR_FAULT : ( logging || finalize_state != LOG_FINALIZE_IDLE ) ? XFER_ERROR_BUSY : XFER_ERROR_OPEN;
+        send_xfer_frame( frame, XFER_TYPE_ERROR, 1 );
+        return;
+    }
+
+    u4 size = file.fileSize();
+    u4 sectors = ( size + XFER_SECTOR_SIZE - 1 ) / XFER_SECTOR_SIZE;
+    u4 last_request = millis();
+    bool info = true; // ファイル情報を送る
+    while ( millis() - last_request < XFER_TIMEOUT_MS ) {
+        if ( info ) {
+            memcpy( &payload[0], &size, 4 );
+            memcpy( &payload[4], &sectors, 4 );
+            send_xfer_frame( frame, XFER_TYPE_INFO, 8 );
+            info = false;
+        }
+
+        int c = Serial.read();
+        if ( c < 0 || !parser.feed( c ) ) {
+            continue;
+        }
+        last_request = millis();
+
+        if ( parser.get_type() == XFER_TYPE_QUIT ) {
             break;
+        } else if ( parser.get_type() == XFER_TYPE_INFO ) {
+            info = true;
+        } else if ( parser.get_type() == XFER_TYPE_REQUEST && parser.get_len() == 6 ) {
+            u4 sector;
+            u2 count;
+            memcpy( &sector, parser.get_payload(), 4 );
+            memcpy( &count, parser.get_payload() + 4, 2 );
+            count = min( count, (u2)XFER_REQUEST_SECTORS );
+            for ( u2 i = 0; i < count && sector + i < sectors; i++ ) {
+                u4 index = sector + i;
+                int n = -1;
+                if ( file.seekSet( index * XFER_SECTOR_SIZE ) ) {
+                    n = file.read( &payload[4], XFER_SECTOR_SIZE );
+                }
+                if ( n < 0 ) {
+                    break; // 読めなかったセクタはホストが要求し直す
+                }
+                memcpy( &payload[0], &index, 4 );
+                send_xfer_frame( frame, XFER_TYPE_DATA, 4 + n );
+            }
         }
-        Serial.write( c );
     }
 
     file.close();
 }
 
+/*
+ * 概要：ペイロードを詰めたフレームを送信する
+ * 引数：frame フレーム type 種類 len ペイロード長
+ * 戻り値：なし
+ * 詳細：送信バッファに空きができるまで待つ
+ */
+void mcr_logger::send_xfer_frame( u1* frame, u1 type, u2 len ) {
+    Serial.write( frame, xfer_frame_finish( frame, type, len ) );
+}
+
 /*
  * 概要：ロギング開始
  * 引数：なし
  * 戻り値：タスク作成成功:true 失敗:false
  * 詳細：ロギングタスクを作成する
+ *      バッファの統計と間引きの段階をリセットする
  */
 void mcr_logger::logging_begin() {
+    memset( &stats, 0, sizeof( stats ) );
+    stats.capacity = streaming ? stream.capacity() : RING_BUF_CAPACITY;
+    stalled = false;
+    pressure = LOG_PRESSURE_NONE;
+
+    if ( binary && !fault ) {
+        checkpoint_seq = 0;
+        checkpoint_crc.reset();
+        checkpoint_bytes = 0;
+        checkpointing = true;
+        put_checkpoint(); // レコードの開始位置を示すため、長さ0のチェックポイントを書く
+    }
     this->logging = true; // loggingはアトミック操作で設定されるので排他処理は不要
 }
 
+/*
+ * 概要：チェックポイントを書き込む
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：前回のチェックポイントの後ろから今までに書き込んだバイト列のCRC32を書き込む
+ *      電源断などでログファイルが閉じられなかった場合、init()で最後の正しいチェックポイントまでに切り詰める
+ *      形式(リトルエンディアン) : LOG_CHECKPOINT_SYNC 通し番号(u4) バイト数(u4) CRC32(u4) ログ番号(u4)
+ *      リングバッファの場合、exec()でキャッシュをSDカードへ書き出す
+ */
+void mcr_logger::put_checkpoint() {
+    u4 fields[4] = { checkpoint_seq, checkpoint_bytes, checkpoint_crc.finalize(), log_number };
+    u1 buf[LOG_CHECKPOINT_SIZE];
+
+    buf[0] = LOG_CHECKPOINT_SYNC;
+    memcpy( &buf[1], fields, sizeof( fields ) ); // RA4M1はリトルエンディアン
+    write_raw( buf, sizeof( buf ) );
+
+    checkpoint_seq++;
+    checkpoint_crc.reset();
+    checkpoint_bytes = 0;
+    sync_pending = !streaming;
+}
+
+/*
+ * 概要：バッファの統計をログの最後に書き込む
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：バイナリの場合 形式(リトルエンディアン) : LOG_STATS_SYNC log_stats_tのメンバ(u4)をメンバ順に
+ *      csvの場合 "#ST,dropped_bytes,dropped_records,high_water,capacity,stalls,max_write_us,pressure_max,pressure_ms"の
+ *      順に値を並べたコメント行
+ *      ロギングを止めた後に呼ぶこと(バッファが空くまで待って書き込む)
+ */
+void mcr_logger::put_stats() {
+    static_assert( sizeof( log_stats_t ) + 1 == LOG_STATS_SIZE, "LOG_STATS_SIZEがlog_stats_tと合っていません" );
+
+    if ( binary ) {
+        u1 buf[LOG_STATS_SIZE];
+        buf[0] = LOG_STATS_SYNC;
+        memcpy( &buf[1], &stats, sizeof( stats ) ); // RA4M1はリトルエンディアン
+        write_out( buf, sizeof( buf ) );
+        return;
+    }
+
+    char line[128];
+    mini_snprintf( line, sizeof( line ), "#ST,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", stats.dropped_bytes, stats.dropped_records, stats.high_water,
+                   stats.capacity, stats.stalls, stats.max_write_us, stats.pressure_max, stats.pressure_ms );
+    put( line );
+}
+
 /*
  * 概要：ロギング終了
  * 引数：なし
- * 戻り値：trueのみ
- * 詳細：ロギングを終了する
+ * 戻り値：なし
+ * 詳細：ロギングを止め、バッファの統計を書き込んでから、ログファイルの終了処理を開始する
+ *      終了処理はexec()が少しずつ進めるため、この関数はすぐに戻る
+ *      終了処理が終わったかはis_finalizing()で確認すること
  */
 void mcr_logger::logging_end() {
     this->logging = false; // loggingはアトミック操作で設定されるので排他処理は不要
+    checkpointing = false;
+
+    if ( finalize_state != LOG_FINALIZE_IDLE || !file.isOpen() ) {
+        return;
+    }
+    if ( pressure != LOG_PRESSURE_NONE ) {
+        stats.pressure_ms += millis() - pressure_since;
+        pressure = LOG_PRESSURE_NONE;
+    }
+    if ( !fault ) {
+        put_stats();
+    }
+    streamed = streaming;
+    if ( streaming ) {
+        stream.flush();
+    } else {
+        finalize_total = rb.bytesUsed();
+    }
+    echo_lines = 0;
+    finalize_progress = 0;
+    finalize_state = LOG_FINALIZE_FLUSH;
+}
+
+/*
+ * 概要：ロガーの周期処理
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：セクタストリーミング中は書き込み待ちのセクタをSDカードへ渡す
+ *      リングバッファの場合、たまったログを書き出し、チェックポイントの後にキャッシュをSDカードへ書き出す
+ *      ロギング中はバッファの使用率から間引きの段階を更新する
+ *      終了処理中はLOG_FINALIZE_BUDGET_USの時間だけ終了処理を進める
+ *      loop()から毎周期呼ぶこと
+ */
+void mcr_logger::exec() {
+    if ( finalize_state != LOG_FINALIZE_IDLE ) {
+        u4 start = micros();
+        do {
+            finalize_step();
+        } while ( finalize_state != LOG_FINALIZE_IDLE && micros() - start < LOG_FINALIZE_BUDGET_US );
+        return;
+    }
+
+    if ( logging ) {
+        if ( !streaming ) {
+            drain();
+        }
+        update_pressure();
+    }
+    if ( !streaming ) {
+        // チェックポイントを書いたら、カードがbusyでないときにキャッシュを書き出す
+        if ( sync_pending && !file.isBusy() ) {
+            file.sync();
+            sync_pending = false;
+        }
+        return;
+    }
+    stream.poll();
+    if ( stream.get_errors() != 0 ) {
+        fault = true;
+    }
+}
 
-    wait_ms( 1000 );
+/*
+ * 概要：終了処理を1ステップ進める
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：1ステップではSDカードへの操作を1回(最大1セクタ分)だけ行う
+ *     LOG_FINALIZE_FLUSH    : バッファに残ったログを書き出す
+ *     LOG_FINALIZE_TRUNCATE : ファイル長を確定させる(セクタストリーミングの場合はフッタを書く)
+ *     LOG_FINALIZE_ECHO     : ログファイルの先頭をシリアルへ出力する(CONFIG_LOG_END_ECHO、csv形式のみ)
+ *                             送信バッファに空きが無いままLOG_END_ECHO_STALL_MS経ったら(USBの受信側が読んでいないなど)やめる
+ *     LOG_FINALIZE_CLOSE    : ファイルを閉じる
+ */
+void mcr_logger::finalize_step() {
+    switch ( finalize_state ) {
+    case LOG_FINALIZE_FLUSH:
+        if ( streaming ) {
+            stream.poll();
+            if ( stream.is_idle() ) {
+                sd_dev.end();
+                streaming = false;
+                finalize_state = LOG_FINALIZE_TRUNCATE;
+            }
+            finalize_progress = 40;
+        } else if ( rb.bytesUsed() > 0 ) {
+            if ( !file.isBusy() ) {
+                size_t n = rb.bytesUsed();
+                rb.writeOut( n < 512 ? n : 512 );
+            }
+            finalize_progress = finalize_total ? 80 * ( finalize_total - rb.bytesUsed() ) / finalize_total : 80;
+        } else {
+            file.sync();
+            finalize_state = LOG_FINALIZE_TRUNCATE;
+        }
+        break;
 
-    rb.sync();
-    file.truncate();
-    file.rewind();
+    case LOG_FINALIZE_TRUNCATE:
+        if ( !streamed ) {
+            file.truncate();
+        } else {
+            sd_blk.begin( sd.card() );
+            if ( binary && extent.finalize( &sd_blk, stream.get_bytes_accepted() ) ) {
+                file.truncate( extent.file_bytes() ); // データの直後のフッタまでを残す
+            } else {
+                file.truncate( stream.get_bytes_accepted() ); // 0で埋めた最後のセクタの余りを切り捨てる
+            }
+        }
+        file.rewind();
+        finalize_progress = 80;
+        echo_progress_ms = millis();
+        finalize_state = ( CONFIG_LOG_END_ECHO && !binary ) ? LOG_FINALIZE_ECHO : LOG_FINALIZE_CLOSE; // バイナリは行にならないため出力しない
+        break;
 
-    for ( uint8_t n = 0; n < 500 && file.available(); ) {
-        int c = file.read();
-        if ( c < 0 ) {
+    case LOG_FINALIZE_ECHO: {
+        // シリアルの送信バッファの空きの分だけ出力し、送信完了を待たない
+        int room = Serial.availableForWrite();
+        if ( room > LOG_END_ECHO_CHUNK ) {
+            room = LOG_END_ECHO_CHUNK;
+        }
+        if ( room <= 0 ) {
+            if ( millis() - echo_progress_ms >= LOG_END_ECHO_STALL_MS ) {
+                finalize_state = LOG_FINALIZE_CLOSE;
+            }
             break;
         }
-        Serial.write( c );
-        if ( c == '\n' )
-            n++;
+        echo_progress_ms = millis();
+        for ( int i = 0; i < room; i++ ) {
+            int c = file.available() ? file.read() : -1;
+            if ( c < 0 || echo_lines >= LOG_END_ECHO_LINES ) {
+                finalize_state = LOG_FINALIZE_CLOSE;
+                break;
+            }
+            Serial.write( c );
+            if ( c == '\n' ) {
+                echo_lines++;
+            }
+        }
+        finalize_progress = 80 + 19 * echo_lines / LOG_END_ECHO_LINES;
+        break;
     }
 
-    file.close();
-    // sd.end();
+    case LOG_FINALIZE_CLOSE:
+        file.close();
+        save_log_index( nullptr ); // 正常に閉じたので、init()での復旧は不要
+        finalize_progress = 100;
+        finalize_state = LOG_FINALIZE_IDLE;
+        break;
+
+    case LOG_FINALIZE_IDLE:
+    default:
+        break;
+    }
 }
 
 /***********************************/
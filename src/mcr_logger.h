@@ -4,10 +4,20 @@
 
 #pragma once
 #include <stdlib.h>
+#if defined( ARDUINO_ARCH_RENESAS )
 #include <SPI.h>
 #include "RingBuf.h"
 #include "SdFat.h"
+#include "sd_dma_device.h"
+#endif
+#include <CRC32.h>
 #include "defines.h"
+#include "features.h"
+#include "sector_stream.h"
+#include "log_extent.h"
+#include "delta_codec.h"
+#include "xfer_frame.h"
+#include "latency_histogram.h"
 
 /******************************************************************/
 /* Definitions                                                    */
@@ -17,6 +27,110 @@
 /***********************************/
 
 #define RING_BUF_CAPACITY ( 1024 ) // bytes
+#define LOG_STREAM_BUFFERS ( 3 )   // セクタストリーミング時のセクタバッファの面数
+
+#define LOG_FINALIZE_BUDGET_US ( 500 ) // exec()1回で終了処理に使う時間 LSB:1[us]
+#define LOG_END_ECHO_LINES ( 500 )     // 終了時にシリアルへ出力するログの行数
+#define LOG_END_ECHO_CHUNK ( 64 )      // 終了処理の1ステップでシリアルへ出力する最大バイト数
+#define LOG_END_ECHO_STALL_MS ( 500 )  // シリアルの送信バッファに空きが無いまま、この時間が経ったら出力をやめる LSB:1[ms]
+
+#define LOG_BINARY_MAGIC "MCRLOG2" // バイナリログファイルの先頭に書く識別子
+#define LOG_DELTA_MAGIC "MCRLOG3"  // 差分圧縮したバイナリログファイルの先頭に書く識別子
+#define LOG_RECORD_SYNC ( 0xA5 )   // バイナリログの各レコードの先頭に付ける同期バイト
+#define LOG_CHANNEL_MAX ( 32 )     // ログチャンネルの最大数(log_record_tのmaskのビット数)
+#define LOG_RECORD_DATA_MAX ( 64 ) // 1レコードに詰める値の最大バイト数
+
+#define LOG_CHECKPOINT_SYNC ( 0xA6 )           // バイナリログのチェックポイントの先頭に付ける同期バイト
+#define LOG_CHECKPOINT_SIZE ( 17 )             // チェックポイントのバイト数
+#define LOG_CHECKPOINT_SECTORS ( 8 )           // チェックポイントを書く間隔 LSB:1[sector]
+#define LOG_CHECKPOINT_SCAN ( 256 )            // 復旧時にチェックポイントを探す範囲(1レコードの最大バイト数より大きいこと)
+#define LOG_CHECKPOINT_HEADER_MAX ( 8 * 1024 ) // 復旧時に最初のチェックポイントを探す範囲(スキーマヘッダより大きいこと)
+
+#define LOG_FLIGHT_SYNC ( 0xA7 ) // バイナリログのフライトレコーダーのフレームの先頭に付ける同期バイト
+#define LOG_EVENT_SYNC ( 0xA8 )  // バイナリログのイベントの先頭に付ける同期バイト
+#define LOG_EVENT_SIZE ( 14 )    // イベントのバイト数
+#define LOG_STATS_SYNC ( 0xA9 )  // バイナリログの最後に書くバッファの統計の先頭に付ける同期バイト
+#define LOG_STATS_SIZE ( 33 )    // バッファの統計のバイト数
+#define LOG_INPUT_SYNC ( 0xAA )  // バイナリログのインプットレコーダーのフレームの先頭に付ける同期バイト
+
+#define LOG_PRESSURE_DECIMATE_PERCENT ( 75 ) // バッファの使用率がこれ以上になったら記録周期を間引く LSB:1[%]
+#define LOG_PRESSURE_PRIORITY_PERCENT ( 90 ) // バッファの使用率がこれ以上になったら優先チャンネルだけを記録する LSB:1[%]
+#define LOG_PRESSURE_RELEASE_PERCENT ( 50 )  // バッファの使用率がこれ未満になったら1段階戻す LSB:1[%]
+#define LOG_PRESSURE_DECIMATION ( 4 )        // 間引き中の記録周期の倍率
+
+#define XFER_TIMEOUT_MS ( 5000 )       // ダウンロード中、ホストからの要求が途絶えたら終了するまでの時間 LSB:1[ms]
+#define XFER_REQUEST_SECTORS ( 64 )    // 1回の要求で送る最大セクタ数
+#define XFER_REQUEST_PAYLOAD_MAX ( 8 ) // ホストから受け取るフレームの最大ペイロード長
+
+#define LOG_BENCH_FILE_SIZE ( 256 * 1024UL )       // ベンチマークで1回に書き込むバイト数
+#define LOG_BENCH_BUFFER_SIZES { 512, 1024, 4096 } // ベンチマークで試す1回の書き込みのバイト数(512の倍数)
+#define LOG_BENCH_BUFFER_MAX ( 4096 )              // LOG_BENCH_BUFFER_SIZESの最大値
+#define LOG_BENCH_PASSES ( 3 )                     // ベンチマークで1つのクロックを試す回数(全て通ったクロックだけを安定とみなす)
+
+// ログファイルの終了処理の状態
+enum e_log_finalize_state {
+    LOG_FINALIZE_IDLE = 0, // 終了処理中でない
+    LOG_FINALIZE_FLUSH,    // バッファに残ったログを書き出し中
+    LOG_FINALIZE_TRUNCATE, // ファイル長を確定する
+    LOG_FINALIZE_ECHO,     // ログをシリアルへ出力中
+    LOG_FINALIZE_CLOSE,    // ファイルを閉じる
+};
+
+// イベントの種類(スキーマヘッダのEVENTSセクションに番号と名前を書く)
+enum e_log_event {
+    LOG_EVENT_RUN_MODE = 0, // run_modeの変化 値:変化後のrun_mode
+    LOG_EVENT_RUN_STATUS,   // run_statusの変化 値:変化後のrun_status
+    LOG_EVENT_MARKER,       // 難所マーカーの確定 値:遷移先のrun_mode
+    LOG_EVENT_SECTION,      // セクションカウントの増加 値:増加後のセクションカウント
+    LOG_EVENT_FAILER,       // failerの変化 値:変化後のfailer
+    LOG_EVENT_PRESSURE,     // バッファの逼迫による間引きの段階の変化 値:変化後のe_log_pressure
+    LOG_EVENT_NUM,
+};
+
+// バッファの逼迫による間引きの段階(log_channels_sample()が参照する)
+enum e_log_pressure {
+    LOG_PRESSURE_NONE = 0, // 間引かない
+    LOG_PRESSURE_DECIMATE, // 全てのチャンネルの記録周期をLOG_PRESSURE_DECIMATION倍にする
+    LOG_PRESSURE_PRIORITY, // 優先チャンネル(記録周期1ms)だけを、記録周期をLOG_PRESSURE_DECIMATION倍にして記録する
+};
+
+// ロギング1回分のバッファの統計(ログの最後とsd statで出力する。値は全てu4)
+typedef struct {
+    u4 dropped_bytes;   // バッファに空きが無く捨てたバイト数
+    u4 dropped_records; // バッファに空きが無く捨てたレコード(イベント、フレームを含む)の数
+    u4 high_water;      // バッファの最大使用量 LSB:1[byte]
+    u4 capacity;        // バッファの容量 LSB:1[byte]
+    u4 stalls;          // 書き出すデータがたまっているのにカードがbusyで待たされた回数
+    u4 max_write_us;    // リングバッファの1回の書き出しにかかった最大時間 LSB:1[us]
+    u4 pressure_max;    // 最も強く間引いた段階(e_log_pressure)
+    u4 pressure_ms;     // 間引いていた時間の合計 LSB:1[ms]
+} log_stats_t;
+
+// ログチャンネルの型
+enum e_log_type {
+    LOG_TYPE_U1 = 0,
+    LOG_TYPE_S1,
+    LOG_TYPE_U2,
+    LOG_TYPE_S2,
+    LOG_TYPE_U4,
+    LOG_TYPE_S4,
+};
+
+// ログチャンネルの定義
+typedef struct {
+    const char* name; // チャンネル名(csvの列名)
+    e_log_type type;  // 型
+    const char* unit; // LSBと単位 例:"0.01m/s"
+    const void* ptr;  // 値の格納場所
+    u2 period_ms;     // 記録周期 LSB:1[ms] 1で1kHz
+} log_channel_t;
+
+// 1周期分のログレコード
+typedef struct {
+    u4 mask;                      // 記録したチャンネル bit i:チャンネルi
+    u1 len;                       // dataに詰めたバイト数
+    u1 data[LOG_RECORD_DATA_MAX]; // 記録したチャンネルの値をチャンネル順に詰めたもの
+} log_record_t;
 
 /***********************************/
 /* Class                           */
@@ -26,58 +140,117 @@ class mcr_logger {
     mcr_logger(){};
     ~mcr_logger(){};
     bool init();
-    bool make_log_file();
+    bool make_log_file( bool binary = false );
     void put( const char* str );
     void put_log( const char* str );
     void write_program_info();
-    void write_header( const char* header );
+    void write_header( const log_channel_t* channels, u1 num, const log_channel_t* flight_channels = nullptr, u1 flight_num = 0,
+                       const log_channel_t* input_channels = nullptr, u1 input_num = 0 );
     void logging_begin();
     void logging_end();
-    /*
-     * 概要：ロギングを実施する
-     * 引数：なし
-     * 戻り値：なし
-     * 詳細：SDカードにログを書き込む
-     *      1ms周期で呼び出すこと
-     *      引数を全てs4型として扱い、カンマ区切りの文字列にして書き込む
-     */
-    inline void mcr_logger_1ms( const s4* data, size_t len ) {
-        if ( logging && !fault ) {
-            size_t n = rb.bytesUsed();
-
-            if ( n >= 512 && !file.isBusy() ) {
-                if ( 512 != rb.writeOut( 512 ) ) {
-                }
-            }
-
-            rb.print( micros() );
-            rb.print( ',' );
-            for ( int i = 0; i < len; i++ ) {
-                rb.print( data[i] );
-                if ( i != len - 1 ) {
-                    rb.print( ',' );
-                }
-            }
-            rb.print( '\n' );
-        }
-    }
+    void exec();
+    void put_record( const log_channel_t* channels, u1 num, const log_record_t* record );
+    void put_flight_frame( u1 event, s2 offset, const void* frame, u1 len );
+    void put_input_frame( const void* frame, u1 len );
+    void put_event( e_log_event type, s4 value, u4 time_us, s4 distance_mm );
+    static const char* log_event_name( e_log_event type );
+    static u1 log_type_size( e_log_type type );
+    static s4 unpack_value( e_log_type type, const u1* data );
+    static const char* log_type_name( e_log_type type );
     void ls();
     void cat( const char* filename );
+    void download( const char* filename );
+    u1 bench( const u1* clocks, u1 clock_num );
     bool is_fault() {
         return fault;
     }
+    bool is_logging() {
+        return logging;
+    }
+    bool is_finalizing() {
+        return finalize_state != LOG_FINALIZE_IDLE;
+    }
+    /*
+     * 概要：終了処理の進捗を取得する
+     * 戻り値：進捗 LSB:1[%]
+     */
+    u1 get_finalize_progress() {
+        return finalize_progress;
+    }
+    /*
+     * 概要：バッファの逼迫による間引きの段階を取得する
+     * 戻り値：e_log_pressure
+     * 詳細：1msタスクから呼んでよい
+     */
+    u1 get_pressure() {
+        return pressure;
+    }
+    const log_stats_t* get_stats() {
+        return &stats;
+    }
+    size_t get_buffer_used();
 
   private:
+#if defined( ARDUINO_ARCH_RENESAS )
     SdFs sd;
     FsFile file;
 
     RingBuf<FsFile, RING_BUF_CAPACITY> rb;
-    size_t maxUsed = 0;
-    uint32_t m;
+#endif
 
-    uint32_t max_time = 0;
     bool fault = false;
     bool logging = false;
+    bool binary = false;     // 作成したログファイルがバイナリ形式か
+    u4 next_log_number = 0;  // 次に作成するログファイルの番号
+    u4 log_number = 0;       // 作成したログファイルの番号
+    delta_encoder delta_enc; // バイナリログの差分圧縮(CONFIG_LOG_COMPRESS)
+
+    // セクタストリーミング(CONFIG_LOG_SECTOR_STREAM)
+#if defined( ARDUINO_ARCH_RENESAS )
+    sd_dma_device sd_dev;
+    sector_stream<LOG_STREAM_BUFFERS> stream{ &sd_dev };
+    sd_block_device sd_blk;
+#endif
+    log_extent extent;      // ログファイルに確保した連続セクタ領域
+    bool streaming = false; // ログファイルの領域へセクタを直接書き込み中
+
+    // 終了処理
+    e_log_finalize_state finalize_state = LOG_FINALIZE_IDLE;
+    bool streamed = false;     // 終了処理中のファイルをセクタストリーミングで書き込んだか
+    size_t finalize_total = 0; // 終了処理開始時にリングバッファに残っていたバイト数
+    u2 echo_lines = 0;         // シリアルへ出力した行数
+    u4 echo_progress_ms = 0;   // 最後にシリアルへ出力できた時刻 LSB:1[ms]
+    u1 finalize_progress = 0;  // 終了処理の進捗 LSB:1[%]
+
+    // チェックポイント(バイナリログのみ)
+    bool checkpointing = false; // ロギング中でチェックポイントを書く
+    bool sync_pending = false;  // チェックポイントを書いたので、キャッシュを書き出す
+    u4 checkpoint_seq = 0;      // 次に書くチェックポイントの通し番号
+    u4 checkpoint_bytes = 0;    // 前回のチェックポイントから書き込んだバイト数
+    CRC32 checkpoint_crc;       // 前回のチェックポイントから書き込んだバイト列のCRC32
+
+    // バッファの統計と間引き
+    log_stats_t stats = {};   // ロギング1回分のバッファの統計
+    volatile u1 pressure = 0; // 間引きの段階(e_log_pressure)
+    bool stalled = false;     // カードがbusyで書き出しを待っている
+    u4 pressure_since = 0;    // 間引きを始めた時刻 LSB:1[ms]
+
+    void load_log_index();
+    bool save_log_index( const char* open_name );
+    bool recover_log( const char* name, u4 number );
+    void put_checkpoint();
+    void put_stats();
+    bool reserve( size_t len );
+    void drain();
+    void update_pressure();
+    size_t write_raw( const void* data, size_t len );
+    void write_schema( const log_channel_t* channels, u1 num, const log_channel_t* flight_channels, u1 flight_num,
+                       const log_channel_t* input_channels, u1 input_num );
+    void write_channels( const char* title, const log_channel_t* channels, u1 num );
+    void write_out( const void* data, size_t len );
+    void send_xfer_frame( u1* frame, u1 type, u2 len );
+    void finalize_step();
+    static void on_sector_written( void* context, uint32_t sector_index, bool ok );
 };
 
 /***********************************/
@@ -0,0 +1,121 @@
+/*
+ * 概要：ログの値の型とイベントの名前を扱う
+ * SDカードに依存しないため、ホスト(ネイティブ)ビルドでも使用する
+ */
+
+#include <string.h>
+#include "mcr_logger.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+
+/***********************************/
+/* Class implementions             */
+/***********************************/
+/*
+ * 概要：ログチャンネルの型のバイト数を取得する
+ * 引数：type 型
+ * 戻り値：バイト数
+ * 詳細：なし
+ */
+u1 mcr_logger::log_type_size( e_log_type type ) {
+    switch ( type ) {
+    case LOG_TYPE_U1:
+    case LOG_TYPE_S1:
+        return 1;
+    case LOG_TYPE_U2:
+    case LOG_TYPE_S2:
+        return 2;
+    case LOG_TYPE_U4:
+    case LOG_TYPE_S4:
+    default:
+        return 4;
+    }
+}
+
+/*
+ * 概要：ログレコードに詰めた値を1つ取り出す
+ * 引数：type 型 data 値の先頭
+ * 戻り値：値 符号付きの型は符号拡張する
+ * 詳細：u4はs4にそのまま入れるため、符号なしとして扱う場合はu4にキャストすること
+ */
+s4 mcr_logger::unpack_value( e_log_type type, const u1* data ) {
+    u4 raw = 0;
+    memcpy( &raw, data, log_type_size( type ) ); // RA4M1はリトルエンディアン
+    switch ( type ) {
+    case LOG_TYPE_S1:
+        return (signed char)raw; // s1(char)はARMでは符号なしのため
+    case LOG_TYPE_S2:
+        return (s2)raw;
+    default:
+        return (s4)raw;
+    }
+}
+
+/*
+ * 概要：ログチャンネルの型の名前を取得する
+ * 引数：type 型
+ * 戻り値：型の名前(スキーマヘッダに書く名前)
+ * 詳細：なし
+ */
+const char* mcr_logger::log_type_name( e_log_type type ) {
+    switch ( type ) {
+    case LOG_TYPE_U1:
+        return "u1";
+    case LOG_TYPE_S1:
+        return "s1";
+    case LOG_TYPE_U2:
+        return "u2";
+    case LOG_TYPE_S2:
+        return "s2";
+    case LOG_TYPE_U4:
+        return "u4";
+    case LOG_TYPE_S4:
+    default:
+        return "s4";
+    }
+}
+
+/*
+ * 概要：イベントの名前を取得する
+ * 引数：type イベントの種類
+ * 戻り値：イベントの名前
+ * 詳細：なし
+ */
+const char* mcr_logger::log_event_name( e_log_event type ) {
+    switch ( type ) {
+    case LOG_EVENT_RUN_MODE:
+        return "run_mode";
+    case LOG_EVENT_RUN_STATUS:
+        return "run_status";
+    case LOG_EVENT_MARKER:
+        return "marker";
+    case LOG_EVENT_SECTION:
+        return "section";
+    case LOG_EVENT_FAILER:
+        return "failer";
+    case LOG_EVENT_PRESSURE:
+        return "pressure";
+    default:
+        return "unknown";
+    }
+}
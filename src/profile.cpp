@@ -0,0 +1,111 @@
+/*
+ * 概要：1msタスクの各処理の実行時間を計測する
+ */
+#include <Arduino.h>
+#include "profile.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static cycle_profiler profile[PROFILE_STAGE_NUM];
+
+static const char* const profile_stage_names[PROFILE_STAGE_NUM] = {
+    "sensors", "servo", "motor", "log", "buzzer", "total",
+};
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+u2 profile_us[PROFILE_STAGE_NUM];
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+
+/***********************************/
+/* Class implementions             */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：プロファイラを初期化する
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：サイクルカウンタを有効にし、全区間の統計をクリアする
+ */
+void profile_init() {
+    cycle_counter_init();
+    profile_reset();
+}
+
+/*
+ * 概要：区間の終わりを記録する
+ * 引数：stage 区間、start 区間開始時のサイクルカウンタ値
+ * 戻り値：現在のサイクルカウンタ値(次の区間の開始値として使う)
+ * 詳細：割り込みコンテキストから呼ぶこと
+ */
+u4 profile_lap( enum e_profile_stage stage, u4 start ) {
+    u4 now = cycle_counter_read();
+    profile_add( stage, now - start );
+    return now;
+}
+
+/*
+ * 概要：区間のサイクル数を追加する
+ * 引数：stage 区間、cycles サイクル数
+ * 戻り値：なし
+ * 詳細：割り込みコンテキストから呼ぶこと
+ *      ログ用にprofile_usも更新する
+ */
+void profile_add( enum e_profile_stage stage, u4 cycles ) {
+    profile[stage].add( cycles );
+    profile_us[stage] = (u2)CYCLES_TO_US( cycles );
+}
+
+/*
+ * 概要：区間の統計を取得する
+ * 引数：stage 区間、out コピー先
+ * 戻り値：なし
+ * 詳細：1msタスクに更新されないよう、割り込み禁止中にコピーする
+ */
+void profile_get( enum e_profile_stage stage, cycle_profiler* out ) {
+    noInterrupts();
+    *out = profile[stage];
+    interrupts();
+}
+
+/*
+ * 概要：全区間の統計をクリアする
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：なし
+ */
+void profile_reset() {
+    noInterrupts();
+    for ( u1 i = 0; i < PROFILE_STAGE_NUM; i++ ) {
+        profile[i].reset();
+    }
+    interrupts();
+}
+
+/*
+ * 概要：区間の名前を取得する
+ * 引数：stage 区間
+ * 戻り値：区間の名前
+ * 詳細：なし
+ */
+const char* profile_stage_name( enum e_profile_stage stage ) {
+    return ( stage < PROFILE_STAGE_NUM ) ? profile_stage_names[stage] : "";
+}
@@ -0,0 +1,43 @@
+/*
+ * 概要：1msタスクの各処理の実行時間を計測する
+ */
+#pragma once
+#include <Arduino.h>
+#include "defines.h"
+#include "cycle_profiler.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+// 計測する処理の区間
+enum e_profile_stage {
+    PROFILE_STAGE_SENSORS = 0, // sensors_update_interrupt
+    PROFILE_STAGE_SERVO,       // servo_control
+    PROFILE_STAGE_MOTOR,       // motor_control
+    PROFILE_STAGE_LOG,         // ログ出力
+    PROFILE_STAGE_BUZZER,      // bz.process_1ms
+    PROFILE_STAGE_TOTAL,       // 1msタスク全体
+    PROFILE_STAGE_NUM,
+};
+
+/***********************************/
+/* Class                           */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+void profile_init();
+u4 profile_lap( enum e_profile_stage stage, u4 start );
+void profile_add( enum e_profile_stage stage, u4 cycles );
+void profile_get( enum e_profile_stage stage, cycle_profiler* out );
+void profile_reset();
+const char* profile_stage_name( enum e_profile_stage stage );
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern u2 profile_us[PROFILE_STAGE_NUM]; // 各区間の前回の実行時間 LSB:1[us]
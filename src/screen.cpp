@@ -606,14 +606,14 @@ void display_sensor_calibration() {
 
 #if defined( CONFIG_LINE_SENSOR_STEALTH )
     line_sensor_stealth* stealth = static_cast<line_sensor_stealth*>( &ls );
-    display_draw_str( 0, ROW_2, "%4d %4d", stealth->ar3->corrected(), stealth->ar3->raw );
-    display_draw_str( 0, ROW_3, "%4d %4d", stealth->ar2->corrected(), stealth->ar2->raw );
-    display_draw_str( 0, ROW_4, "%4d %4d", stealth->ar1->corrected(), stealth->ar1->raw );
-    display_draw_str( 0, ROW_5, "%4d %4d", stealth->ac->corrected(), stealth->ac->raw );
-    display_draw_str( 0, ROW_6, "%4d %4d", stealth->al1->corrected(), stealth->al1->raw );
-    display_draw_str( 0, ROW_7, "%4d %4d", stealth->al2->corrected(), stealth->al2->raw );
-    display_draw_str( 0, ROW_8, "%4d %4d", stealth->al3->corrected(), stealth->al3->raw );
-    display_draw_str( 0, ROW_10, " %4d", ls.line_error );
+    display_draw_str( 0, ROW_2, "%4d %4d", stealth->sensors.corrected[0], stealth->sensors.raw[0] );
+    display_draw_str( 0, ROW_3, "%4d %4d", stealth->sensors.corrected[1], stealth->sensors.raw[1] );
+    display_draw_str( 0, ROW_4, "%4d %4d", stealth->sensors.corrected[2], stealth->sensors.raw[2] );
+    display_draw_str( 0, ROW_5, "%4d %4d", stealth->sensors.corrected[3], stealth->sensors.raw[3] );
+    display_draw_str( 0, ROW_6, "%4d %4d", stealth->sensors.corrected[4], stealth->sensors.raw[4] );
+    display_draw_str( 0, ROW_7, "%4d %4d", stealth->sensors.corrected[5], stealth->sensors.raw[5] );
+    display_draw_str( 0, ROW_8, "%4d %4d", stealth->sensors.corrected[6], stealth->sensors.raw[6] );
+    display_draw_str( 0, ROW_10, " %4d %4d %4d", ls.line_error, stealth->line_width, stealth->line_contrast );
 #elif defined( CONFIG_LINE_SENSOR_D5A2 )
     line_sensor_d5a2* d5a2 = static_cast<line_sensor_d5a2*>( &ls );
     display_draw_str( COL_ITEM, ROW_2, "L" );
@@ -648,13 +648,13 @@ void display_sensor_calibration() {
             switch ( sensor_calibration_status ) {
             case CALIBRATION_W:
 #if defined( CONFIG_LINE_SENSOR_STEALTH )
-                prm_line_AR3_W = stealth->ar3->get();
-                prm_line_AR2_W = stealth->ar2->get();
-                prm_line_AR1_W = stealth->ar1->get();
-                prm_line_AC_W = stealth->ac->get();
-                prm_line_AL1_W = stealth->al1->get();
-                prm_line_AL2_W = stealth->al2->get();
-                prm_line_AL3_W = stealth->al3->get();
+                prm_line_AR3_W = stealth->sensors.raw[0];
+                prm_line_AR2_W = stealth->sensors.raw[1];
+                prm_line_AR1_W = stealth->sensors.raw[2];
+                prm_line_AC_W = stealth->sensors.raw[3];
+                prm_line_AL1_W = stealth->sensors.raw[4];
+                prm_line_AL2_W = stealth->sensors.raw[5];
+                prm_line_AL3_W = stealth->sensors.raw[6];
 #elif defined( CONFIG_LINE_SENSOR_D5A2 )
                 prm_line_trace_left_W = d5a2->line_left_raw;
                 prm_line_trace_right_W = d5a2->line_right_raw;
@@ -664,13 +664,13 @@ void display_sensor_calibration() {
                 break;
             case CALIBRATION_B:
 #if defined( CONFIG_LINE_SENSOR_STEALTH )
-                prm_line_AR3_B = stealth->ar3->get();
-                prm_line_AR2_B = stealth->ar2->get();
-                prm_line_AR1_B = stealth->ar1->get();
-                prm_line_AC_B = stealth->ac->get();
-                prm_line_AL1_B = stealth->al1->get();
-                prm_line_AL2_B = stealth->al2->get();
-                prm_line_AL3_B = stealth->al3->get();
+                prm_line_AR3_B = stealth->sensors.raw[0];
+                prm_line_AR2_B = stealth->sensors.raw[1];
+                prm_line_AR1_B = stealth->sensors.raw[2];
+                prm_line_AC_B = stealth->sensors.raw[3];
+                prm_line_AL1_B = stealth->sensors.raw[4];
+                prm_line_AL2_B = stealth->sensors.raw[5];
+                prm_line_AL3_B = stealth->sensors.raw[6];
 #elif defined( CONFIG_LINE_SENSOR_D5A2 )
                 prm_line_trace_left_B = d5a2->line_left_raw;
                 prm_line_trace_right_B = d5a2->line_right_raw;
@@ -680,6 +680,7 @@ void display_sensor_calibration() {
             default:
                 break;
             }
+            ls.reload_calibration();
         } else {
             sensor_calibration_cursor = 0;
             sensor_calibration_status = CALIBRATION_W;
@@ -749,6 +750,7 @@ void display_parameter_parameter() {
         [&]() {
             if ( parameter_parameter_cursor < prms.size() ) {
                 --( *( prms[parameter_parameter_cursor] ) );
+                ls.reload_calibration(); // キャリブレーションのパラメータの場合に補正へ反映する
             }
         },
         prms[parameter_parameter_cursor]->get_max_min_diff() );
@@ -756,6 +758,7 @@ void display_parameter_parameter() {
         [&]() {
             if ( parameter_parameter_cursor < prms.size() ) {
                 ++( *( prms[parameter_parameter_cursor] ) );
+                ls.reload_calibration(); // キャリブレーションのパラメータの場合に補正へ反映する
             }
         },
         prms[parameter_parameter_cursor]->get_max_min_diff() );
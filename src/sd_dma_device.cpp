@@ -0,0 +1,170 @@
+/*
+ * 概要：SDカードへのセクタ書き込みをSPI1とDMACで非同期に行う
+ */
+#include <Arduino.h>
+#include <SPI.h>
+#include "sd_dma_device.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define SD_TOKEN_WRITE_MULTIPLE ( 0xFC ) // マルチブロック書き込みのデータトークン
+#define SD_DATA_RES_MASK ( 0x1F )        // データレスポンスのマスク
+#define SD_DATA_RES_ACCEPTED ( 0x05 )    // データレスポンス:受理
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+
+/***********************************/
+/* Class implementions             */
+/***********************************/
+/*
+ * 概要：マルチブロック書き込みを開始する
+ * 引数：card SdFatのカード first_sector 書き込みを開始するセクタ
+ * 戻り値：成功:true 失敗:false
+ * 詳細：DMACを初期化し、SdFatにCMD25を発行させる
+ *      DMACの転送先はSPI1のデータレジスタ、起動要因はSPI1の送信バッファ空き(SPTI)
+ */
+bool sd_dma_device::begin( SdCard* card, uint32_t first_sector ) {
+    this->card = card;
+    transferring = false;
+    transferred = false;
+
+    if ( !opened ) {
+        dma.info.transfer_settings_word_b.dest_addr_mode = TRANSFER_ADDR_MODE_FIXED;
+        dma.info.transfer_settings_word_b.src_addr_mode = TRANSFER_ADDR_MODE_INCREMENTED;
+        dma.info.transfer_settings_word_b.repeat_area = TRANSFER_REPEAT_AREA_DESTINATION;
+        dma.info.transfer_settings_word_b.size = TRANSFER_SIZE_1_BYTE;
+        dma.info.transfer_settings_word_b.mode = TRANSFER_MODE_NORMAL;
+        dma.info.transfer_settings_word_b.irq = TRANSFER_IRQ_END;
+        dma.info.p_dest = (void*)&R_SPI1->SPDR_BY;
+        dma.info.length = SECTOR_SIZE;
+        dma.set_activation_source( ELC_EVENT_SPI1_TXI );
+        if ( !dma.setup_irq( dma_callback, 12, this ) ) {
+            return false;
+        }
+        if ( R_DMAC_Open( &dma.ctrl, &dma.cfg ) != FSP_SUCCESS ) {
+            return false;
+        }
+        opened = true;
+    }
+
+    return card->writeStart( first_sector );
+}
+
+/*
+ * 概要：マルチブロック書き込みを終了する
+ * 引数：なし
+ * 戻り値：成功:true 失敗:false
+ * 詳細：転送中の場合は終わるまで待ち、SdFatにストップトークンを送らせる
+ */
+bool sd_dma_device::end() {
+    while ( transferring || transferred ) {
+        poll();
+    }
+    return card->writeStop();
+}
+
+/*
+ * 概要：次のセクタの書き込みを開始できるか
+ * 引数：なし
+ * 戻り値：開始できる:true 転送中、またはカードが書き込み中(busy):false
+ * 詳細：カードはbusyの間MISOをLowにするので、0xFFが読めればreadyとする
+ */
+bool sd_dma_device::is_ready() {
+    if ( transferring || transferred ) {
+        return false;
+    }
+    return SPI1.transfer( 0xFF ) == 0xFF;
+}
+
+/*
+ * 概要：1セクタの書き込みを開始する
+ * 引数：sector 書き込むデータ(SECTOR_SIZEバイト)
+ * 戻り値：開始成功:true 失敗:false
+ * 詳細：データトークンを送った後、SPI1を送信専用にしてDMACで512バイトを送る
+ *      is_ready()がtrueのときに呼ぶこと
+ */
+bool sd_dma_device::start_write( const uint8_t* sector ) {
+    SPI1.transfer( SD_TOKEN_WRITE_MULTIPLE );
+
+    transferring = true;
+    if ( R_DMAC_Reset( &dma.ctrl, sector, (void*)&R_SPI1->SPDR_BY, SECTOR_SIZE ) != FSP_SUCCESS ) {
+        transferring = false;
+        return false;
+    }
+    spi_set_transmit_only( true ); // SPTIEを立てると最初の送信バッファ空きでDMACが起動する
+    return true;
+}
+
+/*
+ * 概要：転送の後処理を進める
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：DMA転送が終わり、SPI1の送信が全て終わっていれば、CRC(ダミー)を送ってデータレスポンスを確認し、完了を通知する
+ */
+void sd_dma_device::poll() {
+    if ( !transferred ) {
+        return;
+    }
+    if ( R_SPI1->SPSR_b.IDLNF ) {
+        return; // 最後のバイトを送信中
+    }
+    spi_set_transmit_only( false );
+
+    SPI1.transfer( 0xFF ); // CRC(SPIモードでは無視される)
+    SPI1.transfer( 0xFF );
+    u1 response = SPI1.transfer( 0xFF );
+
+    transferred = false;
+    notify_complete( ( response & SD_DATA_RES_MASK ) == SD_DATA_RES_ACCEPTED );
+}
+
+/*
+ * 概要：SPI1の送信専用モードを切り替える
+ * 引数：enable 送信専用にする:true 全二重に戻す:false
+ * 戻り値：なし
+ * 詳細：送信専用では受信データを読まなくてもオーバーランにならないため、DMACは送信側だけでよい
+ *      TXMDはSPEが0のときに変更する
+ */
+void sd_dma_device::spi_set_transmit_only( bool enable ) {
+    R_SPI1->SPCR_b.SPE = 0;
+    R_SPI1->SPCR_b.TXMD = enable ? 1 : 0;
+    R_SPI1->SPCR_b.SPTIE = enable ? 1 : 0;
+    R_SPI1->SPSR; // OVRFをクリアするために読む
+    R_SPI1->SPSR = 0;
+    R_SPI1->SPCR_b.SPE = 1;
+}
+
+/*
+ * 概要：DMA転送完了割り込み
+ * 引数：args DMACのコールバック引数
+ * 戻り値：なし
+ * 詳細：SPI1の送信はまだ続いているので、後処理はpoll()で行う
+ */
+void sd_dma_device::dma_callback( dmac_callback_args_t* args ) {
+    sd_dma_device* self = (sd_dma_device*)args->p_context;
+
+    R_SPI1->SPCR_b.SPTIE = 0;
+    self->transferring = false;
+    self->transferred = true;
+}
+
+/***********************************/
+/* Global functions                */
+/***********************************/
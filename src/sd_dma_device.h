@@ -0,0 +1,79 @@
+/*
+ * 概要：SDカードへのセクタ書き込みをSPI1とDMACで非同期に行う
+ */
+#pragma once
+#include <Arduino.h>
+#include <FspTransfer.h>
+#include "SdFat.h"
+#include "defines.h"
+#include "sector_stream.h"
+#include "log_extent.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define SD_DMA_CHANNEL ( 2 ) // 使用するDMACのチャンネル(0,1はSoftwareSerialが使う)
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：SDカードのマルチブロック書き込み(CMD25)の各セクタのデータ転送をDMACで行うクラス
+ * begin()でSdFatにマルチブロック書き込みを開始させ、以降のデータトークンとデータ転送を自前で行う
+ * データ512バイトの転送はDMACがSPI1の送信バッファ空き(SPTI)で1バイトずつ書き込み、CPUは待たない
+ * 転送完了後のCRC送信とデータレスポンスの確認はpoll()で行い、完了を通知する
+ * 注意：begin()からend()までの間、SPI1(SDカード)を他の処理から使わないこと
+ */
+class sd_dma_device : public sector_device {
+  public:
+    sd_dma_device() : dma( SD_DMA_CHANNEL ) {
+    }
+    ~sd_dma_device() {
+    }
+    bool begin( SdCard* card, uint32_t first_sector );
+    bool end();
+    bool is_ready() override;
+    bool start_write( const uint8_t* sector ) override;
+    void poll() override;
+
+  private:
+    FspDma dma;
+    SdCard* card = nullptr;
+    bool opened = false;
+    volatile bool transferring = false; // DMA転送中
+    volatile bool transferred = false;  // DMA転送が終わり、後処理待ち
+
+    void spi_set_transmit_only( bool enable );
+    static void dma_callback( dmac_callback_args_t* args );
+};
+
+/*
+ * 概要：SdFatのカードをセクタ単位で読み書きするブロックデバイス
+ * 注意：マルチブロック書き込み中(sd_dma_deviceのbegin()からend()まで)は使わないこと
+ */
+class sd_block_device : public block_device {
+  public:
+    void begin( SdCard* card ) {
+        this->card = card;
+    }
+    bool read_sector( uint32_t sector, uint8_t* buf ) override {
+        return card != nullptr && card->readSector( sector, buf );
+    }
+    bool write_sector( uint32_t sector, const uint8_t* buf ) override {
+        return card != nullptr && card->writeSector( sector, buf );
+    }
+
+  private:
+    SdCard* card = nullptr;
+};
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
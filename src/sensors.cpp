@@ -10,6 +10,7 @@
 #include "calibration.h"
 #include "mcr_gpt_lib.h"
 #include "line_sensor.h"
+#include "adc_scan.h"
 
 /******************************************************************/
 /* Definitions                                                    */
@@ -34,6 +35,7 @@ s4 distance;          // 走行距離 LSB:1[mm]
 s4 temperature; // 温度 LSB:1[degC]
 
 u4 servo_enc_pulse_1ms; // 1msあたりのサーボエンコーダのパルス数 LSB:1[-]
+s2 steer_angle_raw;     // ステアリング角度のエンコーダカウント(GPT7) LSB:1[-]
 s2 steer_angle;         // ステアリング角度 LSB:0.1[deg]
 
 u4 slope_raw;    // 坂センサーの生値 14bitADCの値 LSB:1[-]
@@ -83,7 +85,7 @@ static void slope_update() {
  */
 static void battery_update() {
     noInterrupts();
-    battery_voltage_raw = analogRead( PIN_BATT_VOLTAGE );
+    battery_voltage_raw = adc_scan_read( PIN_BATT_VOLTAGE );
     battery_voltage = battery_voltage_raw * 1400 / 4096; // LSB 0.01V
     interrupts();
 }
@@ -171,6 +173,7 @@ static void encoder_update() {
  */
 static void angle_update() {
     s2 servo_pulse_cnt = (s2)GPT7_CNT;
+    steer_angle_raw = servo_pulse_cnt;
     steer_angle = ( (s4)servo_pulse_cnt * 3600 ) / ( ANGLE_PULSE * CAR_STEER_GEAR_RATIO / 10 );
     steer_angle = -steer_angle;
 }
@@ -235,6 +238,11 @@ void sensors_init() {
 
     // バッテリー関連の初期化
     pinMode( PIN_BATT_VOLTAGE, INPUT );
+    adc_scan_add( PIN_BATT_VOLTAGE );
+
+    // 汎用ADCピンの初期化(ラインセンサーと同じスキャンで変換しておく)
+    adc_scan_add( PIN_GP_AN_1 );
+    adc_scan_add( PIN_GP_AN_2 );
 }
 
 /*
@@ -256,8 +264,10 @@ void sensors_update_period() {
  * 引数：なし
  * 戻り値：なし
  * 詳細：1ms周期割り込みタスク
+ *      A/D変換は1msタスクの直前にハードウェアで済んでいるため(adc_scan.cpp)、結果を読むだけ
  */
 void sensors_update_interrupt() {
+    adc_scan_wait();
     ls.update();
     encoder_update();
     angle_update();
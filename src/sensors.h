@@ -40,6 +40,7 @@ extern s4 distance;          // 走行距離 LSB:1[mm]
 extern s4 temperature; // 温度 LSB:1[degC]
 
 extern u4 servo_enc_pulse_1ms; // 1msあたりのサーボエンコーダのパルス数 LSB:1[-]
+extern s2 steer_angle_raw;     // ステアリング角度のエンコーダカウント(GPT7) LSB:1[-]
 extern s2 steer_angle;         // ステアリング角度 LSB:0.1[deg]
 
 extern u4 slope_raw;    // 坂センサーの生値 14bitADCの値 LSB:1[-]
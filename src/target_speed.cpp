@@ -7,6 +7,7 @@
 #include "sensors.h"
 #include "distance_measure.h"
 #include "calc_utils.h"
+#include "log_channels.h"
 
 /******************************************************************/
 /* Definitions                                                    */
@@ -160,6 +161,7 @@ static void difficult_target_speed_update() {
  * 詳細：セクションカウントを増やす
  *      セクション数が最大値を超えないようにする
  *      超えた場合は0に戻す
+ *      増やしたセクションカウントをイベントとして記録する
  */
 void increase_section_cnt() {
     if ( section_cnt < SECTION_MAX - 1 ) {
@@ -167,6 +169,7 @@ void increase_section_cnt() {
     } else {
         section_cnt = 0;
     }
+    log_event( LOG_EVENT_SECTION, section_cnt );
 }
 
 /*
@@ -174,6 +177,7 @@ void increase_section_cnt() {
  * 引数：run_mode 走行モード
  * 戻り値：なし
  * 詳細：難所読み取りからの距離計測をスタートする
+ *      確定した難所マーカーをイベントとして記録する
  */
 void start_difficult( enum e_run_mode mode ) {
     u1 idx = section_cnt;
@@ -182,6 +186,7 @@ void start_difficult( enum e_run_mode mode ) {
     case RUN_X_LINE_TRACE:
     case RUN_R_LANE_CHANGE:
     case RUN_L_LANE_CHANGE:
+        log_event( LOG_EVENT_MARKER, mode );
         run_mode_difficult = mode;
         speed_initial_from_marker = speed;
         difficult_marker_distance.restart();
@@ -208,9 +213,9 @@ void start_difficult( enum e_run_mode mode ) {
         // マーカー～難所開始までの距離(パラメータで設定した値)
         difficult_ctrl.difficult_distance = difficult_distances[idx]->get();
 
-        // 減速区間距離
+        // 減速区間距離 calc_target_speed()と同じ等加速度の式(v^2 - v0^2 = 2ad)で求める
         difficult_ctrl.distance_slow_down =
-            ( ( difficult_ctrl.speed_difficult - speed_initial_from_marker ) / DECELERATION ) * speed_initial_from_marker;
+            max( ( sq( difficult_ctrl.speed_difficult ) - sq( speed_initial_from_marker ) ) / ( 2 * DECELERATION ), 0 );
 
         // 安定区間距離(固定値)
         difficult_ctrl.distance_stable_buffer = DISTANCE_STALE_BUFFER;
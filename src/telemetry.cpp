@@ -0,0 +1,203 @@
+/*
+ * 概要：選択した信号をバイナリパケットでシリアルへ送信する(テレメトリ)
+ */
+#include <Arduino.h>
+#include <CRC32.h>
+#include "telemetry.h"
+#include "log_channels.h"
+#include "sensors.h"
+#include "line_sensor.h"
+#include "motor_control.h"
+#include "spsc_queue.h"
+#include "cobs.h"
+#include "mini-printf.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Local definitions               */
+/***********************************/
+#define TELEMETRY_PACKET_MAX ( 1 + 2 + TELEMETRY_SCHEMA_MAX + 4 )                           // 符号化前のパケットの最大バイト数
+#define TELEMETRY_FRAME_MAX ( cobs_encoded_max( TELEMETRY_PACKET_MAX ) + 1 )                  // 符号化して区切りを付けたパケットの最大バイト数
+#define TELEMETRY_SAMPLE_FRAME_MAX ( cobs_encoded_max( 1 + 2 + TELEMETRY_DATA_MAX + 4 ) + 1 ) // サンプルのパケットの最大バイト数
+
+/***********************************/
+/* Local Variables                 */
+/***********************************/
+static spsc_queue<telemetry_sample_t, TELEMETRY_QUEUE_DEPTH> telemetry_queue;
+static volatile bool enabled = CONFIG_TELEMETRY;  // 送信中
+static u2 seq = 0;                                // 次のサンプルの通し番号(1msタスクのみ更新)
+static u2 tick = 0;                               // 送信周期の判定に使う1msカウンタ
+static u4 sent = 0;                               // 送信したサンプルの数
+static u4 dropped = 0;                            // 送信バッファに空きが無く捨てたサンプルの数
+static u4 schema_time = 0;                        // 前回スキーマを送った時刻 LSB:1[ms]
+static bool schema_sent = false;                  // 送信開始後にスキーマを送ったか
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern u1 run_mode;
+
+/*
+ * テレメトリで送る信号の定義(パケットの値の順)
+ * 送る信号はここに追加すること。TELEMETRY_DATA_MAXを超えたチャンネルは送らない
+ */
+const log_channel_t telemetry_channels[] = {
+    LOG_CHANNEL( "run_mode", run_mode, "-", 1 ),
+    LOG_CHANNEL( "line_error", ls.line_error, "-", 1 ),
+    LOG_CHANNEL( "steer_angle", steer_angle, "0.1deg", 1 ),
+    LOG_CHANNEL( "speed", speed, "0.01m/s", 1 ),
+    LOG_CHANNEL( "FL", FL, "1%", 1 ),
+    LOG_CHANNEL( "FR", FR, "1%", 1 ),
+    LOG_CHANNEL( "RL", RL, "1%", 1 ),
+    LOG_CHANNEL( "RR", RR, "1%", 1 ),
+    LOG_CHANNEL( "SV", SV, "1%", 1 ),
+};
+const u1 telemetry_channel_num = array_size( telemetry_channels );
+
+/******************************************************************/
+/* Implementation                                                 */
+/******************************************************************/
+/***********************************/
+/* Local functions                 */
+/***********************************/
+/*
+ * 概要：パケットを符号化して送信する
+ * 引数：type 種類 number 通し番号 payload ペイロード len ペイロードのバイト数
+ * 戻り値：なし
+ * 詳細：送信バッファに空きがあることを確認してから呼ぶこと
+ */
+static void send_packet( u1 type, u2 number, const u1* payload, u2 len ) {
+    static u1 packet[TELEMETRY_PACKET_MAX];
+    static u1 frame[TELEMETRY_FRAME_MAX];
+
+    packet[0] = type;
+    packet[1] = (u1)number;
+    packet[2] = (u1)( number >> 8 );
+    memcpy( &packet[3], payload, len );
+    u4 crc = CRC32::calculate( packet, 3 + len );
+    memcpy( &packet[3 + len], &crc, sizeof( crc ) ); // RA4M1はリトルエンディアン
+
+    size_t n = cobs_encode( packet, 3 + len + sizeof( crc ), frame );
+    frame[n++] = 0x00;
+    Serial.write( frame, n );
+}
+
+/*
+ * 概要：スキーマのテキストを送信する
+ * 引数：なし
+ * 戻り値：送信した:true 送信バッファに空きが無い:false
+ */
+static bool send_schema() {
+    char text[TELEMETRY_SCHEMA_MAX];
+    s4 len = 0;
+
+    if ( Serial.availableForWrite() < TELEMETRY_FRAME_MAX ) {
+        return false;
+    }
+    for ( u1 i = 0; i < telemetry_channel_num; i++ ) {
+        const log_channel_t* ch = &telemetry_channels[i];
+        len += mini_snprintf( &text[len], sizeof( text ) - len, "%s,%s,%s\n", ch->name, mcr_logger::log_type_name( ch->type ),
+                              ch->unit );
+    }
+    send_packet( TELEMETRY_TYPE_SCHEMA, 0, (const u1*)text, len );
+    return true;
+}
+
+/***********************************/
+/* Class implementions             */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：送信周期になったらtelemetry_channelsの値をサンプルに詰めてloop()へ渡す
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：1msタスクから毎周期呼ぶこと
+ *      キューが満杯の場合は捨てる(通し番号は進めるため、ホスト側で抜けとしてわかる)
+ */
+void telemetry_sample() {
+    if ( !enabled ) {
+        return;
+    }
+    if ( ++tick < CONFIG_TELEMETRY_PERIOD_MS ) {
+        return;
+    }
+    tick = 0;
+
+    telemetry_sample_t sample;
+    sample.seq = seq++;
+    sample.len = 0;
+    for ( u1 i = 0; i < telemetry_channel_num; i++ ) {
+        const log_channel_t* ch = &telemetry_channels[i];
+        u1 size = mcr_logger::log_type_size( ch->type );
+        if ( sample.len + size > TELEMETRY_DATA_MAX ) {
+            break;
+        }
+        memcpy( &sample.data[sample.len], ch->ptr, size );
+        sample.len += size;
+    }
+    telemetry_queue.push( sample );
+}
+
+/*
+ * 概要：サンプルをシリアルへ送信する
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：loop()から呼ぶこと
+ *      送信バッファに空きがある分だけ送り、送信完了を待たない(制御周期を延ばさないため)
+ *      空きが無いサンプルは捨てて数える
+ *      ホストが途中から受信しても値を解釈できるよう、TELEMETRY_SCHEMA_PERIOD_MSごとにスキーマを送る
+ */
+void telemetry_task() {
+    telemetry_sample_t sample;
+
+    if ( !enabled ) {
+        return;
+    }
+    if ( !schema_sent || millis() - schema_time >= TELEMETRY_SCHEMA_PERIOD_MS ) {
+        if ( send_schema() ) {
+            schema_sent = true;
+            schema_time = millis();
+        }
+    }
+    while ( telemetry_queue.pop( &sample ) ) {
+        if ( Serial.availableForWrite() < TELEMETRY_SAMPLE_FRAME_MAX ) {
+            dropped++;
+            continue;
+        }
+        send_packet( TELEMETRY_TYPE_SAMPLE, sample.seq, sample.data, sample.len );
+        sent++;
+    }
+}
+
+/*
+ * 概要：テレメトリの送信を開始、停止する
+ * 引数：on true:開始 false:停止
+ * 戻り値：なし
+ * 詳細：開始時はすぐにスキーマを送る
+ */
+void telemetry_set_enabled( bool on ) {
+    schema_sent = false;
+    enabled = on;
+}
+
+bool telemetry_is_enabled() {
+    return enabled;
+}
+
+u4 telemetry_get_sent() {
+    return sent;
+}
+
+/*
+ * 概要：送れなかったサンプルの数を取得する
+ * 引数：なし
+ * 戻り値：送信バッファに空きが無く捨てた数と、キューが満杯で捨てた数の合計
+ */
+u4 telemetry_get_dropped() {
+    return dropped + telemetry_queue.get_dropped();
+}
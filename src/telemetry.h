@@ -0,0 +1,61 @@
+/*
+ * 概要：選択した信号をバイナリパケットでシリアルへ送信する(テレメトリ)
+ */
+#pragma once
+#include <Arduino.h>
+#include "defines.h"
+#include "features.h"
+#include "mcr_logger.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+/*
+ * パケットの形式(リトルエンディアン)
+ *   COBS( 種類(u1) 通し番号(u2) ペイロード CRC32(u4) ) 0x00
+ *   CRC32は種類からペイロードの最後までを対象にする
+ *   TELEMETRY_TYPE_SAMPLE : ペイロードはtelemetry_channelsの値をチャンネル順に詰めたもの
+ *                           通し番号は1周期ごとに増えるため、抜けた番号で送れなかったパケットがわかる
+ *   TELEMETRY_TYPE_SCHEMA : ペイロードは1行に1チャンネル "名前,型,LSBと単位" のテキスト
+ */
+#define TELEMETRY_TYPE_SAMPLE ( 0x01 )
+#define TELEMETRY_TYPE_SCHEMA ( 0x02 )
+
+#if CONFIG_TELEMETRY
+#define TELEMETRY_QUEUE_DEPTH ( 8 )          // 1msタスクからloop()へ渡すサンプルの数(2のべき乗)
+#else
+#define TELEMETRY_QUEUE_DEPTH ( 1 )          // 無効のときはRAMを使わない(telemコマンドで開始した場合は抜けが増える)
+#endif
+#define TELEMETRY_DATA_MAX ( 32 )            // 1サンプルの値の最大バイト数
+#define TELEMETRY_SCHEMA_MAX ( 192 )         // スキーマのテキストの最大バイト数
+#define TELEMETRY_SCHEMA_PERIOD_MS ( 1000 )  // スキーマを送る周期 LSB:1[ms]
+
+// 1周期分のサンプル
+typedef struct {
+    u2 seq;                       // 通し番号
+    u1 len;                       // dataに詰めたバイト数
+    u1 data[TELEMETRY_DATA_MAX];  // telemetry_channelsの値をチャンネル順に詰めたもの
+} telemetry_sample_t;
+
+/***********************************/
+/* Class                           */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+void telemetry_sample();
+void telemetry_task();
+void telemetry_set_enabled( bool on );
+bool telemetry_is_enabled();
+u4 telemetry_get_sent();
+u4 telemetry_get_dropped();
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+extern const log_channel_t telemetry_channels[];
+extern const u1 telemetry_channel_num;
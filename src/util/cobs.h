@@ -0,0 +1,77 @@
+/*
+ * 概要：COBS(Consistent Overhead Byte Stuffing)によるフレームの符号化
+ * Arduinoに依存しないため、ホスト(ネイティブ)ビルドでも使用できる
+ * 符号化したデータは0x00を含まないため、0x00をフレームの区切りに使える
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define cobs_encoded_max( len ) ( ( len ) + ( len ) / 254 + 1 ) // lenバイトを符号化した最大バイト数(区切りの0x00を含まない)
+
+/***********************************/
+/* Class                           */
+/***********************************/
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：COBSで符号化する
+ * 引数：in 符号化するデータ len バイト数 out 格納先(cobs_encoded_max(len)バイト以上)
+ * 戻り値：符号化したバイト数(区切りの0x00は含まない)
+ */
+static inline size_t cobs_encode( const uint8_t* in, size_t len, uint8_t* out ) {
+    size_t code_pos = 0;
+    size_t pos = 1;
+    uint8_t code = 1;
+
+    for ( size_t i = 0; i < len; i++ ) {
+        if ( in[i] != 0 ) {
+            out[pos++] = in[i];
+            code++;
+        }
+        if ( in[i] == 0 || code == 0xFF ) {
+            out[code_pos] = code;
+            code_pos = pos++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+    return pos;
+}
+
+/*
+ * 概要：COBSを復号する
+ * 引数：in 符号化したデータ(区切りの0x00は含まない) len バイト数 out 格納先(lenバイト以上)
+ * 戻り値：復号したバイト数 符号化が正しくない場合は0
+ */
+static inline size_t cobs_decode( const uint8_t* in, size_t len, uint8_t* out ) {
+    size_t pos = 0;
+    size_t n = 0;
+
+    while ( pos < len ) {
+        uint8_t code = in[pos++];
+        if ( code == 0 || pos + code - 1 > len ) {
+            return 0;
+        }
+        for ( uint8_t i = 1; i < code; i++ ) {
+            out[n++] = in[pos++];
+        }
+        if ( code != 0xFF && pos < len ) {
+            out[n++] = 0;
+        }
+    }
+    return n;
+}
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
@@ -0,0 +1,65 @@
+/*
+ * 概要：CPUサイクルカウンタ(DWT CYCCNT)を扱う
+ * ホスト(ネイティブ)ビルド時はDWTが無いため、任意に進められるスタブのカウンタを使用する
+ */
+
+#pragma once
+#include <stdint.h>
+#if defined( ARDUINO_ARCH_RENESAS )
+#include <Arduino.h>
+#endif
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define CPU_CLOCK_HZ ( 48000000UL )                           // CPUクロック LSB:1[Hz]
+#define CYCLES_PER_US ( CPU_CLOCK_HZ / 1000000UL )            // 1usあたりのサイクル数
+#define CYCLES_TO_US( cycles ) ( ( cycles ) / CYCLES_PER_US ) // サイクル数をusに変換する
+
+/***********************************/
+/* Class                           */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
+#if !defined( ARDUINO_ARCH_RENESAS )
+// ホストビルド用のスタブカウンタ。テストコードから直接値を進めること
+inline uint32_t cycle_counter_stub = 0;
+#endif
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：サイクルカウンタを有効にする
+ * 引数：なし
+ * 戻り値：なし
+ * 詳細：DWTのトレースを有効にし、CYCCNTのカウントを開始する
+ */
+static inline void cycle_counter_init() {
+#if defined( ARDUINO_ARCH_RENESAS )
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#else
+    cycle_counter_stub = 0;
+#endif
+}
+
+/*
+ * 概要：サイクルカウンタの現在値を読む
+ * 引数：なし
+ * 戻り値：サイクルカウンタ値 LSB:1[cycle]
+ * 詳細：約89秒(48MHz)で一周するため、差分はu4同士の引き算で求めること
+ */
+static inline uint32_t cycle_counter_read() {
+#if defined( ARDUINO_ARCH_RENESAS )
+    return DWT->CYCCNT;
+#else
+    return cycle_counter_stub;
+#endif
+}
@@ -0,0 +1,112 @@
+/*
+ * 概要：処理時間(CPUサイクル数)の統計を取るクラス
+ * Arduinoに依存しないため、ホスト(ネイティブ)ビルドでも使用できる
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "cycle_counter.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define CYCLE_PROFILER_HIST_BINS ( 12 )                  // ヒストグラムのビン数(最後のビンは上限超え)
+#define CYCLE_PROFILER_HIST_BASE_CYCLES ( CYCLES_PER_US ) // ヒストグラムの最初のビンの上限 1[us]
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：処理時間の統計を取るクラス
+ * add()でサイクル数を追加すると、最小、平均、最大とヒストグラムを更新します
+ * ヒストグラムは2倍刻み(対数)で、ビン0は1us未満、ビンn(1～10)は2^(n-1)us以上2^n us未満、
+ * 最後のビンには1024us以上の全てのサンプルが入ります(数usの区間から1ms周期の超過まで区別できる)
+ * 注意：割り込みコンテキストから更新する場合、読み出し側は割り込み禁止中にコピーを取ること
+ */
+class cycle_profiler {
+  public:
+    cycle_profiler() {
+        reset();
+    }
+    ~cycle_profiler() {
+    }
+    void reset() {
+        min_cycles = UINT32_MAX;
+        max_cycles = 0;
+        last_cycles = 0;
+        count = 0;
+        sum_cycles = 0;
+        memset( hist, 0, sizeof( hist ) );
+    }
+    void add( uint32_t cycles ) {
+        hist[bin_of( cycles )]++;
+
+        if ( cycles < min_cycles ) {
+            min_cycles = cycles;
+        }
+        if ( cycles > max_cycles ) {
+            max_cycles = cycles;
+        }
+        last_cycles = cycles;
+        sum_cycles += cycles;
+        count++;
+    }
+    uint32_t get_min() {
+        return count ? min_cycles : 0;
+    }
+    uint32_t get_max() {
+        return max_cycles;
+    }
+    uint32_t get_mean() {
+        return count ? (uint32_t)( sum_cycles / count ) : 0;
+    }
+    uint32_t get_last() {
+        return last_cycles;
+    }
+    uint32_t get_count() {
+        return count;
+    }
+    uint32_t get_hist( uint8_t bin ) {
+        return ( bin < CYCLE_PROFILER_HIST_BINS ) ? hist[bin] : 0;
+    }
+
+    /*
+     * 概要：サイクル数が入るヒストグラムのビンを求める
+     * 引数：cycles サイクル数
+     * 戻り値：ビンの番号
+     */
+    static uint8_t bin_of( uint32_t cycles ) {
+        uint32_t units = cycles / CYCLE_PROFILER_HIST_BASE_CYCLES;
+        uint32_t bin = ( units == 0 ) ? 0 : 32 - __builtin_clz( units );
+        return ( bin < CYCLE_PROFILER_HIST_BINS ) ? bin : CYCLE_PROFILER_HIST_BINS - 1;
+    }
+
+    /*
+     * 概要：ヒストグラムのビンの下限を求める
+     * 引数：bin ビンの番号
+     * 戻り値：下限 LSB:1[cycle]
+     */
+    static uint32_t bin_floor( uint8_t bin ) {
+        return ( bin == 0 ) ? 0 : CYCLE_PROFILER_HIST_BASE_CYCLES << ( bin - 1 );
+    }
+
+  private:
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint32_t last_cycles;
+    uint32_t count;
+    uint64_t sum_cycles;
+    uint32_t hist[CYCLE_PROFILER_HIST_BINS];
+};
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
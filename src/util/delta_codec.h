@@ -0,0 +1,327 @@
+/*
+ * 概要：ログレコードを前回値との差分(デルタ)とzigzag/varintで圧縮する
+ * Arduinoに依存しないため、ホスト(ネイティブ)ビルドでも使用できる
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define DELTA_CODEC_CHANNELS ( 32 )                                     // チャンネルの最大数(maskのビット数)
+#define DELTA_CODEC_KEYFRAME_MARKER0 ( 0xA5 )                           // キーフレームの1バイト目
+#define DELTA_CODEC_KEYFRAME_MARKER1 ( 0x5A )                           // キーフレームの2バイト目
+#define DELTA_CODEC_KEYFRAME_INTERVAL ( 1000 )                          // キーフレームを入れる間隔[レコード]
+#define DELTA_CODEC_RECORD_MAX ( 1 + 5 + 5 + DELTA_CODEC_CHANNELS * 5 ) // 1レコードの最大バイト数
+#define DELTA_CODEC_FLAG_NEW_MASK ( 0x01 )                              // デルタのヘッダ:maskが前回から変わった
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：符号付きの値を、絶対値が小さいほど小さな符号なしの値に変換する(0,-1,1,-2... -> 0,1,2,3...)
+ */
+static inline uint32_t zigzag_encode( int32_t v ) {
+    return ( (uint32_t)v << 1 ) ^ (uint32_t)( v >> 31 );
+}
+
+/*
+ * 概要：zigzag_encode()の逆変換
+ */
+static inline int32_t zigzag_decode( uint32_t v ) {
+    return (int32_t)( ( v >> 1 ) ^ ( 0U - ( v & 1 ) ) );
+}
+
+/*
+ * 概要：varint(7ビットずつ、下位から、最上位ビットが継続フラグ)を書く
+ * 戻り値：書いたバイト数(1～5)
+ */
+static inline size_t varint_write( uint32_t v, uint8_t* out ) {
+    size_t n = 0;
+    while ( v >= 0x80 ) {
+        out[n++] = (uint8_t)( v | 0x80 );
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+/*
+ * 概要：varintを読む
+ * 戻り値：読んだバイト数 データが足りない、または5バイトを超える場合は0
+ */
+static inline size_t varint_read( const uint8_t* in, size_t len, uint32_t* v ) {
+    uint32_t result = 0;
+    for ( size_t n = 0; n < len && n < 5; n++ ) {
+        result |= (uint32_t)( in[n] & 0x7F ) << ( 7 * n );
+        if ( ( in[n] & 0x80 ) == 0 ) {
+            *v = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * 概要：ログレコードを差分で圧縮するクラス
+ * レコードは2種類あり、DELTA_CODEC_KEYFRAME_INTERVALレコードごとにキーフレームを入れます
+ *   キーフレーム : 0xA5 0x5A 長さ(u1) ペイロード チェックサム(ペイロードのバイトの和の下位8ビット)
+ *                  ペイロードはmask(varint)と、maskのチャンネルの値(zigzag varint)
+ *                  キーフレームの前に全チャンネルの前回値を0に戻すため、値はそのまま(絶対値)になる
+ *   デルタ       : ヘッダ(u1) [mask(varint)] changed(varint) 差分(zigzag varint)...
+ *                  ヘッダのDELTA_CODEC_FLAG_NEW_MASKが立っていればmaskが続く。立っていなければ前回と同じmask
+ *                  changedのビットkは、maskのk番目(下位から数えて)のチャンネルの値が変わったことを表す
+ *                  変わったチャンネルの分だけ、前回値との差分が続く
+ * デルタのヘッダは0xA5にならないため、データが壊れた場合は次のキーフレームを探して復帰できます
+ * 値が変わらないチャンネルは0バイトで済むため、ゆっくり変わるチャンネルが多いほど小さくなります
+ */
+class delta_encoder {
+  public:
+    delta_encoder( uint32_t keyframe_interval = DELTA_CODEC_KEYFRAME_INTERVAL ) : keyframe_interval( keyframe_interval ) {
+        reset();
+    }
+    ~delta_encoder() {
+    }
+    /*
+     * 概要：次のレコードをキーフレームから始める
+     */
+    void reset() {
+        count = 0;
+    }
+    /*
+     * 概要：1レコードを圧縮する
+     * 引数：mask 記録したチャンネル values チャンネル番号で引く値の配列(maskのチャンネルのみ参照)
+     *      out 出力先(DELTA_CODEC_RECORD_MAXバイト以上)
+     * 戻り値：出力したバイト数
+     */
+    size_t encode( uint32_t mask, const int32_t* values, uint8_t* out ) {
+        size_t n = 0;
+
+        if ( count % keyframe_interval == 0 ) {
+            memset( prev, 0, sizeof( prev ) );
+            out[n++] = DELTA_CODEC_KEYFRAME_MARKER0;
+            out[n++] = DELTA_CODEC_KEYFRAME_MARKER1;
+            n++; // 長さは後で書く
+            size_t payload = n;
+            n += varint_write( mask, &out[n] );
+            for ( uint8_t i = 0; i < DELTA_CODEC_CHANNELS; i++ ) {
+                if ( mask & ( 1UL << i ) ) {
+                    n += varint_write( zigzag_encode( values[i] ), &out[n] );
+                    prev[i] = values[i];
+                }
+            }
+            uint8_t sum = 0;
+            for ( size_t i = payload; i < n; i++ ) {
+                sum += out[i];
+            }
+            out[payload - 1] = (uint8_t)( n - payload );
+            out[n++] = sum;
+        } else {
+            uint32_t changed = 0;
+            uint8_t k = 0;
+            for ( uint8_t i = 0; i < DELTA_CODEC_CHANNELS; i++ ) {
+                if ( mask & ( 1UL << i ) ) {
+                    if ( values[i] != prev[i] ) {
+                        changed |= 1UL << k;
+                    }
+                    k++;
+                }
+            }
+            out[n++] = ( mask != prev_mask ) ? DELTA_CODEC_FLAG_NEW_MASK : 0;
+            if ( mask != prev_mask ) {
+                n += varint_write( mask, &out[n] );
+            }
+            n += varint_write( changed, &out[n] );
+            for ( uint8_t i = 0; i < DELTA_CODEC_CHANNELS; i++ ) {
+                if ( ( mask & ( 1UL << i ) ) && values[i] != prev[i] ) {
+                    n += varint_write( zigzag_encode( (int32_t)( (uint32_t)values[i] - (uint32_t)prev[i] ) ), &out[n] );
+                    prev[i] = values[i];
+                }
+            }
+        }
+        prev_mask = mask;
+        count++;
+        return n;
+    }
+
+  private:
+    int32_t prev[DELTA_CODEC_CHANNELS]; // 各チャンネルの前回値
+    uint32_t prev_mask = 0;             // 前回のレコードのmask
+    uint32_t count;                     // キーフレームからのレコード数
+    uint32_t keyframe_interval;
+};
+
+/*
+ * 概要：delta_encoderで圧縮したレコードを復元するクラス
+ * 最初のキーフレームより前のデータ、壊れたデータは次のキーフレームまで読み飛ばします
+ */
+class delta_decoder {
+  public:
+    delta_decoder() {
+        reset();
+    }
+    ~delta_decoder() {
+    }
+    void reset() {
+        synced = false;
+        skipped = 0;
+    }
+    /*
+     * 概要：1レコードを復元する
+     * 引数：in 入力 len 入力のバイト数 mask 復元したmask values チャンネル番号で引く値の配列
+     * 戻り値：読んだバイト数 データが足りない場合は0
+     * 詳細：maskのチャンネルのみvaluesに書く。読み飛ばしたバイト数はget_skipped()で取得できる
+     */
+    size_t decode( const uint8_t* in, size_t len, uint32_t* mask, int32_t* values ) {
+        size_t pos = 0;
+
+        while ( pos < len ) {
+            size_t n;
+            if ( in[pos] == DELTA_CODEC_KEYFRAME_MARKER0 ) {
+                n = decode_keyframe( &in[pos], len - pos, mask, values );
+                if ( n == SIZE_MAX ) {
+                    return 0; // データが足りない
+                }
+            } else if ( synced ) {
+                n = decode_delta( &in[pos], len - pos, mask, values );
+                if ( n == SIZE_MAX ) {
+                    return 0;
+                }
+            } else {
+                n = 0;
+            }
+            if ( n != 0 ) {
+                return pos + n;
+            }
+            synced = false;
+            skipped++;
+            pos++;
+        }
+        return 0;
+    }
+    uint32_t get_skipped() {
+        return skipped;
+    }
+
+  private:
+    int32_t prev[DELTA_CODEC_CHANNELS];
+    uint32_t prev_mask = 0;
+    bool synced;
+    uint32_t skipped; // 読み飛ばしたバイト数
+
+    // 戻り値：読んだバイト数 形式が正しくない場合は0 データが足りない場合はSIZE_MAX
+    size_t decode_keyframe( const uint8_t* in, size_t len, uint32_t* mask, int32_t* values ) {
+        if ( len < 3 ) {
+            return SIZE_MAX;
+        }
+        if ( in[1] != DELTA_CODEC_KEYFRAME_MARKER1 ) {
+            return 0;
+        }
+        size_t payload_len = in[2];
+        if ( len < 3 + payload_len + 1 ) {
+            return SIZE_MAX;
+        }
+        const uint8_t* payload = &in[3];
+        uint8_t sum = 0;
+        for ( size_t i = 0; i < payload_len; i++ ) {
+            sum += payload[i];
+        }
+        if ( sum != in[3 + payload_len] ) {
+            return 0;
+        }
+
+        int32_t v[DELTA_CODEC_CHANNELS] = { 0 };
+        uint32_t m;
+        size_t n = varint_read( payload, payload_len, &m );
+        if ( n == 0 ) {
+            return 0;
+        }
+        for ( uint8_t i = 0; i < DELTA_CODEC_CHANNELS; i++ ) {
+            if ( m & ( 1UL << i ) ) {
+                uint32_t z;
+                size_t r = varint_read( &payload[n], payload_len - n, &z );
+                if ( r == 0 ) {
+                    return 0;
+                }
+                v[i] = zigzag_decode( z );
+                n += r;
+            }
+        }
+        if ( n != payload_len ) {
+            return 0;
+        }
+
+        memcpy( prev, v, sizeof( prev ) );
+        prev_mask = m;
+        synced = true;
+        output( m, mask, values );
+        return 3 + payload_len + 1;
+    }
+    size_t decode_delta( const uint8_t* in, size_t len, uint32_t* mask, int32_t* values ) {
+        size_t n = 1;
+        uint32_t m = prev_mask;
+        uint32_t changed;
+        size_t r;
+
+        if ( in[0] & ~DELTA_CODEC_FLAG_NEW_MASK ) {
+            return 0;
+        }
+        if ( in[0] & DELTA_CODEC_FLAG_NEW_MASK ) {
+            if ( ( r = varint_read( &in[n], len - n, &m ) ) == 0 ) {
+                return len - n < 5 ? SIZE_MAX : 0;
+            }
+            n += r;
+        }
+        if ( ( r = varint_read( &in[n], len - n, &changed ) ) == 0 ) {
+            return len - n < 5 ? SIZE_MAX : 0;
+        }
+        n += r;
+
+        int32_t v[DELTA_CODEC_CHANNELS];
+        memcpy( v, prev, sizeof( v ) );
+        uint8_t k = 0;
+        for ( uint8_t i = 0; i < DELTA_CODEC_CHANNELS; i++ ) {
+            if ( m & ( 1UL << i ) ) {
+                if ( changed & ( 1UL << k ) ) {
+                    uint32_t z;
+                    if ( ( r = varint_read( &in[n], len - n, &z ) ) == 0 ) {
+                        return len - n < 5 ? SIZE_MAX : 0;
+                    }
+                    v[i] = (int32_t)( (uint32_t)prev[i] + (uint32_t)zigzag_decode( z ) );
+                    n += r;
+                }
+                k++;
+            }
+        }
+        if ( k < 32 && ( changed >> k ) != 0 ) {
+            return 0; // maskに無いチャンネルが変わったことになっている
+        }
+
+        memcpy( prev, v, sizeof( prev ) );
+        prev_mask = m;
+        output( m, mask, values );
+        return n;
+    }
+    void output( uint32_t m, uint32_t* mask, int32_t* values ) {
+        *mask = m;
+        for ( uint8_t i = 0; i < DELTA_CODEC_CHANNELS; i++ ) {
+            if ( m & ( 1UL << i ) ) {
+                values[i] = prev[i];
+            }
+        }
+    }
+};
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
@@ -0,0 +1,177 @@
+/*
+ * 概要：イベントの前後を切り出すフライトレコーダー(リングバッファ)
+ * Arduinoに依存しないため、ホスト(ネイティブ)ビルドでも使用できる
+ */
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+// フライトレコーダーの状態
+enum e_flight_state {
+    FLIGHT_STATE_ARMED = 0, // 常時記録中(古いフレームから上書きする)
+    FLIGHT_STATE_CAPTURING, // イベント後のフレームを記録中
+    FLIGHT_STATE_DRAINING,  // 窓の記録が終わり、読み出し待ち
+};
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：イベント前preフレーム、イベント後postフレームの窓を切り出す固定長リングバッファ
+ * 割り込み(書き込み側)からrecord()、メインループ(読み出し側)からtrigger()、pop()を呼ぶことを想定しています
+ * 普段は古いフレームから上書きし続け、trigger()の次のrecord()で窓の先頭を確定します
+ * 窓のフレームは記録中から読み出せるため、イベント後のフレームはNに収める必要はありません
+ * 読み出しが間に合わずに窓の未読フレームを上書きしそうになった場合、窓をそこで打ち切ります
+ * 窓を全て読み出すと、次のイベントを待つ状態に戻ります
+ * 注意：Nは2のべき乗であること pre < Nであること
+ *       record()を呼ぶのは1か所(1スレッド)、trigger()、pop()を呼ぶのも1か所(1スレッド)に限ること
+ */
+template <typename T, uint32_t N>
+class flight_recorder {
+    static_assert( N != 0 && ( N & ( N - 1 ) ) == 0, "N must be a power of 2" );
+
+  public:
+    flight_recorder( uint32_t pre, uint32_t post )
+        : pre( pre < N ? pre : N - 1 ), post( post ), head( 0 ), read( 0 ), armed_head( 0 ), trigger_head( 0 ), post_left( 0 ),
+          event( 0 ), pending( 0 ), state( FLIGHT_STATE_ARMED ), truncated( 0 ), windows( 0 ) {
+    }
+    ~flight_recorder() {
+    }
+    /*
+     * 概要：フレームを記録する(書き込み側専用)
+     * 引数：frame 記録するフレーム
+     * 戻り値：なし
+     */
+    void record( const T& frame ) {
+        uint32_t h = head.load( std::memory_order_relaxed );
+        e_flight_state s = state.load( std::memory_order_acquire );
+
+        if ( s == FLIGHT_STATE_ARMED ) {
+            uint8_t ev = pending.load( std::memory_order_acquire );
+            if ( ev != 0 ) {
+                // 窓の先頭を確定する(再開してから記録した分しか遡れない)
+                uint32_t filled = h - armed_head.load( std::memory_order_relaxed );
+                read.store( h - ( filled < pre ? filled : pre ), std::memory_order_relaxed );
+                trigger_head = h;
+                post_left = post;
+                event = ev;
+                pending.store( 0, std::memory_order_relaxed );
+                state.store( FLIGHT_STATE_CAPTURING, std::memory_order_release );
+                s = FLIGHT_STATE_CAPTURING;
+            }
+        }
+        if ( s == FLIGHT_STATE_DRAINING ) {
+            return;
+        }
+        if ( s == FLIGHT_STATE_CAPTURING ) {
+            if ( post_left == 0 ) {
+                state.store( FLIGHT_STATE_DRAINING, std::memory_order_release );
+                return;
+            }
+            if ( h - read.load( std::memory_order_acquire ) >= N ) {
+                // 読み出しが間に合わないので、窓をここで打ち切る
+                truncated.store( truncated.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+                state.store( FLIGHT_STATE_DRAINING, std::memory_order_release );
+                return;
+            }
+            post_left--;
+        }
+        buf[h & ( N - 1 )] = frame;
+        head.store( h + 1, std::memory_order_release );
+    }
+    /*
+     * 概要：窓の切り出しを要求する(読み出し側専用)
+     * 引数：ev イベントの種類(0以外)
+     * 戻り値：受け付けた:true 前の窓を処理中、または要求済み:false
+     * 詳細：次のrecord()で記録するフレームがイベント時刻(オフセット0)になる
+     */
+    bool trigger( uint8_t ev ) {
+        if ( ev == 0 || state.load( std::memory_order_acquire ) != FLIGHT_STATE_ARMED || pending.load( std::memory_order_relaxed ) != 0 ) {
+            return false;
+        }
+        pending.store( ev, std::memory_order_release );
+        return true;
+    }
+    /*
+     * 概要：窓のフレームを古い順に取り出す(読み出し側専用)
+     * 引数：frame 取り出したフレームの格納先
+     *       offset イベント時刻からのフレーム数の格納先(イベント前は負)
+     * 戻り値：取り出し成功:true 取り出せるフレームが無い:false
+     * 詳細：窓を全て取り出したら、次のイベントを待つ状態に戻る
+     */
+    bool pop( T* frame, int32_t* offset ) {
+        e_flight_state s = state.load( std::memory_order_acquire );
+        if ( s == FLIGHT_STATE_ARMED ) {
+            return false;
+        }
+        uint32_t r = read.load( std::memory_order_relaxed );
+        uint32_t h = head.load( std::memory_order_acquire );
+        if ( r == h ) {
+            if ( s == FLIGHT_STATE_DRAINING ) {
+                armed_head.store( h, std::memory_order_relaxed );
+                windows.store( windows.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+                state.store( FLIGHT_STATE_ARMED, std::memory_order_release );
+            }
+            return false;
+        }
+        *frame = buf[r & ( N - 1 )];
+        *offset = (int32_t)( r - trigger_head );
+        read.store( r + 1, std::memory_order_release );
+        return true;
+    }
+    /*
+     * 概要：窓を処理中か
+     * 戻り値：要求済み、記録中、読み出し待ち:true イベント待ち:false
+     */
+    bool is_busy() {
+        return state.load( std::memory_order_acquire ) != FLIGHT_STATE_ARMED || pending.load( std::memory_order_relaxed ) != 0;
+    }
+    e_flight_state get_state() {
+        return state.load( std::memory_order_acquire );
+    }
+    /*
+     * 概要：処理中の窓のイベントの種類を取得する(pop()で取り出せた後に有効)
+     */
+    uint8_t get_event() {
+        return event;
+    }
+    uint32_t get_truncated() {
+        return truncated.load( std::memory_order_relaxed );
+    }
+    uint32_t get_windows() {
+        return windows.load( std::memory_order_relaxed );
+    }
+    uint32_t capacity() {
+        return N;
+    }
+
+  private:
+    T buf[N];
+    const uint32_t pre;                // イベント前に遡るフレーム数
+    const uint32_t post;               // イベント後に記録するフレーム数(イベント時刻のフレームを含む)
+    std::atomic<uint32_t> head;        // 書き込み位置(書き込み側のみ更新)
+    std::atomic<uint32_t> read;        // 窓の読み出し位置(窓の確定時は書き込み側、以降は読み出し側が更新)
+    std::atomic<uint32_t> armed_head;  // イベント待ちに戻ったときの書き込み位置
+    uint32_t trigger_head;             // イベント時刻のフレームの位置
+    uint32_t post_left;                // イベント後に記録する残りのフレーム数
+    uint8_t event;                     // 処理中の窓のイベントの種類
+    std::atomic<uint8_t> pending;      // 要求されたイベントの種類 0:要求なし
+    std::atomic<e_flight_state> state; // 状態
+    std::atomic<uint32_t> truncated;   // 読み出しが間に合わずに打ち切った窓の数
+    std::atomic<uint32_t> windows;     // 読み出しを終えた窓の数
+};
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
@@ -0,0 +1,119 @@
+/*
+ * 概要：待ち時間の分布(パーセンタイル)を固定メモリで求めるヒストグラム
+ * Arduinoに依存しないため、ホスト(ネイティブ)ビルドでも使用できる
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define LATENCY_HIST_LINEAR ( 16 )                                  // 1刻みで数える範囲 [0, 16)
+#define LATENCY_HIST_SUB_BITS ( 3 )                                 // 2のべき乗の区間を分割するビン数のビット数(8分割、誤差12.5%以下)
+#define LATENCY_HIST_EXP_MAX ( 20 )                                 // 2^20以上は最後のビンに入れる
+#define LATENCY_HIST_BINS ( LATENCY_HIST_LINEAR + ( LATENCY_HIST_EXP_MAX - 4 ) * ( 1 << LATENCY_HIST_SUB_BITS ) )
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：待ち時間の分布を求めるヒストグラム
+ * 値を1つずつ保存せず、16未満は1刻み、16以上は2のべき乗の区間を8分割したビンで数えます
+ * パーセンタイルはビンの上端で返すため、実際の値より最大12.5%大きくなります(最大値は正確)
+ * 値の単位は呼び出し側で決めます(SDカードのベンチマークではus)
+ */
+class latency_histogram {
+  public:
+    latency_histogram() {
+        reset();
+    }
+    ~latency_histogram() {
+    }
+    void reset() {
+        count = 0;
+        max_value = 0;
+        memset( hist, 0, sizeof( hist ) );
+    }
+    void add( uint32_t value ) {
+        uint32_t bin = bin_of( value );
+        if ( hist[bin] != UINT16_MAX ) {
+            hist[bin]++;
+        }
+        if ( value > max_value ) {
+            max_value = value;
+        }
+        count++;
+    }
+    uint32_t get_count() {
+        return count;
+    }
+    uint32_t get_max() {
+        return max_value;
+    }
+    /*
+     * 概要：パーセンタイルを求める
+     * 引数：permille 求める割合 LSB:0.1[%] 500で中央値、990で99パーセンタイル
+     * 戻り値：値の小さい方からpermille/1000の割合の値が含まれるビンの上端(最大値を超えない)
+     */
+    uint32_t get_percentile( uint32_t permille ) {
+        uint32_t target = (uint32_t)( ( (uint64_t)count * permille + 999 ) / 1000 );
+        uint32_t sum = 0;
+
+        if ( count == 0 ) {
+            return 0;
+        }
+        if ( target == 0 ) {
+            target = 1;
+        }
+        for ( uint32_t bin = 0; bin < LATENCY_HIST_BINS; bin++ ) {
+            sum += hist[bin];
+            if ( sum >= target ) {
+                uint32_t upper = upper_of( bin );
+                return upper < max_value ? upper : max_value;
+            }
+        }
+        return max_value;
+    }
+
+  private:
+    uint32_t count;
+    uint32_t max_value;
+    uint16_t hist[LATENCY_HIST_BINS]; // 各ビンの数(飽和する)
+
+    static uint32_t bin_of( uint32_t value ) {
+        if ( value < LATENCY_HIST_LINEAR ) {
+            return value;
+        }
+        uint32_t exp = 31 - __builtin_clz( value ); // 4以上
+        if ( exp >= LATENCY_HIST_EXP_MAX ) {
+            return LATENCY_HIST_BINS - 1;
+        }
+        uint32_t sub = ( value >> ( exp - LATENCY_HIST_SUB_BITS ) ) & ( ( 1 << LATENCY_HIST_SUB_BITS ) - 1 );
+        return LATENCY_HIST_LINEAR + ( exp - 4 ) * ( 1 << LATENCY_HIST_SUB_BITS ) + sub;
+    }
+    static uint32_t upper_of( uint32_t bin ) {
+        if ( bin < LATENCY_HIST_LINEAR ) {
+            return bin;
+        }
+        if ( bin == LATENCY_HIST_BINS - 1 ) {
+            return UINT32_MAX;
+        }
+        uint32_t exp = ( bin - LATENCY_HIST_LINEAR ) / ( 1 << LATENCY_HIST_SUB_BITS ) + 4;
+        uint32_t sub = ( bin - LATENCY_HIST_LINEAR ) % ( 1 << LATENCY_HIST_SUB_BITS );
+        uint32_t step = 1UL << ( exp - LATENCY_HIST_SUB_BITS );
+        return ( 1UL << exp ) + ( sub + 1 ) * step - 1;
+    }
+};
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
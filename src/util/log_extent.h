@@ -0,0 +1,192 @@
+/*
+ * 概要：ログファイル用に確保した連続セクタ領域(エクステント)の書き込み位置とフッタを管理する
+ * Arduinoに依存しないため、ホスト(ネイティブ)ビルドでもファイルをディスクイメージとして使用できる
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if !defined( ARDUINO_ARCH_RENESAS )
+#include <stdio.h>
+#endif
+#include <CRC32.h>
+#include "sector_stream.h"
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define LOG_FOOTER_MAGIC "MCRFOOT1" // フッタセクタの先頭に書く識別子(8文字)
+
+// エクステントの最後のセクタに書くフッタ
+typedef struct {
+    char magic[8];         // LOG_FOOTER_MAGIC
+    uint32_t first_sector; // エクステントの先頭セクタ
+    uint32_t sector_count; // 確保したエクステントのセクタ数
+    uint32_t data_bytes;   // ログの有効バイト数
+    uint32_t data_sectors; // 書き込んだデータのセクタ数(フッタはこの直後のセクタ)
+    uint32_t errors;       // 書き込みに失敗したセクタ数
+    uint32_t crc;          // crcより前のCRC32
+} log_footer_t;
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：セクタ単位で読み書きするブロックデバイスのインターフェース
+ * マイコンではSDカード、ホストではディスクイメージのファイルを使う
+ */
+class block_device {
+  public:
+    virtual ~block_device() {
+    }
+    virtual bool read_sector( uint32_t sector, uint8_t* buf ) = 0;
+    virtual bool write_sector( uint32_t sector, const uint8_t* buf ) = 0;
+};
+
+#if !defined( ARDUINO_ARCH_RENESAS )
+/*
+ * 概要：ファイルをディスクイメージとして扱うブロックデバイス(ホストビルド用)
+ */
+class image_block_device : public block_device {
+  public:
+    image_block_device( FILE* fp ) : fp( fp ) {
+    }
+    bool read_sector( uint32_t sector, uint8_t* buf ) override {
+        return fseek( fp, (long)sector * SECTOR_SIZE, SEEK_SET ) == 0 && fread( buf, SECTOR_SIZE, 1, fp ) == 1;
+    }
+    bool write_sector( uint32_t sector, const uint8_t* buf ) override {
+        return fseek( fp, (long)sector * SECTOR_SIZE, SEEK_SET ) == 0 && fwrite( buf, SECTOR_SIZE, 1, fp ) == 1;
+    }
+
+  private:
+    FILE* fp;
+};
+#endif
+
+/*
+ * 概要：連続セクタ領域の書き込み位置とフッタを管理するクラス
+ * データは領域の先頭から順に書き込まれる前提で、mark_written()で書き込んだセクタを数えます
+ * 領域の最後の1セクタはフッタ用に空けておき、データのセクタ数はその手前までに制限します
+ * finalize()はデータの直後のセクタにフッタを書きます。ファイルはフッタのセクタまでに切り詰めること
+ * ファイルの最後のセクタのフッタを読めば、0で埋めた最後のセクタの余りを除いたログの長さがわかります
+ */
+class log_extent {
+  public:
+    log_extent() {
+        begin( 0, 0 );
+    }
+    ~log_extent() {
+    }
+    /*
+     * 概要：領域を設定する
+     * 引数：first 先頭セクタ last 最後のセクタ(フッタを書くセクタ)
+     */
+    void begin( uint32_t first, uint32_t last ) {
+        first_sector = first;
+        sector_count = ( last >= first ) ? last - first + 1 : 0;
+        written = 0;
+        errors = 0;
+    }
+    /*
+     * 概要：データに使えるセクタ数
+     */
+    uint32_t data_capacity() {
+        return sector_count > 1 ? sector_count - 1 : 0;
+    }
+    /*
+     * 概要：次に書き込むセクタ(finalize()後はフッタのセクタ)
+     */
+    uint32_t next_sector() {
+        return first_sector + written;
+    }
+    /*
+     * 概要：フッタまで含めたファイル長
+     */
+    uint32_t file_bytes() {
+        return ( written + 1 ) * SECTOR_SIZE;
+    }
+    /*
+     * 概要：データのセクタを1つ書き込んだことを記録する
+     * 引数：ok 書き込み成功:true 失敗:false
+     * 戻り値：記録できた:true 領域が一杯:false
+     */
+    bool mark_written( bool ok ) {
+        if ( is_full() ) {
+            return false;
+        }
+        written++;
+        if ( !ok ) {
+            errors++;
+        }
+        return true;
+    }
+    bool is_full() {
+        return written >= data_capacity();
+    }
+    uint32_t get_written() {
+        return written;
+    }
+    uint32_t get_errors() {
+        return errors;
+    }
+    /*
+     * 概要：フッタを作成して書き込む
+     * 引数：dev ブロックデバイス data_bytes ログの有効バイト数
+     * 戻り値：成功:true 失敗:false
+     */
+    bool finalize( block_device* dev, uint32_t data_bytes ) {
+        uint8_t sector[SECTOR_SIZE];
+        log_footer_t footer;
+
+        if ( sector_count == 0 ) {
+            return false;
+        }
+        memcpy( footer.magic, LOG_FOOTER_MAGIC, sizeof( footer.magic ) );
+        footer.first_sector = first_sector;
+        footer.sector_count = sector_count;
+        footer.data_bytes = data_bytes;
+        footer.data_sectors = written;
+        footer.errors = errors;
+        footer.crc = CRC32::calculate( (const uint8_t*)&footer, offsetof( log_footer_t, crc ) );
+
+        memset( sector, 0, sizeof( sector ) );
+        memcpy( sector, &footer, sizeof( footer ) );
+        return dev->write_sector( next_sector(), sector );
+    }
+    /*
+     * 概要：フッタを読む
+     * 引数：dev ブロックデバイス sector フッタのセクタ footer 読んだフッタの格納先
+     * 戻り値：正しいフッタがある:true 無い、または壊れている:false
+     */
+    static bool read_footer( block_device* dev, uint32_t sector, log_footer_t* footer ) {
+        uint8_t buf[SECTOR_SIZE];
+
+        if ( !dev->read_sector( sector, buf ) ) {
+            return false;
+        }
+        memcpy( footer, buf, sizeof( *footer ) );
+        return is_valid_footer( footer ) && footer->first_sector + footer->data_sectors == sector;
+    }
+    static bool is_valid_footer( const log_footer_t* footer ) {
+        return memcmp( footer->magic, LOG_FOOTER_MAGIC, sizeof( footer->magic ) ) == 0 &&
+               footer->crc == CRC32::calculate( (const uint8_t*)footer, offsetof( log_footer_t, crc ) );
+    }
+
+  private:
+    uint32_t first_sector;
+    uint32_t sector_count;
+    uint32_t written; // 書き込んだデータのセクタ数
+    uint32_t errors;  // 書き込みに失敗したデータのセクタ数
+};
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
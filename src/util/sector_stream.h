@@ -0,0 +1,281 @@
+/*
+ * 概要：ログのバイト列を512バイトのセクタにまとめ、ブロックデバイスへ非同期に書き込む
+ * Arduinoに依存しないため、ホスト(ネイティブ)ビルドでも偽のブロックデバイスと組み合わせて使用できる
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+#define SECTOR_SIZE ( 512 ) // 1セクタのバイト数
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：セクタ単位で非同期に書き込むブロックデバイスのインターフェース
+ * start_write()で書き込みを開始し、書き込みが終わったら(割り込みからでもよい)
+ * set_callback()で登録された関数を呼ぶこと
+ */
+class sector_device {
+  public:
+    typedef void ( *complete_callback_t )( void* context, bool ok );
+
+    virtual ~sector_device() {
+    }
+    /*
+     * 概要：次のセクタの書き込みを開始できるか
+     * 戻り値：開始できる:true 前回の転送中、またはカードが書き込み中:false
+     */
+    virtual bool is_ready() = 0;
+    /*
+     * 概要：1セクタの書き込みを開始する
+     * 引数：sector 書き込むデータ(SECTOR_SIZEバイト) 完了通知までデバイスが参照する
+     * 戻り値：開始成功:true 失敗:false
+     */
+    virtual bool start_write( const uint8_t* sector ) = 0;
+    /*
+     * 概要：転送の後処理を進める
+     * 詳細：割り込みで完了できないデバイスはここで後処理を行い、完了を通知する
+     */
+    virtual void poll() {
+    }
+    void set_callback( complete_callback_t cb, void* ctx ) {
+        callback = cb;
+        context = ctx;
+    }
+
+  protected:
+    void notify_complete( bool ok ) {
+        if ( callback != nullptr ) {
+            callback( context, ok );
+        }
+    }
+
+  private:
+    complete_callback_t callback = nullptr;
+    void* context = nullptr;
+};
+
+/*
+ * 概要：N面のセクタバッファを回して、ブロックデバイスへ非同期に書き込むクラス
+ * write()で書き込んだバイト列は512バイトたまるとREADYになり、poll()でデバイスへ渡されます
+ * デバイスの書き込みが終わるとバッファはFREEに戻り、set_callback()で登録された関数が呼ばれます
+ * バッファの状態は FREE -> FILLING -> READY -> WRITING -> FREE の順に遷移します
+ * 注意：write()、flush()、poll()は同じコンテキスト(loop)から呼ぶこと
+ *       デバイスの完了通知は割り込みから呼ばれてもよい
+ */
+template <uint8_t N>
+class sector_stream {
+    static_assert( N >= 2, "N must be 2 or more" );
+
+  public:
+    enum e_buffer_state {
+        BUFFER_FREE = 0, // 空き
+        BUFFER_FILLING,  // write()で書き込み中
+        BUFFER_READY,    // 512バイトたまり、書き込み待ち
+        BUFFER_WRITING,  // デバイスが書き込み中
+    };
+    typedef void ( *sector_callback_t )( void* context, uint32_t sector_index, bool ok );
+
+    sector_stream( sector_device* dev ) : dev( dev ) {
+        dev->set_callback( on_device_complete, this );
+        begin( UINT32_MAX );
+    }
+    ~sector_stream() {
+    }
+    /*
+     * 概要：書き込みを開始する
+     * 引数：max_sectors 書き込めるセクタ数の上限(確保した領域の大きさ)
+     */
+    void begin( uint32_t max_sectors ) {
+        for ( uint8_t i = 0; i < N; i++ ) {
+            state[i].store( BUFFER_FREE, std::memory_order_relaxed );
+        }
+        fill_index = 0;
+        fill_len = 0;
+        write_index.store( 0, std::memory_order_relaxed );
+        sector_limit = max_sectors;
+        sectors_queued = 0;
+        sectors_written.store( 0, std::memory_order_relaxed );
+        errors.store( 0, std::memory_order_relaxed );
+        overflow_bytes = 0;
+        bytes_accepted = 0;
+    }
+    void set_callback( sector_callback_t cb, void* ctx ) {
+        callback = cb;
+        context = ctx;
+    }
+    /*
+     * 概要：バイト列を書き込む
+     * 引数：data データ len バイト数
+     * 戻り値：受け付けたバイト数 空きバッファが無い、または上限に達した場合はlenより小さくなる
+     */
+    size_t write( const void* data, size_t len ) {
+        const uint8_t* src = (const uint8_t*)data;
+        size_t done = 0;
+
+        while ( done < len ) {
+            uint8_t s = state[fill_index].load( std::memory_order_acquire );
+            if ( s == BUFFER_FREE ) {
+                if ( sectors_queued >= sector_limit ) {
+                    break;
+                }
+                state[fill_index].store( BUFFER_FILLING, std::memory_order_relaxed );
+                fill_len = 0;
+            } else if ( s != BUFFER_FILLING ) {
+                break; // 全てのバッファが書き込み待ち、または書き込み中
+            }
+
+            size_t n = SECTOR_SIZE - fill_len;
+            if ( n > len - done ) {
+                n = len - done;
+            }
+            memcpy( &buf[fill_index][fill_len], &src[done], n );
+            fill_len += n;
+            done += n;
+            if ( fill_len == SECTOR_SIZE ) {
+                queue_fill_buffer();
+            }
+        }
+        bytes_accepted += done;
+        overflow_bytes += len - done;
+        return done;
+    }
+    /*
+     * 概要：書き込み途中のバッファを0で埋めて書き込み待ちにする
+     * 戻り値：0で埋めたバイト数
+     * 詳細：ログの最後に呼ぶ。埋めたバイトはget_bytes_accepted()に含まれない
+     */
+    size_t flush() {
+        if ( state[fill_index].load( std::memory_order_acquire ) != BUFFER_FILLING || fill_len == 0 ) {
+            return 0;
+        }
+        size_t pad = SECTOR_SIZE - fill_len;
+        memset( &buf[fill_index][fill_len], 0, pad );
+        fill_len = SECTOR_SIZE;
+        queue_fill_buffer();
+        return pad;
+    }
+    /*
+     * 概要：書き込み待ちのバッファがあり、デバイスが受け付けられるならば書き込みを開始する
+     * 詳細：loop()から繰り返し呼ぶこと
+     */
+    void poll() {
+        dev->poll();
+
+        uint8_t w = write_index.load( std::memory_order_relaxed );
+        if ( state[w].load( std::memory_order_acquire ) != BUFFER_READY || !dev->is_ready() ) {
+            return;
+        }
+        state[w].store( BUFFER_WRITING, std::memory_order_release );
+        if ( !dev->start_write( buf[w] ) ) {
+            complete( false );
+        }
+    }
+    /*
+     * 概要：全てのバッファが空いたか(書き込みが全て終わったか)
+     */
+    bool is_idle() {
+        for ( uint8_t i = 0; i < N; i++ ) {
+            uint8_t s = state[i].load( std::memory_order_acquire );
+            if ( s == BUFFER_READY || s == BUFFER_WRITING ) {
+                return false;
+            }
+        }
+        return true;
+    }
+    /*
+     * 概要：今write()で受け付けられるバイト数
+     * 詳細：空きバッファと書き込み途中のバッファの残りの合計(書き込めるセクタ数の上限を超える分は含まない)
+     */
+    size_t bytes_free() {
+        size_t free_bytes = 0;
+        uint32_t sectors = sectors_queued;
+
+        if ( state[fill_index].load( std::memory_order_acquire ) == BUFFER_FILLING ) {
+            free_bytes = SECTOR_SIZE - fill_len;
+            sectors++;
+        }
+        for ( uint8_t i = 0; i < N; i++ ) {
+            if ( state[i].load( std::memory_order_acquire ) == BUFFER_FREE && sectors < sector_limit ) {
+                free_bytes += SECTOR_SIZE;
+                sectors++;
+            }
+        }
+        return free_bytes;
+    }
+    size_t capacity() {
+        return N * SECTOR_SIZE;
+    }
+    uint8_t get_state( uint8_t i ) {
+        return state[i].load( std::memory_order_acquire );
+    }
+    uint32_t get_sectors_written() {
+        return sectors_written.load( std::memory_order_acquire );
+    }
+    uint32_t get_errors() {
+        return errors.load( std::memory_order_acquire );
+    }
+    uint32_t get_bytes_accepted() {
+        return bytes_accepted;
+    }
+    uint32_t get_overflow_bytes() {
+        return overflow_bytes;
+    }
+
+  private:
+    sector_device* dev;
+    uint8_t buf[N][SECTOR_SIZE];
+    std::atomic<uint8_t> state[N];
+    uint8_t fill_index;                    // write()が書き込むバッファ(loop側のみ更新)
+    size_t fill_len;                       // fill_indexのバッファにたまったバイト数
+    std::atomic<uint8_t> write_index;      // デバイスが書き込む(次に書き込む)バッファ(完了通知側のみ更新)
+    uint32_t sector_limit;                 // 書き込めるセクタ数の上限
+    uint32_t sectors_queued;               // 書き込み待ちにしたセクタ数
+    std::atomic<uint32_t> sectors_written; // 書き込みが終わったセクタ数
+    std::atomic<uint32_t> errors;          // 書き込みに失敗したセクタ数
+    uint32_t overflow_bytes;               // バッファが足りず捨てたバイト数
+    uint32_t bytes_accepted;               // 受け付けたバイト数
+    sector_callback_t callback = nullptr;
+    void* context = nullptr;
+
+    void queue_fill_buffer() {
+        state[fill_index].store( BUFFER_READY, std::memory_order_release );
+        fill_index = ( fill_index + 1 ) % N;
+        fill_len = 0;
+        sectors_queued++;
+    }
+    void complete( bool ok ) {
+        uint8_t w = write_index.load( std::memory_order_relaxed );
+        uint32_t index = sectors_written.load( std::memory_order_relaxed );
+
+        state[w].store( BUFFER_FREE, std::memory_order_release );
+        write_index.store( ( w + 1 ) % N, std::memory_order_release );
+        if ( !ok ) {
+            errors.store( errors.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+        }
+        sectors_written.store( index + 1, std::memory_order_release );
+        if ( callback != nullptr ) {
+            callback( context, index, ok );
+        }
+    }
+    static void on_device_complete( void* context, bool ok ) {
+        ( (sector_stream*)context )->complete( ok );
+    }
+};
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
@@ -0,0 +1,89 @@
+/*
+ * 概要：1対1(単一の書き込み側と単一の読み出し側)のロックフリーキュー
+ * Arduinoに依存しないため、ホスト(ネイティブ)ビルドでも使用できる
+ */
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：固定長の1対1ロックフリーキュー
+ * 割り込み(書き込み側)からpush()、メインループ(読み出し側)からpop()を呼ぶことを想定しています
+ * push()、pop()は待ちが発生せず、割り込み禁止も使いません
+ * 満杯のときpush()は要素を捨て、捨てた数を数えます
+ * 注意：Nは2のべき乗であること
+ *       push()を呼ぶのは1か所(1スレッド)、pop()を呼ぶのも1か所(1スレッド)に限ること
+ */
+template <typename T, uint32_t N>
+class spsc_queue {
+    static_assert( N != 0 && ( N & ( N - 1 ) ) == 0, "N must be a power of 2" );
+
+  public:
+    spsc_queue() : head( 0 ), tail( 0 ), dropped( 0 ) {
+    }
+    ~spsc_queue() {
+    }
+    /*
+     * 概要：要素を追加する(書き込み側専用)
+     * 引数：item 追加する要素
+     * 戻り値：追加成功:true 満杯:false
+     */
+    bool push( const T& item ) {
+        uint32_t t = tail.load( std::memory_order_relaxed );
+        if ( t - head.load( std::memory_order_acquire ) >= N ) {
+            dropped.store( dropped.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            return false;
+        }
+        buf[t & ( N - 1 )] = item;
+        tail.store( t + 1, std::memory_order_release );
+        return true;
+    }
+    /*
+     * 概要：要素を取り出す(読み出し側専用)
+     * 引数：item 取り出した要素の格納先
+     * 戻り値：取り出し成功:true 空:false
+     */
+    bool pop( T* item ) {
+        uint32_t h = head.load( std::memory_order_relaxed );
+        if ( h == tail.load( std::memory_order_acquire ) ) {
+            return false;
+        }
+        *item = buf[h & ( N - 1 )];
+        head.store( h + 1, std::memory_order_release );
+        return true;
+    }
+    uint32_t size() {
+        return tail.load( std::memory_order_acquire ) - head.load( std::memory_order_acquire );
+    }
+    uint32_t capacity() {
+        return N;
+    }
+    uint32_t get_dropped() {
+        return dropped.load( std::memory_order_relaxed );
+    }
+
+  private:
+    T buf[N];
+    std::atomic<uint32_t> head; // 読み出し位置(読み出し側のみ更新)
+    std::atomic<uint32_t> tail; // 書き込み位置(書き込み側のみ更新)
+    std::atomic<uint32_t> dropped;
+};
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
@@ -0,0 +1,114 @@
+/*
+ * 概要：周期タスクの遅れ、抜け、処理時間超過を検出する
+ * Arduinoに依存しないため、ホスト(ネイティブ)ビルドでも使用できる
+ */
+
+#pragma once
+#include <stdint.h>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：周期タスクの監視を行うクラス
+ * タスクの先頭でentry()、末尾でexit()を時刻(任意の単調増加カウンタ)と共に呼ぶと、以下を検出します
+ *  - late    : 前回の開始からの間隔が周期+許容値を超えた(周期の遅れ)
+ *  - missed  : 間隔が周期の1.5倍以上あり、タスクが実行されなかった周期がある(その数を数える)
+ *  - overrun : タスクの処理時間が周期を超えた(前回のタスクが次の周期まで終わっていない)
+ * ジッタは間隔と周期との差の絶対値で、最悪値を保持します
+ * get_faults()は3つの合計で、ある区間(走行中など)に異常があったかは区間の前後の差で判断します
+ * 時刻は32bitで一周してもよい(差分はu4同士の引き算で求める)
+ */
+class tick_monitor {
+  public:
+    tick_monitor( uint32_t period, uint32_t tolerance ) : period( period ), tolerance( tolerance ) {
+        reset();
+    }
+    ~tick_monitor() {
+    }
+    void reset() {
+        started = false;
+        ticks = 0;
+        late = 0;
+        missed = 0;
+        overrun = 0;
+        worst_jitter = 0;
+        last_jitter = 0;
+    }
+    void entry( uint32_t now ) {
+        if ( started ) {
+            uint32_t interval = now - last_entry;
+            uint32_t jitter = ( interval > period ) ? interval - period : period - interval;
+
+            last_jitter = jitter;
+            if ( jitter > worst_jitter ) {
+                worst_jitter = jitter;
+            }
+            if ( interval > period + tolerance ) {
+                late++;
+            }
+            if ( interval >= period + period / 2 ) {
+                missed += ( interval + period / 2 ) / period - 1;
+            }
+        }
+        started = true;
+        last_entry = now;
+        ticks++;
+    }
+    void exit( uint32_t now ) {
+        if ( now - last_entry > period ) {
+            overrun++;
+        }
+    }
+    bool is_fault() {
+        return late != 0 || missed != 0 || overrun != 0;
+    }
+    uint32_t get_faults() {
+        return late + missed + overrun;
+    }
+    uint32_t get_ticks() {
+        return ticks;
+    }
+    uint32_t get_late() {
+        return late;
+    }
+    uint32_t get_missed() {
+        return missed;
+    }
+    uint32_t get_overrun() {
+        return overrun;
+    }
+    uint32_t get_worst_jitter() {
+        return worst_jitter;
+    }
+    uint32_t get_last_jitter() {
+        return last_jitter;
+    }
+
+  private:
+    uint32_t period;    // 周期
+    uint32_t tolerance; // 遅れとみなさない許容値
+    bool started;
+    uint32_t last_entry;
+    uint32_t ticks;
+    uint32_t late;
+    uint32_t missed;
+    uint32_t overrun;
+    uint32_t worst_jitter;
+    uint32_t last_jitter;
+};
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+
+/***********************************/
+/* Global Variables                */
+/***********************************/
@@ -0,0 +1,181 @@
+/*
+ * 概要：シリアル転送用のCRC32付きフレーム
+ * Arduinoに依存しないため、ホスト(ネイティブ)ビルドでも使用できる
+ * ホスト側の実装はscripts/mcr_log_download.py
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <CRC32.h>
+
+/******************************************************************/
+/* Definitions                                                    */
+/******************************************************************/
+/***********************************/
+/* Global definitions              */
+/***********************************/
+/*
+ * フレームの形式(リトルエンディアン)
+ *   XFER_SOF0 XFER_SOF1 種類(u1) ペイロード長(u2) ペイロード CRC32(u4)
+ *   CRC32は種類からペイロードの最後までを対象にする
+ */
+#define XFER_SOF0 ( 0xAA )
+#define XFER_SOF1 ( 0x55 )
+#define XFER_HEAD_SIZE ( 5 )                                                                // SOF、種類、ペイロード長のバイト数
+#define XFER_CRC_SIZE ( 4 )                                                                 // CRC32のバイト数
+#define XFER_SECTOR_SIZE ( 512 )                                                            // データフレームで送るセクタのバイト数
+#define XFER_PAYLOAD_MAX ( 4 + XFER_SECTOR_SIZE )                                           // ペイロードの最大バイト数(データフレーム)
+#define XFER_FRAME_MAX ( XFER_HEAD_SIZE + XFER_PAYLOAD_MAX + XFER_CRC_SIZE )                // フレームの最大バイト数
+#define xfer_frame_payload( frame ) ( (uint8_t*)( frame ) + XFER_HEAD_SIZE )                // フレームのペイロードの先頭
+#define xfer_frame_size( payload_len ) ( XFER_HEAD_SIZE + ( payload_len ) + XFER_CRC_SIZE ) // フレームのバイト数
+
+// フレームの種類
+enum e_xfer_type {
+    XFER_TYPE_INFO = 'I',    // 機器->ホスト ファイル情報 サイズ(u4) セクタ数(u4) / ホスト->機器 ファイル情報の再送要求(ペイロード無し)
+    XFER_TYPE_REQUEST = 'R', // ホスト->機器 セクタの要求 先頭セクタ(u4) セクタ数(u2)
+    XFER_TYPE_DATA = 'D',    // 機器->ホスト セクタ セクタ番号(u4) データ(最後のセクタ以外はXFER_SECTOR_SIZEバイト)
+    XFER_TYPE_ERROR = 'E',   // 機器->ホスト エラー エラーコード(u1)
+    XFER_TYPE_QUIT = 'Q',    // ホスト->機器 転送終了(ペイロード無し)
+};
+
+// エラーコード
+enum e_xfer_error {
+    XFER_ERROR_NONE = 0,
+    XFER_ERROR_OPEN,  // ファイルを開けない
+    XFER_ERROR_BUSY,  // ロギング中
+    XFER_ERROR_FAULT, // SDカードの異常
+};
+
+/***********************************/
+/* Class                           */
+/***********************************/
+/*
+ * 概要：1バイトずつ受け取ってフレームを取り出すパーサ
+ * SOFを探し直すため、フレームの間にフレーム以外のバイト(シェルのエコーなど)があっても読み飛ばします
+ * CRC32が合わないフレーム、ペイロードがNを超えるフレームは捨て、捨てた数を数えます
+ */
+template <uint16_t N>
+class xfer_frame_parser {
+  public:
+    xfer_frame_parser() : state( STATE_SOF0 ), type( 0 ), len( 0 ), pos( 0 ), errors( 0 ) {
+    }
+    ~xfer_frame_parser() {
+    }
+    /*
+     * 概要：1バイト受け取る
+     * 引数：c 受信したバイト
+     * 戻り値：正しいフレームを受け取り終えた:true それ以外:false
+     * 詳細：trueを返したら、次にfeed()を呼ぶまでget_type()、get_payload()、get_len()が有効
+     */
+    bool feed( uint8_t c ) {
+        switch ( state ) {
+        case STATE_SOF0:
+            if ( c == XFER_SOF0 ) {
+                state = STATE_SOF1;
+            }
+            break;
+        case STATE_SOF1:
+            state = ( c == XFER_SOF1 ) ? STATE_TYPE : ( c == XFER_SOF0 ) ? STATE_SOF1 : STATE_SOF0;
+            break;
+        case STATE_TYPE:
+            type = c;
+            crc.reset();
+            crc.update( c );
+            state = STATE_LEN0;
+            break;
+        case STATE_LEN0:
+            len = c;
+            crc.update( c );
+            state = STATE_LEN1;
+            break;
+        case STATE_LEN1:
+            len |= (uint16_t)c << 8;
+            crc.update( c );
+            pos = 0;
+            if ( len > N ) {
+                errors++;
+                state = STATE_SOF0;
+            } else {
+                state = ( len == 0 ) ? STATE_CRC : STATE_PAYLOAD;
+            }
+            break;
+        case STATE_PAYLOAD:
+            payload[pos++] = c;
+            crc.update( c );
+            if ( pos == len ) {
+                pos = 0;
+                state = STATE_CRC;
+            }
+            break;
+        case STATE_CRC:
+            rx_crc[pos++] = c;
+            if ( pos == XFER_CRC_SIZE ) {
+                uint32_t value;
+                memcpy( &value, rx_crc, sizeof( value ) );
+                state = STATE_SOF0;
+                if ( value == crc.finalize() ) {
+                    return true;
+                }
+                errors++;
+            }
+            break;
+        }
+        return false;
+    }
+    uint8_t get_type() {
+        return type;
+    }
+    const uint8_t* get_payload() {
+        return payload;
+    }
+    uint16_t get_len() {
+        return len;
+    }
+    uint32_t get_errors() {
+        return errors;
+    }
+
+  private:
+    enum e_state {
+        STATE_SOF0 = 0,
+        STATE_SOF1,
+        STATE_TYPE,
+        STATE_LEN0,
+        STATE_LEN1,
+        STATE_PAYLOAD,
+        STATE_CRC,
+    };
+    e_state state;
+    uint8_t type;
+    uint16_t len;
+    uint16_t pos;
+    uint8_t payload[N];
+    uint8_t rx_crc[XFER_CRC_SIZE];
+    CRC32 crc;
+    uint32_t errors; // 捨てたフレームの数
+};
+
+/***********************************/
+/* Global functions                */
+/***********************************/
+/*
+ * 概要：ペイロードを詰めたフレームのヘッダとCRC32を書き込む
+ * 引数：frame フレームの先頭(ペイロードはxfer_frame_payload(frame)に詰めておく) type 種類 len ペイロード長
+ * 戻り値：フレームのバイト数
+ * 詳細：ペイロードをコピーせずにフレームにするため、送信バッファに直接ペイロードを読み込んでから呼ぶ
+ */
+static inline uint16_t xfer_frame_finish( uint8_t* frame, uint8_t type, uint16_t len ) {
+    frame[0] = XFER_SOF0;
+    frame[1] = XFER_SOF1;
+    frame[2] = type;
+    frame[3] = (uint8_t)len;
+    frame[4] = (uint8_t)( len >> 8 );
+    uint32_t crc = CRC32::calculate( &frame[2], 3 + len );
+    memcpy( &frame[XFER_HEAD_SIZE + len], &crc, sizeof( crc ) ); // RA4M1はリトルエンディアン
+    return xfer_frame_size( len );
+}
+
+/***********************************/
+/* Global Variables                */
+/***********************************/